@@ -169,16 +169,17 @@ class BytePairEncoder:
 
     @property
     def cache_period(self) -> int:
-        """Returns the cache cleanup period. The cache is used for Encode calls acceleration.
-        The result of the encode call is cached and will be erased if 
-        no call with the same word will occur among next 1-2 X cachePeriod calls.
+        """Returns the cache size. The cache is used for Encode calls acceleration.
+        The cache keeps the results for at most cache_period words.
+        The words are split into up to 16 parts by their hash, and the least recently requested words
+        of a part are erased when it is full.
         :rtype: int.
         """
         return self._internal.get_cache_period()
 
     @cache_period.setter
     def cache_period(self, period: int) -> None:
-        """Sets the cache cleanup period.
+        """Sets the cache size. The cache is cleared.
         """
         # -1 disables cache, 0 causes assert
         if period < 1:
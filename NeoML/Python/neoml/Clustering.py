@@ -242,7 +242,10 @@ class KMeans(PythonWrapper.KMeans) :
     :type cluster_count: int
 
     :param algo: the algorithm used during clustering.
-    :type algo: str, {'elkan', 'lloyd'}, default='lloyd'
+        'hamerly' keeps one lower bound per element instead of one per element and cluster in 'elkan';
+        'minibatch' updates the centers on random batches of `mini_batch_size` elements;
+        'hamerly' and 'minibatch' support only the 'euclid' distance.
+    :type algo: str, {'elkan', 'lloyd', 'hamerly', 'minibatch'}, default='lloyd'
 
     :param init: the algorithm used for selecting initial centers.
     :type init: str, {'k++', 'default'}, default='default'
@@ -258,16 +261,21 @@ class KMeans(PythonWrapper.KMeans) :
 
     :param seed: the initial seed for random
     :type seed: int, default=3306
+
+    :param mini_batch_size: the number of elements in a batch for the 'minibatch' algorithm
+    :type mini_batch_size: int, > 0, default=1024
     """
 
     def __init__(self, max_iteration_count, cluster_count, algo='lloyd', init='default', distance='euclid',
-                 thread_count=1, run_count=1, seed=3306):
-        if algo != 'elkan' and algo != 'lloyd':
-            raise ValueError('The `algo` must be one of {`elkan`, `lloyd`}.')
+                 thread_count=1, run_count=1, seed=3306, mini_batch_size=1024):
+        if algo not in ('elkan', 'lloyd', 'hamerly', 'minibatch'):
+            raise ValueError('The `algo` must be one of {`elkan`, `lloyd`, `hamerly`, `minibatch`}.')
         if init != 'k++' and init != 'default':
             raise ValueError('The `init` must be one of {`k++`, `default`}.')
         if distance != 'euclid' and distance != 'machalanobis' and distance != 'cosine':
             raise ValueError('The `distance` must be one of {`euclid`, `machalanobis`, `cosine`}.')
+        if algo in ('hamerly', 'minibatch') and distance != 'euclid':
+            raise ValueError('The `hamerly` and `minibatch` algorithms support only the `euclid` distance.')
         if max_iteration_count <= 0:
             raise ValueError('The `max_iteration_count` must be > 0.')
         if cluster_count <= 0:
@@ -278,8 +286,10 @@ class KMeans(PythonWrapper.KMeans) :
             raise ValueError('The `run_count` must be > 0')
         if not isinstance(seed, int):
             raise ValueError('The `seed` must be integer')
+        if mini_batch_size <= 0:
+            raise ValueError('The `mini_batch_size` must be > 0')
         super().__init__(algo, init, distance, int(max_iteration_count), int(cluster_count), int(thread_count),
-            int(run_count), int(seed))
+            int(run_count), int(seed), int(mini_batch_size))
 
     def clusterize(self, X, weight=None):
         """Performs clustering of the given data.
@@ -2854,6 +2854,11 @@ class ClusteringTestCase(MultithreadedTestCase):
     def test_kmeans(self):
         self._test_clusterize('KMeans', dict(max_iteration_count=100, cluster_count=6, init='k++'))
 
+    def test_kmeans_euclid_only_algo(self):
+        for algo in ('hamerly', 'minibatch'):
+            with self.assertRaises(ValueError):
+                neoml.Clustering.KMeans(max_iteration_count=100, cluster_count=6, algo=algo, distance='cosine')
+
 
 class TestPca(TestCase):
     def test_full_svd(self):
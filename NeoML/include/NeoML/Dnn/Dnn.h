@@ -23,7 +23,9 @@ limitations under the License.
 #include <NeoMathEngine/NeoMathEngine.h>
 #include <NeoML/Dnn/DnnBlob.h>
 #include <stdint.h>
+#include <mutex>
 #include <NeoML/Dnn/DnnLambdaHolder.h>
+#include <NeoML/Dnn/DnnProfiler.h>
 
 // The macros for the internal name of a NeoML layer
 // If this macros is used when declaring a class, that class may be registered as a NeoML layer
@@ -226,6 +228,9 @@ protected:
 	virtual void BackwardOnce() = 0;
 	// A virtual method that implements one learning step
 	virtual void LearnOnce();
+	// Indicates that the layer passes the gradients of its parameters to the solver by itself in LearnOnce
+	// via CDnnSolver::AddSparseDiff; paramDiffBlobs are not used in this case
+	virtual bool HasSparseParamDiffs() const { return false; }
 	// Indicates that learning must be performed for the layer on the current step
 	bool IsLearningPerformed() const;
 	// Indicates that learning must be performed for the layer when Learn method is called
@@ -277,6 +282,13 @@ protected:
 	// Fills with zeros the parameters that are less (but not equal) than a given threshold
 	virtual void FilterLayerParams( float /*threshold*/ ) {}
 
+	// Gets the pointers to the blobs with the layer parameters which are shared with the inference replicas
+	// (see CDnn::CreateInferenceReplica) or stored separately by CDnn::StoreMapped;
+	// these blobs are written as null by SerializeParamBlob(s) when the network is stored for that purpose
+	// Must not change the layer: the network may be running in other threads
+	// The default implementation returns the parameters of the trainable layers
+	virtual void GetSharedParamBlobs( CArray<CPtr<CDnnBlob>*>& blobs );
+
 	// Allocates the output blobs
 	// The default implementation creates the outputBlobs array using the output descriptions
 	virtual void AllocateOutputBlobs();
@@ -294,6 +306,9 @@ protected:
 	virtual int BlobsForBackward() const { return TInputBlobs | TOutputBlobs; }
 	// Blob types required for the correct work of LearnOnce
 	virtual int BlobsForLearn() const { return TInputBlobs | TOutputBlobs; }
+	// Estimates the number of floating point operations of one call of the layer method (0 if unknown)
+	// Used by the profiler
+	virtual double EstimateFlops() const { return 0; }
 
 	// Indicates if the layer overwrite its inputs
 	bool InputsMayBeOverwritten() const;
@@ -306,6 +321,10 @@ protected:
 	// Throw check exception if expr is false
 	void CheckLayerArchitecture( bool expr, const char* message ) const;
 
+	// Serializes the blobs returned by GetSharedParamBlobs (the same format as SerializeBlob(s))
+	void SerializeParamBlob( CArchive& archive, CPtr<CDnnBlob>& blob );
+	void SerializeParamBlobs( CArchive& archive, CObjectArray<CDnnBlob>& blobs );
+
 private:
 	// Describes an input connection
 	struct CInputInfo {
@@ -387,6 +406,8 @@ private:
 	IPerformanceCounters::CCounter::TCounterType runOnceTime;
 	// Indicates if the layer performs in-place processing (after the Reshape method call)
 	bool isInPlace;
+	// The output blobs placed by the static memory planning of the network (see CDnn::EnableStaticMemoryPlanning)
+	CObjectArray<CDnnBlob> plannedOutputBlobs;
 
 	// Switches the specified blobs into sequence processing mode
 	void switchBlobsToSequentialMode(CObjectArray<CDnnBlob>& blobs, TBlobCacheType cacheType, bool storeParent);
@@ -531,6 +552,19 @@ public:
 	// Releases all temporary resources allocated for RunAndBackwardOnce()
 	void CleanUp();
 
+	// Creates a network for inference which shares the parameter blobs with this network
+	// The replica has its own layers with its own runtime and output blobs, so this network and its replicas
+	// may be run at the same time from different threads (on the same math engine)
+	// The replica may be created while this network is run for inference in another thread
+	// The parameters of this network must be initialized (the network is loaded or has been run at least once)
+	// and must not be changed while the replicas exist
+	// Only the float parameter blobs are shared, the 16-bit copies of the weights are copied into the replica
+	// The learning and backpropagation are forbidden for the replica
+	// The replica is owned by the caller and uses the given random numbers generator
+	CDnn* CreateInferenceReplica( CRandom& replicaRandom );
+	// Indicates that the network has been created by CreateInferenceReplica
+	bool IsInferenceReplica() const { return isInferenceReplica; }
+
 	// Gets the maximum sequence length
 	int GetMaxSequenceLength() const { return maxSequenceLength; }
 	// Gets the current position in sequence (makes sense when calling from one of the Run... methods)
@@ -590,8 +624,50 @@ public:
 	// When loading from checkpoint creates new solver (old pointers will point to an object, not used by this net anymore)
 	void SerializeCheckpoint( CArchive& archive );
 
+	// Stores the network into a file for LoadMapped
+	// The shared parameter blobs (see CBaseLayer::GetSharedParamBlobs) are written after the rest of the network
+	// at page-aligned positions
+	// The network is not changed, so it may be run for inference in other threads meanwhile
+	void StoreMapped( const char* fileName );
+	// Loads the network from a file created by StoreMapped
+	// On a CPU math engine the file is mapped into memory and the shared parameter blobs use its pages without copying,
+	// so the loading time doesn't depend on the parameters size and the processes loading the same file share the pages
+	// The mapping is copy-on-write: the file is never modified, the changed pages become private to the process
+	// The file may be removed or replaced only after all the blobs have been destroyed
+	// On other math engines the parameters are copied from the mapped file
+	void LoadMapped( const char* fileName );
+
 	// Enables profiling for all the layers in the network
 	void EnableProfile( bool profile );
+	// Sets the profiler which records each call of the layers forward, backward and learn methods
+	// The profiler is not owned by the network and must stay alive while it is set; null stops recording
+	// The internal networks of the composite layers use the profiler of the root network
+	void SetProfiler( CDnnProfiler* newProfiler ) { profiler = newProfiler; }
+	CDnnProfiler* GetProfiler() const { return profiler; }
+
+	// Enables the static memory planning for RunOnce
+	// After reshape the lifetimes of the layers outputs are analyzed and all of them are placed into one buffer,
+	// so the outputs which aren't used at the same time share the memory
+	// Only the outputs connected to the sink layers stay valid after the run
+	// Off by default; the memory planning is not used for RunAndBackwardOnce and RunAndLearnOnce
+	// and for the sequences longer than 1 (the outputs are allocated dynamically then)
+	void EnableStaticMemoryPlanning( bool enable );
+	bool IsStaticMemoryPlanningEnabled() const { return isStaticMemoryPlanning; }
+	// Reshapes the network for RunOnce and returns the size of the buffer for the layers outputs in bytes
+	// Returns 0 if the static memory planning is disabled or not applicable
+	size_t GetPlannedPeakMemory();
+
+	// Parallel run of the independent layers (e.g. the branches of an inception block or the towers of a multi-tower model)
+	// Sets the number of threads running the layers during RunOnce; 1 (the default) runs the layers one by one,
+	// 0 or less means all the available cores
+	// The layer dependency graph is built on rebuild; each layer starts as soon as all its inputs are calculated
+	// and runs on one thread, so the results are the same as in the sequential run
+	// The math engine must support the calls from several threads (the CPU math engine does)
+	// The memory reuse mode is off during the parallel run, so it may need more memory
+	// The layers are run one by one while the static memory planning is enabled or the profiler is set,
+	// and also in RunAndBackwardOnce and RunAndLearnOnce
+	void SetRunThreadCount( int threadCount );
+	int GetRunThreadCount() const { return runThreadCount; }
 
 private:
 	// Adds or deletes a layer
@@ -621,6 +697,8 @@ private:
 	bool isLearningEnabled;
 	// Indicates that the recurrent mode is on (for a sub-network of a recurrent layer)
 	bool isRecurrentMode;
+	// Indicates that the network shares the parameters with another one and can't be trained
+	bool isInferenceReplica;
 
 	// The initializer
 	CPtr<CDnnInitializer> initializer;
@@ -636,12 +714,50 @@ private:
 	// The low memory use mode
 	bool isReuseMemoryMode;
 
+	//////////////////////////////////////
+	// For the static memory planning
+	bool isStaticMemoryPlanning;
+	// Indicates that the plan corresponds to the current layers outputs (reset on any layer reshape)
+	bool isMemoryPlanValid;
+	// The buffer which contains all the planned outputs
+	CPtr<CDnnBlob> memoryPlanBuffer;
+
+	//////////////////////////////////////
+	// For the parallel run
+	int runThreadCount;
+	IThreadPool* runThreadPool; // null if the layers are run one by one
+	// The layers in the topological order and, for each of them, the number of the input links
+	// and the indices of the layers connected to its outputs
+	CArray<CBaseLayer*> runSchedule;
+	CArray<int> runScheduleInputCounts;
+	CArray<CArray<int>> runScheduleOutputs;
+
+	// The profiler which records the layers calls
+	CDnnProfiler* profiler;
+	// Gets the profiler of the root network
+	CDnnProfiler* getProfiler() const;
+
+	// The shared parameter blobs which are not written while the network is stored by storeWithoutSharedParams
+	const CHashTable<const CDnnBlob*>* skippedSharedParams;
+	std::mutex skippedSharedParamsMutex;
+	// Checks if the blob is skipped while the root network is stored
+	bool isSharedParamSkipped( const CDnnBlob* blob ) const;
+
 	void setProcessingParams(bool isRecurrentMode, int sequenceLength, bool isReverseSequense, bool isBackwardPerformed);
 	void runOnce(int curSequencePos);
 	void backwardRunAndLearnOnce(int curSequencePos);
 	void reshape();
 	void rebuild();
 	size_t getOutputBlobsSize() const;
+	void planMemory();
+	void resetMemoryPlan();
+	bool isParallelRun() const;
+	void buildRunSchedule();
+	void runLayersParallel();
+	static void runScheduledLayers( int threadIndex, void* params );
+	static void getSharedParamBlobs( CDnnLayerGraph& graph, CArray<CPtr<CDnnBlob>*>& blobs );
+	void storeWithoutSharedParams( CArchive& archive, CObjectArray<CDnnBlob>& sharedParams );
+	void setSharedParams( const CObjectArray<CDnnBlob>& sharedParams );
 
 	friend class CBaseLayer;
 	friend class CCompositeLayer;
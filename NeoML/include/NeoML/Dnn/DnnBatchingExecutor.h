@@ -0,0 +1,105 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <NeoML/NeoMLDefs.h>
+#include <NeoML/Dnn/Dnn.h>
+
+#include <condition_variable>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NeoML {
+
+// The result of one request processed by CDnnBatchingExecutor
+class NEOML_API CDnnBatchingResult : public IObject {
+public:
+	// The output blobs in the order of CDnnBatchingExecutor::GetSinkNames()
+	// The BatchWidth of each blob is equal to the BatchWidth of the request inputs
+	const CObjectArray<CDnnBlob>& GetOutputs() const { return outputs; }
+	const CPtr<CDnnBlob>& GetOutput( int index ) const { return outputs[index]; }
+
+private:
+	CObjectArray<CDnnBlob> outputs;
+
+	friend class CDnnBatchingExecutor;
+};
+
+// Inference executor with dynamic batching
+// Accepts requests from many threads, merges them along BD_BatchWidth and runs the network once per batch
+// The requests are merged only if all their inputs have the same dimensions except BatchWidth,
+// so the requests with different sequence lengths (BatchLength) are put into different batches
+// The network is run on the executor thread, it must not be used by anyone else while the executor exists
+class NEOML_API CDnnBatchingExecutor {
+public:
+	// maxBatchSize is the maximum total BatchWidth of one batch (a single wider request is processed alone)
+	// maxQueueDelay is the maximum time (in microseconds) the first request of a batch waits for the others
+	CDnnBatchingExecutor( CDnn& dnn, int maxBatchSize, int maxQueueDelay );
+	// Processes all the requests already submitted and stops the executor thread
+	~CDnnBatchingExecutor();
+
+	int GetMaxBatchSize() const { return maxBatchSize; }
+	int GetMaxQueueDelay() const { return static_cast<int>( maxQueueDelay.count() ); }
+
+	// The names of the network source and sink layers
+	const CArray<CString>& GetSourceNames() const { return sourceNames; }
+	const CArray<CString>& GetSinkNames() const { return sinkNames; }
+
+	// Adds a request to the queue; may be called from any thread
+	// inputs[i] is the input of the GetSourceNames()[i] layer, all the inputs must have the same BatchWidth
+	// The exception thrown while processing the batch is passed to the future
+	std::future<CPtr<CDnnBatchingResult>> Submit( const CObjectArray<CDnnBlob>& inputs );
+
+	// The number of the network runs performed
+	int GetRunCount() const;
+
+private:
+	// A request waiting in the queue
+	struct CRequest {
+		CObjectArray<CDnnBlob> Inputs;
+		std::promise<CPtr<CDnnBatchingResult>> Result;
+		std::chrono::steady_clock::time_point Deadline;
+	};
+
+	CDnn& dnn;
+	const int maxBatchSize;
+	const std::chrono::microseconds maxQueueDelay;
+	CArray<CString> sourceNames;
+	CArray<CString> sinkNames;
+
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<std::unique_ptr<CRequest>> queue;
+	bool isStopped;
+	int runCount;
+	std::thread worker;
+
+	static bool canMerge( const CRequest& first, const CRequest& second );
+	void run();
+	int getCompatibleBatchSize( const CRequest& first ) const;
+	void extractBatch( std::vector<std::unique_ptr<CRequest>>& batch );
+	void processBatch( std::vector<std::unique_ptr<CRequest>>& batch );
+
+	CDnnBatchingExecutor( const CDnnBatchingExecutor& ) = delete;
+	CDnnBatchingExecutor& operator=( const CDnnBatchingExecutor& ) = delete;
+};
+
+} // namespace NeoML
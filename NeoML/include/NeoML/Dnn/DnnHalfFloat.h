@@ -0,0 +1,71 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <NeoML/NeoMLDefs.h>
+#include <NeoML/Dnn/Dnn.h>
+
+namespace NeoML {
+
+// The precision of the layer weights storage
+// The 16-bit weights take half of the memory both in RAM and in the archive
+// but may be used only for inference; they are converted to float right before the calculations
+enum TDnnWeightsPrecision {
+	DWP_Float32 = 0,
+	DWP_Float16, // see HFF_Float16: the values up to 65504 with 11 significant bits
+	DWP_BFloat16 // see HFF_BFloat16: the whole float range with 8 significant bits
+};
+
+// The 16-bit format of the precision (which must not be DWP_Float32)
+NEOML_API THalfFloatFormat GetHalfFloatFormat( TDnnWeightsPrecision precision );
+
+// The read-only blob stored in the 16-bit floating point format in the host memory
+class NEOML_API CDnnHalfFloatBlob : public IObject {
+public:
+	// Creates an empty blob to be loaded by Serialize
+	CDnnHalfFloatBlob();
+	// Converts the float blob to the given precision (which must not be DWP_Float32)
+	CDnnHalfFloatBlob( TDnnWeightsPrecision precision, const CDnnBlob& blob );
+
+	TDnnWeightsPrecision GetPrecision() const { return precision; }
+	// The dimensions of the original float blob
+	const CBlobDesc& GetDesc() const { return desc; }
+	int GetObjectCount() const { return desc.ObjectCount(); }
+	int GetObjectSize() const { return desc.ObjectSize(); }
+	int GetDataSize() const { return desc.BlobSize(); }
+	const uint16_t* GetData() const { return data.GetPtr(); }
+
+	// Converts the blob back to float
+	CPtr<CDnnBlob> GetFloatBlob( IMathEngine& mathEngine ) const;
+	// Converts one object to float in the host memory (GetObjectSize() values are written)
+	void GetFloatObject( int objectIndex, float* result ) const;
+
+	void Serialize( CArchive& archive );
+
+private:
+	TDnnWeightsPrecision precision;
+	CBlobDesc desc;
+	CArray<uint16_t> data;
+};
+
+// Sets the weights precision of all the layers of CDnn (or of a composite layer) which support it:
+// CFullyConnectedLayer (including the projections inside CMultiheadAttentionLayer and CTransformerEncoderLayer)
+// and CMultichannelLookupLayer; the layers inside of composite layers are processed too
+// The layers with fewer than minWeightsSize weights are skipped
+// Returns the number of the changed layers
+NEOML_API int SetDnnWeightsPrecision( CDnnLayerGraph& graph, TDnnWeightsPrecision precision, int minWeightsSize = 0 );
+
+} // namespace NeoML
@@ -0,0 +1,119 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <NeoML/NeoMLDefs.h>
+#include <NeoML/Dnn/Dnn.h>
+
+namespace NeoML {
+
+// Post-training int8 quantization of the layers which multiply their input by the weights matrix
+// Supported layers: CFullyConnectedLayer and CConvLayer with 1x1 filter, no padding and 1x1 stride
+// The fully-connected parts of CLstmLayer and CGruLayer are not quantized
+// Only CPU math engine is supported
+//
+// The workflow:
+//    1. call CDnnInt8Quantizer::StartCalibration
+//    2. run the network on several representative batches (the layers work in float and collect the input ranges)
+//    3. call CDnnInt8Quantizer::FinishCalibration
+// After that the layers work in int8 mode: the float weights are released and only the int8 weights are kept
+// and stored in the archive together with the quantization parameters
+// Switching back to float mode restores the float weights from the int8 ones (with the quantization error)
+
+// The int8 quantization state of a single layer
+// The input is quantized to uint8 asymmetrically (per-tensor scale and zero point)
+// The weights are quantized to int8 symmetrically (per output channel scale)
+class NEOML_API CInt8LayerQuantization {
+public:
+	CInt8LayerQuantization() = default;
+	CInt8LayerQuantization( const CInt8LayerQuantization& ) = delete;
+	~CInt8LayerQuantization() { ResetDesc(); }
+
+	CInt8LayerQuantization& operator=( const CInt8LayerQuantization& ) = delete;
+
+	bool IsCalibrating() const { return state == S_Calibrating; }
+	bool IsQuantized() const { return state == S_Quantized; }
+
+	// The quantization parameters (valid only if IsQuantized)
+	float GetInputScale() const { return inputScale; }
+	int GetInputZeroPoint() const { return inputZeroPoint; }
+	const CArray<float>& GetWeightScales() const { return weightScales; }
+	// The descriptor of the quantized weights blob (outputSize == GetObjectCount(), inputSize == GetObjectSize())
+	const CBlobDesc& GetWeightsDesc() const { return weightsDesc; }
+
+	// Starts collecting the input range
+	void StartCalibration();
+	// Updates the input range
+	void Calibrate( const CDnnBlob& input );
+	// Calculates the quantization parameters and quantizes the weights
+	// The weights blob must be of GetObjectCount() x GetObjectSize() == outputSize x inputSize size
+	// The layer may release its float weights after that
+	void FinishCalibration( const CDnnBlob& weights );
+	// Restores the float weights from the quantized ones (valid only if IsQuantized)
+	CPtr<CDnnBlob> GetDequantizedWeights( IMathEngine& mathEngine ) const;
+	// Switches back to float mode
+	void Reset();
+
+	// Destroys the prepared int8 weights (must be called if the free term has been changed)
+	void ResetDesc();
+
+	// Multiplies input (inputHeight x inputSize) by the transposed weights, adds free term (if not null)
+	void Run( IMathEngine& mathEngine, const CDnnBlob* freeTerm, const CConstFloatHandle& input, int inputHeight,
+		const CFloatHandle& output );
+
+	void Serialize( CArchive& archive );
+
+private:
+	enum TState {
+		S_Float,
+		S_Calibrating,
+		S_Quantized
+	};
+
+	TState state = S_Float;
+	// The input range collected during calibration
+	float inputMin = 0;
+	float inputMax = 0;
+	// The quantization parameters
+	float inputScale = 1;
+	int inputZeroPoint = 0;
+	CArray<float> weightScales;
+	// The quantized weights (outputSize x inputSize)
+	CBlobDesc weightsDesc;
+	CArray<signed char> weights;
+	// The int8 weights prepared by the math engine
+	CInt8FullyConnectedDesc* desc = nullptr;
+
+	void quantizeWeights( const CDnnBlob& floatWeights );
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// Switches all the supported layers of CDnn (or of a composite layer) to int8 mode
+// The layers inside of composite layers are processed too
+class NEOML_API CDnnInt8Quantizer {
+public:
+	// Starts the calibration
+	// Returns the number of layers which will be quantized
+	int StartCalibration( CDnnLayerGraph& graph ) const;
+	// Finishes the calibration and switches layers to int8 mode
+	// Returns the number of quantized layers
+	int FinishCalibration( CDnnLayerGraph& graph ) const;
+	// Switches all the layers back to float mode
+	int Reset( CDnnLayerGraph& graph ) const;
+};
+
+} // namespace NeoML
@@ -0,0 +1,129 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <NeoML/NeoMLDefs.h>
+#include <NeoMathEngine/PerformanceCounters.h>
+#include <memory>
+
+namespace NeoML {
+
+class CBaseLayer;
+
+// The stage of the layer processing
+enum TDnnProfileStage {
+	DPS_Forward = 0, // RunOnce
+	DPS_Backward, // BackwardOnce
+	DPS_Learn, // LearnOnce
+
+	DPS_Count
+};
+
+// One call of a layer method recorded by the profiler
+struct NEOML_API CDnnProfileEvent {
+	// The layer path (see CBaseLayer::GetPath) and class name
+	CString LayerPath;
+	CString LayerClass;
+	TDnnProfileStage Stage = DPS_Forward;
+	// The number of the network run
+	int RunNumber = 0;
+	// The start time since the profiler creation (or the last Clear call) and the duration, in nanoseconds
+	IPerformanceCounters::CCounter::TCounterType Start = 0;
+	IPerformanceCounters::CCounter::TCounterType Duration = 0;
+	// The size of the math engine memory allocated during the call and not freed by its end, in bytes
+	// Negative if the layer has freed more memory than allocated
+	int64_t AllocatedMemory = 0;
+	// The estimated number of floating point operations (0 if unknown for this layer)
+	double Flops = 0;
+	// The hardware counters (if requested and supported by the math engine)
+	// Not collected for the composite layers, their internal layers are recorded separately
+	CArray<IPerformanceCounters::CCounter> Counters;
+
+	CDnnProfileEvent() = default;
+	CDnnProfileEvent( const CDnnProfileEvent& other ) :
+		LayerPath( other.LayerPath ),
+		LayerClass( other.LayerClass ),
+		Stage( other.Stage ),
+		RunNumber( other.RunNumber ),
+		Start( other.Start ),
+		Duration( other.Duration ),
+		AllocatedMemory( other.AllocatedMemory ),
+		Flops( other.Flops )
+	{
+		other.Counters.CopyTo( Counters );
+	}
+};
+
+// Records the per-layer profile of the network runs
+// Set it to the network with CDnn::SetProfiler; the events of all the layers including
+// the internal layers of the composite ones are recorded by the root network profiler
+//
+// The recorded timeline can be saved in Chrome trace event format (open in chrome://tracing or ui.perfetto.dev)
+// or as the CSV table aggregated by layer and stage
+class NEOML_API CDnnProfiler {
+public:
+	// The hardware counters are collected using IMathEngine::CreatePerformanceCounters
+	explicit CDnnProfiler( bool collectHardwareCounters = false );
+	~CDnnProfiler();
+
+	CDnnProfiler( const CDnnProfiler& ) = delete;
+	CDnnProfiler& operator=( const CDnnProfiler& ) = delete;
+
+	bool IsCollectingHardwareCounters() const { return collectHardwareCounters; }
+
+	// The recorded events in the order of their start
+	const CArray<CDnnProfileEvent>& GetEvents() const { return events; }
+	// Deletes all the recorded events and restarts the timeline
+	void Clear();
+
+	// Writes the events in Chrome trace event format (JSON)
+	void SaveChromeTrace( CTextStream& stream ) const;
+	// Writes the statistics aggregated by layer and stage as CSV with a header line
+	void SaveSummary( CTextStream& stream ) const;
+
+	// Records one event during its lifetime (used by the layers)
+	class NEOML_API CEventScope {
+	public:
+		// The profiler may be null, then nothing is recorded
+		CEventScope( CDnnProfiler* profiler, const CBaseLayer& layer, TDnnProfileStage stage, int runNumber,
+			bool collectCounters, double flops );
+		~CEventScope();
+
+		CEventScope( const CEventScope& ) = delete;
+		CEventScope& operator=( const CEventScope& ) = delete;
+
+	private:
+		CDnnProfiler* const profiler;
+		IMathEngine* mathEngine;
+		int eventIndex;
+		size_t freeMemory;
+		IPerformanceCounters* counters;
+	};
+
+private:
+	const bool collectHardwareCounters;
+	// The time of the timeline start
+	IPerformanceCounters::CCounter::TCounterType startTime;
+	CArray<CDnnProfileEvent> events;
+	// The hardware counters (created on first use)
+	std::unique_ptr<IPerformanceCounters> counters;
+	const IMathEngine* countersMathEngine;
+
+	IPerformanceCounters::CCounter::TCounterType now() const;
+	IPerformanceCounters* getCounters( IMathEngine& mathEngine );
+};
+
+} // namespace NeoML
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -31,6 +31,13 @@ public:
 	// forSharedWeightsLayer=true should only be used within layers that share weights with other layers.
 	void AddDiff( CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramDiffBlobs, 
 		bool sharedWeights = false );
+	// Stores the gradients of some rows of the layer parameters, the gradients of the other rows are zero
+	// Each parameter blob is treated as a matrix of GetObjectCount() x GetObjectSize() size
+	// rowIndices[i] - the indices of the rows of the i'th parameter (CT_Int blob of 1 x RowCount x 1 size)
+	// rowDiffBlobs[i] - the gradients of these rows (CT_Float blob of 1 x RowCount x GetObjectSize() size)
+	// Both are null if the i'th parameter has no gradients; sharedWeights has the same meaning as in AddDiff
+	void AddSparseDiff( CBaseLayer* layer, const CObjectArray<CDnnBlob>& rowIndices,
+		const CObjectArray<CDnnBlob>& rowDiffBlobs, bool sharedWeights = false );
 
 	// Modifies the trainable parameters of the network layers, 
 	// using the accumulated gradients and previous steps' history (moment, etc.) 
@@ -76,6 +83,19 @@ protected:
 	virtual void TrainLayer( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
 		const CObjectArray<CDnnBlob>& paramDiffBlobs, CObjectArray<CDnnBlob>& learningHistory ) = 0;
 
+	// Modifies trainable parameters of a given layer using the gradients of some of their rows (see AddSparseDiff)
+	// The row indices are unique
+	// By default the gradients are converted to the dense ones and passed to TrainLayer
+	virtual void TrainLayerSparse( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+		const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+		CObjectArray<CDnnBlob>& learningHistory );
+	// Applies TrainLayer only to the given rows of the parameters and of the learning history
+	// The history of the other rows isn't changed ("lazy" update)
+	// May be used in TrainLayerSparse by the solvers which process each parameter element independently
+	void TrainLayerRows( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+		const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+		CObjectArray<CDnnBlob>& learningHistory );
+
 private:
 	IMathEngine& mathEngine;
 	float learningRate;
@@ -95,6 +115,16 @@ private:
 
 	// The buffers used to add up the gradients from several AddDiff calls
 	CMap<CBaseLayer*, CDiffBlobSum> layerToParamDiffBlobsSum;
+
+	// The sparse gradients from several AddSparseDiff calls
+	struct CSparseDiffSum {
+		CSparseDiffSum() : Count( 0 ) {}
+
+		CObjectArray<CDnnBlob> RowIndices; // the indices of the rows, may repeat
+		CObjectArray<CDnnBlob> RowDiffs; // the gradients of the rows
+		int Count; // the number of terms in each sum
+	};
+	CMap<CBaseLayer*, CSparseDiffSum> layerToSparseDiffSum;
 	// The buffers for storing gradients history and moment
 	// Used in the inheriting classes
 	CMap<CBaseLayer*, CObjectArray<CDnnBlob>> layerToGradientHistory;
@@ -104,6 +134,10 @@ private:
 
 	// Averages weights over all threads
 	void allReduce( float distributedCoeff );
+	// Adds the sparse gradients of the layers which also have the dense ones to the dense ones
+	void mergeSparseDiffs();
+	// Trains the layers which have only the sparse gradients
+	void trainSparse();
 
 	// Clips and normalize gradients according to the settings
 	void clipGradients(const CObjectArray<CDnnBlob>& paramDiffBlobs);
@@ -175,6 +209,10 @@ public:
 protected:
 	void TrainLayer( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs, 
 		const CObjectArray<CDnnBlob>& paramDiffBlobs, CObjectArray<CDnnBlob>& gradientHistory ) override;
+	// Only the rows with gradients and their moments are updated
+	void TrainLayerSparse( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+		const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+		CObjectArray<CDnnBlob>& gradientHistory ) override;
 
 private:
 	// Moment decay rate (moment is a weighted sum of previous gradients)
@@ -244,6 +282,10 @@ protected:
 	// Updates the trainable weights of the layer
 	virtual void TrainLayer( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
 		const CObjectArray<CDnnBlob>& paramDiffBlobs, CObjectArray<CDnnBlob>& gradientHistory ) override;
+	// Only the rows with gradients and their moments are updated
+	void TrainLayerSparse( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+		const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+		CObjectArray<CDnnBlob>& gradientHistory ) override;
 
 private:
 	// The gradientHistory array stores the previous values of gradients of different types
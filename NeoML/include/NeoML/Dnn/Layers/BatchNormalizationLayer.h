@@ -19,6 +19,8 @@ limitations under the License.
 #include <NeoML/Dnn/Dnn.h>
 #include <NeoMathEngine/NeoMathEngine.h>
 
+#include <mutex>
+
 namespace NeoML {
 
 // Batch normalization layer (see the paper: http://arxiv.org/pdf/1502.03167.pdf)
@@ -65,6 +67,7 @@ protected:
 	void LearnOnce() override;
 	int BlobsForBackward() const override { return 0; }
 	int BlobsForLearn() const override { return 0; }
+	void GetSharedParamBlobs( CArray<CPtr<CDnnBlob>*>& blobs ) override;
 
 private:
 	bool isChannelBased;
@@ -117,6 +120,8 @@ private:
 	void backwardWhenNoLearning();
 
 	bool isFinalParamDirty; // indicates if final params need updating
+	// Guards the update of the final params: the network may be stored in one thread while running in another
+	std::mutex finalParamsMutex;
 	void updateFinalParams();
 
 	void initializeFromFinalParams();
@@ -118,6 +118,10 @@ protected:
 	};
 	const COutputMapping& GetOutputMapping( int i ) const { return outputMappings[i]; }
 
+	// Stores the layer with the internal layers and output mappings of the given composite instead of its own
+	// Used when some of the internal layers are only a runtime substitution which must not be stored
+	void StoreWithLayout( CArchive& archive, CCompositeLayer& layout );
+
 	// Internal network run and backpropagation (the methods should be overloaded in the derived classes)
 	virtual void RunInternalDnn();
 	virtual void RunInternalDnnBackward();
@@ -152,6 +156,7 @@ private:
 	bool areInternalLogsEnabled;
 
 	void processBackwardOrLearn();
+	void storeLayers( CArchive& archive );
 
 	// Gets the name of the source/sink with the given number
 	// Used to then connect the internal layer to it
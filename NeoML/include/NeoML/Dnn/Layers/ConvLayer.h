@@ -18,6 +18,7 @@ limitations under the License.
 #include <NeoML/NeoMLDefs.h>
 #include <NeoML/Dnn/Layers/BatchNormalizationLayer.h>
 #include <NeoML/Dnn/Dnn.h>
+#include <NeoML/Dnn/DnnInt8Quantization.h>
 
 namespace NeoML {
 
@@ -80,7 +81,8 @@ public:
 	// Applies the batch normalization parameters to the internal parameters of the layer
 	// The layer will then return the same output 
 	// that was previously returned by the combination of this layer with batch normalization
-	void ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm);
+	// Returns false if the filter is stored in a special format (e.g. int8) and cannot be changed
+	bool ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm);
 
 protected:
 	CBaseConvLayer( IMathEngine& mathEngine, const char* name );
@@ -122,6 +124,21 @@ public:
 
 	void Serialize( CArchive& archive ) override;
 
+	CPtr<CDnnBlob> GetFilterData() const override;
+	void SetFilterData( const CPtr<CDnnBlob>& newFilter ) override;
+	void SetFreeTermData( const CPtr<CDnnBlob>& newFreeTerms ) override;
+
+	// Int8 post-training quantization (CPU only, see CDnnInt8Quantizer)
+	// Only 1x1 convolution without padding and with 1x1 stride is supported
+	// Setting a new filter switches the layer back to float mode
+	// The float filter is released when the calibration is finished
+	// and restored from the int8 one (with the quantization error) when the quantization is reset
+	bool IsInt8QuantizationSupported() const { return isMatrixMultiplication(); }
+	const CInt8LayerQuantization& GetInt8Quantization() const { return int8Quantization; }
+	void StartInt8Calibration();
+	void FinishInt8Calibration();
+	void ResetInt8Quantization();
+
 protected:
 	~CConvLayer() override;
 
@@ -131,13 +148,22 @@ protected:
 	void LearnOnce() override;
 	int BlobsForBackward() const override { return 0; }
 	int BlobsForLearn() const override { return TInputBlobs; }
+	void FilterLayerParams( float threshold ) override;
+	double EstimateFlops() const override;
 
 private:
 	CConvolutionDesc* convDesc; // the convolution descriptor
+	CInt8LayerQuantization int8Quantization; // the int8 quantization state
+	// The filter packed for the inference of 1x1 convolution
+	// (nullptr if not created yet or not supported by the math engine)
+	CPackedMatrixDesc* packedFilter;
 
 	void calcOutputBlobSize(int& outputHeight, int& outputWidth) const;
 	void initConvDesc();
 	void destroyConvDesc();
+	bool isMatrixMultiplication() const;
+	const CPackedMatrixDesc* getPackedFilter();
+	void resetPreparedFilter();
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -119,6 +119,17 @@ public:
 	Quality ArcQuality() const { return LogProb; }
 };
 
+// The external scorer of the label sequences for the CTC beam search decoding (e.g. a language model)
+class NEOML_API ICtcLabelScorer {
+public:
+	virtual ~ICtcLabelScorer() = default;
+
+	// Gets the log-score of appending the label to the prefix (the prefix contains no blanks and no repeats)
+	// The sum of the scores of the prefix labels is added to its log-probability when the beam is pruned
+	// May be called from several threads at the same time
+	virtual float GetLogScore( const int* prefix, int prefixLength, int label ) const = 0;
+};
+
 class NEOML_API CCtcDecodingLayer : public CBaseLayer {
 	NEOML_DNN_LAYER( CCtcDecodingLayer )
 public:
@@ -155,6 +166,25 @@ public:
 
 	void GetBestSequence(int sequenceNumber, CArray<int>& bestLabelSequence) const;
 
+	// The number of the prefixes kept by the beam search
+	int GetBeamWidth() const { return beamWidth; }
+	void SetBeamWidth( int width );
+	// The probability threshold for the beam search: the prefixes are not extended by the labels
+	// with a smaller probability at the given position (the blanks are never cut off)
+	float GetBeamLabelProbabilityThreshold() const { return beamLabelProbabilityThreshold; }
+	void SetBeamLabelProbabilityThreshold( float threshold );
+	// The external scorer for the beam search; null by default
+	// The scorer is not owned by the layer and is not serialized
+	const ICtcLabelScorer* GetLabelScorer() const { return labelScorer; }
+	void SetLabelScorer( const ICtcLabelScorer* scorer ) { labelScorer = scorer; }
+
+	// Finds the best label sequence using the prefix beam search and returns its score
+	// (the log-probability of the sequence plus the scorer scores)
+	float GetBeamSearchSequence( int sequenceNumber, CArray<int>& labelSequence ) const;
+	// Finds the best label sequences for the whole batch using the prefix beam search
+	// The sequences are processed in parallel by threadCount threads (all the available cores if threadCount <= 0)
+	void GetBeamSearchSequences( CArray<CArray<int>>& labelSequences, int threadCount = 1 ) const;
+
 	void Serialize( CArchive& archive ) override;
 
 protected:
@@ -167,10 +197,15 @@ private:
 	int blankLabel; // the blank label
 	float blankProbabilityThreshold; // the blank probability threshold for LDG building
 	float arcProbabilityThreshold; // the arc probability threshold for LDG building
+	int beamWidth; // the beam width for the beam search
+	float beamLabelProbabilityThreshold; // the label probability threshold for the beam search
+	const ICtcLabelScorer* labelScorer; // the external scorer for the beam search
 	CPtr<CDnnBlob> transposedResult; // the transposed log(softmax(0))
 	CPtr<CDnnBlob> resultLogProb; // the window blob for one sequence in the transposedResult
 	CPtr<CDnnBlob> bestLabels; // the best labels along each dimension
 	CObjectArray<CDnnBlob> lastResults; // the copies of input blobs from the last run
+
+	void getSequenceLengths( CArray<int>& lengths ) const;
 };
 
 } // namespace NeoML
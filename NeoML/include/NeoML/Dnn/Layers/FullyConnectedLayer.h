@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -18,6 +18,8 @@ limitations under the License.
 #include <NeoML/NeoMLDefs.h>
 #include <NeoML/Dnn/Layers/BatchNormalizationLayer.h>
 #include <NeoML/Dnn/Dnn.h>
+#include <NeoML/Dnn/DnnHalfFloat.h>
+#include <NeoML/Dnn/DnnInt8Quantization.h>
 
 namespace NeoML {
 
@@ -50,19 +52,37 @@ public:
 	// Applies the batch normalization parameters to the internal parameters of the layer
 	// The layer will then return the same output 
 	// that was previously returned by the combination of this layer with batch normalization
-	void ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm);
+	// Returns false if the weights are stored in the 16-bit or int8 format and cannot be changed
+	bool ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm);
 
 	// Indicates if the free term should be set to zero ("no bias")
 	bool IsZeroFreeTerm() const { return isZeroFreeTerm; }
 	void SetZeroFreeTerm(bool _isZeroFreeTerm);
 
+	// Int8 post-training quantization (CPU only, see CDnnInt8Quantizer)
+	// Setting new weights switches the layer back to float mode
+	const CInt8LayerQuantization& GetInt8Quantization() const { return int8Quantization; }
+	// The float weights are released when the calibration is finished
+	// and restored from the int8 ones (with the quantization error) when the quantization is reset
+	void StartInt8Calibration();
+	void FinishInt8Calibration();
+	void ResetInt8Quantization();
+
+	// The precision of the weights storage (DWP_Float32 by default)
+	// The 16-bit weights are used only for inference and are not compatible with int8 quantization
+	// On CPU they are converted to float block by block during the multiplication,
+	// other math engines convert them to a temporary float blob on every run (no float copy is kept)
+	TDnnWeightsPrecision GetWeightsPrecision() const { return weightsPrecision; }
+	void SetWeightsPrecision( TDnnWeightsPrecision precision );
+
+	// The float weights; null if the weights are stored in the 16-bit or int8 format (use GetWeightsData then)
 	CPtr<CDnnBlob>& Weights() { return paramBlobs[0]; }
 	CPtr<CDnnBlob>& FreeTerms() { return paramBlobs[1]; }	// the free term matrix
 	const CPtr<CDnnBlob>& Weights() const { return paramBlobs[0]; }
 	const CPtr<CDnnBlob>& FreeTerms() const { return paramBlobs[1]; }	// the free term matrix
 
 protected:
-	~CFullyConnectedLayer() override = default;
+	~CFullyConnectedLayer() override;
 
 	void Reshape() override;
 	void RunOnce() override;
@@ -71,6 +91,7 @@ protected:
 	void FilterLayerParams( float threshold ) override;
 	int BlobsForBackward() const override { return 0; }
 	int BlobsForLearn() const override { return TInputBlobs; }
+	double EstimateFlops() const override;
 
 	// The filter. The pointer is valid only if the desired parameters are known (either defined externally or obtained on reshape)
 	CPtr<CDnnBlob>& WeightsDiff() { return paramDiffBlobs[0]; }
@@ -79,6 +100,18 @@ protected:
 private:
 	int numberOfElements = 0; // the number of elements (neurons) of the fully-connected layer
 	bool isZeroFreeTerm = false; // indicates if the free term should be set to zero
+	CInt8LayerQuantization int8Quantization; // the int8 quantization state
+	TDnnWeightsPrecision weightsPrecision = DWP_Float32; // the precision of the weights storage
+	CPtr<CDnnHalfFloatBlob> halfWeights; // the weights if weightsPrecision is not DWP_Float32
+	// The weights packed for the inference (nullptr if not created yet or not supported by the math engine)
+	CPackedMatrixDesc* packedWeights = nullptr;
+	// The float copy of halfWeights used if packing is not supported (nullptr if not created yet)
+	CPtr<CDnnBlob> convertedWeights;
+
+	const CPackedMatrixDesc* getPackedWeights();
+	CDnnBlob* getConvertedWeights();
+	void applyWeightsPrecision();
+	void resetPreparedWeights();
 };
 
 NEOML_API CLayerWrapper<CFullyConnectedLayer> FullyConnected(
@@ -28,6 +28,7 @@ class NEOML_API CGruLayer : public CRecurrentLayer {
 	NEOML_DNN_LAYER( CGruLayer )
 public:
 	explicit CGruLayer( IMathEngine& mathEngine );
+	~CGruLayer();
 
 	void Serialize( CArchive& archive ) override;
 
@@ -47,6 +48,9 @@ public:
 	void SetGateWeightsData(CDnnBlob* newWeights) { gateLayer->SetWeightsData(newWeights); }
 	void SetGateFreeTermData(CDnnBlob* newFreeTerm) { gateLayer->SetFreeTermData(newFreeTerm); }
 
+	void RunOnce() override;
+	void Reshape() override;
+
 private:
 	// The indices of the gates in the hidden layer output
 	enum TGateOut {
@@ -61,7 +65,13 @@ private:
 	CPtr<CSplitChannelsLayer> splitLayer;
 	CPtr<CBackLinkLayer> mainBackLink;
 
+	// The descriptor of the fused CPU inference
+	CGruDesc* gruDesc;
+
 	void buildLayer();
+	bool isFusedInference() const;
+	void initDesc();
+	void freeDesc();
 };
 
 NEOML_API CLayerWrapper<CGruLayer> Gru( int hiddenSize );
@@ -70,6 +70,12 @@ public:
 	void RunOnce() override;
 	void Reshape() override;
 
+protected:
+	void BackwardOnce() override;
+	void LearnOnce() override;
+	int BlobsForBackward() const override;
+	int BlobsForLearn() const override;
+
 private:
 	// The gate numbers for the hidden layer output
 	enum TGateOut {
@@ -97,12 +103,19 @@ private:
 	bool isInCompatibilityMode;
 
 	CLstmDesc* lstmDesc;
+	// The activated gates of the whole sequence calculated during the fused training run
+	CPtr<CDnnBlob> fusedGates;
+	// The states of the whole sequence if the layer has no state output
+	CPtr<CDnnBlob> fusedStates;
 
 	void buildLayer(float dropout);
 	void checkBlobDescs() const;
 	void setWeightsData(const CPtr<CDnnBlob>& newWeights);
 	void initDesc();
 	void freeDesc();
+	bool isFusedTraining() const;
+	void runFusedTraining();
+	void backwardAndLearnFused();
 };
 
 //--------------------------------------------------------------------------
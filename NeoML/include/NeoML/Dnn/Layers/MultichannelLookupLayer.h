@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <NeoML/NeoMLDefs.h>
 #include <NeoML/Dnn/Dnn.h>
+#include <NeoML/Dnn/DnnHalfFloat.h>
 
 namespace NeoML {
 
@@ -35,6 +36,7 @@ public:
 	const CArray<CLookupDimension>& GetDimensions() const { return dimensions; }
 
 	// Gets the blob with the embeddings (written in the rows) 
+	// Returns null if the embeddings are stored in the 16-bit format
 	const CDnnBlob* GetEmbeddings(int i) const;
 	// Sets the i'th embedding table
 	// Copies embeddings from data
@@ -47,6 +49,17 @@ public:
 	bool IsUseFrameworkLearning() const { return useFrameworkLearning; }
 	void SetUseFrameworkLearning(bool _useFrameworkLearning);
 
+	// Indicates that only the looked up rows of the tables are passed to the solver on the learning step
+	// The solver updates only these rows and their gradient history (moments) and skips the rest of the table
+	// Used only with the external training; the default value is false
+	bool IsUseSparseGradients() const { return useSparseGradients; }
+	void SetUseSparseGradients( bool _useSparseGradients ) { useSparseGradients = _useSparseGradients; }
+
+	// The precision of the embeddings storage (DWP_Float32 by default)
+	// The 16-bit embeddings are used only for inference; the looked up vectors are converted to float
+	TDnnWeightsPrecision GetEmbeddingsPrecision() const { return embeddingsPrecision; }
+	void SetEmbeddingsPrecision( TDnnWeightsPrecision precision );
+
 	// Initializes the layer data. Called automatically on Reshape, 
 	// however, you may call it in other situations as well (i.e. on Word2VecStep). 
 	// Set the input parameter to 0 to clear the embeddings.
@@ -80,6 +93,8 @@ protected:
 	void BackwardOnce() override;
 	void LearnOnce() override;
 	int BlobsForLearn() const override { return TInputBlobs; }
+	bool HasSparseParamDiffs() const override { return useFrameworkLearning && useSparseGradients; }
+	void GetSharedParamBlobs( CArray<CPtr<CDnnBlob>*>& blobs ) override;
 
 private:
 	// The size of stored vectors
@@ -87,10 +102,21 @@ private:
 
 	// Indicates that "external" training should be used
 	bool useFrameworkLearning;
+	// Indicates that the sparse gradients are passed to the solver
+	bool useSparseGradients;
 
 	CObjectArray<CDnnBlob> ownParams; // "internal" training parameters
 	CObjectArray<CDnnBlob>& getParams() { return useFrameworkLearning ? paramBlobs : ownParams; }
 	const CObjectArray<CDnnBlob>& getParams() const { return useFrameworkLearning ? paramBlobs : ownParams; }
+
+	// The precision of the embeddings storage
+	TDnnWeightsPrecision embeddingsPrecision;
+	// The embedding tables if embeddingsPrecision is not DWP_Float32 (the float tables are null then)
+	CObjectArray<CDnnHalfFloatBlob> halfEmbeddings;
+
+	void applyEmbeddingsPrecision();
+	void learnSparse();
+	void lookupHalfFloat( const CDnnBlob& input, CDnnBlob& output ) const;
 };
 
 NEOML_API CLayerWrapper<CMultichannelLookupLayer> MultichannelLookup(
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -20,6 +20,8 @@ limitations under the License.
 
 namespace NeoML {
 
+class CScaledDotProductAttentionLayer;
+
 // Multihead Self Attention
 // UNIVERSAL TRANSFORMERS https://arxiv.org/pdf/1706.03762.pdf 
 // Attention Is All You Need https://arxiv.org/pdf/1807.03819.pdf
@@ -43,6 +45,13 @@ namespace NeoML {
 //  W_* - trainable parameters and W_O is an additional trainable matrix of size (GetHiddenSize() x GetOutputSize())
 //
 // Result has size (1, BatchWidth, ListSize_Q, 1, 1, 1, GetOutputSize())
+//
+// During inference on CPU (if the softmax output isn't used) the attention itself is calculated
+// by CScaledDotProductAttentionLayer which doesn't store the ListSize_Q x ListSize_V matrices
+//
+// For the autoregressive decoding the layer may keep the K and V of the previous runs (see SetMaxCacheLength)
+// In this mode only the new elements of the sequences are passed to K and V on each run
+// and the attention is calculated over all the cached elements
 class NEOML_API CMultiheadAttentionLayer : public CCompositeLayer {
 	NEOML_DNN_LAYER( CMultiheadAttentionLayer )
 public:
@@ -92,6 +101,24 @@ public:
 	bool IsInCompatibilityMode() const { return isInCompatibilityMode; }
 	void SetCompatibilityMode( bool value );
 
+	// The maximum number of the elements of K and V kept between the runs
+	// If the cache is full the oldest elements are discarded
+	// The cache is supported only in inference on CPU and the softmax output isn't available with it
+	// 0 means that the cache isn't used; by default the cache isn't used
+	int GetMaxCacheLength() const { return maxCacheLength; }
+	void SetMaxCacheLength( int maxCacheLength );
+
+	// The current number of the cached elements
+	int GetCacheLength() const;
+	// Clears the cache, should be called before processing new sequences
+	void ResetCache();
+	// Keeps only the last length elements in the cache
+	void TrimCache( int length );
+	// The cached K and V after the W_K and W_V multiplication
+	// Their size is (1 x BatchWidth x GetCacheLength() x 1 x 1 x 1 x GetHiddenSize())
+	void GetCache( CPtr<CDnnBlob>& keys, CPtr<CDnnBlob>& values ) const;
+	void SetCache( const CDnnBlob& keys, const CDnnBlob& values );
+
 	void Serialize( CArchive& archive ) override;
 
 	// Recreates the layer if forceRebuild is true or it doesn't contain sublayers
@@ -117,8 +144,18 @@ private:
 	bool isInCompatibilityMode;
 	// layer applying scale
 	CString multiplyByConstLayerName;
+	// The maximum length of the K and V cache
+	int maxCacheLength;
 
 	void create();
+	bool isFusedAttentionUsed() const;
+	void rebuildAttention( bool useFusedAttention );
+	CBaseLayer* createAttention( CBaseLayer* Q, CBaseLayer* K, CBaseLayer* V );
+	CBaseLayer* createFusedAttention( CBaseLayer* Q, CBaseLayer* K, CBaseLayer* V );
+	CScaledDotProductAttentionLayer* getFusedAttention();
+	const CScaledDotProductAttentionLayer* getFusedAttention() const;
+	CPtr<CMultiheadAttentionLayer> createStepByStepLayout();
+	CBaseLayer* addLayerCopy( CBaseLayer& layer );
 
 	// Layer inputs
 	enum TInputs {
@@ -152,4 +189,67 @@ private:
 NEOML_API CLayerWrapper<CMultiheadAttentionLayer> MultiheadAttention(
 	int headCount, int hiddenSize, int outputSize, float dropoutRate );
 
+//---------------------------------------------------------------------------------------------------------------------
+
+// The fused attention used by CMultiheadAttentionLayer during inference
+// Calculates concat( head_1, ..., head_N ) where head_i = softmax( scale * Q_i * K_i_t - 1e9 * mask ) * V_i
+// The keys are processed by blocks, so the memory doesn't depend on ListSize_Q * ListSize_V
+// (see IDnnEngine::ScaledDotProductAttention); only CPU is supported and there is no backward
+//
+// If SetMaxCacheLength() is set the K and V of each run are appended to the cache
+// and Q attends to all the cached elements; the mask (if any) must cover all of them
+//
+//  Inputs:
+//  #0 - matrix Q (1 x BatchWidth x ListSize_Q x 1 x 1 x 1 x HiddenSize)
+//  #1 - matrix K (1 x BatchWidth x ListSize_V x 1 x 1 x 1 x HiddenSize)
+//  #2 - matrix V (1 x BatchWidth x ListSize_V x 1 x 1 x 1 x HiddenSize)
+//  #3 - mask (optional) of the CMultiheadAttentionLayer::TMaskType shape
+//
+// Result has size (1, BatchWidth, ListSize_Q, 1, 1, 1, HiddenSize)
+class NEOML_API CScaledDotProductAttentionLayer : public CBaseLayer {
+	NEOML_DNN_LAYER( CScaledDotProductAttentionLayer )
+public:
+	explicit CScaledDotProductAttentionLayer( IMathEngine& mathEngine );
+
+	// The number of heads; HiddenSize must be a multiple of this value
+	int GetHeadCount() const { return headCount; }
+	void SetHeadCount( int headCount );
+
+	// The multiplier of Q * K_t
+	float GetScale() const { return scale; }
+	void SetScale( float _scale ) { scale = _scale; }
+
+	// The maximum number of the cached elements of K and V, 0 means no cache
+	// See the CMultiheadAttentionLayer methods with the same names
+	int GetMaxCacheLength() const { return maxCacheLength; }
+	void SetMaxCacheLength( int maxCacheLength );
+
+	int GetCacheLength() const { return cacheLength; }
+	void ResetCache() { cacheLength = 0; }
+	void TrimCache( int length );
+	void GetCache( CPtr<CDnnBlob>& keys, CPtr<CDnnBlob>& values ) const;
+	void SetCache( const CDnnBlob& keys, const CDnnBlob& values );
+
+	void Serialize( CArchive& archive ) override;
+
+protected:
+	void Reshape() override;
+	void RunOnce() override;
+	void BackwardOnce() override;
+
+private:
+	int headCount;
+	float scale;
+	int maxCacheLength;
+	// The cached K and V of size (1 x BatchWidth x maxCacheLength x 1 x 1 x 1 x HiddenSize)
+	CPtr<CDnnBlob> keyCache;
+	CPtr<CDnnBlob> valueCache;
+	// The number of the filled elements in the cache
+	int cacheLength;
+
+	void initCache( int batchSize, int hiddenSize );
+	void appendToCache( const CDnnBlob& keys, const CDnnBlob& values );
+	void runWithCache();
+};
+
 } // namespace NeoML
@@ -109,6 +109,7 @@ class CActivationDesc;
 //				- ListSize - equal to the number of head counts
 //				- Other dimensions must be equal to 1
 //				- it can be easily created with TransformerSourceMaskLayer
+//			if the cache is used the Channels(seq_V) must be equal to GetCacheLength() after the run
 // Outputs:
 //      1. output data - float blob of size:
 //          - BatchWidth and ListSize are equal to the corresponding dims of the first input
@@ -156,6 +157,17 @@ public:
 	void SetMaskType( CMultiheadAttentionLayer::TMaskType type );
 	CMultiheadAttentionLayer::TMaskType GetMaskType() const { return selfAttention->GetMaskType(); }
 
+	// The cache of the self-attention keys and values for the autoregressive decoding
+	// With the cache only the new elements of the sequences are passed on each run
+	// See CMultiheadAttentionLayer::SetMaxCacheLength for details
+	int GetMaxCacheLength() const { return selfAttention->GetMaxCacheLength(); }
+	void SetMaxCacheLength( int length ) { selfAttention->SetMaxCacheLength( length ); }
+	int GetCacheLength() const { return selfAttention->GetCacheLength(); }
+	void ResetCache() { selfAttention->ResetCache(); }
+	void TrimCache( int length ) { selfAttention->TrimCache( length ); }
+	void GetCache( CPtr<CDnnBlob>& keys, CPtr<CDnnBlob>& values ) const { selfAttention->GetCache( keys, values ); }
+	void SetCache( const CDnnBlob& keys, const CDnnBlob& values ) { selfAttention->SetCache( keys, values ); }
+
 protected:
 	void Reshape() override;
 
@@ -39,6 +39,7 @@ protected:
 	bool IsFilterTransposed() const override { return true; }
 	int BlobsForBackward() const override { return 0; }
 	int BlobsForLearn() const override { return TInputBlobs; }
+	double EstimateFlops() const override;
 
 private:
 	CConvolutionDesc* convDesc;
@@ -36,7 +36,10 @@ limitations under the License.
 #include <NeoML/Dnn/AutoDiffFunctions.h>
 #include <NeoML/Dnn/Dnn.h>
 #include <NeoML/Dnn/DnnBlob.h>
+#include <NeoML/Dnn/DnnHalfFloat.h>
 #include <NeoML/Dnn/DnnInitializer.h>
+#include <NeoML/Dnn/DnnInt8Quantization.h>
+#include <NeoML/Dnn/DnnProfiler.h>
 #include <NeoML/Dnn/DnnSolver.h>
 #include <NeoML/Dnn/DnnSparseMatrix.h>
 #include <NeoML/Dnn/Layers/3dConvLayer.h>
@@ -97,6 +100,7 @@ limitations under the License.
 #include <NeoML/TraditionalML/Svm.h>
 #include <NeoML/TraditionalML/WordDictionary.h>
 
+#include <NeoML/Dnn/DnnBatchingExecutor.h>
 #include <NeoML/Dnn/DnnDistributed.h>
 #include <NeoML/Dnn/DnnLora.h>
 #include <NeoML/Dnn/DnnOptimization.h>
@@ -35,12 +35,18 @@ class NEOML_API CCrossValidation {
 public:
 	CCrossValidation( ITrainingModel& trainingModel, const IProblem* problem );
 
+	// Sets the number of threads for processing the parts, the same as COneVersusAll::SetThreadCount
+	// The results do not depend on it
+	void SetThreadCount( int newThreadCount ) { threadCount = newThreadCount; }
+	int GetThreadCount() const { return threadCount; }
+
 	// Performs cross-validation
 	void Execute( int partsCount, TScore score, CCrossValidationResult& results, bool stratified );
 
 private:
 	ITrainingModel& trainingModel; // the base training model
 	const CPtr<const IProblem> problem; // the input data
+	int threadCount; // the number of threads used
 };
 
 } // namespace NeoML
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -15,7 +15,7 @@ limitations under the License.
 
 // The QuickScorer algorithm implementation. See http://ecmlpkdd2017.ijs.si/papers/paperID718.pdf
 // A gradient boosting model optimized with the help of this algorithm may perform up to 10 times faster.
-// The algorithm is especially efficient if the tree depth is not greater than 6.
+// The algorithm is especially efficient if the tree depth is not greater than 6; trees with up to 256 leaves are fully optimized.
 
 #pragma once
 
@@ -23,6 +23,8 @@ limitations under the License.
 
 namespace NeoML {
 
+class IThreadPool;
+
 DECLARE_NEOML_MODEL_NAME( GradientBoostQSModelName, "FmlGradientBoostQSModel" )
 
 // Optimized model interface
@@ -37,6 +39,12 @@ public:
 	// with k taking values from 1 to the total number of trees
 	virtual bool ClassifyEx( const CSparseFloatVector& data, CArray<CClassificationResult>& results ) const = 0;
 	virtual bool ClassifyEx( const CFloatVectorDesc& data, CArray<CClassificationResult>& results ) const = 0;
+
+	// Classifies all the matrix rows, results[i] is the result for the ith row
+	// The dense matrices are processed by blocks of several rows, which is faster than classifying the rows one by one
+	// The blocks are processed in parallel if the thread pool is specified
+	virtual bool ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+		IThreadPool* threadPool = nullptr ) const = 0;
 };
 
 // Optimized regression model interface
@@ -46,6 +54,12 @@ public:
 
 	// Gets the learning rate
 	virtual double GetLearningRate() const = 0;
+
+	// Predicts the values for all the matrix rows, results[i] is the prediction for the ith row
+	// The dense matrices are processed by blocks of several rows, which is faster than predicting the rows one by one
+	// The blocks are processed in parallel if the thread pool is specified
+	virtual void PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+		IThreadPool* threadPool = nullptr ) const = 0;
 };
 
 // The QuickScorer algorithm for optimizing a gradient boosting model
@@ -37,6 +37,15 @@ public:
 		// Elkan argorithm
 		// If used then the distance func must support triangle inequality
 		KMA_Elkan,
+		// Hamerly algorithm
+		// Keeps only one lower bound per element instead of one per element and cluster in Elkan algorithm
+		// Only Euclidean distance is supported
+		KMA_Hamerly,
+		// Mini-batch algorithm
+		// Updates the centers on randomly sampled batches of MiniBatchSize elements with per-center learning rates
+		// Doesn't copy the whole data set, the rows are read from the matrix batch by batch
+		// Only Euclidean distance is supported
+		KMA_MiniBatch,
 
 		KMA_Count
 	};
@@ -65,9 +74,13 @@ public:
 		// It's ignored if initial clusters were provided by user (initialClusters parameter of constructor)
 		TKMeansInitialization Initialization = KMI_Default;
 		// The maximum number of iterations
+		// For mini-batch algorithm it's the maximum number of batches
 		int MaxIterations = 1;
-		// Tolerance criterion for Elkan algorithm
+		// Tolerance criterion for Elkan and Hamerly algorithms (inertia change)
+		// and for mini-batch algorithm (squared movement of the centers on one batch)
 		double Tolerance = 1e-5f;
+		// The number of elements sampled on each iteration of mini-batch algorithm
+		int MiniBatchSize = 1024;
 		// Number of threads used in KMeans
 		int ThreadCount = 1;
 		// Number of runs of algorithm
@@ -126,6 +139,15 @@ private:
 	void computeClustersDists( CVariableMatrix<float>& dists, CArray<float>& closestCluster ) const;
 	void updateMoveDistance( const CArray<CClusterCenter>& oldCenters, CArray<float>& moveDistance ) const;
 
+	// Hamerly algorithm implementation for sparse data
+	bool hamerlyClusterization( const CFloatMatrixDesc& matrix, const CArray<double>& weights, double& inertia );
+
+	// Mini-batch algorithm implementation (uses MathEngine, the data may be dense or sparse)
+	bool miniBatchClusterize( IClusteringData* rawData, int seed, CClusteringResult& result, double& inertia );
+	void selectMiniBatchInitialClusters( const CFloatMatrixDesc& matrix, int seed, CDnnBlob& centers );
+	bool miniBatchClusterization( const IClusteringData& rawData, int seed, CDnnBlob& centers );
+	double miniBatchAssignAll( const IClusteringData& rawData, const CDnnBlob& centers, CClusteringResult& result );
+
 	// Specific case for dense data with Euclidean metrics and Lloyd algorithm
 	bool denseLloydL2Clusterize( IClusteringData* rawData, int seed, CClusteringResult& result, double& inertia );
 	// Initial cluster selection
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -22,6 +22,8 @@ limitations under the License.
 
 namespace NeoML {
 
+class IThreadPool;
+
 // Trained classifier model interface
 class NEOML_API IModel : virtual public IObject {
 public:
@@ -37,6 +39,13 @@ public:
 	virtual bool Classify( const CFloatVector& data, CClassificationResult& result ) const
 		{ return Classify( data.GetDesc(), result ); }
 
+	// Classifies all the matrix rows, results[i] is the result for the ith row
+	// Returns true if all the rows have been classified successfully
+	// The rows are processed in parallel if the thread pool is specified
+	// The default implementation calls Classify for each row
+	virtual bool ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+		IThreadPool* threadPool = nullptr ) const;
+
 	// Serializes the model
 	void Serialize( CArchive& archive ) override = 0;
 };
@@ -53,6 +62,12 @@ public:
 	virtual double Predict( const CFloatVector& data ) const
 		{ return Predict( data.GetDesc() ); };
 
+	// Predicts the function values for all the matrix rows, results[i] is the value for the ith row
+	// The rows are processed in parallel if the thread pool is specified
+	// The default implementation calls Predict for each row
+	virtual void PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+		IThreadPool* threadPool = nullptr ) const;
+
 	// Serializes the model
 	void Serialize( CArchive& archive ) override = 0;
 };
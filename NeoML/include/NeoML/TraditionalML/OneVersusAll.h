@@ -56,12 +56,18 @@ public:
 	// Sets a text stream for logging processing
 	void SetLog( CTextStream* newLog ) { logStream = newLog; }
 
+	// Sets the number of threads for training the binary classifiers, 1 by default (0 or less for all the cores)
+	// With several threads the basic classifier Train method is called concurrently (CLinear supports it)
+	void SetThreadCount( int newThreadCount ) { threadCount = newThreadCount; }
+	int GetThreadCount() const { return threadCount; }
+
 	// ITrainingModel interface methods:
 	CPtr<IModel> Train( const IProblem& trainingClassificationData ) override;
 
 private:
 	ITrainingModel& baseBinaryClassifier; // the basic binary classifier used
 	CTextStream* logStream; // the logging stream
+	int threadCount; // the number of threads used for training
 };
 
 } // namespace NeoML
@@ -32,12 +32,17 @@ public:
 	// Sets a text stream for logging
 	void SetLog( CTextStream* newLog ) { log = newLog; }
 
+	// Sets the number of threads for training the class pairs, the same as COneVersusAll::SetThreadCount
+	void SetThreadCount( int newThreadCount ) { threadCount = newThreadCount; }
+	int GetThreadCount() const { return threadCount; }
+
 	// ITrainingModel interface methods
 	CPtr<IModel> Train( const IProblem& traningData ) override;
 
 private:
 	ITrainingModel& baseClassifier; // the basic binary classifier used
 	CTextStream* log; // the logging stream
+	int threadCount; // the number of threads used for training
 };
 
 } // namespace NeoML
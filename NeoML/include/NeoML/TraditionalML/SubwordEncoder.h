@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <NeoML/NeoMLDefs.h>
 #include <NeoML/TraditionalML/Model.h>
+#include <memory>
 
 namespace NeoML {
 
@@ -72,71 +73,49 @@ public:
 };
 
 // Subword encoder which supports caching results of 'Encode' calls.
+// Encode and EncodeBatch may be called from several threads at the same time.
 class NEOML_API ISubwordEncoderWithCache : public ISubwordEncoder {
 public:
 	void Encode( const CString& word, CArray<int>& tokenIds,
 		CArray<int>& tokenLengths ) const override final;
 
-	// Cache cleanup period
+	// Encodes the words into one array of token ids with corresponding token lengths.
+	// The tokens of the i-th word are [ offsets[i], offsets[i + 1] ), offsets.Size() == words.Size() + 1.
+	// The words are encoded in parallel if the thread pool is specified.
+	void EncodeBatch( const CArray<CString>& words, CArray<int>& tokenIds, CArray<int>& tokenLengths,
+		CArray<int>& offsets, IThreadPool* threadPool = nullptr ) const;
+
+	// Cache size
 	// The cache is used for Encode calls acceleration.
-	// The result of the encode call is cached and will be erased if 
-	// no call with the same word will occur among next 1-2 X cachePeriod calls.
-	int GetCachePeriod() const { return cache.GetCachePeriod(); }
+	// The cache keeps the results for at most cachePeriod words.
+	// The words are split into up to 16 parts by their hash, and the least recently requested words
+	// of a part are erased when it is full.
+	int GetCachePeriod() const;
 
-	// Sets the cache cleanup period.
+	// Sets the cache size. The cache is cleared.
 	// Increase in cachePeriod leads to a in increase in memory consumption.
 	// To completely switch the cache off set cachePeriod equal to -1.
 	// Value 0 is treated as invalid.
-	void SetCachePeriod( int cachePeriod ) const { cache.SetCachePeriod( cachePeriod ); }
+	void SetCachePeriod( int cachePeriod ) const;
 
 	// Clears cache.
-	void ClearCache() const { cache.Clear(); }
+	void ClearCache() const;
 
 protected:
+	ISubwordEncoderWithCache();
+	~ISubwordEncoderWithCache() override;
+
 	// 'Internal' Encode with the same meaning.
+	// May be called from several threads at the same time.
 	virtual void DoEncode( const CString& word, CArray<int>& tokenIds,
 		CArray<int>& tokenLengths ) const = 0;
 
 private:
-	// Internal cache for encoding requests.
-	class CCache {
-	public:
-		CCache() : cacheTime( 0 ), cachePeriod( 50000 ) {}
-		// Cache cleanup period
-		int GetCachePeriod() const { return cachePeriod; }
-		// Sets the cache cleanup period
-		void SetCachePeriod( int newPeriod );
-		// Requests data from cache.
-		bool Request( const CString& word, CArray<int>& tokenIds,
-			CArray<int>& tokenLengths );
-		// Adds data to cache.
-		void Add( const CString& word, const CArray<int>& tokenIds,
-			const CArray<int>& tokenLengths );
-		// Clears cache.
-		void Clear() { cacheTime = 0; wordCache.DeleteAll(); }
-
-	private:
-		// Data stored in cache: token ids and their unicode lengths and the latest request time.
-		struct CCachedData {
-			CFastArray<int, 4> TokenIds;
-			CFastArray<int, 4> TokenLengths;
-			long long Time;
-
-			CCachedData() : Time( 0 ) {}
-			CCachedData( const CCachedData& other );
-			CCachedData( CCachedData&& other );
-		};
-
-		// Current cache state.
-		CMap<CString, CCachedData> wordCache;
-		// Current cache time.
-		long long cacheTime;
-		// Cache cleanup period.
-		int cachePeriod;
-	};
+	// Internal thread-safe cache for encoding requests.
+	class CCache;
 
 	// Cache for Encode calls.
-	mutable CCache cache;
+	const std::unique_ptr<CCache> cache;
 };
 
 DECLARE_NEOML_MODEL_NAME( BytePairEncoderModelName, "NeoMLBytePairEncoderModel" )
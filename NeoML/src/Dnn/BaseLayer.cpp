@@ -100,6 +100,7 @@ void CBaseLayer::unlink()
 	paramDiffBlobs.DeleteAll();
 
 	readyOutputDiffs.DeleteAll();
+	plannedOutputBlobs.DeleteAll();
 
 	clearAllRuntimeBlobs();
 }
@@ -205,6 +206,10 @@ bool CBaseLayer::InputsMayBeOverwritten() const
 			// Current input may be used for training other layers connected to this input
 			return false;
 		}
+		if( GetDnn()->runThreadPool != nullptr && inputLayer->outputs[inputLinks[i].OutputNumber] != 1 ) {
+			// Current input may be used at the same time by other layers during the parallel run
+			return false;
+		}
 		if( ( inputLayer->blobsNeededForBackward & TOutputBlobs ) != 0 ) {
 			// The previous layer needs its output for backward
 			return false;
@@ -251,7 +256,11 @@ void CBaseLayer::AllocateOutputBlobs()
 
 	for( int i = 0; i < outputDescs.Size(); ++i ) {
 		if( outputBlobs[i] == nullptr ) {
-			outputBlobs[i] = CDnnBlob::CreateBlob( MathEngine(), outputDescs[i].GetDataType(), outputDescs[i] );
+			if( i < plannedOutputBlobs.Size() && plannedOutputBlobs[i] != nullptr ) {
+				outputBlobs[i] = plannedOutputBlobs[i];
+			} else {
+				outputBlobs[i] = CDnnBlob::CreateBlob( MathEngine(), outputDescs[i].GetDataType(), outputDescs[i] );
+			}
 		} else {
 			if( !outputBlobs[i]->GetDesc().HasEqualDimensions( outputDescs[i] ) ) {
 				// If this output can be connected to in-place transform. And on the second run outputBlob's shape can mismatch with outputDesc.
@@ -295,6 +304,45 @@ size_t CBaseLayer::GetTrainableParametersSize() const
 	return result;
 }
 
+void CBaseLayer::GetSharedParamBlobs( CArray<CPtr<CDnnBlob>*>& blobs )
+{
+	if( !isLearnable ) {
+		// The layer settings may be stored in the parameter blobs of the layers which are not trained
+		return;
+	}
+	for( int i = 0; i < paramBlobs.Size(); ++i ) {
+		blobs.Add( &paramBlobs[i] );
+	}
+}
+
+void CBaseLayer::SerializeParamBlob( CArchive& archive, CPtr<CDnnBlob>& blob )
+{
+	if( archive.IsStoring() && blob != nullptr && dnn != nullptr && dnn->isSharedParamSkipped( blob ) ) {
+		// The blob is passed to the loaded network separately
+		CPtr<CDnnBlob> skipped;
+		SerializeBlob( mathEngine, archive, skipped );
+	} else {
+		SerializeBlob( mathEngine, archive, blob );
+	}
+}
+
+void CBaseLayer::SerializeParamBlobs( CArchive& archive, CObjectArray<CDnnBlob>& blobs )
+{
+	if( archive.IsStoring() ) {
+		archive << blobs.Size();
+	} else if( archive.IsLoading() ) {
+		int size = 0;
+		archive >> size;
+		blobs.SetSize( size );
+	} else {
+		NeoAssert( false );
+	}
+
+	for( int i = 0; i < blobs.Size(); i++ ) {
+		SerializeParamBlob( archive, blobs[i] );
+	}
+}
+
 void CBaseLayer::switchBlobsToSequentialMode(CObjectArray<CDnnBlob>& blobs, TBlobCacheType cacheType, bool storeParent)
 {
 	CObjectArray<CDnnBlob>& cache = blobCache[cacheType];
@@ -401,6 +449,9 @@ void CBaseLayer::reshape()
 	}
 
 	Reshape();
+	// The output sizes or the in-place mode may have changed
+	plannedOutputBlobs.DeleteAll();
+	dnn->isMemoryPlanValid = false;
 	blobsNeededForBackward = ( IsBackwardPerformed() ? BlobsForBackward() : 0 )
 		| ( IsLearningPerformed() ? BlobsForLearn() : 0 );
 
@@ -508,6 +559,9 @@ void CBaseLayer::runOnce()
 
 	{
 		CRunOnceTimer timer( useTimer, MathEngine(), runOnceCount, runOnceTime );
+		CDnnProfiler* profiler = dnn->getProfiler();
+		CDnnProfiler::CEventScope profile( profiler, *this, DPS_Forward, dnn->runNumber, !isComposite(),
+			profiler == nullptr ? 0. : EstimateFlops() );
 		RunOnce();
 	}
 
@@ -596,11 +650,14 @@ void CBaseLayer::backwardRunAndLearnOnce()
 
 		// Perform one step of error backward propagation: 
 		// calculate the input error from the output one
+		CDnnProfiler* profiler = dnn->getProfiler();
+		CDnnProfiler::CEventScope profile( profiler, *this, DPS_Backward, dnn->runNumber, !isComposite(),
+			profiler == nullptr ? 0. : EstimateFlops() );
 		BackwardOnce();
 	}
 	// Learning: change the layer weights, using the output errors and inputs
 	if( IsLearningPerformed() ) {
-		if( paramDiffBlobs.Size() == 0 ) {
+		if( paramDiffBlobs.Size() == 0 && !HasSparseParamDiffs() ) {
 			// Create blobs
 			for( int i = 0; i < paramBlobs.Size(); ++i ) {
 				paramDiffBlobs.Add( paramBlobs[i]->GetClone() );
@@ -608,10 +665,17 @@ void CBaseLayer::backwardRunAndLearnOnce()
 			}
 		}
 		// Calculate parameter diffs
-		LearnOnce();
+		{
+			CDnnProfiler* profiler = dnn->getProfiler();
+			CDnnProfiler::CEventScope profile( profiler, *this, DPS_Learn, dnn->runNumber, !isComposite(),
+				profiler == nullptr ? 0. : EstimateFlops() );
+			LearnOnce();
+		}
 		// Change paramBlobs layer parameters, by applying paramDiffBlobs corrections
 		// according to optimizer strategy
-		if( paramBlobs.Size() != 0 && ( !dnn->IsRecurrentMode() || dnn->IsFirstSequencePos() ) ) {
+		if( paramBlobs.Size() != 0 && !HasSparseParamDiffs()
+			&& ( !dnn->IsRecurrentMode() || dnn->IsFirstSequencePos() ) )
+		{
 			GetDnn()->GetSolver()->AddDiff( this, paramDiffBlobs );
 			paramDiffBlobs.DeleteAll();
 		}
@@ -777,7 +841,7 @@ void CBaseLayer::Serialize( CArchive& archive )
 		archive << isBackwardForced;
 		archive << isLearningEnabled;
 		archive << baseLearningRate << baseL2RegularizationMult << baseL1RegularizationMult;
-		SerializeBlobs( mathEngine, archive, paramBlobs );
+		SerializeParamBlobs( archive, paramBlobs );
 	} else if( archive.IsLoading() ) {
 		if( dnn != 0 ) {
 			unlink();
@@ -794,7 +858,7 @@ void CBaseLayer::Serialize( CArchive& archive )
 		archive >> isLearningEnabled;
 		archive >> baseLearningRate >> baseL2RegularizationMult >> baseL1RegularizationMult;
 
-		SerializeBlobs( mathEngine, archive, paramBlobs );
+		SerializeParamBlobs( archive, paramBlobs );
 	} else {
 		NeoAssert( false );
 	}
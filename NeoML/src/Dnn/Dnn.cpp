@@ -285,6 +285,7 @@ REGISTER_NEOML_LAYER( CIndRnnRecurrentLayer, "NeoMLDnnIndRnnRecurrentLayer" )
 REGISTER_NEOML_LAYER( CMatrixMultiplicationLayer, "NeoMLDnnMatrixMultiplicationLayer" )
 REGISTER_NEOML_LAYER( CMobileNetV2BlockLayer, "NeoMLDnnMobileNetV2BlockLayer" )
 REGISTER_NEOML_LAYER( CMultiheadAttentionLayer, "NeoMLDnnMultiheadAttentionLayer" )
+REGISTER_NEOML_LAYER( CScaledDotProductAttentionLayer, "NeoMLDnnScaledDotProductAttentionLayer" )
 REGISTER_NEOML_LAYER( CObjectNormalizationLayer, "NeoMLDnnObjectNormalizationLayer" )
 REGISTER_NEOML_LAYER( CParameterLayer, "NeoMLDnnParameterLayer" )
 REGISTER_NEOML_LAYER( CQrnnFPoolingLayer, "NeoMLDnnQrnnFPoolingLayer" )
@@ -412,11 +413,18 @@ CDnn::CDnn( CRandom& _random, IMathEngine& _mathEngine, const CCompositeLayer* o
 	isBackwardPerformed( false ),
 	isLearningEnabled( true ),
 	isRecurrentMode( false ),
+	isInferenceReplica( false ),
 	maxSequenceLength( 1 ),
 	currentSequencePos( 0 ),
 	isReverseSequense( false ),
 	autoRestartMode( true ),
-	isReuseMemoryMode( false )
+	isReuseMemoryMode( false ),
+	isStaticMemoryPlanning( false ),
+	isMemoryPlanValid( false ),
+	runThreadCount( 1 ),
+	runThreadPool( nullptr ),
+	profiler( nullptr ),
+	skippedSharedParams( nullptr )
 {
 	solver = FINE_DEBUG_NEW CDnnSimpleGradientSolver( mathEngine );
 	initializer = FINE_DEBUG_NEW CDnnXavierInitializer( random );
@@ -429,6 +437,7 @@ CDnn::~CDnn()
 		DeleteLayer( *layer );
 		layer->setDnn( 0 );
 	}
+	delete runThreadPool;
 }
 
 void CDnn::GetLayerList( CArray<const char*>& layerList ) const
@@ -542,6 +551,7 @@ void CDnn::EnableLearning()
 	if( isLearningEnabled ) {
 		return;
 	}
+	NeoAssert( !isInferenceReplica );
 	isLearningEnabled = true;
 	RequestReshape( /*forcedReshape*/true );
 }
@@ -585,7 +595,11 @@ void CDnn::runOnce( int curSequencePos )
 	if( IsLogging() ) {
 		*log << "Run " << runNumber << " : " << currentSequencePos;
 	}
+	if( isParallelRun() ) {
+		runLayersParallel();
+	}
 	// Run the network for each sink layer; they will recursively call RunOnce for all their inputs
+	// After the parallel run all the layers have already been run
 	for( int i = 0; i < sinkLayers.Size(); ++i ) {
 		sinkLayers[i]->runOnce();
 
@@ -615,8 +629,19 @@ void CDnn::RunOnce()
 		}
 		reshape(); // rebuild the network if necessary
 
-		// During inference we turning reuseMemoryMode on when the net is big enough
-		isReuseMemoryMode = ( getOutputBlobsSize() > MinReuseMemoryModeNetSize );
+		if( isStaticMemoryPlanning && maxSequenceLength == 1 ) {
+			// The planned outputs are placed into the preallocated buffer
+			planMemory();
+			isReuseMemoryMode = false;
+		} else {
+			// The plan describes a single step, the sequences use the dynamic allocation
+			if( isMemoryPlanValid ) {
+				resetMemoryPlan();
+			}
+			// During inference we turning reuseMemoryMode on when the net is big enough
+			// The parallel run releases the blobs in a different order, so the memory isn't reused
+			isReuseMemoryMode = !isParallelRun() && ( getOutputBlobsSize() > MinReuseMemoryModeNetSize );
+		}
 		runOnce( 0 );
 #ifdef NEOML_USE_FINEOBJ
 	} catch( CCheckException* exception ) {
@@ -638,6 +663,7 @@ void CDnn::RunOnce()
 void CDnn::RunAndBackwardOnce()
 {
 	try {
+		NeoAssert( !isInferenceReplica );
 		NeoAssert( maxSequenceLength == 1 );
 		if( !isBackwardPerformed ) {
 			// The layer Reshape methods depend on IsBackwardPerformed()
@@ -647,6 +673,8 @@ void CDnn::RunAndBackwardOnce()
 		if( autoRestartMode ) {
 			RestartSequence();
 		}
+		// The outputs may be needed for backward, so the static memory plan is not applicable
+		resetMemoryPlan();
 		reshape(); // rebuild the network if necessary
 
 		// During training we don't reuse memory only when training on nonDistributed CPU
@@ -685,6 +713,99 @@ void CDnn::CleanUp()
 	}
 }
 
+CDnn* CDnn::CreateInferenceReplica( CRandom& replicaRandom )
+{
+	NeoAssert( owner == nullptr );
+
+	// The shared blobs are not written into the archive, so the replica is loaded without them
+	CMemoryFile file;
+	CObjectArray<CDnnBlob> sharedParams;
+	{
+		CArchive archive( &file, CArchive::SD_Storing );
+		storeWithoutSharedParams( archive, sharedParams );
+		archive.Close();
+	}
+	file.SeekToBegin();
+
+	CDnn* replica = FINE_DEBUG_NEW CDnn( replicaRandom, mathEngine );
+	try {
+		CArchive archive( &file, CArchive::SD_Loading );
+		replica->Serialize( archive );
+		archive.Close();
+		replica->setSharedParams( sharedParams );
+	} catch( ... ) {
+		delete replica;
+		throw;
+	}
+	replica->DisableLearning();
+	replica->isInferenceReplica = true;
+	return replica;
+}
+
+// Serializes the network with the shared parameter blobs written as null and returns these blobs
+// The layers are not changed, so the network may be run in other threads meanwhile
+void CDnn::storeWithoutSharedParams( CArchive& archive, CObjectArray<CDnnBlob>& sharedParams )
+{
+	NeoAssert( archive.IsStoring() );
+	NeoAssert( owner == nullptr );
+
+	CArray<CPtr<CDnnBlob>*> sharedBlobs;
+	getSharedParamBlobs( *this, sharedBlobs );
+	CHashTable<const CDnnBlob*> skipped;
+	sharedParams.SetSize( sharedBlobs.Size() );
+	for( int i = 0; i < sharedBlobs.Size(); ++i ) {
+		sharedParams[i] = *sharedBlobs[i];
+		if( sharedParams[i] != nullptr ) {
+			skipped.Add( sharedParams[i].Ptr() );
+		}
+	}
+
+	// Only one storing at a time uses the skipped blobs table
+	std::lock_guard<std::mutex> lock( skippedSharedParamsMutex );
+	skippedSharedParams = &skipped;
+	try {
+		Serialize( archive );
+	} catch( ... ) {
+		skippedSharedParams = nullptr;
+		throw;
+	}
+	skippedSharedParams = nullptr;
+}
+
+bool CDnn::isSharedParamSkipped( const CDnnBlob* blob ) const
+{
+	if( owner != nullptr && owner->GetDnn() != nullptr ) {
+		return owner->GetDnn()->isSharedParamSkipped( blob );
+	}
+	return skippedSharedParams != nullptr && skippedSharedParams->Has( blob );
+}
+
+// Sets the shared parameter blobs of the network loaded from the archive written by storeWithoutSharedParams
+void CDnn::setSharedParams( const CObjectArray<CDnnBlob>& sharedParams )
+{
+	CArray<CPtr<CDnnBlob>*> sharedBlobs;
+	getSharedParamBlobs( *this, sharedBlobs );
+	NeoAssert( sharedBlobs.Size() == sharedParams.Size() );
+	for( int i = 0; i < sharedBlobs.Size(); ++i ) {
+		*sharedBlobs[i] = sharedParams[i];
+	}
+}
+
+// Collects the shared parameters of all the layers including the internal layers of the composites
+void CDnn::getSharedParamBlobs( CDnnLayerGraph& graph, CArray<CPtr<CDnnBlob>*>& blobs )
+{
+	CArray<const char*> layerNames;
+	graph.GetLayerList( layerNames );
+	for( int i = 0; i < layerNames.Size(); ++i ) {
+		CPtr<CBaseLayer> layer = graph.GetLayer( layerNames[i] );
+		layer->GetSharedParamBlobs( blobs );
+		CCompositeLayer* composite = dynamic_cast<CCompositeLayer*>( layer.Ptr() );
+		if( composite != nullptr ) {
+			getSharedParamBlobs( *composite, blobs );
+		}
+	}
+}
+
 void CDnn::backwardRunAndLearnOnce( int curSequencePos )
 {
 	currentSequencePos = curSequencePos;
@@ -756,6 +877,7 @@ void CDnn::rebuild()
 	for( int i = 0; i < sinkLayers.Size(); ++i ) {
 		sinkLayers[i]->buildOrder();
 	}
+	buildRunSchedule();
 
 	RequestReshape( /*forcedReshape*/true );
 }
@@ -859,4 +981,12 @@ void CDnn::EnableProfile( bool profile )
 	}
 }
 
+CDnnProfiler* CDnn::getProfiler() const
+{
+	if( owner != nullptr && owner->GetDnn() != nullptr ) {
+		return owner->GetDnn()->getProfiler();
+	}
+	return profiler;
+}
+
 } // namespace NeoML
@@ -0,0 +1,228 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/DnnBatchingExecutor.h>
+#include <NeoML/Dnn/Layers/SourceLayer.h>
+#include <NeoML/Dnn/Layers/SinkLayer.h>
+
+namespace NeoML {
+
+// Checks if two blobs may be merged along BD_BatchWidth
+static bool canMergeByBatchWidth( const CDnnBlob& first, const CDnnBlob& second )
+{
+	if( first.GetDataType() != second.GetDataType() ) {
+		return false;
+	}
+	for( int dim = 0; dim < BD_Count; ++dim ) {
+		if( dim != BD_BatchWidth && first.DimSize( dim ) != second.DimSize( dim ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+CDnnBatchingExecutor::CDnnBatchingExecutor( CDnn& _dnn, int _maxBatchSize, int _maxQueueDelay ) :
+	dnn( _dnn ),
+	maxBatchSize( _maxBatchSize ),
+	maxQueueDelay( _maxQueueDelay ),
+	isStopped( false ),
+	runCount( 0 )
+{
+	NeoAssert( maxBatchSize > 0 );
+	NeoAssert( _maxQueueDelay >= 0 );
+
+	CArray<const char*> layerNames;
+	dnn.GetLayerList( layerNames );
+	for( int i = 0; i < layerNames.Size(); ++i ) {
+		const CBaseLayer* layer = dnn.GetLayer( layerNames[i] );
+		if( dynamic_cast<const CSourceLayer*>( layer ) != nullptr ) {
+			sourceNames.Add( layerNames[i] );
+		} else if( dynamic_cast<const CSinkLayer*>( layer ) != nullptr ) {
+			sinkNames.Add( layerNames[i] );
+		}
+	}
+	NeoAssert( !sourceNames.IsEmpty() );
+
+	worker = std::thread( [this] { run(); } );
+}
+
+CDnnBatchingExecutor::~CDnnBatchingExecutor()
+{
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		isStopped = true;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+std::future<CPtr<CDnnBatchingResult>> CDnnBatchingExecutor::Submit( const CObjectArray<CDnnBlob>& inputs )
+{
+	NeoAssert( inputs.Size() == sourceNames.Size() );
+	for( int i = 0; i < inputs.Size(); ++i ) {
+		NeoAssert( inputs[i] != nullptr );
+		NeoAssert( inputs[i]->GetBatchWidth() == inputs[0]->GetBatchWidth() );
+	}
+
+	std::unique_ptr<CRequest> request( new CRequest );
+	inputs.CopyTo( request->Inputs );
+	request->Deadline = std::chrono::steady_clock::now() + maxQueueDelay;
+	std::future<CPtr<CDnnBatchingResult>> result = request->Result.get_future();
+	{
+		std::lock_guard<std::mutex> lock( mutex );
+		NeoAssert( !isStopped );
+		queue.push_back( std::move( request ) );
+	}
+	condition.notify_all();
+	return result;
+}
+
+int CDnnBatchingExecutor::GetRunCount() const
+{
+	std::lock_guard<std::mutex> lock( mutex );
+	return runCount;
+}
+
+// The executor thread
+void CDnnBatchingExecutor::run()
+{
+	std::unique_lock<std::mutex> lock( mutex );
+	while( true ) {
+		condition.wait( lock, [this] { return isStopped || !queue.empty(); } );
+		if( queue.empty() ) {
+			return;
+		}
+
+		// Wait until the batch is full or the first request has waited for too long
+		const std::chrono::steady_clock::time_point deadline = queue.front()->Deadline;
+		while( !isStopped && getCompatibleBatchSize( *queue.front() ) < maxBatchSize ) {
+			if( condition.wait_until( lock, deadline ) == std::cv_status::timeout ) {
+				break;
+			}
+		}
+
+		std::vector<std::unique_ptr<CRequest>> batch;
+		extractBatch( batch );
+		++runCount;
+		lock.unlock();
+		processBatch( batch );
+		lock.lock();
+	}
+}
+
+// Checks if all the inputs of two requests may be merged
+bool CDnnBatchingExecutor::canMerge( const CRequest& first, const CRequest& second )
+{
+	NeoPresume( first.Inputs.Size() == second.Inputs.Size() );
+	for( int i = 0; i < first.Inputs.Size(); ++i ) {
+		if( !canMergeByBatchWidth( *first.Inputs[i], *second.Inputs[i] ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// The total BatchWidth of the queued requests that may be merged with the given one
+// Must be called under the lock
+int CDnnBatchingExecutor::getCompatibleBatchSize( const CRequest& first ) const
+{
+	int result = 0;
+	for( const std::unique_ptr<CRequest>& request : queue ) {
+		if( canMerge( *request, first ) ) {
+			result += request->Inputs[0]->GetBatchWidth();
+		}
+	}
+	return result;
+}
+
+// Moves the requests of the next batch from the queue keeping the order of the others
+// Must be called under the lock
+void CDnnBatchingExecutor::extractBatch( std::vector<std::unique_ptr<CRequest>>& batch )
+{
+	std::deque<std::unique_ptr<CRequest>> rest;
+	int batchSize = 0;
+	for( std::unique_ptr<CRequest>& request : queue ) {
+		const int width = request->Inputs[0]->GetBatchWidth();
+		if( batch.empty() || ( batchSize + width <= maxBatchSize && canMerge( *request, *batch.front() ) ) ) {
+			batchSize += width;
+			batch.push_back( std::move( request ) );
+		} else {
+			rest.push_back( std::move( request ) );
+		}
+	}
+	queue.swap( rest );
+}
+
+// Runs the network on the merged inputs and splits the outputs between the requests
+void CDnnBatchingExecutor::processBatch( std::vector<std::unique_ptr<CRequest>>& batch )
+{
+	try {
+		IMathEngine& mathEngine = dnn.GetMathEngine();
+		int batchWidth = 0;
+		for( const std::unique_ptr<CRequest>& request : batch ) {
+			batchWidth += request->Inputs[0]->GetBatchWidth();
+		}
+
+		for( int i = 0; i < sourceNames.Size(); ++i ) {
+			CPtr<CDnnBlob> input = batch.front()->Inputs[i];
+			if( batch.size() > 1 ) {
+				CObjectArray<CDnnBlob> parts;
+				for( const std::unique_ptr<CRequest>& request : batch ) {
+					parts.Add( request->Inputs[i] );
+				}
+				CBlobDesc desc = input->GetDesc();
+				desc.SetDimSize( BD_BatchWidth, batchWidth );
+				input = CDnnBlob::CreateBlob( mathEngine, input->GetDataType(), desc );
+				CDnnBlob::MergeByDim( mathEngine, BD_BatchWidth, parts, input );
+			}
+			CheckCast<CSourceLayer>( dnn.GetLayer( sourceNames[i] ) )->SetBlob( input );
+		}
+
+		dnn.RunOnce();
+
+		std::vector<CPtr<CDnnBatchingResult>> results;
+		for( size_t i = 0; i < batch.size(); ++i ) {
+			results.push_back( FINE_DEBUG_NEW CDnnBatchingResult );
+		}
+		for( int i = 0; i < sinkNames.Size(); ++i ) {
+			const CPtr<CDnnBlob>& output = CheckCast<CSinkLayer>( dnn.GetLayer( sinkNames[i] ) )->GetBlob();
+			NeoAssert( output->GetBatchWidth() == batchWidth );
+			// The sink blob is overwritten by the next run, so it is always copied
+			CObjectArray<CDnnBlob> parts;
+			for( size_t j = 0; j < batch.size(); ++j ) {
+				CBlobDesc desc = output->GetDesc();
+				desc.SetDimSize( BD_BatchWidth, batch[j]->Inputs[0]->GetBatchWidth() );
+				parts.Add( CDnnBlob::CreateBlob( mathEngine, output->GetDataType(), desc ) );
+				results[j]->outputs.Add( parts.Last() );
+			}
+			CDnnBlob::SplitByDim( mathEngine, BD_BatchWidth, output.Ptr(), parts );
+		}
+
+		for( size_t i = 0; i < batch.size(); ++i ) {
+			batch[i]->Result.set_value( results[i] );
+		}
+	} catch( ... ) {
+		// The failed run may leave the network partially reshaped
+		dnn.RequestReshape( /*forcedReshape*/true );
+		for( const std::unique_ptr<CRequest>& request : batch ) {
+			request->Result.set_exception( std::current_exception() );
+		}
+	}
+}
+
+} // namespace NeoML
@@ -0,0 +1,148 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/DnnHalfFloat.h>
+#include <NeoML/Dnn/Layers/CompositeLayer.h>
+#include <NeoML/Dnn/Layers/FullyConnectedLayer.h>
+#include <NeoML/Dnn/Layers/FullyConnectedSourceLayer.h>
+#include <NeoML/Dnn/Layers/LstmLayer.h>
+#include <NeoML/Dnn/Layers/MultichannelLookupLayer.h>
+#include <NeoMathEngine/NeoMathEngine.h>
+
+namespace NeoML {
+
+THalfFloatFormat GetHalfFloatFormat( TDnnWeightsPrecision precision )
+{
+	switch( precision ) {
+		case DWP_Float16:
+			return HFF_Float16;
+		case DWP_BFloat16:
+			return HFF_BFloat16;
+		default:
+			NeoAssert( false );
+	}
+	return HFF_Float16;
+}
+
+CDnnHalfFloatBlob::CDnnHalfFloatBlob() :
+	precision( DWP_Float16 )
+{
+}
+
+CDnnHalfFloatBlob::CDnnHalfFloatBlob( TDnnWeightsPrecision _precision, const CDnnBlob& blob ) :
+	precision( _precision ),
+	desc( blob.GetDesc() )
+{
+	NeoAssert( blob.GetDataType() == CT_Float );
+
+	CArray<float> buffer;
+	buffer.SetSize( blob.GetDataSize() );
+	blob.CopyTo( buffer.GetPtr() );
+	data.SetSize( buffer.Size() );
+	ConvertToHalfFloat( GetHalfFloatFormat( precision ), buffer.GetPtr(), data.GetPtr(), data.Size() );
+}
+
+CPtr<CDnnBlob> CDnnHalfFloatBlob::GetFloatBlob( IMathEngine& mathEngine ) const
+{
+	CArray<float> buffer;
+	buffer.SetSize( data.Size() );
+	ConvertFromHalfFloat( GetHalfFloatFormat( precision ), data.GetPtr(), buffer.GetPtr(), data.Size() );
+	CPtr<CDnnBlob> result = CDnnBlob::CreateBlob( mathEngine, CT_Float, desc );
+	result->CopyFrom( buffer.GetPtr() );
+	return result;
+}
+
+void CDnnHalfFloatBlob::GetFloatObject( int objectIndex, float* result ) const
+{
+	NeoAssert( 0 <= objectIndex && objectIndex < GetObjectCount() );
+	const int objectSize = GetObjectSize();
+	ConvertFromHalfFloat( GetHalfFloatFormat( precision ), data.GetPtr() + objectIndex * objectSize,
+		result, objectSize );
+}
+
+static const int DnnHalfFloatBlobVersion = 0;
+
+void CDnnHalfFloatBlob::Serialize( CArchive& archive )
+{
+	archive.SerializeVersion( DnnHalfFloatBlobVersion );
+	archive.SerializeEnum( precision );
+	if( archive.IsStoring() ) {
+		for( TBlobDim d = TBlobDim( 0 ); d < BD_Count; ++d ) {
+			archive << desc.DimSize( d );
+		}
+		archive.Write( data.GetPtr(), data.Size() * static_cast<int>( sizeof( uint16_t ) ) );
+	} else if( archive.IsLoading() ) {
+		check( precision == DWP_Float16 || precision == DWP_BFloat16, ERR_BAD_ARCHIVE, archive.Name() );
+		desc = CBlobDesc( CT_Float );
+		for( TBlobDim d = TBlobDim( 0 ); d < BD_Count; ++d ) {
+			int size = 0;
+			archive >> size;
+			check( size > 0, ERR_BAD_ARCHIVE, archive.Name() );
+			desc.SetDimSize( d, size );
+		}
+		data.SetSize( desc.BlobSize() );
+		archive.Read( data.GetPtr(), data.Size() * static_cast<int>( sizeof( uint16_t ) ) );
+	} else {
+		NeoAssert( false );
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+int SetDnnWeightsPrecision( CDnnLayerGraph& graph, TDnnWeightsPrecision precision, int minWeightsSize )
+{
+	int result = 0;
+	CArray<const char*> layerNames;
+	graph.GetLayerList( layerNames );
+	for( const char* layerName : layerNames ) {
+		CBaseLayer* layer = graph.GetLayer( layerName ).Ptr();
+		if( dynamic_cast<CFullyConnectedSourceLayer*>( layer ) != nullptr
+			|| dynamic_cast<CLstmLayer*>( layer ) != nullptr )
+		{
+			// These layers access the weights of their fully-connected parts directly
+			continue;
+		}
+		CFullyConnectedLayer* fc = dynamic_cast<CFullyConnectedLayer*>( layer );
+		CMultichannelLookupLayer* lookup = dynamic_cast<CMultichannelLookupLayer*>( layer );
+		CCompositeLayer* composite = dynamic_cast<CCompositeLayer*>( layer );
+		if( fc != nullptr ) {
+			// The size of the 16-bit or uninitialized weights is not checked
+			const CDnnBlob* weights = fc->Weights();
+			if( fc->GetWeightsPrecision() != precision && !fc->GetInt8Quantization().IsQuantized()
+				&& ( weights == nullptr || weights->GetDataSize() >= minWeightsSize ) )
+			{
+				fc->SetWeightsPrecision( precision );
+				++result;
+			}
+		} else if( lookup != nullptr ) {
+			int weightsSize = 0;
+			for( const CLookupDimension& dimension : lookup->GetDimensions() ) {
+				weightsSize += dimension.VectorCount * dimension.VectorSize;
+			}
+			if( weightsSize >= minWeightsSize && lookup->GetEmbeddingsPrecision() != precision ) {
+				lookup->SetEmbeddingsPrecision( precision );
+				++result;
+			}
+		} else if( composite != nullptr ) {
+			result += SetDnnWeightsPrecision( *composite, precision, minWeightsSize );
+		}
+	}
+	return result;
+}
+
+} // namespace NeoML
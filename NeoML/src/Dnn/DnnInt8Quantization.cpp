@@ -0,0 +1,240 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/DnnInt8Quantization.h>
+#include <NeoML/Dnn/Layers/CompositeLayer.h>
+#include <NeoML/Dnn/Layers/ConvLayer.h>
+#include <NeoML/Dnn/Layers/FullyConnectedLayer.h>
+#include <NeoML/Dnn/Layers/GruLayer.h>
+#include <NeoML/Dnn/Layers/LstmLayer.h>
+#include <NeoMathEngine/NeoMathEngine.h>
+
+namespace NeoML {
+
+void CInt8LayerQuantization::StartCalibration()
+{
+	Reset();
+	inputMin = 0;
+	inputMax = 0;
+	state = S_Calibrating;
+}
+
+void CInt8LayerQuantization::Calibrate( const CDnnBlob& input )
+{
+	NeoAssert( IsCalibrating() );
+	NeoAssert( input.GetDataType() == CT_Float );
+
+	CArray<float> buffer;
+	buffer.SetSize( input.GetDataSize() );
+	input.CopyTo( buffer.GetPtr() );
+	for( int i = 0; i < buffer.Size(); ++i ) {
+		inputMin = min( inputMin, buffer[i] );
+		inputMax = max( inputMax, buffer[i] );
+	}
+}
+
+void CInt8LayerQuantization::FinishCalibration( const CDnnBlob& floatWeights )
+{
+	NeoAssert( IsCalibrating() );
+	NeoAssert( floatWeights.GetDataType() == CT_Float );
+
+	// The range always contains zero, so that zero is represented exactly
+	const float inputRange = inputMax - inputMin;
+	inputScale = inputRange > 0 ? inputRange / 255.f : 1.f;
+	inputZeroPoint = min( 255, max( 0, static_cast<int>( roundf( -inputMin / inputScale ) ) ) );
+
+	const int outputSize = floatWeights.GetObjectCount();
+	const int inputSize = floatWeights.GetObjectSize();
+	CArray<float> buffer;
+	buffer.SetSize( floatWeights.GetDataSize() );
+	floatWeights.CopyTo( buffer.GetPtr() );
+	weightScales.SetSize( outputSize );
+	for( int out = 0; out < outputSize; ++out ) {
+		float maxAbs = 0;
+		for( int in = 0; in < inputSize; ++in ) {
+			maxAbs = max( maxAbs, fabsf( buffer[out * inputSize + in] ) );
+		}
+		weightScales[out] = maxAbs > 0 ? maxAbs / Int8WeightQuantizationMax : 1.f;
+	}
+
+	ResetDesc();
+	quantizeWeights( floatWeights );
+	state = S_Quantized;
+}
+
+// Quantizes each output channel of the weights with its own scale
+void CInt8LayerQuantization::quantizeWeights( const CDnnBlob& floatWeights )
+{
+	const int outputSize = floatWeights.GetObjectCount();
+	const int inputSize = floatWeights.GetObjectSize();
+	NeoAssert( weightScales.Size() == outputSize );
+
+	CArray<float> buffer;
+	buffer.SetSize( floatWeights.GetDataSize() );
+	floatWeights.CopyTo( buffer.GetPtr() );
+	weightsDesc = floatWeights.GetDesc();
+	weights.SetSize( buffer.Size() );
+	for( int out = 0; out < outputSize; ++out ) {
+		for( int in = 0; in < inputSize; ++in ) {
+			const float value = roundf( buffer[out * inputSize + in] / weightScales[out] );
+			weights[out * inputSize + in] = static_cast<signed char>( min( static_cast<float>( Int8WeightQuantizationMax ),
+				max( -static_cast<float>( Int8WeightQuantizationMax ), value ) ) );
+		}
+	}
+}
+
+CPtr<CDnnBlob> CInt8LayerQuantization::GetDequantizedWeights( IMathEngine& mathEngine ) const
+{
+	NeoAssert( IsQuantized() );
+	const int inputSize = weightsDesc.ObjectSize();
+	CArray<float> buffer;
+	buffer.SetSize( weights.Size() );
+	for( int i = 0; i < buffer.Size(); ++i ) {
+		buffer[i] = weights[i] * weightScales[i / inputSize];
+	}
+	CPtr<CDnnBlob> result = CDnnBlob::CreateBlob( mathEngine, CT_Float, weightsDesc );
+	result->CopyFrom( buffer.GetPtr() );
+	return result;
+}
+
+void CInt8LayerQuantization::Reset()
+{
+	ResetDesc();
+	weightScales.DeleteAll();
+	weights.DeleteAll();
+	weights.FreeBuffer();
+	weightsDesc = CBlobDesc();
+	state = S_Float;
+}
+
+void CInt8LayerQuantization::ResetDesc()
+{
+	delete desc;
+	desc = nullptr;
+}
+
+void CInt8LayerQuantization::Run( IMathEngine& mathEngine, const CDnnBlob* freeTerm, const CConstFloatHandle& input,
+	int inputHeight, const CFloatHandle& output )
+{
+	NeoAssert( IsQuantized() );
+	NeoAssert( weightScales.Size() == weightsDesc.ObjectCount() );
+
+	if( desc == nullptr ) {
+		CPtr<CDnnBlob> scales = CDnnBlob::CreateVector( mathEngine, CT_Float, weightScales.Size() );
+		scales->CopyFrom( weightScales.GetPtr() );
+		CConstFloatHandle freeTermData;
+		if( freeTerm != nullptr ) {
+			NeoAssert( freeTerm->GetDataSize() == weightsDesc.ObjectCount() );
+			freeTermData = freeTerm->GetData();
+		}
+		desc = mathEngine.InitInt8FullyConnected( weightsDesc.ObjectSize(), weightsDesc.ObjectCount(),
+			weights.GetPtr(), scales->GetData(), freeTerm != nullptr ? &freeTermData : nullptr,
+			inputScale, inputZeroPoint );
+	}
+	mathEngine.Int8FullyConnected( *desc, input, inputHeight, output );
+}
+
+static const int Int8LayerQuantizationVersion = 0;
+
+void CInt8LayerQuantization::Serialize( CArchive& archive )
+{
+	archive.SerializeVersion( Int8LayerQuantizationVersion );
+
+	if( archive.IsStoring() ) {
+		// The unfinished calibration is not stored
+		const bool isQuantized = IsQuantized();
+		archive << isQuantized;
+		if( isQuantized ) {
+			archive << inputScale << inputZeroPoint;
+			weightScales.Serialize( archive );
+			for( TBlobDim d = TBlobDim( 0 ); d < BD_Count; ++d ) {
+				archive << weightsDesc.DimSize( d );
+			}
+			archive.Write( weights.GetPtr(), weights.Size() );
+		}
+	} else if( archive.IsLoading() ) {
+		Reset();
+		bool isQuantized = false;
+		archive >> isQuantized;
+		if( isQuantized ) {
+			archive >> inputScale >> inputZeroPoint;
+			weightScales.Serialize( archive );
+			weightsDesc = CBlobDesc( CT_Float );
+			for( TBlobDim d = TBlobDim( 0 ); d < BD_Count; ++d ) {
+				int size = 0;
+				archive >> size;
+				check( size > 0, ERR_BAD_ARCHIVE, archive.Name() );
+				weightsDesc.SetDimSize( d, size );
+			}
+			check( weightsDesc.ObjectCount() == weightScales.Size(), ERR_BAD_ARCHIVE, archive.Name() );
+			weights.SetSize( weightsDesc.BlobSize() );
+			archive.Read( weights.GetPtr(), weights.Size() );
+			state = S_Quantized;
+		}
+	} else {
+		NeoAssert( false );
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// Calls the function for every layer which supports int8 quantization
+template<typename TFunction>
+static int forEachQuantizableLayer( CDnnLayerGraph& graph, const TFunction& function )
+{
+	int result = 0;
+	CArray<const char*> layerNames;
+	graph.GetLayerList( layerNames );
+	for( const char* layerName : layerNames ) {
+		CBaseLayer* layer = graph.GetLayer( layerName ).Ptr();
+		if( dynamic_cast<CLstmLayer*>( layer ) != nullptr || dynamic_cast<CGruLayer*>( layer ) != nullptr ) {
+			// These layers access the weights of their fully-connected parts directly
+			continue;
+		}
+		CFullyConnectedLayer* fc = dynamic_cast<CFullyConnectedLayer*>( layer );
+		CConvLayer* conv = dynamic_cast<CConvLayer*>( layer );
+		CCompositeLayer* composite = dynamic_cast<CCompositeLayer*>( layer );
+		if( fc != nullptr ) {
+			function( *fc );
+			++result;
+		} else if( conv != nullptr && conv->IsInt8QuantizationSupported() ) {
+			function( *conv );
+			++result;
+		} else if( composite != nullptr ) {
+			result += forEachQuantizableLayer( *composite, function );
+		}
+	}
+	return result;
+}
+
+int CDnnInt8Quantizer::StartCalibration( CDnnLayerGraph& graph ) const
+{
+	return forEachQuantizableLayer( graph, [] ( auto& layer ) { layer.StartInt8Calibration(); } );
+}
+
+int CDnnInt8Quantizer::FinishCalibration( CDnnLayerGraph& graph ) const
+{
+	return forEachQuantizableLayer( graph, [] ( auto& layer ) { layer.FinishInt8Calibration(); } );
+}
+
+int CDnnInt8Quantizer::Reset( CDnnLayerGraph& graph ) const
+{
+	return forEachQuantizableLayer( graph, [] ( auto& layer ) { layer.ResetInt8Quantization(); } );
+}
+
+} // namespace NeoML
@@ -19,6 +19,7 @@ limitations under the License.
 #include <NeoML/Dnn/DnnLora.h>
 #include <NeoML/Dnn/DnnDistributed.h>
 #include <NeoML/Dnn/Layers/CompositeLayer.h>
+#include <NeoML/Dnn/Layers/FullyConnectedLayer.h>
 #include <NeoML/Dnn/Layers/LoraFullyConnectedLayer.h>
 
 namespace NeoML {
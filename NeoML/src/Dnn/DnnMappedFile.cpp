@@ -0,0 +1,341 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/Dnn.h>
+#include <NeoML/ArchiveFile.h>
+
+#if FINE_PLATFORM( FINE_WINDOWS )
+#include <windows.h>
+#elif FINE_PLATFORM( FINE_LINUX ) || FINE_PLATFORM( FINE_DARWIN ) || FINE_PLATFORM( FINE_IOS ) || FINE_PLATFORM( FINE_ANDROID )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#error Unknown platform
+#endif
+
+namespace NeoML {
+
+namespace {
+
+// The file layout:
+// - the signature and the size of the header (both are 32-bit integers)
+// - the header: an archive with the network without the shared parameter blobs and the descriptions of these blobs
+// - the data of the shared parameter blobs, each blob starts at a page-aligned position
+const int mappedFileSignature = 0x504D4E44; // "DNMP"
+const int mappedFilePrefixSize = 2 * sizeof( int );
+const __int64 mappedFileAlignment = 4096;
+
+const int DnnMappedFileVersion = 0;
+
+inline __int64 alignMappedFilePosition( __int64 position )
+{
+	return ( position + mappedFileAlignment - 1 ) / mappedFileAlignment * mappedFileAlignment;
+}
+
+// The positions of the blobs data in the file; the null blobs have zero size
+void getMappedBlobPositions( int headerSize, const CArray<__int64>& dataSizes, CArray<__int64>& positions )
+{
+	__int64 position = mappedFilePrefixSize + headerSize;
+	positions.SetSize( dataSizes.Size() );
+	for( int i = 0; i < dataSizes.Size(); ++i ) {
+		positions[i] = alignMappedFilePosition( position );
+		position = positions[i] + dataSizes[i];
+	}
+}
+
+void throwMappedFileException( int errorCode, const CString& fileName )
+{
+#ifdef NEOML_USE_FINEOBJ
+	ThrowFileException( errorCode, fileName.CreateUnicodeString( CP_UTF8 ) );
+#else
+	ThrowFileException( errorCode, fileName );
+#endif
+}
+
+// Writes the data which may be larger than the maximum size of one CBaseFile::Write call
+void writeMappedFileData( CBaseFile& file, const void* data, __int64 size )
+{
+	const int maxChunkSize = 1 << 30;
+	const char* ptr = static_cast<const char*>( data );
+	while( size > 0 ) {
+		const int chunkSize = static_cast<int>( min( size, static_cast<__int64>( maxChunkSize ) ) );
+		file.Write( ptr, chunkSize );
+		ptr += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// The file mapped into memory in the copy-on-write mode
+class CDnnFileMapping : public IObject {
+public:
+	explicit CDnnFileMapping( const char* fileName );
+
+	const char* GetData() const { return data; }
+	__int64 GetSize() const { return size; }
+
+protected:
+	~CDnnFileMapping() override;
+
+private:
+	char* data;
+	__int64 size;
+};
+
+#if FINE_PLATFORM( FINE_WINDOWS )
+
+CDnnFileMapping::CDnnFileMapping( const char* fileName ) :
+	data( nullptr ),
+	size( 0 )
+{
+	HANDLE file = ::CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE ) {
+		throwMappedFileException( static_cast<int>( ::GetLastError() ), fileName );
+	}
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if( ::GetFileSizeEx( file, &fileSize ) && fileSize.QuadPart > 0 ) {
+		size = fileSize.QuadPart;
+		mapping = ::CreateFileMappingA( file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr );
+	}
+	if( mapping != nullptr ) {
+		data = static_cast<char*>( ::MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 ) );
+	}
+	const int errorCode = static_cast<int>( ::GetLastError() );
+	if( mapping != nullptr ) {
+		::CloseHandle( mapping );
+	}
+	::CloseHandle( file );
+	check( size > 0, ERR_BAD_ARCHIVE, fileName );
+	if( data == nullptr ) {
+		throwMappedFileException( errorCode, fileName );
+	}
+}
+
+CDnnFileMapping::~CDnnFileMapping()
+{
+	::UnmapViewOfFile( data );
+}
+
+#else
+
+CDnnFileMapping::CDnnFileMapping( const char* fileName ) :
+	data( nullptr ),
+	size( 0 )
+{
+	const int file = ::open( fileName, O_RDONLY );
+	if( file == -1 ) {
+		throwMappedFileException( errno, fileName );
+	}
+	struct stat fileStat;
+	void* mapped = MAP_FAILED;
+	if( ::fstat( file, &fileStat ) == 0 && fileStat.st_size > 0 ) {
+		size = static_cast<__int64>( fileStat.st_size );
+		// The private writable mapping lets the network change the parameters without modifying the file
+		mapped = ::mmap( nullptr, static_cast<size_t>( size ), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0 );
+	}
+	const int errorCode = errno;
+	::close( file );
+	check( size > 0, ERR_BAD_ARCHIVE, fileName );
+	if( mapped == MAP_FAILED ) {
+		throwMappedFileException( errorCode, fileName );
+	}
+	data = static_cast<char*>( mapped );
+}
+
+CDnnFileMapping::~CDnnFileMapping()
+{
+	::munmap( data, static_cast<size_t>( size ) );
+}
+
+#endif
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// The blob which uses the memory of the mapped file
+class CDnnMappedBlob : public CDnnBlob {
+public:
+	CDnnMappedBlob( IMathEngine& mathEngine, const CBlobDesc& desc, CDnnFileMapping& mapping, __int64 position ) :
+		CDnnBlob( mathEngine, desc, CreateCpuExternalMemoryHandle( mathEngine, mapping.GetData() + position ),
+			/*dataOwned*/false ),
+		mapping( &mapping )
+	{
+	}
+
+private:
+	const CPtr<CDnnFileMapping> mapping; // the blob memory stays valid while the blob exists
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void CDnn::StoreMapped( const char* fileName )
+{
+	NeoAssert( owner == nullptr );
+
+	CMemoryFile header;
+	CObjectArray<CDnnBlob> sharedParams;
+	{
+		CArchive archive( &header, CArchive::SD_Storing );
+		archive.SerializeVersion( DnnMappedFileVersion );
+		storeWithoutSharedParams( archive, sharedParams );
+		archive << sharedParams.Size();
+		for( int i = 0; i < sharedParams.Size(); ++i ) {
+			const bool isNull = ( sharedParams[i] == nullptr );
+			archive << isNull;
+			if( !isNull ) {
+				archive << static_cast<int>( sharedParams[i]->GetDataType() );
+				for( TBlobDim d = TBlobDim( 0 ); d < BD_Count; ++d ) {
+					archive << sharedParams[i]->DimSize( d );
+				}
+			}
+		}
+		archive.Close();
+	}
+
+	const int headerSize = static_cast<int>( header.GetLength() );
+	CArray<__int64> dataSizes;
+	dataSizes.Add( 0, sharedParams.Size() );
+	for( int i = 0; i < sharedParams.Size(); ++i ) {
+		if( sharedParams[i] != nullptr ) {
+			dataSizes[i] = static_cast<__int64>( sharedParams[i]->GetDataSize() ) * sizeof( float );
+		}
+	}
+	CArray<__int64> positions;
+	getMappedBlobPositions( headerSize, dataSizes, positions );
+
+	CArchiveFile file( fileName, CArchive::SD_Storing );
+	file.Write( &mappedFileSignature, sizeof( mappedFileSignature ) );
+	file.Write( &headerSize, sizeof( headerSize ) );
+	CArray<char> headerData;
+	headerData.SetSize( headerSize );
+	header.SeekToBegin();
+	header.Read( headerData.GetPtr(), headerSize );
+	file.Write( headerData.GetPtr(), headerSize );
+
+	CArray<char> padding;
+	padding.Add( 0, static_cast<int>( mappedFileAlignment ) );
+	__int64 position = mappedFilePrefixSize + headerSize;
+	for( int i = 0; i < sharedParams.Size(); ++i ) {
+		if( sharedParams[i] == nullptr ) {
+			continue;
+		}
+		file.Write( padding.GetPtr(), static_cast<int>( positions[i] - position ) );
+		const __int64 dataSize = dataSizes[i];
+		switch( sharedParams[i]->GetDataType() ) {
+			case CT_Float:
+			{
+				CDnnBlobBuffer<float> buffer( *sharedParams[i], TDnnBlobBufferAccess::Read );
+				writeMappedFileData( file, buffer.Ptr(), dataSize );
+				break;
+			}
+			case CT_Int:
+			{
+				CDnnBlobBuffer<int> buffer( *sharedParams[i], TDnnBlobBufferAccess::Read );
+				writeMappedFileData( file, buffer.Ptr(), dataSize );
+				break;
+			}
+			default:
+				NeoAssert( false );
+		}
+		position = positions[i] + dataSize;
+	}
+	file.Close();
+}
+
+void CDnn::LoadMapped( const char* fileName )
+{
+	NeoAssert( owner == nullptr );
+
+	CPtr<CDnnFileMapping> mapping = FINE_DEBUG_NEW CDnnFileMapping( fileName );
+	check( mapping->GetSize() >= mappedFilePrefixSize, ERR_BAD_ARCHIVE, fileName );
+	int signature = 0;
+	int headerSize = 0;
+	::memcpy( &signature, mapping->GetData(), sizeof( signature ) );
+	::memcpy( &headerSize, mapping->GetData() + sizeof( signature ), sizeof( headerSize ) );
+	check( signature == mappedFileSignature && headerSize >= 0
+		&& mapping->GetSize() - mappedFilePrefixSize >= headerSize, ERR_BAD_ARCHIVE, fileName );
+
+	CMemoryFile header;
+	header.Write( mapping->GetData() + mappedFilePrefixSize, headerSize );
+	header.SeekToBegin();
+	CArchive archive( &header, CArchive::SD_Loading );
+	archive.SerializeVersion( DnnMappedFileVersion );
+	Serialize( archive );
+
+	// The blobs are created after the network is loaded, as the data types and the sizes are needed
+	int blobCount = 0;
+	archive >> blobCount;
+	CArray<CPtr<CDnnBlob>*> sharedBlobs;
+	getSharedParamBlobs( *this, sharedBlobs );
+	check( blobCount == sharedBlobs.Size(), ERR_BAD_ARCHIVE, fileName );
+	CArray<CBlobDesc> descs;
+	descs.SetSize( blobCount );
+	CArray<__int64> dataSizes;
+	dataSizes.Add( 0, blobCount );
+	for( int i = 0; i < blobCount; ++i ) {
+		bool isNull = false;
+		archive >> isNull;
+		if( isNull ) {
+			continue;
+		}
+		int dataType = 0;
+		archive >> dataType;
+		check( dataType == CT_Float || dataType == CT_Int, ERR_BAD_ARCHIVE, fileName );
+		descs[i].SetDataType( static_cast<TBlobType>( dataType ) );
+		for( TBlobDim d = TBlobDim( 0 ); d < BD_Count; ++d ) {
+			int size = 0;
+			archive >> size;
+			check( size > 0, ERR_BAD_ARCHIVE, fileName );
+			descs[i].SetDimSize( d, size );
+		}
+		dataSizes[i] = static_cast<__int64>( descs[i].BlobSize() ) * sizeof( float );
+	}
+	archive.Close();
+
+	CArray<__int64> positions;
+	getMappedBlobPositions( headerSize, dataSizes, positions );
+	CObjectArray<CDnnBlob> sharedParams;
+	sharedParams.SetSize( blobCount );
+	for( int i = 0; i < blobCount; ++i ) {
+		if( dataSizes[i] == 0 ) {
+			continue;
+		}
+		check( mapping->GetSize() - positions[i] >= dataSizes[i], ERR_BAD_ARCHIVE, fileName );
+		const char* data = mapping->GetData() + positions[i];
+		if( mathEngine.GetType() == MET_Cpu ) {
+			sharedParams[i] = FINE_DEBUG_NEW CDnnMappedBlob( mathEngine, descs[i], *mapping, positions[i] );
+		} else {
+			// The other math engines can't use the host memory directly
+			sharedParams[i] = CDnnBlob::CreateBlob( mathEngine, descs[i].GetDataType(), descs[i] );
+			if( descs[i].GetDataType() == CT_Float ) {
+				sharedParams[i]->CopyFrom( reinterpret_cast<const float*>( data ) );
+			} else {
+				sharedParams[i]->CopyFrom( reinterpret_cast<const int*>( data ) );
+			}
+		}
+	}
+	setSharedParams( sharedParams );
+}
+
+} // namespace NeoML
@@ -0,0 +1,244 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/Dnn.h>
+
+namespace NeoML {
+
+namespace {
+
+// The alignment of the planned blobs in the buffer (in elements)
+const int memoryPlanAlignment = 16;
+
+// The blob placed into the buffer of the memory plan
+class CMemoryPlanBlob : public CDnnBlob {
+public:
+	CMemoryPlanBlob( CDnnBlob& buffer, const CBlobDesc& desc, int offset ) :
+		CDnnBlob( buffer.GetMathEngine(), desc, buffer.GetData() + offset, /*dataOwned*/false ),
+		buffer( &buffer )
+	{
+	}
+
+private:
+	const CPtr<CDnnBlob> buffer; // the buffer which owns the memory
+};
+
+// The memory region used by one or several outputs (in case of in-place processing)
+struct CPlannedRegion {
+	int Size = 0; // the size in elements
+	int Start = 0; // the position of the layer which creates the output in the run order
+	int End = 0; // the position of the last layer which uses the output in the run order
+	int Offset = NotFound; // the offset in the buffer
+
+	bool IntersectsInTime( const CPlannedRegion& other ) const { return Start <= other.End && other.Start <= End; }
+};
+
+// Greedy placement: the largest regions are placed first, each at the lowest offset
+// which doesn't overlap with the regions used at the same time
+// Returns the buffer size
+int placeRegions( CArray<CPlannedRegion>& regions )
+{
+	CArray<int> order;
+	order.SetBufferSize( regions.Size() );
+	for( int i = 0; i < regions.Size(); ++i ) {
+		order.Add( i );
+	}
+	for( int i = 1; i < order.Size(); ++i ) {
+		// Insertion sort by descending size (stable, so the result doesn't depend on the sort implementation)
+		const int current = order[i];
+		int j = i;
+		for( ; j > 0 && regions[order[j - 1]].Size < regions[current].Size; --j ) {
+			order[j] = order[j - 1];
+		}
+		order[j] = current;
+	}
+
+	int bufferSize = 0;
+	CArray<int> placed;
+	CArray<int> conflicts;
+	for( int index : order ) {
+		CPlannedRegion& region = regions[index];
+		conflicts.DeleteAll();
+		for( int other : placed ) {
+			if( region.IntersectsInTime( regions[other] ) ) {
+				conflicts.Add( other );
+			}
+		}
+		// Find the first gap between the conflicting regions
+		int offset = 0;
+		bool isMoved = true;
+		while( isMoved ) {
+			isMoved = false;
+			for( int other : conflicts ) {
+				const CPlannedRegion& otherRegion = regions[other];
+				if( offset < otherRegion.Offset + otherRegion.Size && otherRegion.Offset < offset + region.Size ) {
+					offset = otherRegion.Offset + otherRegion.Size;
+					isMoved = true;
+				}
+			}
+		}
+		region.Offset = offset;
+		bufferSize = max( bufferSize, offset + region.Size );
+		placed.Add( index );
+	}
+	return bufferSize;
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------------------------
+
+void CDnn::EnableStaticMemoryPlanning( bool enable )
+{
+	if( isStaticMemoryPlanning == enable ) {
+		return;
+	}
+	isStaticMemoryPlanning = enable;
+	resetMemoryPlan();
+	RequestReshape( /*forcedReshape*/true );
+}
+
+size_t CDnn::GetPlannedPeakMemory()
+{
+	if( !isStaticMemoryPlanning || maxSequenceLength != 1 ) {
+		return 0;
+	}
+	if( isBackwardPerformed ) {
+		// The layer Reshape methods depend on IsBackwardPerformed()
+		RequestReshape( /*forcedReshape*/true );
+	}
+	isBackwardPerformed = false;
+	reshape();
+	planMemory();
+	return memoryPlanBuffer == nullptr ? 0 : memoryPlanBuffer->GetDataSize() * sizeof( float );
+}
+
+// Places the layers outputs into one buffer according to their lifetimes during the run
+void CDnn::planMemory()
+{
+	// The outputs are planned for a single step
+	NeoAssert( maxSequenceLength == 1 );
+	if( isMemoryPlanValid ) {
+		return;
+	}
+	resetMemoryPlan();
+
+	// The layers in the run order (see CBaseLayer::runOnce)
+	CArray<CBaseLayer*> runOrder;
+	CMap<const CBaseLayer*, int> runPositions;
+	CArray<CBaseLayer*> stack;
+	CArray<int> nextInput;
+	for( CBaseLayer* sink : sinkLayers ) {
+		if( runPositions.Has( sink ) ) {
+			continue;
+		}
+		stack.Add( sink );
+		nextInput.Add( 0 );
+		while( !stack.IsEmpty() ) {
+			CBaseLayer* layer = stack.Last();
+			if( nextInput.Last() < layer->GetInputCount() ) {
+				CBaseLayer* input = layer->GetInputLayer( nextInput.Last()++ );
+				if( !runPositions.Has( input ) ) {
+					stack.Add( input );
+					nextInput.Add( 0 );
+				}
+				continue;
+			}
+			runPositions.Add( layer, runOrder.Size() );
+			runOrder.Add( layer );
+			stack.DeleteLast();
+			nextInput.DeleteLast();
+		}
+	}
+
+	// The memory region of each layer output (NotFound if the output is not planned)
+	CArray<CPlannedRegion> regions;
+	CArray<CArray<int>> outputRegions;
+	outputRegions.SetSize( runOrder.Size() );
+	for( int pos = 0; pos < runOrder.Size(); ++pos ) {
+		CBaseLayer* layer = runOrder[pos];
+		outputRegions[pos].Add( NotFound, layer->GetOutputCount() );
+		for( int i = 0; i < layer->GetInputCount(); ++i ) {
+			const int inputRegion = outputRegions[runPositions.Get( layer->GetInputLayer( i ) )][layer->inputLinks[i].OutputNumber];
+			if( inputRegion != NotFound ) {
+				// The outputs of the sink layers inputs are used after the run
+				regions[inputRegion].End = layer->GetOutputCount() == 0 ? runOrder.Size() : max( regions[inputRegion].End, pos );
+			}
+		}
+		if( layer->GetInputCount() == 0 || layer->isComposite() ) {
+			// The source layers outputs belong to the user, the composite layers use the internal networks outputs
+			continue;
+		}
+		for( int i = 0; i < layer->GetOutputCount(); ++i ) {
+			if( layer->isInPlace ) {
+				// The output is the same blob as the input
+				outputRegions[pos][i] = outputRegions[runPositions.Get( layer->GetInputLayer( i ) )][layer->inputLinks[i].OutputNumber];
+			} else {
+				outputRegions[pos][i] = regions.Size();
+				CPlannedRegion& region = regions.Append();
+				region.Size = ( layer->outputDescs[i].BlobSize() + memoryPlanAlignment - 1 ) / memoryPlanAlignment * memoryPlanAlignment;
+				region.Start = pos;
+				region.End = pos;
+			}
+		}
+	}
+
+	const int bufferSize = placeRegions( regions );
+	if( bufferSize > 0 ) {
+		memoryPlanBuffer = CDnnBlob::CreateVector( mathEngine, CT_Float, bufferSize );
+	}
+	for( int pos = 0; pos < runOrder.Size(); ++pos ) {
+		CBaseLayer* layer = runOrder[pos];
+		if( layer->isInPlace ) {
+			continue;
+		}
+		for( int i = 0; i < outputRegions[pos].Size(); ++i ) {
+			const int region = outputRegions[pos][i];
+			if( region != NotFound ) {
+				layer->plannedOutputBlobs.SetSize( layer->GetOutputCount() );
+				layer->plannedOutputBlobs[i] = FINE_DEBUG_NEW CMemoryPlanBlob( *memoryPlanBuffer,
+					layer->outputDescs[i], regions[region].Offset );
+			}
+		}
+	}
+	isMemoryPlanValid = true;
+}
+
+// Releases the buffer of the memory plan and the blobs placed into it
+void CDnn::resetMemoryPlan()
+{
+	for( int layerIndex = 0; layerIndex < layers.Size(); ++layerIndex ) {
+		CBaseLayer* layer = layers[layerIndex];
+		layer->plannedOutputBlobs.DeleteAll();
+		// The layers may still refer to the planned blobs, which would keep the old buffer alive
+		for( int i = 0; i < layer->outputBlobs.Size(); ++i ) {
+			if( dynamic_cast<CMemoryPlanBlob*>( layer->outputBlobs[i].Ptr() ) != nullptr ) {
+				layer->outputBlobs[i] = nullptr;
+			}
+		}
+		for( int i = 0; i < layer->inputBlobs.Size(); ++i ) {
+			if( dynamic_cast<CMemoryPlanBlob*>( layer->inputBlobs[i].Ptr() ) != nullptr ) {
+				layer->inputBlobs[i] = nullptr;
+			}
+		}
+	}
+	memoryPlanBuffer = nullptr;
+	isMemoryPlanValid = false;
+}
+
+} // namespace NeoML
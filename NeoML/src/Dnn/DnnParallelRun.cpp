@@ -0,0 +1,189 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/Dnn.h>
+#include <NeoMathEngine/ThreadPool.h>
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+namespace NeoML {
+
+namespace {
+
+// The state of one parallel run shared by the threads
+struct CParallelRunState {
+	const CArray<CBaseLayer*>& Layers;
+	const CArray<CArray<int>>& Outputs;
+
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	// The number of the input links whose layers haven't been run yet
+	CArray<int> WaitingInputs;
+	// The layers ready to be run; the earliest ones in the topological order are taken first
+	CPriorityQueue<CArray<int>, Descending<int>> Ready;
+	int FinishedCount;
+	std::exception_ptr Exception;
+
+	CParallelRunState( const CArray<CBaseLayer*>& layers, const CArray<int>& inputCounts,
+		const CArray<CArray<int>>& outputs );
+
+	bool IsFinished() const { return FinishedCount == Layers.Size() || Exception != nullptr; }
+};
+
+CParallelRunState::CParallelRunState( const CArray<CBaseLayer*>& layers, const CArray<int>& inputCounts,
+		const CArray<CArray<int>>& outputs ) :
+	Layers( layers ),
+	Outputs( outputs ),
+	FinishedCount( 0 )
+{
+	inputCounts.CopyTo( WaitingInputs );
+	for( int i = 0; i < WaitingInputs.Size(); ++i ) {
+		if( WaitingInputs[i] == 0 ) {
+			Ready.Push( i );
+		}
+	}
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------------------------------------------------
+
+void CDnn::SetRunThreadCount( int threadCount )
+{
+	if( threadCount <= 0 ) {
+		threadCount = GetAvailableCpuCores();
+	}
+	if( threadCount == runThreadCount ) {
+		return;
+	}
+	runThreadCount = threadCount;
+	delete runThreadPool;
+	runThreadPool = runThreadCount > 1 ? CreateThreadPool( runThreadCount ) : nullptr;
+	// The schedule is built and the in-place processing is checked on rebuild
+	ForceRebuild();
+}
+
+// Checks if the layers should be run in parallel on this step
+bool CDnn::isParallelRun() const
+{
+	return runThreadPool != nullptr && !isBackwardPerformed && !isRecurrentMode && !isStaticMemoryPlanning
+		&& getProfiler() == nullptr;
+}
+
+// Builds the layer dependency graph for the parallel run
+void CDnn::buildRunSchedule()
+{
+	runSchedule.DeleteAll();
+	runScheduleInputCounts.DeleteAll();
+	runScheduleOutputs.DeleteAll();
+	if( runThreadPool == nullptr ) {
+		return;
+	}
+
+	// The same topological order as in the sequential run: the depth-first search from the sinks
+	CMap<const CBaseLayer*, int> indices;
+	CArray<CBaseLayer*> stack;
+	CArray<int> nextInput;
+	for( int i = 0; i < sinkLayers.Size(); ++i ) {
+		if( indices.Has( sinkLayers[i] ) ) {
+			continue;
+		}
+		stack.Add( sinkLayers[i] );
+		nextInput.Add( 0 );
+		while( !stack.IsEmpty() ) {
+			CBaseLayer* layer = stack.Last();
+			int& input = nextInput.Last();
+			while( input < layer->GetInputCount() && indices.Has( layer->GetInputLayer( input ) ) ) {
+				++input;
+			}
+			if( input < layer->GetInputCount() ) {
+				CBaseLayer* inputLayer = layer->GetInputLayer( input );
+				NeoAssert( !stack.Has( inputLayer ) ); // the graph must be acyclic
+				stack.Add( inputLayer );
+				nextInput.Add( 0 );
+				continue;
+			}
+			indices.Add( layer, runSchedule.Size() );
+			runSchedule.Add( layer );
+			stack.DeleteLast();
+			nextInput.DeleteLast();
+		}
+	}
+
+	runScheduleInputCounts.Add( 0, runSchedule.Size() );
+	runScheduleOutputs.SetSize( runSchedule.Size() );
+	for( int i = 0; i < runSchedule.Size(); ++i ) {
+		const CBaseLayer* layer = runSchedule[i];
+		runScheduleInputCounts[i] = layer->GetInputCount();
+		for( int input = 0; input < layer->GetInputCount(); ++input ) {
+			runScheduleOutputs[indices.Get( layer->GetInputLayer( input ) )].Add( i );
+		}
+	}
+}
+
+// Takes the ready layers and runs them until all the layers are run
+void CDnn::runScheduledLayers( int /*threadIndex*/, void* params )
+{
+	CParallelRunState& state = *static_cast<CParallelRunState*>( params );
+	std::unique_lock<std::mutex> lock( state.Mutex );
+	while( true ) {
+		state.Condition.wait( lock, [&state] { return state.IsFinished() || !state.Ready.IsEmpty(); } );
+		if( state.IsFinished() ) {
+			return;
+		}
+		int index = NotFound;
+		state.Ready.Pop( index );
+		lock.unlock();
+
+		try {
+			// The inputs have already been run, so only this layer is calculated
+			state.Layers[index]->runOnce();
+		} catch( ... ) {
+			lock.lock();
+			if( state.Exception == nullptr ) {
+				state.Exception = std::current_exception();
+			}
+			state.Condition.notify_all();
+			return;
+		}
+
+		lock.lock();
+		++state.FinishedCount;
+		for( int output : state.Outputs[index] ) {
+			if( --state.WaitingInputs[output] == 0 ) {
+				state.Ready.Push( output );
+			}
+		}
+		state.Condition.notify_all();
+	}
+}
+
+// Runs all the layers on the thread pool, each layer is started when all its inputs are ready
+void CDnn::runLayersParallel()
+{
+	NeoAssert( runThreadPool != nullptr );
+	CParallelRunState state( runSchedule, runScheduleInputCounts, runScheduleOutputs );
+	NEOML_NUM_THREADS( *runThreadPool, &state, runScheduledLayers );
+	if( state.Exception != nullptr ) {
+		std::rethrow_exception( state.Exception );
+	}
+}
+
+} // namespace NeoML
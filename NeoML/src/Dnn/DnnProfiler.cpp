@@ -0,0 +1,262 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoML/Dnn/DnnProfiler.h>
+#include <NeoML/Dnn/Dnn.h>
+#include <chrono>
+
+namespace NeoML {
+
+static const char* const profileStageNames[DPS_Count] = { "Forward", "Backward", "Learn" };
+
+// Writes the string as JSON string literal
+static void writeJsonString( CTextStream& stream, const char* str )
+{
+	static const char* const hexDigits = "0123456789abcdef";
+	stream << '"';
+	for( const char* ch = str; *ch != 0; ++ch ) {
+		switch( *ch ) {
+			case '"':
+				stream << "\\\"";
+				break;
+			case '\\':
+				stream << "\\\\";
+				break;
+			case '\n':
+				stream << "\\n";
+				break;
+			case '\t':
+				stream << "\\t";
+				break;
+			default:
+				if( static_cast<unsigned char>( *ch ) < 0x20 ) {
+					stream << "\\u00" << hexDigits[*ch >> 4] << hexDigits[*ch & 0xF];
+				} else {
+					stream << *ch;
+				}
+		}
+	}
+	stream << '"';
+}
+
+// Writes the string as CSV field
+static void writeCsvString( CTextStream& stream, const char* str )
+{
+	stream << '"';
+	for( const char* ch = str; *ch != 0; ++ch ) {
+		if( *ch == '"' ) {
+			stream << '"';
+		}
+		stream << *ch;
+	}
+	stream << '"';
+}
+
+// Writes the time in nanoseconds as microseconds (the time unit of Chrome trace format)
+static void writeMicroseconds( CTextStream& stream, IPerformanceCounters::CCounter::TCounterType time )
+{
+	const int fraction = static_cast<int>( time % 1000 );
+	stream << time / 1000 << '.' << fraction / 100 << fraction / 10 % 10 << fraction % 10;
+}
+
+//---------------------------------------------------------------------------------------------------------
+
+CDnnProfiler::CDnnProfiler( bool _collectHardwareCounters ) :
+	collectHardwareCounters( _collectHardwareCounters ),
+	startTime( 0 ),
+	countersMathEngine( nullptr )
+{
+	startTime = now();
+}
+
+CDnnProfiler::~CDnnProfiler() = default;
+
+void CDnnProfiler::Clear()
+{
+	events.DeleteAll();
+	startTime = now();
+}
+
+void CDnnProfiler::SaveChromeTrace( CTextStream& stream ) const
+{
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for( int i = 0; i < events.Size(); ++i ) {
+		const CDnnProfileEvent& event = events[i];
+		stream << ( i == 0 ? "\n" : ",\n" ) << "{\"name\":";
+		writeJsonString( stream, event.LayerPath );
+		stream << ",\"cat\":\"" << profileStageNames[event.Stage] << "\",\"ph\":\"X\",\"ts\":";
+		writeMicroseconds( stream, event.Start );
+		stream << ",\"dur\":";
+		writeMicroseconds( stream, event.Duration );
+		stream << ",\"pid\":0,\"tid\":0,\"args\":{\"class\":";
+		writeJsonString( stream, event.LayerClass );
+		stream << ",\"run\":" << event.RunNumber
+			<< ",\"allocated_bytes\":" << event.AllocatedMemory
+			<< ",\"flops\":" << event.Flops;
+		for( const IPerformanceCounters::CCounter& counter : event.Counters ) {
+			stream << ',';
+			writeJsonString( stream, counter.Name );
+			stream << ':' << counter.Value;
+		}
+		stream << "}}";
+	}
+	stream << "\n]}\n";
+}
+
+void CDnnProfiler::SaveSummary( CTextStream& stream ) const
+{
+	// The statistics of one layer and stage
+	struct CSummary {
+		int FirstEvent = 0;
+		int Calls = 0;
+		IPerformanceCounters::CCounter::TCounterType TotalTime = 0;
+		IPerformanceCounters::CCounter::TCounterType MaxTime = 0;
+		int64_t AllocatedMemory = 0;
+		double Flops = 0;
+	};
+
+	// The names of all the counters
+	CArray<CString> counterNames;
+	CMap<CString, int> counterIndices;
+	for( const CDnnProfileEvent& event : events ) {
+		for( const IPerformanceCounters::CCounter& counter : event.Counters ) {
+			if( !counterIndices.Has( counter.Name ) ) {
+				counterIndices.Add( counter.Name, counterNames.Size() );
+				counterNames.Add( counter.Name );
+			}
+		}
+	}
+
+	// Aggregate the events in the order of the first appearance
+	CArray<CSummary> summaries;
+	CMap<CString, int> summaryIndices;
+	// The total values of the counters: counterNames.Size() values for each summary
+	CArray<IPerformanceCounters::CCounter::TCounterType> counterTotals;
+	for( int i = 0; i < events.Size(); ++i ) {
+		const CDnnProfileEvent& event = events[i];
+		const CString key = event.LayerPath + "\n" + profileStageNames[event.Stage];
+		int index = NotFound;
+		if( !summaryIndices.Lookup( key, index ) ) {
+			index = summaries.Size();
+			summaryIndices.Add( key, index );
+			summaries.Append().FirstEvent = i;
+			counterTotals.Add( 0, counterNames.Size() );
+		}
+		CSummary& summary = summaries[index];
+		summary.Calls++;
+		summary.TotalTime += event.Duration;
+		summary.MaxTime = max( summary.MaxTime, event.Duration );
+		summary.AllocatedMemory += event.AllocatedMemory;
+		summary.Flops += event.Flops;
+		for( const IPerformanceCounters::CCounter& counter : event.Counters ) {
+			counterTotals[index * counterNames.Size() + counterIndices.Get( counter.Name )] += counter.Value;
+		}
+	}
+
+	stream << "layer,class,stage,calls,total_ms,average_ms,max_ms,allocated_bytes,flops,gflops_per_second";
+	for( const CString& name : counterNames ) {
+		stream << ',';
+		writeCsvString( stream, name );
+	}
+	stream << '\n';
+	for( int index = 0; index < summaries.Size(); ++index ) {
+		const CSummary& summary = summaries[index];
+		const CDnnProfileEvent& event = events[summary.FirstEvent];
+		writeCsvString( stream, event.LayerPath );
+		stream << ',';
+		writeCsvString( stream, event.LayerClass );
+		stream << ',' << profileStageNames[event.Stage]
+			<< ',' << summary.Calls
+			<< ',' << summary.TotalTime / 1e6
+			<< ',' << summary.TotalTime / 1e6 / summary.Calls
+			<< ',' << summary.MaxTime / 1e6
+			<< ',' << summary.AllocatedMemory
+			<< ',' << summary.Flops
+			<< ',' << ( summary.TotalTime == 0 ? 0. : summary.Flops / summary.TotalTime );
+		for( int i = 0; i < counterNames.Size(); ++i ) {
+			stream << ',' << counterTotals[index * counterNames.Size() + i];
+		}
+		stream << '\n';
+	}
+}
+
+IPerformanceCounters::CCounter::TCounterType CDnnProfiler::now() const
+{
+	return static_cast<IPerformanceCounters::CCounter::TCounterType>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch() ).count() );
+}
+
+IPerformanceCounters* CDnnProfiler::getCounters( IMathEngine& mathEngine )
+{
+	if( countersMathEngine != &mathEngine ) {
+		counters.reset( mathEngine.CreatePerformanceCounters() );
+		countersMathEngine = &mathEngine;
+	}
+	return counters.get();
+}
+
+//---------------------------------------------------------------------------------------------------------
+
+CDnnProfiler::CEventScope::CEventScope( CDnnProfiler* _profiler, const CBaseLayer& layer, TDnnProfileStage stage,
+		int runNumber, bool collectCounters, double flops ) :
+	profiler( _profiler ),
+	mathEngine( nullptr ),
+	eventIndex( NotFound ),
+	freeMemory( 0 ),
+	counters( nullptr )
+{
+	if( profiler == nullptr ) {
+		return;
+	}
+
+	mathEngine = &layer.MathEngine();
+	eventIndex = profiler->events.Size();
+	CDnnProfileEvent& event = profiler->events.Append();
+	event.LayerPath = layer.GetPath();
+	event.LayerClass = GetLayerClass( layer );
+	event.Stage = stage;
+	event.RunNumber = runNumber;
+	event.Flops = flops;
+
+	if( collectCounters && profiler->collectHardwareCounters ) {
+		counters = profiler->getCounters( *mathEngine );
+		counters->Synchronise();
+	}
+	freeMemory = mathEngine->GetFreeMemorySize();
+	event.Start = profiler->now() - profiler->startTime;
+}
+
+CDnnProfiler::CEventScope::~CEventScope()
+{
+	if( profiler == nullptr ) {
+		return;
+	}
+
+	CDnnProfileEvent& event = profiler->events[eventIndex];
+	event.Duration = profiler->now() - profiler->startTime - event.Start;
+	event.AllocatedMemory = static_cast<int64_t>( freeMemory ) - static_cast<int64_t>( mathEngine->GetFreeMemorySize() );
+	if( counters != nullptr ) {
+		counters->Synchronise();
+		// The first counter is the time which is already recorded
+		for( size_t i = 1; i < counters->size(); ++i ) {
+			event.Counters.Add( ( *counters )[i] );
+		}
+	}
+}
+
+} // namespace NeoML
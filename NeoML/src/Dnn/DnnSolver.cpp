@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -195,11 +195,65 @@ void CDnnSolver::AddDiff( CBaseLayer* layer, const CObjectArray<CDnnBlob>& param
 	}
 }
 
+// Concatenates the rows of two blobs
+static CPtr<CDnnBlob> concatRows( IMathEngine& mathEngine, CDnnBlob* first, CDnnBlob* second )
+{
+	CObjectArray<CDnnBlob> parts;
+	parts.Add( first );
+	parts.Add( second );
+	CBlobDesc desc = first->GetDesc();
+	desc.SetDimSize( BD_BatchWidth, first->GetBatchWidth() + second->GetBatchWidth() );
+	CPtr<CDnnBlob> result = CDnnBlob::CreateBlob( mathEngine, first->GetDataType(), desc );
+	CDnnBlob::MergeByDim( mathEngine, BD_BatchWidth, parts, result );
+	return result;
+}
+
+void CDnnSolver::AddSparseDiff( CBaseLayer* layer, const CObjectArray<CDnnBlob>& rowIndices,
+	const CObjectArray<CDnnBlob>& rowDiffBlobs, bool sharedWeights )
+{
+	NeoAssert( layer != 0 );
+	NeoAssert( rowIndices.Size() == rowDiffBlobs.Size() );
+
+	if( MathEngine().IsDistributed() && !layersToReduce.Has( layer ) ) {
+		layersToReduce.Add( layer );
+		reduceOrder.Add( layer );
+	}
+
+	CSparseDiffSum& sparseDiffSum = layerToSparseDiffSum.GetOrCreateValue( layer );
+
+	if( !sharedWeights ) {
+		++sparseDiffSum.Count;
+	}
+
+	if( sparseDiffSum.RowIndices.IsEmpty() ) {
+		rowIndices.CopyTo( sparseDiffSum.RowIndices );
+		rowDiffBlobs.CopyTo( sparseDiffSum.RowDiffs );
+		return;
+	}
+
+	NeoAssert( sparseDiffSum.RowIndices.Size() == rowIndices.Size() );
+	for( int i = 0; i < rowIndices.Size(); i++ ) {
+		NeoAssert( ( rowIndices[i] == nullptr ) == ( rowDiffBlobs[i] == nullptr ) );
+		if( rowIndices[i] == nullptr ) {
+			continue;
+		}
+		if( sparseDiffSum.RowIndices[i] == nullptr ) {
+			sparseDiffSum.RowIndices[i] = rowIndices[i];
+			sparseDiffSum.RowDiffs[i] = rowDiffBlobs[i];
+		} else {
+			// The repeated rows are summed up in Train
+			sparseDiffSum.RowIndices[i] = concatRows( MathEngine(), sparseDiffSum.RowIndices[i], rowIndices[i] );
+			sparseDiffSum.RowDiffs[i] = concatRows( MathEngine(), sparseDiffSum.RowDiffs[i], rowDiffBlobs[i] );
+		}
+	}
+}
+
 // Modifies the trainable parameters of the network layers, using the accumulated gradient values 
 // and the history of previous modifications (moment, etc.)
 void CDnnSolver::Train( float distributedCoeff )
 {
 	OnTrain();
+	mergeSparseDiffs();
 
 	CFloatHandleStackVar oneDivEpoch( mathEngine );
 
@@ -232,6 +286,7 @@ void CDnnSolver::Train( float distributedCoeff )
 		paramDiffBlobsSum.Sum.Empty();
 		paramDiffBlobsSum.Count = 0;
 	}
+	trainSparse();
 
 	if( MathEngine().IsDistributed() ){
 		allReduce( distributedCoeff );
@@ -241,10 +296,246 @@ void CDnnSolver::Train( float distributedCoeff )
 void CDnnSolver::Reset()
 {
 	layerToParamDiffBlobsSum.DeleteAll();
+	layerToSparseDiffSum.DeleteAll();
 	layerToGradientHistory.DeleteAll();
 	OnReset();
 }
 
+// Sums up the gradients of the same rows
+static void mergeRepeatedRows( IMathEngine& mathEngine, CPtr<CDnnBlob>& rowIndices, CPtr<CDnnBlob>& rowDiffs )
+{
+	const int rowCount = rowIndices->GetDataSize();
+	CArray<int> indices;
+	indices.SetSize( rowCount );
+	rowIndices->CopyTo( indices.GetPtr() );
+
+	CMap<int, int> rowPositions;
+	CArray<int> positions;
+	CArray<int> uniqueIndices;
+	for( int i = 0; i < rowCount; i++ ) {
+		const TMapPosition pos = rowPositions.GetFirstPosition( indices[i] );
+		if( pos == NotFound ) {
+			rowPositions.Add( indices[i], uniqueIndices.Size() );
+			positions.Add( uniqueIndices.Size() );
+			uniqueIndices.Add( indices[i] );
+		} else {
+			positions.Add( rowPositions.GetValue( pos ) );
+		}
+	}
+	if( uniqueIndices.Size() == rowCount ) {
+		return;
+	}
+
+	const int rowSize = rowDiffs->GetObjectSize();
+	CPtr<CDnnBlob> positionsBlob = CDnnBlob::CreateDataBlob( mathEngine, CT_Int, 1, rowCount, 1 );
+	positionsBlob->CopyFrom( positions.GetPtr() );
+	CPtr<CDnnBlob> mergedDiffs = CDnnBlob::CreateDataBlob( mathEngine, CT_Float, 1, uniqueIndices.Size(), rowSize );
+	mergedDiffs->Clear();
+	mathEngine.MatrixSpreadRowsAdd( rowDiffs->GetData(), rowCount, rowSize, mergedDiffs->GetData(),
+		uniqueIndices.Size(), positionsBlob->GetData<int>() );
+
+	rowIndices = CDnnBlob::CreateDataBlob( mathEngine, CT_Int, 1, uniqueIndices.Size(), 1 );
+	rowIndices->CopyFrom( uniqueIndices.GetPtr() );
+	rowDiffs = mergedDiffs;
+}
+
+void CDnnSolver::mergeSparseDiffs()
+{
+	for( TMapPosition pos = layerToSparseDiffSum.GetFirstPosition(); pos != NotFound;
+		pos = layerToSparseDiffSum.GetNextPosition( pos ) )
+	{
+		CSparseDiffSum& sparseDiffSum = layerToSparseDiffSum.GetValue( pos );
+		const TMapPosition densePos = layerToParamDiffBlobsSum.GetFirstPosition( layerToSparseDiffSum.GetKey( pos ) );
+		if( sparseDiffSum.RowIndices.IsEmpty() || densePos == NotFound
+			|| layerToParamDiffBlobsSum.GetValue( densePos ).Sum.IsEmpty() )
+		{
+			continue;
+		}
+
+		CDiffBlobSum& paramDiffBlobsSum = layerToParamDiffBlobsSum.GetValue( densePos );
+		NeoAssert( paramDiffBlobsSum.Sum.Size() == sparseDiffSum.RowIndices.Size() );
+		for( int i = 0; i < sparseDiffSum.RowIndices.Size(); i++ ) {
+			if( sparseDiffSum.RowIndices[i] != nullptr ) {
+				CDnnBlob& sum = *paramDiffBlobsSum.Sum[i];
+				MathEngine().MatrixSpreadRowsAdd( sparseDiffSum.RowDiffs[i]->GetData(),
+					sparseDiffSum.RowIndices[i]->GetDataSize(), sum.GetObjectSize(), sum.GetData(),
+					sum.GetObjectCount(), sparseDiffSum.RowIndices[i]->GetData<int>() );
+			}
+		}
+		paramDiffBlobsSum.Count += sparseDiffSum.Count;
+
+		sparseDiffSum.RowIndices.Empty();
+		sparseDiffSum.RowDiffs.Empty();
+		sparseDiffSum.Count = 0;
+	}
+}
+
+void CDnnSolver::trainSparse()
+{
+	CFloatHandleStackVar oneDivEpoch( mathEngine );
+
+	for( TMapPosition pos = layerToSparseDiffSum.GetFirstPosition(); pos != NotFound;
+		pos = layerToSparseDiffSum.GetNextPosition( pos ) )
+	{
+		CBaseLayer* layer = layerToSparseDiffSum.GetKey( pos );
+		CSparseDiffSum& sparseDiffSum = layerToSparseDiffSum.GetValue( pos );
+		if( sparseDiffSum.RowIndices.IsEmpty() ) {
+			continue;
+		}
+		NeoAssert( sparseDiffSum.Count > 0 );
+
+		oneDivEpoch.SetValue( 1.f / sparseDiffSum.Count );
+		CObjectArray<CDnnBlob> rowDiffs;
+		for( int i = 0; i < sparseDiffSum.RowIndices.Size(); i++ ) {
+			if( sparseDiffSum.RowIndices[i] == nullptr ) {
+				continue;
+			}
+			mergeRepeatedRows( MathEngine(), sparseDiffSum.RowIndices[i], sparseDiffSum.RowDiffs[i] );
+			if( sparseDiffSum.Count > 1 ) {
+				MathEngine().VectorMultiply( sparseDiffSum.RowDiffs[i]->GetData(), sparseDiffSum.RowDiffs[i]->GetData(),
+					sparseDiffSum.RowDiffs[i]->GetDataSize(), oneDivEpoch );
+			}
+			rowDiffs.Add( sparseDiffSum.RowDiffs[i] );
+		}
+
+		// The other rows have zero gradients so the norm is the same as for the dense gradients
+		clipGradients( rowDiffs );
+
+		TrainLayerSparse( layer, layer->paramBlobs, sparseDiffSum.RowIndices, sparseDiffSum.RowDiffs,
+			layerToGradientHistory.GetOrCreateValue( layer ) );
+
+		sparseDiffSum.RowIndices.Empty();
+		sparseDiffSum.RowDiffs.Empty();
+		sparseDiffSum.Count = 0;
+	}
+}
+
+void CDnnSolver::TrainLayerSparse( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+	const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+	CObjectArray<CDnnBlob>& learningHistory )
+{
+	CObjectArray<CDnnBlob> paramDiffBlobs;
+	for( int i = 0; i < paramBlobs.Size(); i++ ) {
+		CPtr<CDnnBlob> paramDiff = paramBlobs[i]->GetClone();
+		paramDiff->Clear();
+		if( rowIndices[i] != nullptr ) {
+			MathEngine().MatrixSpreadRowsAdd( rowDiffBlobs[i]->GetData(), rowIndices[i]->GetDataSize(),
+				paramBlobs[i]->GetObjectSize(), paramDiff->GetData(), paramBlobs[i]->GetObjectCount(),
+				rowIndices[i]->GetData<int>() );
+		}
+		paramDiffBlobs.Add( paramDiff );
+	}
+	TrainLayer( layer, paramBlobs, paramDiffBlobs, learningHistory );
+}
+
+// Copies the rows of the matrix into a new blob
+static CPtr<CDnnBlob> gatherRows( IMathEngine& mathEngine, const CDnnBlob& matrix, const CDnnBlob& rowIndices )
+{
+	const int rowCount = rowIndices.GetDataSize();
+	CPtr<CDnnBlob> result = CDnnBlob::CreateDataBlob( mathEngine, CT_Float, 1, rowCount, matrix.GetObjectSize() );
+	mathEngine.LookupAndSum( rowIndices.GetData<int>(), rowCount, 1, matrix.GetData(), matrix.GetObjectSize(),
+		result->GetData() );
+	return result;
+}
+
+// Adds the difference between the new and the old values of the rows to the matrix
+static void addRowsChange( IMathEngine& mathEngine, const CDnnBlob& newRows, const CDnnBlob* oldRows,
+	const CDnnBlob& rowIndices, CDnnBlob& matrix )
+{
+	CPtr<CDnnBlob> change = newRows.GetCopy();
+	if( oldRows != nullptr ) {
+		mathEngine.VectorSub( newRows.GetData(), oldRows->GetData(), change->GetData(), change->GetDataSize() );
+	}
+	mathEngine.MatrixSpreadRowsAdd( change->GetData(), rowIndices.GetDataSize(), matrix.GetObjectSize(),
+		matrix.GetData(), matrix.GetObjectCount(), rowIndices.GetData<int>() );
+}
+
+void CDnnSolver::TrainLayerRows( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+	const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+	CObjectArray<CDnnBlob>& learningHistory )
+{
+	const int paramCount = paramBlobs.Size();
+	for( int i = 0; i < paramCount; i++ ) {
+		if( rowIndices[i] == nullptr ) {
+			continue;
+		}
+
+		// TrainLayer is applied to the blobs with the copies of the rows
+		CObjectArray<CDnnBlob> rows;
+		rows.Add( gatherRows( MathEngine(), *paramBlobs[i], *rowIndices[i] ) );
+		CObjectArray<CDnnBlob> rowDiffs;
+		rowDiffs.Add( rowDiffBlobs[i] );
+		CObjectArray<CDnnBlob> historyRows;
+		CObjectArray<CDnnBlob> oldHistoryRows;
+		const bool isNewHistory = learningHistory.IsEmpty();
+		if( !isNewHistory ) {
+			NeoAssert( learningHistory.Size() % paramCount == 0 );
+			for( int j = i; j < learningHistory.Size(); j += paramCount ) {
+				historyRows.Add( gatherRows( MathEngine(), *learningHistory[j], *rowIndices[i] ) );
+				oldHistoryRows.Add( historyRows.Last()->GetCopy() );
+			}
+		}
+		CPtr<CDnnBlob> oldRows = rows[0]->GetCopy();
+
+		TrainLayer( layer, rows, rowDiffs, historyRows );
+
+		if( isNewHistory ) {
+			// The history blobs of the same types have been created by TrainLayer
+			for( int type = 0; type < historyRows.Size(); type++ ) {
+				for( int j = 0; j < paramCount; j++ ) {
+					CPtr<CDnnBlob> history = paramBlobs[j]->GetClone();
+					history->Clear();
+					learningHistory.Add( history );
+				}
+			}
+		}
+		NeoAssert( learningHistory.Size() == historyRows.Size() * paramCount );
+
+		// Only the rows are changed
+		addRowsChange( MathEngine(), *rows[0], oldRows, *rowIndices[i], *paramBlobs[i] );
+		for( int type = 0; type < historyRows.Size(); type++ ) {
+			addRowsChange( MathEngine(), *historyRows[type], isNewHistory ? nullptr : oldHistoryRows[type],
+				*rowIndices[i], *learningHistory[type * paramCount + i] );
+		}
+	}
+}
+
+// The maximum size of the bucket in which the small parameter blobs are reduced together (1 MB)
+static const int maxAllReduceBucketSize = 1 << 18;
+
+// Averages the blobs over all threads in one reduction
+// Each reduction synchronizes all the threads, so the small blobs are copied into one buffer and reduced together
+static void allReduceBucket( IMathEngine& mathEngine, const CArray<CDnnBlob*>& blobs, int bucketSize,
+	const CConstFloatHandle* coeff )
+{
+	if( blobs.IsEmpty() ) {
+		return;
+	}
+	if( blobs.Size() == 1 ) {
+		if( coeff != nullptr ) {
+			mathEngine.VectorMultiply( blobs[0]->GetData(), blobs[0]->GetData(), bucketSize, *coeff );
+		}
+		mathEngine.AllReduce( blobs[0]->GetData(), bucketSize );
+		return;
+	}
+
+	CFloatHandleStackVar bucket( mathEngine, bucketSize );
+	int offset = 0;
+	for( const CDnnBlob* blob : blobs ) {
+		mathEngine.VectorCopy( bucket.GetHandle() + offset, blob->GetData(), blob->GetDataSize() );
+		offset += blob->GetDataSize();
+	}
+	if( coeff != nullptr ) {
+		mathEngine.VectorMultiply( bucket.GetHandle(), bucket.GetHandle(), bucketSize, *coeff );
+	}
+	mathEngine.AllReduce( bucket.GetHandle(), bucketSize );
+	offset = 0;
+	for( CDnnBlob* blob : blobs ) {
+		mathEngine.VectorCopy( blob->GetData(), bucket.GetHandle() + offset, blob->GetDataSize() );
+		offset += blob->GetDataSize();
+	}
+}
+
 void CDnnSolver::allReduce( float distributedCoeff )
 {
 	const bool isCoeffNontrivial = ::fabsf( distributedCoeff - 1.f ) >= FLT_EPSILON;
@@ -252,19 +543,29 @@ void CDnnSolver::allReduce( float distributedCoeff )
 	if( isCoeffNontrivial ) {
 		coeffVar.SetValue( distributedCoeff );
 	}
+	const CConstFloatHandle coeff = coeffVar.GetHandle();
+	const CConstFloatHandle* coeffPtr = isCoeffNontrivial ? &coeff : nullptr;
 
+	// The order of the blobs and their sizes are the same in all threads, so the buckets are the same too
+	CArray<CDnnBlob*> bucketBlobs;
+	int bucketSize = 0;
 	for( int i = 0; i < reduceOrder.Size(); ++i ) {
 		if( !reduceOrder[i]->IsLearnable() || !reduceOrder[i]->IsLearningEnabled() ) {
 			continue;
 		}
 		const CObjectArray<CDnnBlob>& params = reduceOrder[i]->paramBlobs;
 		for( int j = 0; j < params.Size(); j++ ) {
-			if( isCoeffNontrivial ) {
-				MathEngine().VectorMultiply( params[j]->GetData(), params[j]->GetData(), params[j]->GetDataSize(), coeffVar );
+			const int size = params[j]->GetDataSize();
+			if( bucketSize + size > maxAllReduceBucketSize ) {
+				allReduceBucket( MathEngine(), bucketBlobs, bucketSize, coeffPtr );
+				bucketBlobs.DeleteAll();
+				bucketSize = 0;
 			}
-			MathEngine().AllReduce( params[j]->GetData(), params[j]->GetDataSize() );
+			bucketBlobs.Add( params[j] );
+			bucketSize += size;
 		}
 	}
+	allReduceBucket( MathEngine(), bucketBlobs, bucketSize, coeffPtr );
 }
 
 void CDnnSolver::clip( const CObjectArray<CDnnBlob>& paramDiffBlobs )
@@ -322,7 +623,7 @@ void CDnnSolver::clipGradients(const CObjectArray<CDnnBlob>& paramDiffBlobs)
 	}
 }
 
-static const int DnnSolverVersion = 1;
+static const int DnnSolverVersion = 2;
 
 void CDnnSolver::Serialize( CArchive& archive, CDnn& dnn )
 {
@@ -349,11 +650,22 @@ void CDnnSolver::Serialize( CArchive& archive, CDnn& dnn )
 		}
 		archive << learningRate << regularizationL1 << regularizationL2 << maxGradientNorm;
 		archive << clipGradientMin << clipGradientMax;
+
+		archive << layerToSparseDiffSum.Size();
+		for( int pos = layerToSparseDiffSum.GetFirstPosition(); pos != NotFound;
+			pos = layerToSparseDiffSum.GetNextPosition( pos ) )
+		{
+			archive << layerPtrToId[layerToSparseDiffSum.GetKey( pos )];
+			archive << layerToSparseDiffSum.GetValue( pos ).Count;
+			SerializeBlobs( mathEngine, archive, layerToSparseDiffSum.GetValue( pos ).RowIndices );
+			SerializeBlobs( mathEngine, archive, layerToSparseDiffSum.GetValue( pos ).RowDiffs );
+		}
 	} else {
 		CMap<CString, CBaseLayer*> layerIdToPtr;
 		mapLayerIdToPtr( dnn, layerIdToPtr );
 
 		layerToParamDiffBlobsSum.DeleteAll();
+		layerToSparseDiffSum.DeleteAll();
 		layerToGradientHistory.DeleteAll();
 		layersToReduce.DeleteAll();
 		reduceOrder.DeleteAll();
@@ -381,6 +693,17 @@ void CDnnSolver::Serialize( CArchive& archive, CDnn& dnn )
 			clipGradientMin = -FLT_MAX;
 			clipGradientMax = FLT_MAX;
 		}
+		if( version >= 2 ) {
+			archive >> size;
+			for( int i = 0; i < size; ++i ) {
+				CString layerId;
+				archive >> layerId;
+				CSparseDiffSum& sparseDiffSum = layerToSparseDiffSum.GetOrCreateValue( layerIdToPtr[layerId] );
+				archive >> sparseDiffSum.Count;
+				SerializeBlobs( mathEngine, archive, sparseDiffSum.RowIndices );
+				SerializeBlobs( mathEngine, archive, sparseDiffSum.RowDiffs );
+			}
+		}
 	}
 }
 
@@ -462,6 +785,13 @@ void CDnnSimpleGradientSolver::TrainLayer( const CBaseLayer* layer, const CObjec
 	}
 }
 
+void CDnnSimpleGradientSolver::TrainLayerSparse( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+	const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+	CObjectArray<CDnnBlob>& gradientHistory )
+{
+	TrainLayerRows( layer, paramBlobs, rowIndices, rowDiffBlobs, gradientHistory );
+}
+
 CDnnAdaptiveGradientSolver::CDnnAdaptiveGradientSolver( IMathEngine& mathEngine ) :
 	CDnnSolver( mathEngine ),
 	momentDecayRate(0.9f),
@@ -636,6 +966,13 @@ void CDnnAdaptiveGradientSolver::TrainLayer( const CBaseLayer* layer, const CObj
 	}
 }
 
+void CDnnAdaptiveGradientSolver::TrainLayerSparse( const CBaseLayer* layer, const CObjectArray<CDnnBlob>& paramBlobs,
+	const CObjectArray<CDnnBlob>& rowIndices, const CObjectArray<CDnnBlob>& rowDiffBlobs,
+	CObjectArray<CDnnBlob>& gradientHistory )
+{
+	TrainLayerRows( layer, paramBlobs, rowIndices, rowDiffBlobs, gradientHistory );
+}
+
 CDnnNesterovGradientSolver::CDnnNesterovGradientSolver( IMathEngine& mathEngine ) :
 	CDnnSolver( mathEngine ),
 	momentDecayRate( 0.9f ),
@@ -142,11 +142,15 @@ void CBaseConvLayer::SetFreeTermData(const CPtr<CDnnBlob>& newFreeTerms)
 	}
 }
 
-void CBaseConvLayer::ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm)
+bool CBaseConvLayer::ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm)
 {
+	if(Filter() == 0 && GetFilterData() != 0) {
+		// The filter is stored in another format by the derived layer
+		return false;
+	}
 	CPtr<CDnnBlob> params = batchNorm.GetFinalParams();
 	if(params.Ptr() == 0 || Filter().Ptr() == 0) {
-		return;
+		return true;
 	}
 	NeoAssert(params->GetObjectSize() == filterCount);
 	CConstFloatHandle gamma = params->GetObjectData( 0 );
@@ -179,6 +183,7 @@ void CBaseConvLayer::ApplyBatchNormalization(CBatchNormalizationLayer& batchNorm
 
 	SetFilterData(newFilter);
 	SetFreeTermData(newFreeTerm);
+	return true;
 }
 
 void CBaseConvLayer::FilterLayerParams( float threshold )
@@ -299,12 +299,11 @@ void CBatchNormalizationLayer::updateSlowParams(bool isInit)
 
 void CBatchNormalizationLayer::updateFinalParams()
 {
+	std::lock_guard<std::mutex> lock( finalParamsMutex );
 	if(!isFinalParamDirty) {
 		return;
 	}
 
-	isFinalParamDirty = false;
-
 	int fullBatchSize;
 	int objectSize;
 	getFullBatchAndObjectSize(fullBatchSize, objectSize);
@@ -328,6 +327,8 @@ void CBatchNormalizationLayer::updateFinalParams()
 		MathEngine().VectorEltwiseMultiply(finalGamma, slowAverage, finalBeta, objectSize);
 		MathEngine().VectorSub(beta, finalBeta, finalBeta, objectSize);
 	}
+	// The flag is cleared only when the final params are ready to be read by the other threads
+	isFinalParamDirty = false;
 }
 
 // Performs a step in network run with learning
@@ -422,6 +423,15 @@ void CBatchNormalizationLayer::backwardWhenNoLearning()
 		inputDiff, inputDiffBlobs[0]->GetDataSize());
 }
 
+void CBatchNormalizationLayer::GetSharedParamBlobs( CArray<CPtr<CDnnBlob>*>& blobs )
+{
+	// The final parameters are brought up to date by Serialize before they are stored or shared
+	// The update is guarded, so the network may be running in another thread meanwhile
+	CBaseLayer::GetSharedParamBlobs( blobs );
+	blobs.Add( &finalParams );
+	blobs.Add( &internalParams );
+}
+
 void CBatchNormalizationLayer::LearnOnce()
 {
 	// No regularization
@@ -472,8 +482,8 @@ void CBatchNormalizationLayer::Serialize( CArchive& archive )
 		updateFinalParams();
 		archive << isChannelBased;
 		archive << GetSlowConvergenceRate();
-		SerializeBlob( MathEngine(), archive, finalParams );
-		SerializeBlob( MathEngine(), archive, internalParams );
+		SerializeParamBlob( archive, finalParams );
+		SerializeParamBlob( archive, internalParams );
 		archive << isZeroFreeTerm;
 		archive << useFinalParamsForInitialization;
 	} else if( archive.IsLoading() ) {
@@ -481,8 +491,8 @@ void CBatchNormalizationLayer::Serialize( CArchive& archive )
 		float tempFloat;
 		archive >> tempFloat;
 		SetSlowConvergenceRate(tempFloat);
-		SerializeBlob( MathEngine(), archive, finalParams );
-		SerializeBlob( MathEngine(), archive, internalParams );
+		SerializeParamBlob( archive, finalParams );
+		SerializeParamBlob( archive, internalParams );
 		archive >> isZeroFreeTerm;
 		archive >> useFinalParamsForInitialization;
 		isFinalParamDirty = false;
@@ -134,6 +134,16 @@ void CChannelwiseConvLayer::LearnOnce()
 	}
 }
 
+// All the stages (forward, backward and learn) perform one convolution of the same size
+double CChannelwiseConvLayer::EstimateFlops() const
+{
+	double flops = 0;
+	for( int i = 0; i < outputDescs.Size(); ++i ) {
+		flops += 2. * outputDescs[i].BlobSize() * GetFilterHeight() * GetFilterWidth();
+	}
+	return flops;
+}
+
 static const int ChannelwiseConvLayerVersion = 2000;
 
 void CChannelwiseConvLayer::Serialize( CArchive& archive )
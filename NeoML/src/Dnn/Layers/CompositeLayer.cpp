@@ -655,21 +655,36 @@ void CCompositeLayer::serializationHook(CArchive&)
 
 static const int CompositeLayerVersion = 2000;
 
+void CCompositeLayer::storeLayers( CArchive& archive )
+{
+	archive << layers.Size();
+	for( int i = 0; i < layers.Size(); i++ ) {
+		SerializeLayer( archive, MathEngine(), layers[i] );
+	}
+	archive << outputMappings.Size();
+	for(int i = 0; i < outputMappings.Size(); i++) {
+		archive << outputMappings[i].InternalLayerName;
+		archive << outputMappings[i].InternalLayerOutput;
+	}
+}
+
+void CCompositeLayer::StoreWithLayout( CArchive& archive, CCompositeLayer& layout )
+{
+	NeoAssert( archive.IsStoring() );
+
+	archive.SerializeVersion( CompositeLayerVersion, CDnn::ArchiveMinSupportedVersion );
+	CBaseLayer::Serialize( archive );
+	layout.storeLayers( archive );
+	serializationHook( archive );
+}
+
 void CCompositeLayer::Serialize( CArchive& archive )
 {
 	archive.SerializeVersion( CompositeLayerVersion, CDnn::ArchiveMinSupportedVersion );
 	CBaseLayer::Serialize(archive);
 
 	if( archive.IsStoring() ) {
-		archive << layers.Size();
-		for( int i = 0; i < layers.Size(); i++ ) {
-			SerializeLayer( archive, MathEngine(), layers[i] );
-		}
-		archive << outputMappings.Size();
-		for(int i = 0; i < outputMappings.Size(); i++) {
-			archive << outputMappings[i].InternalLayerName;
-			archive << outputMappings[i].InternalLayerOutput;
-		}
+		storeLayers( archive );
 		serializationHook(archive);
 	} else if( archive.IsLoading() ) {
 		if( internalDnn != 0 ) {
@@ -23,13 +23,15 @@ namespace NeoML {
 
 CConvLayer::CConvLayer( IMathEngine& mathEngine ) :
 	CBaseConvLayer( mathEngine, "CCnnConvLayer" ),
-	convDesc( 0 )
+	convDesc( 0 ),
+	packedFilter( nullptr )
 {
 }
 
 CConvLayer::~CConvLayer()
 {
 	destroyConvDesc();
+	resetPreparedFilter();
 }
 
 void CConvLayer::initConvDesc()
@@ -69,6 +71,9 @@ void CConvLayer::Reshape()
 		"different number of inputs and outputs in conv layer" );
 	CheckLayerArchitecture( paddingHeight < filterHeight * dilationHeight && paddingWidth < filterWidth * dilationWidth,
 		"padding is more or equal to receptive field size" );
+	CheckLayerArchitecture( !int8Quantization.IsQuantized()
+		|| ( IsInt8QuantizationSupported() && MathEngine().GetType() == MET_Cpu ),
+		"int8 quantization is supported only for 1x1 convolution on CPU" );
 
 	int outputHeight, outputWidth;
 	calcOutputBlobSize(outputHeight, outputWidth);
@@ -77,7 +82,15 @@ void CConvLayer::Reshape()
 			&& filterWidth <= inputDescs[i].Width() + 2 * paddingWidth,
 			"filter is bigger than input" );
 
-		if(Filter() == 0) {
+		if( int8Quantization.IsQuantized() ) {
+			// Only the int8 filter is kept
+			const CBlobDesc& filterDesc = int8Quantization.GetWeightsDesc();
+			NeoAssert( filterDesc.ObjectCount() == filterCount );
+			NeoAssert( filterDesc.Height() == filterHeight );
+			NeoAssert( filterDesc.Width() == filterWidth );
+			NeoAssert( filterDesc.Depth() == inputDescs[i].Depth() );
+			NeoAssert( filterDesc.Channels() == inputDescs[i].Channels() );
+		} else if(Filter() == 0) {
 			// Create a weights matrix
 			Filter() = CDnnBlob::Create3DImageBlob( MathEngine(), CT_Float, 1, filterCount, filterHeight, filterWidth,
 				inputDescs[i].Depth(), inputDescs[i].Channels() );
@@ -109,16 +122,44 @@ void CConvLayer::Reshape()
 	}
 
 	destroyConvDesc();
+	resetPreparedFilter();
 }
 
 void CConvLayer::RunOnce()
 {
-	initConvDesc();
+	if( int8Quantization.IsQuantized() ) {
+		CheckLayerArchitecture( !IsBackwardPerformed() && !IsLearningPerformed(),
+			"int8 quantized filter is supported only for inference" );
+		// 1x1 convolution is a matrix multiplication of the pixels by the filters
+		const int pixelSize = int8Quantization.GetWeightsDesc().ObjectSize();
+		for( int i = 0; i < outputBlobs.Size(); ++i ) {
+			int8Quantization.Run( MathEngine(), FreeTerms().Ptr(), inputBlobs[i]->GetData(),
+				inputBlobs[i]->GetDataSize() / pixelSize, outputBlobs[i]->GetData() );
+		}
+		return;
+	}
+
+	const CPackedMatrixDesc* packedFilterData = isMatrixMultiplication() ? getPackedFilter() : nullptr;
+	if( packedFilterData == nullptr ) {
+		initConvDesc();
+	}
 
 	for( int i = 0; i < outputBlobs.Size(); ++i ) {
+		if( int8Quantization.IsCalibrating() ) {
+			int8Quantization.Calibrate( *inputBlobs[i] );
+		}
 		CConstFloatHandle freeTerm = FreeTerms()->GetData();
-		MathEngine().BlobConvolution( *convDesc, inputBlobs[i]->GetData(),
-			Filter()->GetData(), &freeTerm, outputBlobs[i]->GetData() );
+		if( packedFilterData != nullptr ) {
+			const int pixelSize = Filter()->GetObjectSize();
+			const int pixelCount = inputBlobs[i]->GetDataSize() / pixelSize;
+			MathEngine().MultiplyMatrixByPackedTransposedMatrix( inputBlobs[i]->GetData(), pixelCount, pixelSize,
+				*packedFilterData, outputBlobs[i]->GetData(), outputBlobs[i]->GetDataSize() );
+			MathEngine().AddVectorToMatrixRows( /*batchSize*/1, outputBlobs[i]->GetData(), outputBlobs[i]->GetData(),
+				pixelCount, filterCount, freeTerm );
+		} else {
+			MathEngine().BlobConvolution( *convDesc, inputBlobs[i]->GetData(),
+				Filter()->GetData(), &freeTerm, outputBlobs[i]->GetData() );
+		}
 	}
 }
 
@@ -143,12 +184,117 @@ void CConvLayer::LearnOnce()
 	}
 }
 
-static const int ConvLayerVersion = 2000;
+CPtr<CDnnBlob> CConvLayer::GetFilterData() const
+{
+	if( int8Quantization.IsQuantized() ) {
+		return int8Quantization.GetDequantizedWeights( MathEngine() );
+	}
+	return CBaseConvLayer::GetFilterData();
+}
+
+void CConvLayer::SetFilterData( const CPtr<CDnnBlob>& newFilter )
+{
+	resetPreparedFilter();
+	int8Quantization.Reset();
+	CBaseConvLayer::SetFilterData( newFilter );
+}
+
+void CConvLayer::SetFreeTermData( const CPtr<CDnnBlob>& newFreeTerms )
+{
+	CBaseConvLayer::SetFreeTermData( newFreeTerms );
+	resetPreparedFilter();
+}
+
+void CConvLayer::FilterLayerParams( float threshold )
+{
+	CBaseConvLayer::FilterLayerParams( threshold );
+	resetPreparedFilter();
+}
+
+// All the stages (forward, backward and learn) perform one convolution of the same size
+double CConvLayer::EstimateFlops() const
+{
+	double flops = 0;
+	for( int i = 0; i < inputDescs.Size() && i < outputDescs.Size(); ++i ) {
+		flops += 2. * outputDescs[i].BlobSize() * GetFilterHeight() * GetFilterWidth()
+			* inputDescs[i].Depth() * inputDescs[i].Channels();
+	}
+	return flops;
+}
+
+// Checks if the convolution is a matrix multiplication of the pixels by the filters (1x1 filter, stride and no padding)
+bool CConvLayer::isMatrixMultiplication() const
+{
+	return filterHeight == 1 && filterWidth == 1 && strideHeight == 1 && strideWidth == 1
+		&& paddingHeight == 0 && paddingWidth == 0;
+}
+
+// Returns the filter packed for the inference
+// Nullptr is returned during training (the filter changes after every step) or if packing is not supported
+const CPackedMatrixDesc* CConvLayer::getPackedFilter()
+{
+	if( IsBackwardPerformed() || IsLearningPerformed() ) {
+		resetPreparedFilter();
+		return nullptr;
+	}
+	if( packedFilter == nullptr ) {
+		packedFilter = MathEngine().InitPackedTransposedMatrix( Filter()->GetData(),
+			Filter()->GetObjectCount(), Filter()->GetObjectSize() );
+	}
+	return packedFilter;
+}
+
+// Destroys all the data calculated from the filter
+void CConvLayer::resetPreparedFilter()
+{
+	int8Quantization.ResetDesc();
+	delete packedFilter;
+	packedFilter = nullptr;
+}
+
+void CConvLayer::StartInt8Calibration()
+{
+	NeoAssert( IsInt8QuantizationSupported() );
+	// The calibration is done on the float filter
+	ResetInt8Quantization();
+	int8Quantization.StartCalibration();
+}
+
+void CConvLayer::FinishInt8Calibration()
+{
+	NeoAssert( IsInt8QuantizationSupported() );
+	NeoAssert( Filter() != nullptr );
+	NeoAssert( MathEngine().GetType() == MET_Cpu );
+	int8Quantization.FinishCalibration( *Filter() );
+	// Only the int8 filter is used from now on
+	resetPreparedFilter();
+	Filter() = nullptr;
+}
+
+void CConvLayer::ResetInt8Quantization()
+{
+	if( int8Quantization.IsQuantized() ) {
+		Filter() = int8Quantization.GetDequantizedWeights( MathEngine() );
+	}
+	resetPreparedFilter();
+	int8Quantization.Reset();
+}
+
+static const int ConvLayerVersion = 2001;
 
 void CConvLayer::Serialize( CArchive& archive )
 {
-	archive.SerializeVersion( ConvLayerVersion, CDnn::ArchiveMinSupportedVersion );
+	const int version = archive.SerializeVersion( ConvLayerVersion, CDnn::ArchiveMinSupportedVersion );
 	CBaseConvLayer::Serialize( archive );
+	if( version >= 2001 ) {
+		int8Quantization.Serialize( archive );
+		if( archive.IsLoading() && int8Quantization.IsQuantized() ) {
+			// The float filter is not needed once the int8 filter is known
+			Filter() = nullptr;
+		}
+	} else {
+		int8Quantization.Reset();
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -19,7 +19,12 @@ limitations under the License.
 #pragma hdrstop
 
 #include <NeoML/Dnn/Layers/CtcLayer.h>
+#include <NeoMathEngine/ThreadPool.h>
 #include <float.h>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
 
 namespace NeoML {
 
@@ -184,10 +189,25 @@ CCtcDecodingLayer::CCtcDecodingLayer( IMathEngine& mathEngine ) :
 	CBaseLayer( mathEngine, "CCnnCtcDecodingLayer", false ),
 	blankLabel(0),
 	blankProbabilityThreshold(0.01f),
-	arcProbabilityThreshold(0.01f)
+	arcProbabilityThreshold(0.01f),
+	beamWidth(16),
+	beamLabelProbabilityThreshold(0.001f),
+	labelScorer(nullptr)
 {
 }
 
+void CCtcDecodingLayer::SetBeamWidth( int width )
+{
+	NeoAssert( width > 0 );
+	beamWidth = width;
+}
+
+void CCtcDecodingLayer::SetBeamLabelProbabilityThreshold( float threshold )
+{
+	NeoAssert( threshold >= 0 && threshold <= 1 );
+	beamLabelProbabilityThreshold = threshold;
+}
+
 void CCtcDecodingLayer::Reshape()
 {
 	CheckInputs();
@@ -347,13 +367,9 @@ void CCtcDecodingLayer::GetBestSequence(int sequenceNumber, CArray<int>& bestLab
 		return;
 	}
 	// Find the best label for each index in the sequence
-	int sequenceLength = lastResults[I_Result]->GetBatchLength();
-	if( lastResults.Size() > I_InputLengths ) {
-		CArray<int> lengths;
-		lengths.SetSize( lastResults[I_InputLengths]->GetDataSize() );
-		lastResults[I_InputLengths]->CopyTo( lengths.GetPtr() );
-		sequenceLength = min( lengths[sequenceNumber], sequenceLength );
-	}
+	CArray<int> lengths;
+	getSequenceLengths( lengths );
+	const int sequenceLength = lengths[sequenceNumber];
 	CArray<int> bestLabelsArray;
 	bestLabelsArray.SetSize(sequenceLength);
 	MathEngine().DataExchangeTyped(bestLabelsArray.GetPtr(), bestLabels->GetData<const int>( {sequenceNumber} ), sequenceLength);
@@ -368,21 +384,316 @@ void CCtcDecodingLayer::GetBestSequence(int sequenceNumber, CArray<int>& bestLab
 	}
 }
 
-static const int CtcDecodingLayerVersion = 2000;
+//---------------------------------------------------------------------------------------------------------------------
+
+static float logSumExp( float first, float second )
+{
+	if( first < second ) {
+		swap( first, second );
+	}
+	if( second <= -FLT_MAX ) {
+		return first;
+	}
+	return first + log1pf( expf( second - first ) );
+}
+
+// The prefix beam search over the log-probabilities of one sequence
+// Based on A. Hannun et al., "First-Pass Large Vocabulary Continuous Speech Recognition using Bi-Directional Recurrent DNNs"
+class CCtcPrefixBeamSearch {
+public:
+	CCtcPrefixBeamSearch( int labelsCount, int blankLabel, int beamWidth, float labelProbabilityThreshold,
+		const ICtcLabelScorer* scorer );
+
+	// Decodes the sequenceLength * labelsCount matrix of the log-probabilities and returns the result score
+	float Decode( const float* logProbs, int sequenceLength, CArray<int>& result );
+
+private:
+	// The node of the prefix tree
+	struct CNode {
+		int Parent;
+		int Label;
+		float Score; // the total scorer score of the prefix
+	};
+
+	// The key for searching the child node
+	struct CNodeKey {
+		int Parent;
+		int Label;
+
+		int HashKey() const;
+		bool operator==( const CNodeKey& other ) const { return Parent == other.Parent && Label == other.Label; }
+	};
+
+	// The prefix in the beam
+	struct CBeamEntry {
+		int Node;
+		float BlankLogProb; // the log-probability of the paths ending with the blank
+		float LabelLogProb; // the log-probability of the paths ending with the last label of the prefix
+		float Score; // the total log-probability plus the scorer score
+	};
+
+	const int labelsCount;
+	const int blankLabel;
+	const int beamWidth;
+	const float labelLogProbThreshold;
+	const ICtcLabelScorer* const scorer;
+
+	CArray<CNode> nodes;
+	CMap<CNodeKey, int> children;
+	CArray<CBeamEntry> beam;
+	CArray<CBeamEntry> candidates;
+	CArray<int> candidateIndices; // the index of the node in the candidates array or NotFound
+	CArray<int> labels; // the labels that extend the prefixes at the current position
+	CArray<int> prefix;
+
+	int getChild( int node, int label );
+	void getPrefix( int node, CArray<int>& result ) const;
+	void addCandidate( int node, float blankLogProb, float labelLogProb );
+};
+
+int CCtcPrefixBeamSearch::CNodeKey::HashKey() const
+{
+	int hashKey = CDefaultHash<int>::HashKey( Parent );
+	AddToHashKey( CDefaultHash<int>::HashKey( Label ), hashKey );
+	return hashKey;
+}
+
+CCtcPrefixBeamSearch::CCtcPrefixBeamSearch( int _labelsCount, int _blankLabel, int _beamWidth,
+		float labelProbabilityThreshold, const ICtcLabelScorer* _scorer ) :
+	labelsCount( _labelsCount ),
+	blankLabel( _blankLabel ),
+	beamWidth( _beamWidth ),
+	labelLogProbThreshold( labelProbabilityThreshold > 0 ? logf( labelProbabilityThreshold ) : -FLT_MAX ),
+	scorer( _scorer )
+{
+	NeoAssert( beamWidth > 0 );
+}
+
+float CCtcPrefixBeamSearch::Decode( const float* logProbs, int sequenceLength, CArray<int>& result )
+{
+	nodes.DeleteAll();
+	children.DeleteAll();
+	candidateIndices.DeleteAll();
+	// The root is the empty prefix
+	nodes.Add( CNode{ NotFound, NotFound, 0.f } );
+	candidateIndices.Add( NotFound );
+	beam.DeleteAll();
+	beam.Add( CBeamEntry{ 0, 0.f, -FLT_MAX, 0.f } );
+
+	for( int pos = 0; pos < sequenceLength; ++pos ) {
+		const float* frame = logProbs + pos * labelsCount;
+		labels.DeleteAll();
+		for( int label = 0; label < labelsCount; ++label ) {
+			if( label != blankLabel && frame[label] >= labelLogProbThreshold ) {
+				labels.Add( label );
+			}
+		}
+
+		candidates.DeleteAll();
+		for( int i = 0; i < beam.Size(); ++i ) {
+			const CBeamEntry entry = beam[i];
+			const float logProb = logSumExp( entry.BlankLogProb, entry.LabelLogProb );
+			const int lastLabel = nodes[entry.Node].Label;
+			// The blank keeps the prefix
+			addCandidate( entry.Node, logProb + frame[blankLabel], -FLT_MAX );
+			// The repeated last label is merged with it
+			if( lastLabel != NotFound ) {
+				addCandidate( entry.Node, -FLT_MAX, entry.LabelLogProb + frame[lastLabel] );
+			}
+			for( int j = 0; j < labels.Size(); ++j ) {
+				const int label = labels[j];
+				// The same label extends the prefix only after the blank
+				const float extensionLogProb = ( label == lastLabel ? entry.BlankLogProb : logProb ) + frame[label];
+				addCandidate( getChild( entry.Node, label ), -FLT_MAX, extensionLogProb );
+			}
+		}
+
+		for( int i = 0; i < candidates.Size(); ++i ) {
+			CBeamEntry& candidate = candidates[i];
+			candidate.Score = logSumExp( candidate.BlankLogProb, candidate.LabelLogProb ) + nodes[candidate.Node].Score;
+			candidateIndices[candidate.Node] = NotFound;
+		}
+		candidates.QuickSort<DescendingByMember<CBeamEntry, float, &CBeamEntry::Score>>();
+		beam.DeleteAll();
+		for( int i = 0; i < min( beamWidth, candidates.Size() ); ++i ) {
+			beam.Add( candidates[i] );
+		}
+	}
+
+	getPrefix( beam[0].Node, result );
+	return beam[0].Score;
+}
+
+// Gets the child of the prefix tree node, creates it if necessary
+int CCtcPrefixBeamSearch::getChild( int node, int label )
+{
+	const CNodeKey key{ node, label };
+	int child = NotFound;
+	if( children.Lookup( key, child ) ) {
+		return child;
+	}
+
+	float score = nodes[node].Score;
+	if( scorer != nullptr ) {
+		getPrefix( node, prefix );
+		score += scorer->GetLogScore( prefix.GetPtr(), prefix.Size(), label );
+	}
+	child = nodes.Size();
+	nodes.Add( CNode{ node, label, score } );
+	candidateIndices.Add( NotFound );
+	children.Add( key, child );
+	return child;
+}
+
+// Gets the labels of the prefix
+void CCtcPrefixBeamSearch::getPrefix( int node, CArray<int>& result ) const
+{
+	result.DeleteAll();
+	for( int current = node; nodes[current].Parent != NotFound; current = nodes[current].Parent ) {
+		result.Add( nodes[current].Label );
+	}
+	for( int i = 0; i < result.Size() / 2; ++i ) {
+		swap( result[i], result[result.Size() - 1 - i] );
+	}
+}
+
+// Adds the probabilities of the paths to the prefix candidate for the next position
+void CCtcPrefixBeamSearch::addCandidate( int node, float blankLogProb, float labelLogProb )
+{
+	int& index = candidateIndices[node];
+	if( index == NotFound ) {
+		index = candidates.Size();
+		candidates.Add( CBeamEntry{ node, blankLogProb, labelLogProb, 0.f } );
+	} else {
+		CBeamEntry& candidate = candidates[index];
+		candidate.BlankLogProb = logSumExp( candidate.BlankLogProb, blankLogProb );
+		candidate.LabelLogProb = logSumExp( candidate.LabelLogProb, labelLogProb );
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+
+// Gets the lengths of the sequences from the last run
+void CCtcDecodingLayer::getSequenceLengths( CArray<int>& lengths ) const
+{
+	const int batchWidth = lastResults[I_Result]->GetBatchWidth();
+	const int maxLength = lastResults[I_Result]->GetBatchLength();
+	if( lastResults.Size() > I_InputLengths ) {
+		NeoAssert( lastResults[I_InputLengths]->GetDataSize() == batchWidth );
+		lengths.SetSize( batchWidth );
+		lastResults[I_InputLengths]->CopyTo( lengths.GetPtr() );
+		for( int i = 0; i < lengths.Size(); ++i ) {
+			lengths[i] = min( lengths[i], maxLength );
+		}
+	} else {
+		lengths.DeleteAll();
+		lengths.Add( maxLength, batchWidth );
+	}
+}
+
+float CCtcDecodingLayer::GetBeamSearchSequence( int sequenceNumber, CArray<int>& labelSequence ) const
+{
+	labelSequence.DeleteAll();
+	if( lastResults.IsEmpty() ) {
+		return 0;
+	}
+
+	CArray<int> lengths;
+	getSequenceLengths( lengths );
+	const int labelsCount = lastResults[I_Result]->GetChannelsCount();
+	// The log(softmax) of the sequence is stored in the transposed result
+	CArray<float> logProbs;
+	logProbs.SetSize( lengths[sequenceNumber] * labelsCount );
+	MathEngine().DataExchangeTyped( logProbs.GetPtr(), transposedResult->GetData<const float>( { sequenceNumber } ),
+		logProbs.Size() );
+
+	CCtcPrefixBeamSearch beamSearch( labelsCount, blankLabel, beamWidth, beamLabelProbabilityThreshold, labelScorer );
+	return beamSearch.Decode( logProbs.GetPtr(), lengths[sequenceNumber], labelSequence );
+}
+
+void CCtcDecodingLayer::GetBeamSearchSequences( CArray<CArray<int>>& labelSequences, int threadCount ) const
+{
+	labelSequences.DeleteAll();
+	if( lastResults.IsEmpty() ) {
+		return;
+	}
+
+	CArray<int> lengths;
+	getSequenceLengths( lengths );
+	CArray<float> logProbs;
+	logProbs.SetSize( transposedResult->GetDataSize() );
+	transposedResult->CopyTo( logProbs.GetPtr() );
+	labelSequences.SetSize( lengths.Size() );
+
+	// The sequences are processed independently
+	const int labelsCount = lastResults[I_Result]->GetChannelsCount();
+	const int maxLength = lastResults[I_Result]->GetBatchLength();
+	auto decode = [&]( int begin, int end ) {
+		CCtcPrefixBeamSearch beamSearch( labelsCount, blankLabel, beamWidth, beamLabelProbabilityThreshold, labelScorer );
+		for( int i = begin; i < end; ++i ) {
+			beamSearch.Decode( logProbs.GetPtr() + i * maxLength * labelsCount, lengths[i], labelSequences[i] );
+		}
+	};
+
+	std::unique_ptr<IThreadPool> threadPool( threadCount == 1 || lengths.Size() == 1 ? nullptr
+		: CreateThreadPool( threadCount ) );
+	if( threadPool == nullptr ) {
+		decode( 0, lengths.Size() );
+		return;
+	}
+
+	// The thread pool tasks must not throw (e.g. from the label scorer),
+	// so the first exception is rethrown after all the tasks have finished
+	std::mutex exceptionMutex;
+	std::exception_ptr exception;
+	std::atomic<bool> isFailed( false );
+	auto decodeRange = [&]( int begin, int end ) {
+		if( isFailed ) {
+			return;
+		}
+		try {
+			decode( begin, end );
+		} catch( ... ) {
+			std::lock_guard<std::mutex> lock( exceptionMutex );
+			if( exception == nullptr ) {
+				exception = std::current_exception();
+			}
+			isFailed = true;
+		}
+	};
+	threadPool->ParallelFor( lengths.Size(), /*grainSize*/1, []( int, int begin, int end, void* params ) {
+		( *static_cast<decltype( decodeRange )*>( params ) )( begin, end );
+	}, &decodeRange );
+	if( exception != nullptr ) {
+		std::rethrow_exception( exception );
+	}
+}
+
+static const int CtcDecodingLayerVersion = 2001;
 
 void CCtcDecodingLayer::Serialize( CArchive& archive )
 {
-	archive.SerializeVersion( CtcDecodingLayerVersion, CDnn::ArchiveMinSupportedVersion );
+	const int version = archive.SerializeVersion( CtcDecodingLayerVersion, CDnn::ArchiveMinSupportedVersion );
 	CBaseLayer::Serialize( archive );
 
 	if( archive.IsStoring() ) {
 		archive << blankLabel;
 		archive << blankProbabilityThreshold;
 		archive << arcProbabilityThreshold;
+		archive << beamWidth;
+		archive << beamLabelProbabilityThreshold;
 	} else if( archive.IsLoading() ) {
 		archive >> blankLabel;
 		archive >> blankProbabilityThreshold;
 		archive >> arcProbabilityThreshold;
+		if( version >= 2001 ) {
+			archive >> beamWidth;
+			archive >> beamLabelProbabilityThreshold;
+			check( beamWidth > 0, ERR_BAD_ARCHIVE, archive.Name() );
+		} else {
+			beamWidth = 16;
+			beamLabelProbabilityThreshold = 0.001f;
+		}
 		ForceReshape();
 	} else {
 		NeoAssert( false );
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -29,13 +29,32 @@ CFullyConnectedLayer::CFullyConnectedLayer( IMathEngine& mathEngine, const char*
 	paramBlobs.SetSize(2);
 }
 
+CFullyConnectedLayer::~CFullyConnectedLayer()
+{
+	resetPreparedWeights();
+}
+
 void CFullyConnectedLayer::Reshape()
 {
 	CheckInputs();
 	CheckLayerArchitecture( GetInputCount() == GetOutputCount(),
 		"fully connected layer with different numbers of input and output" );
+	CheckLayerArchitecture( !int8Quantization.IsQuantized() || MathEngine().GetType() == MET_Cpu,
+		"int8 quantization is supported only on CPU" );
+	resetPreparedWeights();
 	for( int i = 0; i < GetInputCount(); ++i ) {
-		if( Weights() == nullptr ) {
+		if( halfWeights != nullptr ) {
+			CheckLayerArchitecture( halfWeights->GetObjectCount() == numberOfElements,
+				"weights number is not equal to number of elements" );
+			CheckLayerArchitecture( halfWeights->GetObjectSize() == inputDescs[i].ObjectSize(),
+				"weights size mismatch" );
+		} else if( int8Quantization.IsQuantized() ) {
+			// Only the int8 weights are kept
+			CheckLayerArchitecture( int8Quantization.GetWeightsDesc().ObjectCount() == numberOfElements,
+				"weights number is not equal to number of elements" );
+			CheckLayerArchitecture( int8Quantization.GetWeightsDesc().ObjectSize() == inputDescs[i].ObjectSize(),
+				"weights size mismatch" );
+		} else if( Weights() == nullptr ) {
 			// Create a weights matrix
 			CBlobDesc weightsDesc = inputDescs[i];
 			weightsDesc.SetDimSize( BD_BatchLength, 1 );
@@ -44,6 +63,7 @@ void CFullyConnectedLayer::Reshape()
 			Weights() = CDnnBlob::CreateBlob( MathEngine(), CT_Float, weightsDesc );
 			// Initialize
 			InitializeParamBlob( i, *Weights() );
+			applyWeightsPrecision();
 		} else {
 			CheckLayerArchitecture( Weights()->GetObjectCount() == numberOfElements,
 				"weights number is not equal to number of elements" );
@@ -71,12 +91,23 @@ void CFullyConnectedLayer::Reshape()
 
 void CFullyConnectedLayer::RunOnce()
 {
+	CheckLayerArchitecture( halfWeights == nullptr || ( !IsBackwardPerformed() && !IsLearningPerformed() ),
+		"16-bit weights are supported only for inference" );
+	CheckLayerArchitecture( !int8Quantization.IsQuantized() || ( !IsBackwardPerformed() && !IsLearningPerformed() ),
+		"int8 quantized weights are supported only for inference" );
+
 	const int inputCount = GetInputCount();
 	const int secondHeight = numberOfElements;
-	const int secondWidth = Weights()->GetObjectSize();
+	const int secondWidth = halfWeights != nullptr ? halfWeights->GetObjectSize()
+		: ( int8Quantization.IsQuantized() ? int8Quantization.GetWeightsDesc().ObjectSize() : Weights()->GetObjectSize() );
 
-	CConstFloatHandle weightData = Weights()->GetData();
 	CConstFloatHandle FreeTermsData = FreeTerms()->GetData();
+	const CPackedMatrixDesc* packedWeightData = int8Quantization.IsQuantized() ? nullptr : getPackedWeights();
+	// If packing is not supported the 16-bit weights are used through their float copy
+	CPtr<CDnnBlob> floatWeights;
+	if( packedWeightData == nullptr && !int8Quantization.IsQuantized() ) {
+		floatWeights = halfWeights != nullptr ? getConvertedWeights() : Weights().Ptr();
+	}
 
 	for( int inputNumber = 0; inputNumber < inputCount; ++inputNumber ) {
 		CConstFloatHandle inputData = inputBlobs[inputNumber]->GetData();
@@ -88,10 +119,26 @@ void CFullyConnectedLayer::RunOnce()
 		NeoPresume( firstWidth == secondWidth );
 		NeoPresume( resultWidth == secondHeight );
 
-		MathEngine().MultiplyMatrixByTransposedMatrix(
-			/*first*/inputData, firstHeight, firstWidth, firstWidth,
-			/*second*/weightData, secondHeight, secondWidth,
-			/*result*/outputData, resultWidth, /*unused*/0 );
+		if( int8Quantization.IsQuantized() ) {
+			int8Quantization.Run( MathEngine(), isZeroFreeTerm ? nullptr : FreeTerms().Ptr(),
+				inputData, firstHeight, outputData );
+			continue;
+		}
+		if( int8Quantization.IsCalibrating() ) {
+			int8Quantization.Calibrate( *inputBlobs[inputNumber] );
+		}
+
+		if( packedWeightData != nullptr ) {
+			MathEngine().MultiplyMatrixByPackedTransposedMatrix(
+				/*first*/inputData, firstHeight, firstWidth,
+				/*second*/*packedWeightData,
+				/*result*/outputData, outputBlobs[inputNumber]->GetDataSize() );
+		} else {
+			MathEngine().MultiplyMatrixByTransposedMatrix(
+				/*first*/inputData, firstHeight, firstWidth, firstWidth,
+				/*second*/floatWeights->GetData(), secondHeight, secondWidth,
+				/*result*/outputData, resultWidth, /*unused*/0 );
+		}
 
 		if( !isZeroFreeTerm ) {
 			MathEngine().AddVectorToMatrixRows( /*batchSize*/1, outputData,
@@ -100,6 +147,63 @@ void CFullyConnectedLayer::RunOnce()
 	}
 }
 
+// Returns the weights packed for the inference
+// Nullptr is returned during training (the weights change after every step) or if packing is not supported
+const CPackedMatrixDesc* CFullyConnectedLayer::getPackedWeights()
+{
+	if( IsBackwardPerformed() || IsLearningPerformed() ) {
+		resetPreparedWeights();
+		return nullptr;
+	}
+	if( packedWeights == nullptr ) {
+		if( halfWeights != nullptr ) {
+			packedWeights = MathEngine().InitHalfFloatPackedTransposedMatrix( GetHalfFloatFormat( weightsPrecision ),
+				halfWeights->GetData(), numberOfElements, halfWeights->GetObjectSize() );
+		} else {
+			packedWeights = MathEngine().InitPackedTransposedMatrix( Weights()->GetData(),
+				numberOfElements, Weights()->GetObjectSize() );
+		}
+	}
+	return packedWeights;
+}
+
+// Returns the float copy of the 16-bit weights
+// The copy is kept until the weights are changed
+CDnnBlob* CFullyConnectedLayer::getConvertedWeights()
+{
+	NeoPresume( halfWeights != nullptr );
+	if( convertedWeights == nullptr ) {
+		convertedWeights = halfWeights->GetFloatBlob( MathEngine() );
+	}
+	return convertedWeights;
+}
+
+// Converts the stored weights to weightsPrecision
+void CFullyConnectedLayer::applyWeightsPrecision()
+{
+	resetPreparedWeights();
+	if( weightsPrecision == DWP_Float32 ) {
+		if( halfWeights != nullptr ) {
+			Weights() = halfWeights->GetFloatBlob( MathEngine() );
+			halfWeights = nullptr;
+		}
+	} else if( Weights() != nullptr ) {
+		halfWeights = FINE_DEBUG_NEW CDnnHalfFloatBlob( weightsPrecision, *Weights() );
+		Weights() = nullptr;
+	} else if( halfWeights != nullptr && halfWeights->GetPrecision() != weightsPrecision ) {
+		halfWeights = FINE_DEBUG_NEW CDnnHalfFloatBlob( weightsPrecision, *halfWeights->GetFloatBlob( MathEngine() ) );
+	}
+}
+
+// Destroys all the data calculated from the weights
+void CFullyConnectedLayer::resetPreparedWeights()
+{
+	int8Quantization.ResetDesc();
+	delete packedWeights;
+	packedWeights = nullptr;
+	convertedWeights = nullptr;
+}
+
 void CFullyConnectedLayer::BackwardOnce()
 {
 	const int outputDiffCount = outputDiffBlobs.Size();
@@ -154,6 +258,7 @@ void CFullyConnectedLayer::LearnOnce()
 
 void CFullyConnectedLayer::FilterLayerParams( float threshold )
 {
+	resetPreparedWeights();
 	for( int blobIndex = 0; blobIndex < paramBlobs.Size(); ++blobIndex ) {
 		if( paramBlobs[blobIndex] != nullptr ) {
 			MathEngine().FilterSmallValues( paramBlobs[blobIndex]->GetData(),
@@ -162,6 +267,16 @@ void CFullyConnectedLayer::FilterLayerParams( float threshold )
 	}
 }
 
+// All the stages (forward, backward and learn) perform one multiplication of the same size
+double CFullyConnectedLayer::EstimateFlops() const
+{
+	double flops = 0;
+	for( int i = 0; i < inputDescs.Size(); ++i ) {
+		flops += 2. * inputDescs[i].ObjectCount() * inputDescs[i].ObjectSize() * numberOfElements;
+	}
+	return flops;
+}
+
 void CFullyConnectedLayer::SetNumberOfElements( int newNumberOfElements )
 {
 	NeoAssert( ( Weights() == nullptr && FreeTerms() == nullptr ) || numberOfElements == newNumberOfElements );
@@ -170,6 +285,12 @@ void CFullyConnectedLayer::SetNumberOfElements( int newNumberOfElements )
 
 CPtr<CDnnBlob> CFullyConnectedLayer::GetWeightsData() const
 {
+	if( halfWeights != nullptr ) {
+		return halfWeights->GetFloatBlob( MathEngine() );
+	}
+	if( int8Quantization.IsQuantized() ) {
+		return int8Quantization.GetDequantizedWeights( MathEngine() );
+	}
 	if( Weights() == nullptr ) {
 		return nullptr;
 	}
@@ -178,6 +299,9 @@ CPtr<CDnnBlob> CFullyConnectedLayer::GetWeightsData() const
 
 void CFullyConnectedLayer::SetWeightsData( const CDnnBlob* newWeights )
 {
+	resetPreparedWeights();
+	halfWeights = nullptr;
+	int8Quantization.Reset();
 	if( newWeights == nullptr ) {
 		NeoAssert( Weights() == nullptr || GetDnn() == nullptr );
 		Weights() = nullptr;
@@ -192,6 +316,7 @@ void CFullyConnectedLayer::SetWeightsData( const CDnnBlob* newWeights )
 	if( Weights() != nullptr ) {
 		numberOfElements = Weights()->GetObjectCount();
 	}
+	applyWeightsPrecision();
 }
 
 CPtr<CDnnBlob> CFullyConnectedLayer::GetFreeTermData() const
@@ -220,6 +345,7 @@ void CFullyConnectedLayer::SetFreeTermData( const CDnnBlob* newFreeTerms )
 	if( FreeTerms() != nullptr ) {
 		numberOfElements = FreeTerms()->GetDataSize();
 	}
+	resetPreparedWeights();
 }
 
 void CFullyConnectedLayer::SetZeroFreeTerm( bool _isZeroFreeTerm )
@@ -227,12 +353,16 @@ void CFullyConnectedLayer::SetZeroFreeTerm( bool _isZeroFreeTerm )
 	isZeroFreeTerm = _isZeroFreeTerm;
 }
 
-void CFullyConnectedLayer::ApplyBatchNormalization( CBatchNormalizationLayer& batchNorm )
+bool CFullyConnectedLayer::ApplyBatchNormalization( CBatchNormalizationLayer& batchNorm )
 {
+	if( weightsPrecision != DWP_Float32 || int8Quantization.IsQuantized() ) {
+		return false;
+	}
 	CPtr<CDnnBlob> params = batchNorm.GetFinalParams();
 	if( params.Ptr() == nullptr || Weights().Ptr() == nullptr ) {
-		return;
+		return true;
 	}
+	resetPreparedWeights();
 	NeoAssert( params->GetObjectSize() == numberOfElements );
 	CConstFloatHandle gamma = params->GetObjectData( 0 );
 	CConstFloatHandle beta = params->GetObjectData( 1 );
@@ -246,17 +376,78 @@ void CFullyConnectedLayer::ApplyBatchNormalization( CBatchNormalizationLayer& ba
 		MathEngine().VectorMultiply( weightData, weightData, wieghtCount, gamma++ );
 		weightData += wieghtCount;
 	}
+	return true;
+}
+
+void CFullyConnectedLayer::SetWeightsPrecision( TDnnWeightsPrecision precision )
+{
+	NeoAssert( precision == DWP_Float32 || !int8Quantization.IsQuantized() );
+	weightsPrecision = precision;
+	applyWeightsPrecision();
 }
 
-static const int FullyConnectedLayerVersion = 2000;
+void CFullyConnectedLayer::StartInt8Calibration()
+{
+	// The calibration is done on the float weights
+	ResetInt8Quantization();
+	int8Quantization.StartCalibration();
+}
+
+void CFullyConnectedLayer::FinishInt8Calibration()
+{
+	NeoAssert( Weights() != nullptr );
+	NeoAssert( MathEngine().GetType() == MET_Cpu );
+	int8Quantization.FinishCalibration( *Weights() );
+	// Only the int8 weights are used from now on
+	resetPreparedWeights();
+	Weights() = nullptr;
+}
+
+void CFullyConnectedLayer::ResetInt8Quantization()
+{
+	if( int8Quantization.IsQuantized() ) {
+		Weights() = int8Quantization.GetDequantizedWeights( MathEngine() );
+	}
+	resetPreparedWeights();
+	int8Quantization.Reset();
+}
+
+static const int FullyConnectedLayerVersion = 2002;
 
 void CFullyConnectedLayer::Serialize( CArchive& archive )
 {
-	archive.SerializeVersion( FullyConnectedLayerVersion, CDnn::ArchiveMinSupportedVersion );
+	const int version = archive.SerializeVersion( FullyConnectedLayerVersion, CDnn::ArchiveMinSupportedVersion );
+	if( archive.IsLoading() ) {
+		resetPreparedWeights();
+	}
 	CBaseLayer::Serialize( archive );
 
 	archive.Serialize( numberOfElements );
 	archive.Serialize( isZeroFreeTerm );
+	if( version >= 2001 ) {
+		int8Quantization.Serialize( archive );
+		if( archive.IsLoading() && int8Quantization.IsQuantized() ) {
+			// The float weights are not needed once the int8 weights are known
+			Weights() = nullptr;
+		}
+	} else {
+		int8Quantization.Reset();
+	}
+	if( version >= 2002 ) {
+		// The 16-bit weights are stored instead of the float weights blob which is null then
+		archive.SerializeEnum( weightsPrecision );
+		bool hasHalfWeights = halfWeights != nullptr;
+		archive.Serialize( hasHalfWeights );
+		if( archive.IsLoading() ) {
+			halfWeights = hasHalfWeights ? FINE_DEBUG_NEW CDnnHalfFloatBlob() : nullptr;
+		}
+		if( hasHalfWeights ) {
+			halfWeights->Serialize( archive );
+		}
+	} else {
+		weightsPrecision = DWP_Float32;
+		halfWeights = nullptr;
+	}
 
 	if( archive.IsLoading() ) {
 		// Converts the free terms blob into a new tensor with the length in the first dimension not Channels
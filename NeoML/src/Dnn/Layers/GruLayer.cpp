@@ -25,11 +25,17 @@ limitations under the License.
 namespace NeoML {
 
 CGruLayer::CGruLayer( IMathEngine& mathEngine ) :
-	CRecurrentLayer( mathEngine, "CCnnGruLayer" )
+	CRecurrentLayer( mathEngine, "CCnnGruLayer" ),
+	gruDesc( nullptr )
 {
 	buildLayer();
 }
 
+CGruLayer::~CGruLayer()
+{
+	delete gruDesc;
+}
+
 // Builds the layer
 void CGruLayer::buildLayer()
 {
@@ -142,6 +148,59 @@ void CGruLayer::Serialize( CArchive& archive )
 	}
 }
 
+void CGruLayer::RunOnce()
+{
+	if( isFusedInference() ) {
+		initDesc();
+		CConstFloatHandle initialState = inputBlobs.Size() > 1 ? inputBlobs[1]->GetData() : CConstFloatHandle();
+		MathEngine().Gru( *gruDesc, IsReverseSequence(), inputBlobs[0]->GetBatchLength(),
+			inputBlobs[0]->GetBatchWidth() * inputBlobs[0]->GetListSize(), initialState, inputBlobs[0]->GetData(),
+			outputBlobs[0]->GetData() );
+	} else {
+		freeDesc();
+		CRecurrentLayer::RunOnce();
+	}
+}
+
+void CGruLayer::Reshape()
+{
+	CRecurrentLayer::Reshape();
+	freeDesc();
+}
+
+// Indicates that the whole sequence may be processed by the fused GRU primitive
+// instead of running the internal network step by step
+bool CGruLayer::isFusedInference() const
+{
+	return MathEngine().GetType() == MET_Cpu
+		&& !IsBackwardPerformed()
+		&& !IsLearningPerformed()
+		&& GetRepeatCount() == 1
+		&& inputBlobs[0]->GetDataType() == CT_Float
+		&& mainLayer->GetWeightsPrecision() == DWP_Float32
+		&& gateLayer->GetWeightsPrecision() == DWP_Float32
+		&& !mainLayer->GetInt8Quantization().IsQuantized()
+		&& !gateLayer->GetInt8Quantization().IsQuantized();
+}
+
+void CGruLayer::initDesc()
+{
+	if( gruDesc == nullptr ) {
+		CConstFloatHandle gateFreeTerm = gateLayer->IsZeroFreeTerm() || gateLayer->FreeTerms() == nullptr
+			? CConstFloatHandle() : gateLayer->FreeTerms()->GetData();
+		CConstFloatHandle mainFreeTerm = mainLayer->IsZeroFreeTerm() || mainLayer->FreeTerms() == nullptr
+			? CConstFloatHandle() : mainLayer->FreeTerms()->GetData();
+		gruDesc = MathEngine().InitGru( GetHiddenSize(), inputBlobs[0]->GetObjectSize(),
+			gateLayer->Weights()->GetData(), gateFreeTerm, mainLayer->Weights()->GetData(), mainFreeTerm );
+	}
+}
+
+void CGruLayer::freeDesc()
+{
+	delete gruDesc;
+	gruDesc = nullptr;
+}
+
 CLayerWrapper<CGruLayer> Gru( int hiddenSize )
 {
 	return CLayerWrapper<CGruLayer>( "Gru", [=]( CGruLayer* result ) {
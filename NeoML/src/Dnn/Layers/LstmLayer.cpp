@@ -19,6 +19,7 @@ limitations under the License.
 #include <NeoML/Dnn/Layers/LstmLayer.h>
 #include <NeoML/Dnn/Layers/ConcatLayer.h>
 #include <NeoML/Dnn/Layers/SplitLayer.h>
+#include <NeoML/Dnn/DnnSolver.h>
 
 
 namespace NeoML {
@@ -349,7 +350,9 @@ void CLstmLayer::Serialize( CArchive& archive )
 
 void CLstmLayer::RunOnce()
 {
-	if( MathEngine().GetType() == MET_Cpu &&
+	if( isFusedTraining() ) {
+		runFusedTraining();
+	} else if( MathEngine().GetType() == MET_Cpu &&
 		!isInCompatibilityMode &&
 		!IsBackwardPerformed() &&
 		!IsLearningPerformed() &&
@@ -373,6 +376,40 @@ void CLstmLayer::Reshape()
 	checkBlobDescs();
 	CRecurrentLayer::Reshape();
 	freeDesc();
+	fusedGates = nullptr;
+	fusedStates = nullptr;
+}
+
+void CLstmLayer::BackwardOnce()
+{
+	if( isFusedTraining() ) {
+		backwardAndLearnFused();
+	} else {
+		CRecurrentLayer::BackwardOnce();
+	}
+}
+
+void CLstmLayer::LearnOnce()
+{
+	if( isFusedTraining() ) {
+		// The weights diffs are calculated together with the input diffs if backward is performed
+		if( !IsBackwardPerformed() ) {
+			backwardAndLearnFused();
+		}
+	} else {
+		CRecurrentLayer::LearnOnce();
+	}
+}
+
+int CLstmLayer::BlobsForBackward() const
+{
+	// The fused backward uses the inputs and the whole output sequence
+	return isFusedTraining() ? TInputBlobs | TOutputBlobs : CRecurrentLayer::BlobsForBackward();
+}
+
+int CLstmLayer::BlobsForLearn() const
+{
+	return isFusedTraining() ? TInputBlobs | TOutputBlobs : CRecurrentLayer::BlobsForLearn();
 }
 
 // Checks layer input and output descs
@@ -483,6 +520,112 @@ void CLstmLayer::freeDesc()
 	lstmDesc = nullptr;
 }
 
+// Indicates that the whole sequence may be trained by the fused LSTM primitives
+// instead of running the internal network step by step
+bool CLstmLayer::isFusedTraining() const
+{
+	return MathEngine().GetType() == MET_Cpu
+		&& ( IsBackwardPerformed() || IsLearningPerformed() )
+		&& !isInCompatibilityMode
+		&& recurrentActivation == AF_Sigmoid
+		&& inputDropoutLayer == nullptr
+		&& GetRepeatCount() == 1
+		&& !GetDnn()->IsRecurrentMode()
+		&& inputHiddenLayer->GetWeightsPrecision() == DWP_Float32
+		&& recurHiddenLayer->GetWeightsPrecision() == DWP_Float32;
+}
+
+// Calculates the whole sequence and stores the gates for the backward pass
+void CLstmLayer::runFusedTraining()
+{
+	// The weights are changed by the solver after each run
+	freeDesc();
+	initDesc();
+
+	const int sequenceLength = inputBlobs[0]->GetBatchLength();
+	const int sequenceCount = inputBlobs[0]->GetBatchWidth();
+	const int hiddenSize = GetHiddenSize();
+	if( fusedGates == nullptr ) {
+		fusedGates = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, sequenceLength, sequenceCount,
+			G_Count * hiddenSize );
+	}
+	if( outputBlobs.Size() < 2 && fusedStates == nullptr ) {
+		fusedStates = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, sequenceLength, sequenceCount, hiddenSize );
+	}
+
+	CConstFloatHandle inputStateBackLink = inputBlobs.Size() > 1 ? inputBlobs[1]->GetData() : CConstFloatHandle();
+	CConstFloatHandle inputMainBackLink = inputBlobs.Size() > 2 ? inputBlobs[2]->GetData() : CConstFloatHandle();
+	CFloatHandle states = outputBlobs.Size() > 1 ? outputBlobs[1]->GetData() : fusedStates->GetData();
+	MathEngine().LstmForwardTraining( *lstmDesc, IsReverseSequence(), sequenceLength, sequenceCount,
+		inputStateBackLink, inputMainBackLink, inputBlobs[0]->GetData(), fusedGates->GetData(),
+		states, outputBlobs[0]->GetData() );
+}
+
+// Calculates the input diffs and the weights diffs of the fused training run
+void CLstmLayer::backwardAndLearnFused()
+{
+	NeoAssert( lstmDesc != nullptr && fusedGates != nullptr );
+
+	const int sequenceLength = inputBlobs[0]->GetBatchLength();
+	const int sequenceCount = inputBlobs[0]->GetBatchWidth();
+	CPtr<CDnnBlob> gatesDiff = fusedGates->GetClone();
+
+	CConstFloatHandle inputStateBackLink = inputBlobs.Size() > 1 ? inputBlobs[1]->GetData() : CConstFloatHandle();
+	CConstFloatHandle inputMainBackLink = inputBlobs.Size() > 2 ? inputBlobs[2]->GetData() : CConstFloatHandle();
+	CConstFloatHandle states = outputBlobs.Size() > 1 ? outputBlobs[1]->GetData() : fusedStates->GetData();
+	CConstFloatHandle outputStateDiff = outputDiffBlobs.Size() > 1 ? outputDiffBlobs[1]->GetData()
+		: CConstFloatHandle();
+
+	CFloatHandle inputDiff;
+	CFloatHandle inputStateBackLinkDiff;
+	CFloatHandle inputMainBackLinkDiff;
+	if( IsBackwardPerformed() ) {
+		inputDiff = inputDiffBlobs[0]->GetData();
+		if( inputDiffBlobs.Size() > 1 ) {
+			inputStateBackLinkDiff = inputDiffBlobs[1]->GetData();
+		}
+		if( inputDiffBlobs.Size() > 2 ) {
+			inputMainBackLinkDiff = inputDiffBlobs[2]->GetData();
+		}
+	}
+	MathEngine().LstmBackward( *lstmDesc, IsReverseSequence(), sequenceLength, sequenceCount,
+		inputStateBackLink, fusedGates->GetData(), states, outputStateDiff, outputDiffBlobs[0]->GetData(),
+		gatesDiff->GetData(), inputDiff, inputStateBackLinkDiff, inputMainBackLinkDiff );
+
+	if( !IsLearningPerformed()
+		|| ( !inputHiddenLayer->IsLearningEnabled() && !recurHiddenLayer->IsLearningEnabled() ) )
+	{
+		return;
+	}
+
+	// The diffs are passed to the solver the same way the internal layers do it
+	CObjectArray<CDnnBlob> inputHiddenDiffs;
+	inputHiddenDiffs.Add( inputHiddenLayer->Weights()->GetClone() );
+	inputHiddenDiffs.Add( inputHiddenLayer->FreeTerms()->GetClone() );
+	CObjectArray<CDnnBlob> recurHiddenDiffs;
+	recurHiddenDiffs.Add( recurHiddenLayer->Weights()->GetClone() );
+	recurHiddenDiffs.Add( recurHiddenLayer->FreeTerms()->GetClone() );
+	for( int i = 0; i < 2; ++i ) {
+		inputHiddenDiffs[i]->Clear();
+		recurHiddenDiffs[i]->Clear();
+	}
+	CFloatHandle inputFreeTermDiff = inputHiddenLayer->IsZeroFreeTerm() ? CFloatHandle()
+		: inputHiddenDiffs[1]->GetData();
+	CFloatHandle recurFreeTermDiff = recurHiddenLayer->IsZeroFreeTerm() ? CFloatHandle()
+		: recurHiddenDiffs[1]->GetData();
+	MathEngine().LstmLearn( *lstmDesc, IsReverseSequence(), sequenceLength, sequenceCount,
+		inputBlobs[0]->GetData(), inputMainBackLink, outputBlobs[0]->GetData(), gatesDiff->GetData(),
+		inputHiddenDiffs[0]->GetData(), inputFreeTermDiff, recurHiddenDiffs[0]->GetData(), recurFreeTermDiff );
+
+	CDnnSolver* solver = GetDnn()->GetSolver();
+	if( inputHiddenLayer->IsLearningEnabled() ) {
+		solver->AddDiff( inputHiddenLayer, inputHiddenDiffs );
+	}
+	if( recurHiddenLayer->IsLearningEnabled() ) {
+		solver->AddDiff( recurHiddenLayer, recurHiddenDiffs );
+	}
+}
+
 //--------------------------------------------------------------------------
 CLayerWrapper<CLstmLayer> Lstm( int hiddenSize, float dropoutRate, bool isInCompatibilityMode )
 {
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -22,7 +22,9 @@ namespace NeoML {
 
 CMultichannelLookupLayer::CMultichannelLookupLayer( IMathEngine& mathEngine ) :
 	CBaseLayer( mathEngine, "CCnnMultichannelLookupLayer", true ),
-	useFrameworkLearning( false )
+	useFrameworkLearning( false ),
+	useSparseGradients( false ),
+	embeddingsPrecision( DWP_Float32 )
 {
 }
 
@@ -50,6 +52,9 @@ void CMultichannelLookupLayer::SetEmbeddings( const CPtr<CDnnBlob>& data, int i
 		getParams().SetSize(GetDimensions().Size());
 	}
 	
+	if( i < halfEmbeddings.Size() ) {
+		halfEmbeddings[i] = nullptr;
+	}
 	if( data != 0 ) {
 		NeoAssert(data->GetObjectCount() == GetDimensions()[i].VectorCount);
 		NeoAssert(data->GetObjectSize() == GetDimensions()[i].VectorSize);
@@ -57,6 +62,7 @@ void CMultichannelLookupLayer::SetEmbeddings( const CPtr<CDnnBlob>& data, int i
 	} else {
 		getParams()[i] = 0;
 	}
+	applyEmbeddingsPrecision();
 }
 
 void CMultichannelLookupLayer::SetEmbeddings( CPtr<CDnnBlob>& data, int i, bool copy )
@@ -67,6 +73,9 @@ void CMultichannelLookupLayer::SetEmbeddings( CPtr<CDnnBlob>& data, int i, bool
 		getParams().SetSize(GetDimensions().Size());
 	}
 
+	if( i < halfEmbeddings.Size() ) {
+		halfEmbeddings[i] = nullptr;
+	}
 	if( data != 0 ) {
 		NeoAssert(data->GetObjectCount() == GetDimensions()[i].VectorCount);
 		NeoAssert(data->GetObjectSize() == GetDimensions()[i].VectorSize);
@@ -78,6 +87,7 @@ void CMultichannelLookupLayer::SetEmbeddings( CPtr<CDnnBlob>& data, int i, bool
 	} else {
 		getParams()[i] = 0;
 	}
+	applyEmbeddingsPrecision();
 }
 
 void CMultichannelLookupLayer::SetUseFrameworkLearning(bool _useFrameworkLearning)
@@ -98,6 +108,41 @@ void CMultichannelLookupLayer::SetUseFrameworkLearning(bool _useFrameworkLearnin
 	useFrameworkLearning = _useFrameworkLearning;
 }
 
+void CMultichannelLookupLayer::SetEmbeddingsPrecision( TDnnWeightsPrecision precision )
+{
+	embeddingsPrecision = precision;
+	applyEmbeddingsPrecision();
+}
+
+// Converts the stored embeddings to embeddingsPrecision
+void CMultichannelLookupLayer::applyEmbeddingsPrecision()
+{
+	CObjectArray<CDnnBlob>& params = getParams();
+	if( embeddingsPrecision == DWP_Float32 ) {
+		if( params.Size() < halfEmbeddings.Size() ) {
+			params.SetSize( halfEmbeddings.Size() );
+		}
+		for( int i = 0; i < halfEmbeddings.Size(); ++i ) {
+			if( halfEmbeddings[i] != nullptr ) {
+				params[i] = halfEmbeddings[i]->GetFloatBlob( MathEngine() );
+			}
+		}
+		halfEmbeddings.DeleteAll();
+		return;
+	}
+
+	halfEmbeddings.SetSize( max( halfEmbeddings.Size(), params.Size() ) );
+	for( int i = 0; i < halfEmbeddings.Size(); ++i ) {
+		if( i < params.Size() && params[i] != nullptr ) {
+			halfEmbeddings[i] = FINE_DEBUG_NEW CDnnHalfFloatBlob( embeddingsPrecision, *params[i] );
+			params[i] = nullptr;
+		} else if( halfEmbeddings[i] != nullptr && halfEmbeddings[i]->GetPrecision() != embeddingsPrecision ) {
+			halfEmbeddings[i] = FINE_DEBUG_NEW CDnnHalfFloatBlob( embeddingsPrecision,
+				*halfEmbeddings[i]->GetFloatBlob( MathEngine() ) );
+		}
+	}
+}
+
 CArchive& operator << (CArchive& archive, const CLookupDimension& d) {
 	return archive << d.VectorCount << d.VectorSize;
 }
@@ -106,16 +151,47 @@ CArchive& operator >> (CArchive& archive, CLookupDimension& d) {
 	return archive >> d.VectorCount >> d.VectorSize;
 }
 
-static const int MultichannelLookupLayerVersion = 2000;
+static const int MultichannelLookupLayerVersion = 2002;
 
 void CMultichannelLookupLayer::Serialize( CArchive& archive )
 {
-	archive.SerializeVersion( MultichannelLookupLayerVersion, CDnn::ArchiveMinSupportedVersion );
+	const int version = archive.SerializeVersion( MultichannelLookupLayerVersion, CDnn::ArchiveMinSupportedVersion );
 	CBaseLayer::Serialize( archive );
 	
 	dimensions.Serialize(archive);
 	archive.Serialize(useFrameworkLearning);
-	SerializeBlobs( MathEngine(), archive, ownParams );
+	SerializeParamBlobs( archive, ownParams );
+
+	if( version >= 2001 ) {
+		// The 16-bit tables are stored instead of the float ones which are null then
+		archive.SerializeEnum( embeddingsPrecision );
+		int halfEmbeddingsCount = halfEmbeddings.Size();
+		archive.Serialize( halfEmbeddingsCount );
+		if( archive.IsLoading() ) {
+			check( halfEmbeddingsCount >= 0, ERR_BAD_ARCHIVE, archive.Name() );
+			halfEmbeddings.DeleteAll();
+			halfEmbeddings.SetSize( halfEmbeddingsCount );
+		}
+		for( int i = 0; i < halfEmbeddings.Size(); ++i ) {
+			bool isNull = halfEmbeddings[i] == nullptr;
+			archive.Serialize( isNull );
+			if( !isNull ) {
+				if( archive.IsLoading() ) {
+					halfEmbeddings[i] = FINE_DEBUG_NEW CDnnHalfFloatBlob();
+				}
+				halfEmbeddings[i]->Serialize( archive );
+			}
+		}
+	} else {
+		embeddingsPrecision = DWP_Float32;
+		halfEmbeddings.DeleteAll();
+	}
+
+	if( version >= 2002 ) {
+		archive.Serialize( useSparseGradients );
+	} else {
+		useSparseGradients = false;
+	}
 }
 
 void CMultichannelLookupLayer::Initialize(CDnnInitializer* init)
@@ -125,7 +201,7 @@ void CMultichannelLookupLayer::Initialize(CDnnInitializer* init)
 	}
 
 	for(int i = 0; i < getParams().Size(); i++) {
-		if(getParams()[i] == 0) {
+		if(getParams()[i] == 0 && ( i >= halfEmbeddings.Size() || halfEmbeddings[i] == 0 )) {
 			getParams()[i] = CDnnBlob::CreateDataBlob(MathEngine(), CT_Float, 1,
 				GetDimensions()[i].VectorCount, GetDimensions()[i].VectorSize);
 			if(init != 0) {
@@ -135,6 +211,7 @@ void CMultichannelLookupLayer::Initialize(CDnnInitializer* init)
 			}
 		}
 	}
+	applyEmbeddingsPrecision();
 }
 
 void CMultichannelLookupLayer::Reshape()
@@ -152,9 +229,15 @@ void CMultichannelLookupLayer::Reshape()
 
 	int outputChannelsFromTableCount = 0;
 	for( int j = 0; j < getParams().Size(); j++ ) {
-		NeoAssert( getParams()[j] != 0 );
-		NeoAssert( getParams()[j]->GetObjectCount() == GetDimensions()[j].VectorCount );
-		NeoAssert( getParams()[j]->GetObjectSize() == GetDimensions()[j].VectorSize );
+		if( embeddingsPrecision != DWP_Float32 ) {
+			NeoAssert( halfEmbeddings[j] != 0 );
+			NeoAssert( halfEmbeddings[j]->GetObjectCount() == GetDimensions()[j].VectorCount );
+			NeoAssert( halfEmbeddings[j]->GetObjectSize() == GetDimensions()[j].VectorSize );
+		} else {
+			NeoAssert( getParams()[j] != 0 );
+			NeoAssert( getParams()[j]->GetObjectCount() == GetDimensions()[j].VectorCount );
+			NeoAssert( getParams()[j]->GetObjectSize() == GetDimensions()[j].VectorSize );
+		}
 		outputChannelsFromTableCount += GetDimensions()[j].VectorSize;
 	}
 	
@@ -171,6 +254,14 @@ void CMultichannelLookupLayer::Reshape()
 
 void CMultichannelLookupLayer::RunOnce()
 {
+	if( embeddingsPrecision != DWP_Float32 ) {
+		CheckLayerArchitecture( !IsLearningPerformed(), "16-bit embeddings are supported only for inference" );
+		for( int i = 0; i < inputBlobs.Size(); i++ ) {
+			lookupHalfFloat( *inputBlobs[i], *outputBlobs[i] );
+		}
+		return;
+	}
+
 	CArray<CConstFloatHandle> lookupTables;
 	for (int i = 0; i < getParams().Size(); i++) {
 		lookupTables.Add(getParams()[i]->GetData());
@@ -194,17 +285,65 @@ void CMultichannelLookupLayer::RunOnce()
 	}
 }
 
+// Fills the output with the 16-bit embeddings converted to float
+// The lookup is done in the host memory, only the indices and the result are copied
+void CMultichannelLookupLayer::lookupHalfFloat( const CDnnBlob& input, CDnnBlob& output ) const
+{
+	const int batchSize = input.GetObjectCount() * input.GetGeometricalSize();
+	const int channelCount = input.GetChannelsCount();
+	const int outputChannelCount = output.GetChannelsCount();
+
+	CArray<float> floatInput;
+	CArray<int> intInput;
+	if( input.GetDataType() == CT_Float ) {
+		floatInput.SetSize( input.GetDataSize() );
+		input.CopyTo( floatInput.GetPtr() );
+	} else {
+		intInput.SetSize( input.GetDataSize() );
+		input.CopyTo( intInput.GetPtr() );
+	}
+
+	CArray<float> result;
+	result.SetSize( batchSize * outputChannelCount );
+	for( int b = 0; b < batchSize; ++b ) {
+		float* resultPtr = result.GetPtr() + b * outputChannelCount;
+		for( int c = 0; c < channelCount; ++c ) {
+			const int pos = b * channelCount + c;
+			if( c < halfEmbeddings.Size() ) {
+				const int index = floatInput.IsEmpty() ? intInput[pos] : static_cast<int>( floatInput[pos] );
+				halfEmbeddings[c]->GetFloatObject( index, resultPtr );
+				resultPtr += halfEmbeddings[c]->GetObjectSize();
+			} else {
+				// The channels without tables are passed as is
+				*resultPtr++ = floatInput.IsEmpty() ? static_cast<float>( intInput[pos] ) : floatInput[pos];
+			}
+		}
+	}
+	output.CopyFrom( result.GetPtr() );
+}
+
 void CMultichannelLookupLayer::BackwardOnce()
 {
 	// Similar to an input layer, so we don't need to do anything on a backward pass
 	NeoAssert(0);
 }
 
+void CMultichannelLookupLayer::GetSharedParamBlobs( CArray<CPtr<CDnnBlob>*>& blobs )
+{
+	CBaseLayer::GetSharedParamBlobs( blobs );
+	// The embeddings are stored here if the framework learning is off
+	for( int i = 0; i < ownParams.Size(); ++i ) {
+		blobs.Add( &ownParams[i] );
+	}
+}
+
 void CMultichannelLookupLayer::LearnOnce()
 {
 	CFloatHandleStackVar learningRate( MathEngine() );
 
-	if(useFrameworkLearning) {
+	if( HasSparseParamDiffs() ) {
+		learnSparse();
+	} else if(useFrameworkLearning) {
 		learningRate.SetValue( 1 );
 
 		CArray<CFloatHandle> lookupTables;
@@ -255,6 +394,89 @@ void CMultichannelLookupLayer::LearnOnce()
 	}
 }
 
+// Passes the gradients of the looked up rows to the solver
+void CMultichannelLookupLayer::learnSparse()
+{
+	const int tableCount = GetDimensions().Size();
+
+	// Read the indices
+	CArray<CArray<int>> indices;
+	indices.SetSize( inputBlobs.Size() );
+	for( int i = 0; i < inputBlobs.Size(); i++ ) {
+		indices[i].SetSize( inputBlobs[i]->GetDataSize() );
+		if( inputBlobs[i]->GetDataType() == CT_Float ) {
+			CArray<float> floatIndices;
+			floatIndices.SetSize( inputBlobs[i]->GetDataSize() );
+			inputBlobs[i]->CopyTo( floatIndices.GetPtr() );
+			for( int j = 0; j < floatIndices.Size(); j++ ) {
+				indices[i][j] = static_cast<int>( floatIndices[j] );
+			}
+		} else {
+			inputBlobs[i]->CopyTo( indices[i].GetPtr() );
+		}
+	}
+
+	// Replace the indices by the positions of the unique rows
+	CArray<CArray<int>> rows;
+	rows.SetSize( tableCount );
+	for( int table = 0; table < tableCount; table++ ) {
+		CMap<int, int> rowPositions;
+		for( int i = 0; i < inputBlobs.Size(); i++ ) {
+			const int channelCount = inputBlobs[i]->GetChannelsCount();
+			for( int j = table; j < indices[i].Size(); j += channelCount ) {
+				const int index = indices[i][j];
+				NeoAssert( 0 <= index && index < GetDimensions()[table].VectorCount );
+				const TMapPosition pos = rowPositions.GetFirstPosition( index );
+				if( pos == NotFound ) {
+					rowPositions.Add( index, rows[table].Size() );
+					indices[i][j] = rows[table].Size();
+					rows[table].Add( index );
+				} else {
+					indices[i][j] = rowPositions.GetValue( pos );
+				}
+			}
+		}
+	}
+
+	// The gradients of the rows are accumulated in the compact tables
+	CObjectArray<CDnnBlob> rowIndices;
+	CObjectArray<CDnnBlob> rowDiffs;
+	CArray<CLookupDimension> rowDimensions;
+	CArray<CFloatHandle> rowTables;
+	for( int table = 0; table < tableCount; table++ ) {
+		if( rows[table].IsEmpty() ) {
+			// There are no objects in the batch for this table
+			rowIndices.Add( nullptr );
+			rowDiffs.Add( nullptr );
+			rowDimensions.Add( CLookupDimension() );
+			rowTables.Add( CFloatHandle() );
+			continue;
+		}
+		rowIndices.Add( CDnnBlob::CreateDataBlob( MathEngine(), CT_Int, 1, rows[table].Size(), 1 ) );
+		rowIndices.Last()->CopyFrom( rows[table].GetPtr() );
+		rowDiffs.Add( CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, rows[table].Size(),
+			GetDimensions()[table].VectorSize ) );
+		rowDiffs.Last()->Clear();
+		rowDimensions.Add( CLookupDimension( rows[table].Size(), GetDimensions()[table].VectorSize ) );
+		rowTables.Add( rowDiffs.Last()->GetData() );
+	}
+
+	CFloatHandleStackVar mult( MathEngine() );
+	mult.SetValue( 1.f );
+	for( int i = 0; i < inputBlobs.Size(); i++ ) {
+		CPtr<CDnnBlob> positions = CDnnBlob::CreateBlob( MathEngine(), CT_Int, inputBlobs[i]->GetDesc() );
+		positions->CopyFrom( indices[i].GetPtr() );
+		MathEngine().VectorMultichannelLookupAndAddToTable(
+			inputBlobs[i]->GetObjectCount() * inputBlobs[i]->GetGeometricalSize(),
+			inputBlobs[i]->GetChannelsCount(), positions->GetData<int>(),
+			rowTables.GetPtr(), rowDimensions.GetPtr(), tableCount,
+			mult, outputDiffBlobs[i]->GetData(), outputDiffBlobs[i]->GetChannelsCount() );
+	}
+
+	GetDnn()->GetSolver()->AddSparseDiff( this, rowIndices, rowDiffs,
+		GetDnn()->IsRecurrentMode() && !GetDnn()->IsFirstSequencePos() );
+}
+
 void CMultichannelLookupLayer::Word2VecStep( IMathEngine& mathEngine, int batchSize,
 	CMultichannelLookupLayer& word2vecLayer, CMultichannelLookupLayer& context2vecLayer,
 	const CConstIntHandle& positiveSampleMatrix, int positiveCount,
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -29,6 +29,11 @@ limitations under the License.
 
 namespace NeoML {
 
+// The name of the fused attention layer used in inference
+static const char* const FusedAttentionLayerName = "ScaledDotProductAttention";
+// The multiplier of the mask; the value is taken from the original realization
+static const float MaskMultiplier = -1e+9f;
+
 CMultiheadAttentionLayer::CMultiheadAttentionLayer( IMathEngine& mathEngine ) :
 	CCompositeLayer( mathEngine ),
 	headCount( 1 ),
@@ -37,7 +42,8 @@ CMultiheadAttentionLayer::CMultiheadAttentionLayer( IMathEngine& mathEngine ) :
 	useMask( false ),
 	maskType( MT_OneObject ),
 	outputSize( 8 ),
-	isInCompatibilityMode( false )
+	isInCompatibilityMode( false ),
+	maxCacheLength( 0 )
 {
 }
 
@@ -93,14 +99,84 @@ void CMultiheadAttentionLayer::SetCompatibilityMode( bool value )
 	if( HasLayer( multiplyByConstLayerName ) ) {
 		CheckCast<CLinearLayer>( GetLayer( multiplyByConstLayerName ) )->SetMultiplier( getScalingFactor() );
 	}
+	if( HasLayer( FusedAttentionLayerName ) ) {
+		CheckCast<CScaledDotProductAttentionLayer>( GetLayer( FusedAttentionLayerName ) )->SetScale( getScalingFactor() );
+	}
+}
+
+void CMultiheadAttentionLayer::SetMaxCacheLength( int _maxCacheLength )
+{
+	NeoAssert( _maxCacheLength >= 0 );
+	if( _maxCacheLength == maxCacheLength ) {
+		return;
+	}
+
+	maxCacheLength = _maxCacheLength;
+	// The weights are kept: the attention is rebuilt in Reshape if needed
+	if( getFusedAttention() != nullptr ) {
+		getFusedAttention()->SetMaxCacheLength( maxCacheLength );
+	}
+	ForceReshape();
+}
+
+int CMultiheadAttentionLayer::GetCacheLength() const
+{
+	const CScaledDotProductAttentionLayer* attention = getFusedAttention();
+	return attention == nullptr ? 0 : attention->GetCacheLength();
+}
+
+void CMultiheadAttentionLayer::ResetCache()
+{
+	if( getFusedAttention() != nullptr ) {
+		getFusedAttention()->ResetCache();
+	}
 }
 
-static const int MultiheadAttentionLayerVersion = 2;
+void CMultiheadAttentionLayer::TrimCache( int length )
+{
+	if( getFusedAttention() != nullptr ) {
+		getFusedAttention()->TrimCache( length );
+	}
+}
+
+void CMultiheadAttentionLayer::GetCache( CPtr<CDnnBlob>& keys, CPtr<CDnnBlob>& values ) const
+{
+	const CScaledDotProductAttentionLayer* attention = getFusedAttention();
+	if( attention == nullptr ) {
+		keys = nullptr;
+		values = nullptr;
+		return;
+	}
+	attention->GetCache( keys, values );
+}
+
+void CMultiheadAttentionLayer::SetCache( const CDnnBlob& keys, const CDnnBlob& values )
+{
+	NeoAssert( maxCacheLength > 0 );
+	NeoAssert( keys.GetObjectSize() == hiddenSize );
+
+	if( !HasLayer( "Q" ) ) {
+		create();
+	} else if( getFusedAttention() == nullptr ) {
+		rebuildAttention( true );
+	}
+	getFusedAttention()->SetCache( keys, values );
+}
+
+static const int MultiheadAttentionLayerVersion = 3;
 
 void CMultiheadAttentionLayer::Serialize( CArchive& archive )
 {
 	const int version = archive.SerializeVersion( MultiheadAttentionLayerVersion );
-	CCompositeLayer::Serialize( archive );
+	// The fused attention is only a runtime substitution, the step-by-step calculation is always stored
+	// The layer itself is not changed as the network may be running in another thread
+	CPtr<CMultiheadAttentionLayer> stepByStep;
+	if( archive.IsStoring() && getFusedAttention() != nullptr ) {
+		stepByStep = createStepByStepLayout();
+		StoreWithLayout( archive, *stepByStep );
+	} else {
+		CCompositeLayer::Serialize( archive );
+	}
 	archive.Serialize( headCount );
 	archive.Serialize( hiddenSize );
 	archive.Serialize( dropoutRate );
@@ -113,11 +189,20 @@ void CMultiheadAttentionLayer::Serialize( CArchive& archive )
 	}
 	if( version >= 2 ) {
 		archive.Serialize( isInCompatibilityMode );
-		archive.Serialize( multiplyByConstLayerName );
+		if( stepByStep != nullptr ) {
+			archive << stepByStep->multiplyByConstLayerName;
+		} else {
+			archive.Serialize( multiplyByConstLayerName );
+		}
 	} else {
 		isInCompatibilityMode = true;
 		multiplyByConstLayerName = GetName() + CString( ".MultiplyByConst" );
 	}
+	if( version >= 3 ) {
+		archive.Serialize( maxCacheLength );
+	} else {
+		maxCacheLength = 0;
+	}
 }
 
 void CMultiheadAttentionLayer::Reshape()
@@ -125,6 +210,12 @@ void CMultiheadAttentionLayer::Reshape()
 	if( !HasLayer( "Q" ) ) {
 		create();
 	}
+	CheckLayerArchitecture( maxCacheLength == 0 || GetOutputCount() <= O_Softmax,
+		"the softmax output isn't available with the cache" );
+	const bool useFusedAttention = isFusedAttentionUsed();
+	if( useFusedAttention != HasLayer( FusedAttentionLayerName ) ) {
+		rebuildAttention( useFusedAttention );
+	}
 
 	CCompositeLayer::Reshape();
 }
@@ -155,6 +246,54 @@ void CMultiheadAttentionLayer::create()
 	CBaseLayer* K = multiplyInputByMatrixWeights( hiddenSize, "K", I_K );
 	CBaseLayer* V = multiplyInputByMatrixWeights( hiddenSize, "V", I_V );
 
+	// [B, seq_Q, 1, hidden_size]
+	CBaseLayer* attention = isFusedAttentionUsed() ? createFusedAttention( Q, K, V ) : createAttention( Q, K, V );
+
+	CPtr<CBaseLayer> output = multiplyByMatrixWeights( attention, outputSize, "Out.Dense" );
+
+	SetOutputMapping( O_Output, *output );
+}
+
+// The fused attention is used in inference when the softmax output isn't needed
+// The cache is kept only by the fused attention
+bool CMultiheadAttentionLayer::isFusedAttentionUsed() const
+{
+	if( maxCacheLength > 0 ) {
+		return true;
+	}
+	return MathEngine().GetType() == MET_Cpu && GetDnn() != nullptr && !GetDnn()->IsBackwardPerformed()
+		&& GetOutputCount() <= O_Softmax && HasLayer( "Out.Dense" );
+}
+
+// Replaces the layers between the W_Q, W_K, W_V and W_O multiplications
+// The trainable weights are kept
+void CMultiheadAttentionLayer::rebuildAttention( bool useFusedAttention )
+{
+	CArray<const char*> layerNames;
+	GetLayerList( layerNames );
+	CArray<CString> attentionLayerNames;
+	for( const char* name : layerNames ) {
+		const CString layerName( name );
+		if( layerName != "Q" && layerName != "K" && layerName != "V" && layerName != "Out.Dense" ) {
+			attentionLayerNames.Add( layerName );
+		}
+	}
+	for( const CString& name : attentionLayerNames ) {
+		DeleteLayer( name );
+	}
+
+	CPtr<CBaseLayer> Q = GetLayer( "Q" );
+	CPtr<CBaseLayer> K = GetLayer( "K" );
+	CPtr<CBaseLayer> V = GetLayer( "V" );
+	CBaseLayer* attention = useFusedAttention ? createFusedAttention( Q.Ptr(), K.Ptr(), V.Ptr() )
+		: createAttention( Q.Ptr(), K.Ptr(), V.Ptr() );
+	GetLayer( "Out.Dense" )->Connect( *attention );
+}
+
+// Calculates the attention step by step, the softmax output is available
+// [B, seq_Q, 1, hidden_size]
+CBaseLayer* CMultiheadAttentionLayer::createAttention( CBaseLayer* Q, CBaseLayer* K, CBaseLayer* V )
+{
 	// [B, n_head, seq_Q, d_k]
 	Q = prepareQ( Q );
 
@@ -214,12 +353,85 @@ void CMultiheadAttentionLayer::create()
 	AddLayer( *head );
 	
 	// [B, seq_Q, 1, hidden_size]
-	CPtr<CBaseLayer> output = prepareOutput( head );
-
-	output = multiplyByMatrixWeights( output, outputSize, "Out.Dense" );
+	CBaseLayer* output = prepareOutput( head );
 
-	SetOutputMapping( O_Output, *output );
 	SetOutputMapping( O_Softmax, *afterSoftmax );
+	return output;
+}
+
+// Calculates the attention without storing the seq_Q x seq_to matrices
+// [B, seq_Q, 1, hidden_size]
+CBaseLayer* CMultiheadAttentionLayer::createFusedAttention( CBaseLayer* Q, CBaseLayer* K, CBaseLayer* V )
+{
+	CPtr<CScaledDotProductAttentionLayer> attention = new CScaledDotProductAttentionLayer( MathEngine() );
+	attention->SetName( FusedAttentionLayerName );
+	attention->SetHeadCount( headCount );
+	attention->SetScale( getScalingFactor() );
+	attention->SetMaxCacheLength( maxCacheLength );
+	attention->Connect( 0, *Q );
+	attention->Connect( 1, *K );
+	attention->Connect( 2, *V );
+	AddLayer( *attention );
+	if( useMask ) {
+		SetInputMapping( I_Mask, *attention, 3 );
+	}
+	return attention;
+}
+
+CScaledDotProductAttentionLayer* CMultiheadAttentionLayer::getFusedAttention()
+{
+	return HasLayer( FusedAttentionLayerName )
+		? CheckCast<CScaledDotProductAttentionLayer>( GetLayer( FusedAttentionLayerName ).Ptr() ) : nullptr;
+}
+
+const CScaledDotProductAttentionLayer* CMultiheadAttentionLayer::getFusedAttention() const
+{
+	return HasLayer( FusedAttentionLayerName )
+		? CheckCast<CScaledDotProductAttentionLayer>( GetLayer( FusedAttentionLayerName ).Ptr() ) : nullptr;
+}
+
+// Creates the step-by-step attention graph with the copies of the weights of this layer
+CPtr<CMultiheadAttentionLayer> CMultiheadAttentionLayer::createStepByStepLayout()
+{
+	CPtr<CMultiheadAttentionLayer> layout = new CMultiheadAttentionLayer( MathEngine() );
+	layout->SetName( GetName() );
+	layout->headCount = headCount;
+	layout->hiddenSize = hiddenSize;
+	layout->dropoutRate = dropoutRate;
+	layout->useMask = useMask;
+	layout->maskType = maskType;
+	layout->outputSize = outputSize;
+	layout->isInCompatibilityMode = isInCompatibilityMode;
+
+	// The copies keep the connections to the composite sources
+	CBaseLayer* Q = layout->addLayerCopy( *GetLayer( "Q" ) );
+	CBaseLayer* K = layout->addLayerCopy( *GetLayer( "K" ) );
+	CBaseLayer* V = layout->addLayerCopy( *GetLayer( "V" ) );
+	CBaseLayer* attention = layout->createAttention( Q, K, V );
+	CBaseLayer* output = layout->addLayerCopy( *GetLayer( "Out.Dense" ) );
+	output->Connect( *attention );
+	layout->SetOutputMapping( O_Output, *output );
+	return layout;
+}
+
+// Adds the copy of the layer from another graph
+// The parameters shared with the inference replicas are not copied when the network is stored for them
+CBaseLayer* CMultiheadAttentionLayer::addLayerCopy( CBaseLayer& layer )
+{
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::SD_Storing );
+		CPtr<CBaseLayer> layerPtr( &layer );
+		SerializeLayer( archive, MathEngine(), layerPtr );
+	}
+	file.SeekToBegin();
+	CPtr<CBaseLayer> copy;
+	{
+		CArchive archive( &file, CArchive::SD_Loading );
+		SerializeLayer( archive, MathEngine(), copy );
+	}
+	AddLayer( *copy );
+	return copy;
 }
 
 // Multiplies input by trainable weights
@@ -304,8 +516,7 @@ CBaseLayer* CMultiheadAttentionLayer::applyMask( CBaseLayer* layer )
 
 	CPtr<CLinearLayer> multiplierLayer = new CLinearLayer( MathEngine() );
 	multiplierLayer->SetName( GetName() + CString( ".Mask.MultiplyByConst" ) );
-	// The value is taken from the original realization
-	multiplierLayer->SetMultiplier( -1e+9 );
+	multiplierLayer->SetMultiplier( MaskMultiplier );
 	multiplierLayer->SetFreeTerm( 0 );
 	AddLayer( *multiplierLayer );
 	SetInputMapping( I_Mask, *multiplierLayer, 0 );
@@ -466,4 +677,262 @@ CLayerWrapper<CMultiheadAttentionLayer> MultiheadAttention(
 	} );
 }
 
+//---------------------------------------------------------------------------------------------------------------------
+
+CScaledDotProductAttentionLayer::CScaledDotProductAttentionLayer( IMathEngine& mathEngine ) :
+	CBaseLayer( mathEngine, "CScaledDotProductAttentionLayer", false ),
+	headCount( 1 ),
+	scale( 1 ),
+	maxCacheLength( 0 ),
+	cacheLength( 0 )
+{
+}
+
+void CScaledDotProductAttentionLayer::SetHeadCount( int _headCount )
+{
+	NeoAssert( _headCount >= 1 );
+	headCount = _headCount;
+}
+
+void CScaledDotProductAttentionLayer::SetMaxCacheLength( int _maxCacheLength )
+{
+	NeoAssert( _maxCacheLength >= 0 );
+	if( _maxCacheLength == maxCacheLength ) {
+		return;
+	}
+
+	maxCacheLength = _maxCacheLength;
+	keyCache = nullptr;
+	valueCache = nullptr;
+	cacheLength = 0;
+	ForceReshape();
+}
+
+// Keeps the last length elements of each sequence
+void CScaledDotProductAttentionLayer::TrimCache( int length )
+{
+	NeoAssert( length >= 0 );
+	if( length >= cacheLength ) {
+		return;
+	}
+
+	if( length > 0 ) {
+		const int batchSize = keyCache->GetBatchWidth();
+		const int hiddenSize = keyCache->GetChannelsCount();
+		const int shift = cacheLength - length;
+		for( int b = 0; b < batchSize; ++b ) {
+			// The elements are moved by the parts of shift size so that the copied areas don't overlap
+			for( int start = 0; start < length; start += shift ) {
+				const int offset = ( b * maxCacheLength + start ) * hiddenSize;
+				const int size = min( shift, length - start ) * hiddenSize;
+				MathEngine().VectorCopy( keyCache->GetData() + offset, keyCache->GetData() + offset + shift * hiddenSize, size );
+				MathEngine().VectorCopy( valueCache->GetData() + offset, valueCache->GetData() + offset + shift * hiddenSize, size );
+			}
+		}
+	}
+	cacheLength = length;
+}
+
+void CScaledDotProductAttentionLayer::GetCache( CPtr<CDnnBlob>& keys, CPtr<CDnnBlob>& values ) const
+{
+	if( cacheLength == 0 ) {
+		keys = nullptr;
+		values = nullptr;
+		return;
+	}
+
+	const int batchSize = keyCache->GetBatchWidth();
+	const int hiddenSize = keyCache->GetChannelsCount();
+	CBlobDesc desc( CT_Float );
+	desc.SetDimSize( BD_BatchWidth, batchSize );
+	desc.SetDimSize( BD_ListSize, cacheLength );
+	desc.SetDimSize( BD_Channels, hiddenSize );
+	keys = CDnnBlob::CreateBlob( MathEngine(), CT_Float, desc );
+	values = CDnnBlob::CreateBlob( MathEngine(), CT_Float, desc );
+	for( int b = 0; b < batchSize; ++b ) {
+		const int size = cacheLength * hiddenSize;
+		MathEngine().VectorCopy( keys->GetData() + b * size, keyCache->GetData() + b * maxCacheLength * hiddenSize, size );
+		MathEngine().VectorCopy( values->GetData() + b * size, valueCache->GetData() + b * maxCacheLength * hiddenSize, size );
+	}
+}
+
+void CScaledDotProductAttentionLayer::SetCache( const CDnnBlob& keys, const CDnnBlob& values )
+{
+	NeoAssert( maxCacheLength > 0 );
+	NeoAssert( keys.GetDataType() == CT_Float );
+	NeoAssert( keys.HasEqualDimensions( &values ) );
+	NeoAssert( keys.GetListSize() <= maxCacheLength );
+
+	const int batchSize = keys.GetBatchLength() * keys.GetBatchWidth();
+	if( keyCache == nullptr || keyCache->GetBatchWidth() != batchSize
+		|| keyCache->GetChannelsCount() != keys.GetObjectSize() )
+	{
+		initCache( batchSize, keys.GetObjectSize() );
+	}
+	cacheLength = 0;
+	appendToCache( keys, values );
+}
+
+static const int ScaledDotProductAttentionLayerVersion = 1;
+
+void CScaledDotProductAttentionLayer::Serialize( CArchive& archive )
+{
+	const int version = archive.SerializeVersion( ScaledDotProductAttentionLayerVersion );
+	CBaseLayer::Serialize( archive );
+	archive.Serialize( headCount );
+	archive.Serialize( scale );
+	if( version >= 1 ) {
+		archive.Serialize( maxCacheLength );
+	} else {
+		maxCacheLength = 0;
+	}
+
+	if( archive.IsLoading() ) {
+		keyCache = nullptr;
+		valueCache = nullptr;
+		cacheLength = 0;
+	}
+}
+
+void CScaledDotProductAttentionLayer::Reshape()
+{
+	CheckInputs();
+	CheckLayerArchitecture( GetInputCount() == 3 || GetInputCount() == 4, "layer must have 3 or 4 inputs" );
+	CheckLayerArchitecture( MathEngine().GetType() == MET_Cpu, "the fused attention is supported only on CPU" );
+	CheckLayerArchitecture( !IsBackwardPerformed() && !IsLearningPerformed(),
+		"the fused attention is supported only for inference" );
+
+	const CBlobDesc& query = inputDescs[0];
+	const CBlobDesc& key = inputDescs[1];
+	const CBlobDesc& value = inputDescs[2];
+	const int hiddenSize = query.Channels();
+	CheckLayerArchitecture( hiddenSize % headCount == 0, "hidden size must be a multiple of the head count" );
+	for( int i = 0; i < 3; ++i ) {
+		CheckLayerArchitecture( inputDescs[i].GetDataType() == CT_Float, "inputs must be float" );
+		CheckLayerArchitecture( inputDescs[i].ObjectSize() == hiddenSize, "Q, K and V must have the same channels" );
+	}
+	const int batchSize = query.BatchLength() * query.BatchWidth();
+	CheckLayerArchitecture( key.BatchLength() * key.BatchWidth() == batchSize, "Q and K must have the same batch size" );
+	CheckLayerArchitecture( value.HasEqualDimensions( key ), "K and V must have the same size" );
+
+	if( maxCacheLength > 0 ) {
+		CheckLayerArchitecture( key.ListSize() <= maxCacheLength, "K is longer than the cache" );
+		// The cache is kept while the batch size is the same
+		if( keyCache == nullptr || keyCache->GetBatchWidth() != batchSize || keyCache->GetChannelsCount() != hiddenSize ) {
+			initCache( batchSize, hiddenSize );
+		}
+		// The mask size depends on the cache length and is checked in RunOnce
+	} else {
+		keyCache = nullptr;
+		valueCache = nullptr;
+		cacheLength = 0;
+		if( GetInputCount() == 4 ) {
+			const int maskSize = query.ListSize() * key.ListSize();
+			CheckLayerArchitecture( inputDescs[3].BlobSize() == maskSize
+				|| inputDescs[3].BlobSize() == maskSize * headCount * batchSize,
+				"wrong mask size" );
+		}
+	}
+
+	outputDescs[0] = query;
+}
+
+void CScaledDotProductAttentionLayer::RunOnce()
+{
+	if( maxCacheLength > 0 ) {
+		runWithCache();
+		return;
+	}
+
+	const CBlobDesc& query = inputBlobs[0]->GetDesc();
+	const int batchSize = query.BatchLength() * query.BatchWidth();
+	const int querySize = query.ListSize();
+	const int keySize = inputBlobs[1]->GetListSize();
+	const int headSize = query.Channels() / headCount;
+
+	CConstFloatHandle mask;
+	int maskObjectCount = 0;
+	if( GetInputCount() == 4 ) {
+		mask = inputBlobs[3]->GetData();
+		maskObjectCount = inputBlobs[3]->GetDataSize() / ( querySize * keySize );
+	}
+
+	MathEngine().ScaledDotProductAttention( batchSize, headCount, querySize, keySize, headSize,
+		inputBlobs[0]->GetData(), inputBlobs[1]->GetData(), inputBlobs[2]->GetData(), scale,
+		mask.IsNull() ? nullptr : &mask, maskObjectCount, MaskMultiplier, outputBlobs[0]->GetData() );
+}
+
+void CScaledDotProductAttentionLayer::BackwardOnce()
+{
+	NeoAssert( false );
+}
+
+void CScaledDotProductAttentionLayer::initCache( int batchSize, int hiddenSize )
+{
+	CBlobDesc desc( CT_Float );
+	desc.SetDimSize( BD_BatchWidth, batchSize );
+	desc.SetDimSize( BD_ListSize, maxCacheLength );
+	desc.SetDimSize( BD_Channels, hiddenSize );
+	keyCache = CDnnBlob::CreateBlob( MathEngine(), CT_Float, desc );
+	valueCache = CDnnBlob::CreateBlob( MathEngine(), CT_Float, desc );
+	cacheLength = 0;
+}
+
+// Appends the new elements to the cache; the oldest elements are discarded if there is no place
+void CScaledDotProductAttentionLayer::appendToCache( const CDnnBlob& keys, const CDnnBlob& values )
+{
+	const int batchSize = keyCache->GetBatchWidth();
+	const int hiddenSize = keyCache->GetChannelsCount();
+	const int newLength = keys.GetListSize();
+	NeoAssert( keys.GetBatchLength() * keys.GetBatchWidth() == batchSize );
+	NeoAssert( keys.GetObjectSize() == hiddenSize );
+	NeoAssert( newLength <= maxCacheLength );
+
+	if( cacheLength + newLength > maxCacheLength ) {
+		TrimCache( maxCacheLength - newLength );
+	}
+	for( int b = 0; b < batchSize; ++b ) {
+		const int offset = ( b * maxCacheLength + cacheLength ) * hiddenSize;
+		MathEngine().VectorCopy( keyCache->GetData() + offset, keys.GetData() + b * newLength * hiddenSize,
+			newLength * hiddenSize );
+		MathEngine().VectorCopy( valueCache->GetData() + offset, values.GetData() + b * newLength * hiddenSize,
+			newLength * hiddenSize );
+	}
+	cacheLength += newLength;
+}
+
+// Calculates the attention of the new Q over all the cached K and V
+// The sequences are processed one by one because the cache rows are longer than the filled part
+void CScaledDotProductAttentionLayer::runWithCache()
+{
+	appendToCache( *inputBlobs[1], *inputBlobs[2] );
+
+	const CBlobDesc& query = inputBlobs[0]->GetDesc();
+	const int batchSize = query.BatchLength() * query.BatchWidth();
+	const int querySize = query.ListSize();
+	const int hiddenSize = query.Channels();
+	const int headSize = hiddenSize / headCount;
+
+	const int maskSize = querySize * cacheLength;
+	bool isOneObjectMask = true;
+	if( GetInputCount() == 4 ) {
+		const int maskBlobSize = inputBlobs[3]->GetDataSize();
+		CheckLayerArchitecture( maskBlobSize == maskSize || maskBlobSize == maskSize * headCount * batchSize,
+			"the mask must cover all the cached elements" );
+		isOneObjectMask = maskBlobSize == maskSize;
+	}
+
+	for( int b = 0; b < batchSize; ++b ) {
+		CConstFloatHandle mask;
+		if( GetInputCount() == 4 ) {
+			mask = inputBlobs[3]->GetData() + ( isOneObjectMask ? 0 : b * headCount * maskSize );
+		}
+		const int cacheOffset = b * maxCacheLength * hiddenSize;
+		MathEngine().ScaledDotProductAttention( 1, headCount, querySize, cacheLength, headSize,
+			inputBlobs[0]->GetData() + b * querySize * hiddenSize, keyCache->GetData() + cacheOffset,
+			valueCache->GetData() + cacheOffset, scale, mask.IsNull() ? nullptr : &mask,
+			isOneObjectMask ? 1 : headCount, MaskMultiplier, outputBlobs[0]->GetData() + b * querySize * hiddenSize );
+	}
+}
+
 } // namespace NeoML
@@ -189,14 +189,16 @@ void CTransformerEncoderLayer::Reshape()
 	checkBlob( inputDescs[0], GetPath(), "input data", -1, -1, 1, -1 );
 
 	if( GetInputCount() == 2 ) {
+		// With the cache the mask covers the cached elements too, its size is checked by the attention
+		const int maskChannels = GetMaxCacheLength() > 0 ? -1 : inputDescs[0].ListSize();
 		switch( GetMaskType() ) {
 			case CMultiheadAttentionLayer::MT_OneObject:
 				checkBlob( inputDescs[1], GetPath(), "input mask",
-					1, 1, inputDescs[0].ListSize(), inputDescs[0].ListSize() );
+					1, 1, inputDescs[0].ListSize(), maskChannels );
 				break;
 			case CMultiheadAttentionLayer::MT_Eltwise:
 				checkBlob( inputDescs[1], GetPath(), "input mask",
-					inputDescs[0].BatchWidth(), GetHeadCount(), inputDescs[0].ListSize(), inputDescs[0].ListSize() );
+					inputDescs[0].BatchWidth(), GetHeadCount(), inputDescs[0].ListSize(), maskChannels );
 				break;
 			default:
 				NeoAssert( false );
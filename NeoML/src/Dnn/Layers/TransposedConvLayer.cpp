@@ -104,6 +104,16 @@ void CTransposedConvLayer::LearnOnce()
 	}
 }
 
+// All the stages (forward, backward and learn) perform one convolution of the same size
+double CTransposedConvLayer::EstimateFlops() const
+{
+	double flops = 0;
+	for( int i = 0; i < inputDescs.Size(); ++i ) {
+		flops += 2. * inputDescs[i].BlobSize() * GetFilterHeight() * GetFilterWidth() * GetFilterCount();
+	}
+	return flops;
+}
+
 void CTransposedConvLayer::destroyConvDesc()
 {
 	if( convDesc != 0 ) {
@@ -49,11 +49,9 @@ void CBatchNormFusionOptimizer::Apply( CDnnOptimizationReport& report )
 		CBaseConvLayer* conv = dynamic_cast<CBaseConvLayer*>( nextLayer );
 		CFullyConnectedLayer* fc = dynamic_cast<CFullyConnectedLayer*>( nextLayer );
 		if( conv != nullptr ) {
-			conv->ApplyBatchNormalization( *bn );
-			fused = true;
+			fused = conv->ApplyBatchNormalization( *bn );
 		} else if( fc != nullptr ) {
-			fc->ApplyBatchNormalization( *bn );
-			fused = true;
+			fused = fc->ApplyBatchNormalization( *bn );
 		}
 
 		if( fused ) {
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -19,6 +19,7 @@ limitations under the License.
 #include <NeoML/NeoMLDefs.h>
 #include <NeoML/TraditionalML/Model.h>
 #include <NeoML/TraditionalML/TrainingModel.h>
+#include <ModelBatch.h>
 
 namespace NeoML {
 
@@ -27,8 +28,43 @@ static CMap<const std::type_info*, CString, CDefaultHash<const std::type_info*>,
 
 IModel::~IModel() = default;
 
+bool IModel::ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+	IThreadPool* threadPool ) const
+{
+	results.DeleteAll();
+	results.SetSize( data.Height );
+	// The number of the rows not classified by each thread
+	CArray<int> failedCount;
+	failedCount.Add( 0, threadPool == nullptr ? 1 : threadPool->Size() );
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int threadIndex, int begin, int end ) {
+		for( int i = begin; i < end; i++ ) {
+			if( !Classify( data.GetRow( i ), results[i] ) ) {
+				failedCount[threadIndex]++;
+			}
+		}
+	} );
+
+	for( int count : failedCount ) {
+		if( count != 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
 IRegressionModel::~IRegressionModel() = default;
 
+void IRegressionModel::PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+	IThreadPool* threadPool ) const
+{
+	results.SetSize( data.Height );
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		for( int i = begin; i < end; i++ ) {
+			results[i] = Predict( data.GetRow( i ) );
+		}
+	} );
+}
+
 IMultivariateRegressionModel::~IMultivariateRegressionModel() = default;
 
 ITrainingModel::~ITrainingModel() = default;
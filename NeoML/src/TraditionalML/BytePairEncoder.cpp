@@ -27,6 +27,13 @@ REGISTER_NEOML_MODEL( CBytePairEncoder, BytePairEncoderModelName )
 
 static const CString UnkToken( "<UNK>" );
 
+int CBytePairEncoder::CSymbolPair::HashKey() const
+{
+	int hashKey = CDefaultHash<int>::HashKey( Left );
+	AddToHashKey( CDefaultHash<int>::HashKey( Right ), hashKey );
+	return hashKey;
+}
+
 void CBytePairEncoder::InitializeUnsafe( const CBPEDictionary& _tokens )
 {
 	NeoAssert( !IsInitialized() );
@@ -39,6 +46,7 @@ void CBytePairEncoder::InitializeUnsafe( const CBPEDictionary& _tokens )
 		NeoAssert( !tokenToId.Has( token ) );
 		tokenToId.Add( token, tokenToId.Size() );
 	}
+	buildMergeTable();
 }
 
 void CBytePairEncoder::Decode( const CArray<int>& tokenIds, CArray<CString>& words ) const
@@ -84,6 +92,7 @@ void CBytePairEncoder::Serialize( CArchive& archive )
 		for( int i = 0; i < tokens.Size(); i++ ) {
 			tokenToId.Add( tokens[i], i );
 		}
+		buildMergeTable();
 	}
 }
 
@@ -157,6 +166,68 @@ bool CBytePairEncoder::isValidToken( const CString& token, const CArray<CString>
 	return false;
 }
 
+// Checks if the token may be one of the tokens the word is split into before merging
+bool CBytePairEncoder::isInitialToken( const CString& token ) const
+{
+	if( ( UseStartOfWordToken() && token == params.StartOfWordToken )
+		|| ( UseEndOfWordToken() && token == params.EndOfWordToken ) )
+	{
+		return true;
+	}
+	const int charLength = UseRawBytes() ? 1 : GetUtf8CharLength( token[0] );
+	return charLength == token.Length();
+}
+
+// Fills the table of all the pairs of symbols whose concatenation is a token
+void CBytePairEncoder::buildMergeTable()
+{
+	unknownSymbolToId.DeleteAll();
+	pairToToken.DeleteAll();
+
+	// Gets the id of the symbol that may appear in the word being encoded
+	auto getPartId = [this]( const CString& part ) {
+		int id = NotFound;
+		if( tokenToId.Lookup( part, id ) || unknownSymbolToId.Lookup( part, id ) ) {
+			return id;
+		}
+		// Only the initial tokens may be out of the dictionary, the merged ones are always in it
+		if( !isInitialToken( part ) ) {
+			return NotFound;
+		}
+		id = tokens.Size() + unknownSymbolToId.Size();
+		unknownSymbolToId.Add( part, id );
+		return id;
+	};
+
+	for( int tokenId = 0; tokenId < tokens.Size(); ++tokenId ) {
+		const CString& token = tokens[tokenId];
+		for( int j = 1; j < token.Length(); ++j ) {
+			const int left = getPartId( token.Mid( 0, j ) );
+			if( left == NotFound ) {
+				continue;
+			}
+			const int right = getPartId( token.Mid( j, token.Length() - j ) );
+			if( right != NotFound ) {
+				pairToToken.Add( CSymbolPair( left, right ), tokenId );
+			}
+		}
+	}
+}
+
+// The possible merge of the adjacent symbols of the word
+struct CBpeMergeCandidate {
+	int Token = NotFound; // the merged token id, the less the higher the priority
+	int Left = NotFound; // the position of the left symbol
+	int Right = NotFound; // the position of the right symbol
+	// The merged symbols; the candidate is outdated if either of the symbols has been changed
+	int LeftSymbol = NotFound;
+	int RightSymbol = NotFound;
+
+	// The leftmost of the merges with the same priority is performed first
+	bool operator<( const CBpeMergeCandidate& other ) const
+		{ return Token < other.Token || ( Token == other.Token && Left < other.Left ); }
+};
+
 void CBytePairEncoder::DoEncode( const CString& word, CArray<int>& tokenIds,
 	CArray<int>& tokenLengths ) const
 {
@@ -166,44 +237,82 @@ void CBytePairEncoder::DoEncode( const CString& word, CArray<int>& tokenIds,
 	CArray<int> wordTokenLengths;
 	splitWordIntoInitialTokens( word, wordTokens, &wordTokenLengths );
 
-	while( true ) {
-		int bestPairIndex = getShiftedTokenIndex( tokens.Last() ) + 1;
-		int bestMergePos = NotFound;
-		for( int i = 0; i < wordTokens.Size() - 1; i++ ) {
-			const CString pair = mergeTokens( wordTokens[i], wordTokens[i + 1] );
-			const int pairIndex = getShiftedTokenIndex( pair );
-			if( pairIndex != UnknownTokenId() && pairIndex < bestPairIndex ) {
-				bestPairIndex = pairIndex;
-				bestMergePos = i;
-			}
+	// The symbols are stored in the double-linked list over the initial positions,
+	// the merged symbol takes the position of the left one
+	const int size = wordTokens.Size();
+	CArray<int> symbols;
+	CArray<int> prev;
+	CArray<int> next;
+	symbols.SetSize( size );
+	prev.SetSize( size );
+	next.SetSize( size );
+	for( int i = 0; i < size; i++ ) {
+		symbols[i] = getSymbolId( wordTokens[i] );
+		prev[i] = i - 1;
+		next[i] = i + 1 < size ? i + 1 : NotFound;
+	}
+
+	CPriorityQueue<CArray<CBpeMergeCandidate>, Descending<CBpeMergeCandidate>> queue;
+	queue.SetBufferSize( size );
+	auto addCandidate = [&]( int left, int right ) {
+		CBpeMergeCandidate candidate;
+		if( symbols[left] != NotFound && symbols[right] != NotFound
+			&& pairToToken.Lookup( CSymbolPair( symbols[left], symbols[right] ), candidate.Token ) )
+		{
+			candidate.Left = left;
+			candidate.Right = right;
+			candidate.LeftSymbol = symbols[left];
+			candidate.RightSymbol = symbols[right];
+			queue.Push( candidate );
 		}
+	};
+	for( int i = 0; i < size - 1; i++ ) {
+		addCandidate( i, i + 1 );
+	}
 
-		if( bestMergePos == NotFound ) {
-			break;
+	CBpeMergeCandidate candidate;
+	while( queue.Pop( candidate ) ) {
+		if( next[candidate.Left] != candidate.Right || symbols[candidate.Left] != candidate.LeftSymbol
+			|| symbols[candidate.Right] != candidate.RightSymbol )
+		{
+			continue;
 		}
 
-		wordTokens[bestMergePos] = mergeTokens( wordTokens[bestMergePos],
-			wordTokens[bestMergePos + 1] );
-		wordTokenLengths[bestMergePos] += wordTokenLengths[bestMergePos + 1];
+		symbols[candidate.Left] = candidate.Token;
+		wordTokenLengths[candidate.Left] += wordTokenLengths[candidate.Right];
+		symbols[candidate.Right] = NotFound;
+		next[candidate.Left] = next[candidate.Right];
+		if( next[candidate.Left] != NotFound ) {
+			prev[next[candidate.Left]] = candidate.Left;
+			addCandidate( candidate.Left, next[candidate.Left] );
+		}
+		if( prev[candidate.Left] != NotFound ) {
+			addCandidate( prev[candidate.Left], candidate.Left );
+		}
+	}
 
-		wordTokens.DeleteAt( bestMergePos + 1 );
-		wordTokenLengths.DeleteAt( bestMergePos + 1 );
+	tokenIds.SetBufferSize( tokenIds.Size() + size );
+	for( int i = 0; i != NotFound; i = next[i] ) {
+		tokenIds.Add( getShiftedTokenIndex( symbols[i] ) );
+		tokenLengths.Add( wordTokenLengths[i] );
 	}
+}
 
-	NeoAssert( wordTokens.Size() == wordTokenLengths.Size() );
-	tokenIds.SetBufferSize( tokenIds.Size() + wordTokens.Size() );
-	for( int i = 0; i < wordTokens.Size(); i++ ) {
-		tokenIds.Add( getShiftedTokenIndex( wordTokens[i] ) );
+// Returns the id of the initial symbol.
+int CBytePairEncoder::getSymbolId( const CString& token ) const
+{
+	int symbolId = NotFound;
+	if( tokenToId.Lookup( token, symbolId ) || unknownSymbolToId.Lookup( token, symbolId ) ) {
+		return symbolId;
 	}
-	tokenLengths.Add( wordTokenLengths );
+	return NotFound;
 }
 
 // Returns index of token for encoding.
-int CBytePairEncoder::getShiftedTokenIndex( const CString& token ) const
+int CBytePairEncoder::getShiftedTokenIndex( int symbolId ) const
 {
-	int tokenIndex = NotFound;
-	if( tokenToId.Lookup( token, tokenIndex ) ) {
-		return tokenIndex + UnknownTokenId() + 1;
+	if( 0 <= symbolId && symbolId < tokens.Size() ) {
+		return symbolId + UnknownTokenId() + 1;
 	} else {
 		// Unknown token
 		return UnknownTokenId();
@@ -244,9 +353,4 @@ void CBytePairEncoder::splitWordIntoInitialTokens( const CString& word,
 	}
 }
 
-// Concatenates tokens.
-CString CBytePairEncoder::mergeTokens( const CString& first, const CString& second )
-{
-	return first + second;
-}
 } // namespace NeoML
@@ -56,20 +56,39 @@ protected:
 		CArray<int>& tokenLengths ) const override;
 
 private:
+	// A pair of adjacent symbols of the word being encoded
+	struct CSymbolPair {
+		int Left = NotFound;
+		int Right = NotFound;
+
+		CSymbolPair() = default;
+		CSymbolPair( int left, int right ) : Left( left ), Right( right ) {}
+		int HashKey() const;
+		bool operator==( const CSymbolPair& other ) const { return Left == other.Left && Right == other.Right; }
+	};
+
 	// Index map Id -> Token. Note that the ids are being shifted by UnknownTokenId() + 1 while encoding.
 	CBPEDictionary tokens;
 	// Reverse Map: Token -> Id. It is an unshifted index (matches 'tokens' array).
 	CMap<CString, int> tokenToId;
+	// The initial symbols that are not in the dictionary but may be merged into some token.
+	// Their ids follow the dictionary ids.
+	CMap<CString, int> unknownSymbolToId;
+	// Map: (Left symbol, Right symbol) -> Id of the token equal to their concatenation.
+	// The token id is also the priority of the merge (the less the better).
+	CMap<CSymbolPair, int> pairToToken;
 	// Encoder parameters
 	CParams params;
 	// Lazy-initialized mechanism for Decode() function
 	mutable std::unique_ptr<CSubwordDecoder> decoder;
 
 	bool isValidToken( const CString& token, const CArray<CString>& auxTokens ) const;
-	int getShiftedTokenIndex( const CString& token ) const;
+	bool isInitialToken( const CString& token ) const;
+	void buildMergeTable();
+	int getSymbolId( const CString& token ) const;
+	int getShiftedTokenIndex( int symbolId ) const;
 	void splitWordIntoInitialTokens( const CString& word, 
 		CArray<CString>& initialTokens, CArray<int>* initialTokensLength = nullptr ) const;
-	static CString mergeTokens( const CString& first, const CString& second );
 };
 
 } // namespace NeoML
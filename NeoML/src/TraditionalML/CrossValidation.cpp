@@ -17,14 +17,214 @@ limitations under the License.
 #pragma hdrstop
 
 #include <NeoML/TraditionalML/CrossValidation.h>
-#include <NeoML/TraditionalML/CrossValidationSubProblem.h>
-#include <NeoML/TraditionalML/StratifiedCrossValidationSubProblem.h>
+#include <ModelBatch.h>
+
+#include <memory>
 
 namespace NeoML {
 
+// The split of the data set into parts shared by all the training and testing subsets
+// The vector indices are grouped by parts, so that any part (the testing subset) is a contiguous range
+// The training subsets take the vectors of all the other parts in the same order
+// as CCrossValidationSubProblem and CStratifiedCrossValidationSubProblem do
+class CCrossValidationPartition : public IObject {
+public:
+	CCrossValidationPartition( const IProblem& problem, int partsCount, bool stratified );
+
+	// The range of the part vectors
+	int PartBegin( int partIndex ) const { return partBegin[partIndex]; }
+	int PartSize( int partIndex ) const { return partBegin[partIndex + 1] - partBegin[partIndex]; }
+
+	// The indices in the original data set of the vectors starting from the position
+	const int* GetOriginalIndices( int position ) const { return order.GetPtr() + position; }
+	// The matrix of the vectors in the range
+	CFloatMatrixDesc GetMatrix( int begin, int size );
+	// The original indices of the training subset vectors for the part
+	void GetTrainingIndices( int partIndex, CArray<int>& indices ) const;
+
+	// The original data matrix
+	const CFloatMatrixDesc& GetBaseMatrix() const { return baseMatrix; }
+
+protected:
+	~CCrossValidationPartition() override = default; // delete prohibited
+
+private:
+	CFloatMatrixDesc baseMatrix; // the original data matrix
+	CArray<int> partBegin; // the position of the first vector of each part, with the total vector count at the end
+	CArray<int> order; // the vector indices grouped by parts
+	CArray<int> pointerB; // the vector start pointers in the same order
+	CArray<int> pointerE; // the vector end pointers in the same order
+	CArray<int> trainingOrder; // the vector indices in the order of the training subsets
+	CArray<int> vectorPart; // the part index of each vector
+
+	static void buildParts( const IProblem& problem, bool stratified, CArray<CArray<int>>& parts );
+};
+
+CCrossValidationPartition::CCrossValidationPartition( const IProblem& problem, int partsCount, bool stratified ) :
+	baseMatrix( problem.GetMatrix() )
+{
+	NeoAssert( partsCount > 1 );
+	CArray<CArray<int>> parts;
+	parts.SetSize( partsCount );
+	buildParts( problem, stratified, parts );
+
+	const int vectorCount = problem.GetVectorCount();
+	order.SetBufferSize( vectorCount );
+	vectorPart.SetSize( vectorCount );
+	for( int i = 0; i < parts.Size(); i++ ) {
+		partBegin.Add( order.Size() );
+		order.Add( parts[i] );
+		for( int index : parts[i] ) {
+			vectorPart[index] = i;
+		}
+	}
+	partBegin.Add( order.Size() );
+	NeoAssert( order.Size() == vectorCount );
+
+	if( stratified ) {
+		// The stratified training subsets are grouped by parts
+		order.CopyTo( trainingOrder );
+	} else {
+		// The training subsets keep the original order
+		trainingOrder.SetSize( vectorCount );
+		for( int i = 0; i < vectorCount; i++ ) {
+			trainingOrder[i] = i;
+		}
+	}
+
+	pointerB.SetSize( order.Size() );
+	pointerE.SetSize( order.Size() );
+	for( int i = 0; i < order.Size(); i++ ) {
+		pointerB[i] = baseMatrix.PointerB[order[i]];
+		pointerE[i] = baseMatrix.PointerE[order[i]];
+	}
+}
+
+CFloatMatrixDesc CCrossValidationPartition::GetMatrix( int begin, int size )
+{
+	NeoAssert( 0 <= begin && begin + size <= order.Size() );
+	CFloatMatrixDesc matrix = baseMatrix;
+	matrix.Height = size;
+	matrix.PointerB = pointerB.GetPtr() + begin;
+	matrix.PointerE = pointerE.GetPtr() + begin;
+	return matrix;
+}
+
+void CCrossValidationPartition::GetTrainingIndices( int partIndex, CArray<int>& indices ) const
+{
+	indices.Empty();
+	indices.SetBufferSize( order.Size() - PartSize( partIndex ) );
+	for( int index : trainingOrder ) {
+		if( vectorPart[index] != partIndex ) {
+			indices.Add( index );
+		}
+	}
+}
+
+// Distributes the vectors into the parts
+// The same distribution as in CCrossValidationSubProblem and CStratifiedCrossValidationSubProblem
+void CCrossValidationPartition::buildParts( const IProblem& problem, bool stratified, CArray<CArray<int>>& parts )
+{
+	const int partsCount = parts.Size();
+	if( !stratified ) {
+		for( int i = 0; i < problem.GetVectorCount(); ++i ) {
+			parts[i % partsCount].Add( i );
+		}
+		return;
+	}
+
+	// Once the list for a class is as long as the number of parts, its elements are distributed into the parts
+	CArray<CArray<int>> objectsPerClass;
+	objectsPerClass.SetSize( problem.GetClassCount() );
+	for( int i = 0; i < problem.GetVectorCount(); ++i ) {
+		CArray<int>& classObjects = objectsPerClass[problem.GetClass( i )];
+		classObjects.Add( i );
+		if( classObjects.Size() == partsCount ) {
+			for( int j = 0; j < partsCount; ++j ) {
+				parts[j].Add( classObjects[j] );
+			}
+			classObjects.Empty();
+		}
+	}
+
+	// Distribute the rest of the elements so that no two elements from the same class end up in the same part
+	int currentPartIndex = 0;
+	for( const CArray<int>& classObjects : objectsPerClass ) {
+		for( int object : classObjects ) {
+			parts[currentPartIndex].Add( object );
+			currentPartIndex = ( currentPartIndex + 1 ) % partsCount;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------------------------------
+
+// The training or testing subset of the shared partition
+// The testing subset is a range of the partition, the training subset has its own row pointers
+class CCrossValidationPartProblem : public ISubProblem {
+public:
+	CCrossValidationPartProblem( const IProblem* problem, CCrossValidationPartition* partition,
+		int partIndex, bool testSet );
+
+	// ISubProblem interface methods
+	int GetOriginalIndex( int index ) const override { return originalIndices[index]; }
+
+	// IProblem interface methods
+	int GetClassCount() const override { return problem->GetClassCount(); }
+	int GetFeatureCount() const override { return problem->GetFeatureCount(); }
+	bool IsDiscreteFeature( int index ) const override { return problem->IsDiscreteFeature( index ); }
+	int GetVectorCount() const override { return matrix.Height; }
+	int GetClass( int index ) const override { return problem->GetClass( GetOriginalIndex( index ) ); }
+	CFloatMatrixDesc GetMatrix() const override { return matrix; }
+	double GetVectorWeight( int index ) const override { return problem->GetVectorWeight( GetOriginalIndex( index ) ); }
+	int GetDiscretizationValue( int index ) const override { return problem->GetDiscretizationValue( index ); }
+
+protected:
+	~CCrossValidationPartProblem() override = default; // delete prohibited
+
+private:
+	const CPtr<const IProblem> problem; // the original data
+	const CPtr<CCrossValidationPartition> partition; // the split of the data into parts
+	CArray<int> trainingIndices; // the original indices of the training subset vectors
+	CArray<int> trainingPointerB; // the training subset vector start pointers
+	CArray<int> trainingPointerE; // the training subset vector end pointers
+	const int* originalIndices; // the original indices of the subset vectors
+	CFloatMatrixDesc matrix; // the subset matrix
+};
+
+CCrossValidationPartProblem::CCrossValidationPartProblem( const IProblem* _problem,
+		CCrossValidationPartition* _partition, int partIndex, bool testSet ) :
+	problem( _problem ),
+	partition( _partition ),
+	originalIndices( nullptr )
+{
+	if( testSet ) {
+		originalIndices = partition->GetOriginalIndices( partition->PartBegin( partIndex ) );
+		matrix = partition->GetMatrix( partition->PartBegin( partIndex ), partition->PartSize( partIndex ) );
+		return;
+	}
+
+	partition->GetTrainingIndices( partIndex, trainingIndices );
+	const CFloatMatrixDesc& baseMatrix = partition->GetBaseMatrix();
+	trainingPointerB.SetSize( trainingIndices.Size() );
+	trainingPointerE.SetSize( trainingIndices.Size() );
+	for( int i = 0; i < trainingIndices.Size(); i++ ) {
+		trainingPointerB[i] = baseMatrix.PointerB[trainingIndices[i]];
+		trainingPointerE[i] = baseMatrix.PointerE[trainingIndices[i]];
+	}
+	originalIndices = trainingIndices.GetPtr();
+	matrix = baseMatrix;
+	matrix.Height = trainingIndices.Size();
+	matrix.PointerB = trainingPointerB.GetPtr();
+	matrix.PointerE = trainingPointerE.GetPtr();
+}
+
+//---------------------------------------------------------------------------------------------------------
+
 CCrossValidation::CCrossValidation( ITrainingModel& _trainingModel, const IProblem* _problem ) :
 	trainingModel( _trainingModel ),
-	problem( _problem )
+	problem( _problem ),
+	threadCount( 1 )
 {
 	NeoAssert( problem != 0 );
 }
@@ -34,51 +234,46 @@ void CCrossValidation::Execute( int partsCount, TScore score, CCrossValidationRe
 	NeoAssert( partsCount > 0 );
 	NeoAssert( partsCount < problem->GetVectorCount() / 2 );
 
+	const int vectorCount = problem->GetVectorCount();
 	result.Problem = problem;
 	result.Models.Empty();
+	result.Models.SetSize( partsCount );
 	result.Results.Empty();
-	result.Results.SetSize( problem->GetVectorCount() );
+	result.Results.SetSize( vectorCount );
 	result.ModelIndex.Empty();
-	result.ModelIndex.SetSize( problem->GetVectorCount() );
+	result.ModelIndex.SetSize( vectorCount );
 	result.Success.Empty();
+	result.Success.SetSize( partsCount );
 
-	for( int i = 0; i < partsCount; i++ ) {
-		// Choose the training subset
-		CPtr<ISubProblem> trainSubProblem;
-		if( stratified ) {
-			trainSubProblem = FINE_DEBUG_NEW CStratifiedCrossValidationSubProblem( problem, partsCount, i, false );
-		} else {
-			trainSubProblem = FINE_DEBUG_NEW CCrossValidationSubProblem( problem, partsCount, i, false );
-		}
+	// The parts are found once for all the subsets
+	CPtr<CCrossValidationPartition> partition = FINE_DEBUG_NEW CCrossValidationPartition( *problem,
+		partsCount, stratified );
 
-		// Train the model
+	auto processPart = [&]( int i ) {
+		// The training subset consists of all the other parts
+		CPtr<ISubProblem> trainSubProblem = FINE_DEBUG_NEW CCrossValidationPartProblem( problem, partition, i, false );
 		CPtr<IModel> model = trainingModel.Train( *trainSubProblem );
-		result.Models.Add( model );
-
-		// Choose the testing subset
-		CPtr<ISubProblem> testSubProblem;
-		if( stratified ) {
-			testSubProblem = FINE_DEBUG_NEW CStratifiedCrossValidationSubProblem( problem, partsCount, i, true );
-		} else {
-			testSubProblem = FINE_DEBUG_NEW CCrossValidationSubProblem( problem, partsCount, i, true );
-		}
+		result.Models[i] = model;
 
-		CFloatMatrixDesc testSubProblemMatrix = testSubProblem->GetMatrix();
-		
+		CPtr<ISubProblem> testSubProblem = FINE_DEBUG_NEW CCrossValidationPartProblem( problem, partition, i, true );
 		// Current model classification result to calculate the loss function
 		CArray<CClassificationResult> classificationResults;
-
+		model->ClassifyBatch( testSubProblem->GetMatrix(), classificationResults );
 		for( int j = 0; j < testSubProblem->GetVectorCount(); j++ ) {
-			CFloatVectorDesc vector;
-			testSubProblemMatrix.GetRow( j, vector );
-			model->Classify( vector, result.Results[testSubProblem->GetOriginalIndex( j )] );
-			classificationResults.Add( result.Results[testSubProblem->GetOriginalIndex( j )] );
-
-			result.ModelIndex[testSubProblem->GetOriginalIndex( j )] = i;
+			const int originalIndex = testSubProblem->GetOriginalIndex( j );
+			CClassificationResult& vectorResult = result.Results[originalIndex];
+			vectorResult.PreferredClass = classificationResults[j].PreferredClass;
+			vectorResult.ExceptionProbability = classificationResults[j].ExceptionProbability;
+			classificationResults[j].Probabilities.CopyTo( vectorResult.Probabilities );
+			result.ModelIndex[originalIndex] = i;
 		}
 
-		result.Success.Add( score( classificationResults, testSubProblem ) );
-	}
+		result.Success[i] = score( classificationResults, testSubProblem );
+	};
+
+	// The parts are processed concurrently, each of them on its own thread
+	std::unique_ptr<IThreadPool> threadPool( threadCount != 1 ? CreateThreadPool( threadCount ) : nullptr );
+	ProcessRange( threadPool.get(), partsCount, /*grainSize*/1, processPart );
 }
 
 } // namespace NeoML
@@ -44,6 +44,7 @@ public:
 protected:
 	// The size of parallelization, max number of elements to perform
 	int ParallelizeSize() const override { return Node.VectorSetSize; }
+	bool HasThreadResults() const override { return true; }
 	// Run the process in a separate thread
 	void Run( int threadIndex, int startIndex, int count ) override;
 
@@ -272,6 +273,7 @@ public:
 protected:
 	// The size of parallelization, max number of elements to perform
 	int ParallelizeSize() const override { return UsedFeatures.Size(); }
+	bool HasThreadResults() const override { return true; }
 	// Run the process in a separate thread
 	void Run( int threadIndex, int startIndex, int count ) override;
 
@@ -123,6 +123,7 @@ public:
 protected:
 	// The size of parallelization, max number of elements to perform
 	int ParallelizeSize() const override { return Problem.GetUsedFeatureCount(); }
+	bool HasThreadResults() const override { return true; }
 	// Run the process in a separate thread
 	void Run( int threadIndex, int startIndex, int count ) override;
 
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <GradientBoostModel.h>
 #include <CompactRegressionTree.h>
+#include <ModelBatch.h>
 
 namespace NeoML {
 
@@ -52,6 +53,31 @@ bool CGradientBoostModel::Classify( const CFloatVectorDesc& data, CClassificatio
 	return classify( predictions, result );
 }
 
+bool CGradientBoostModel::ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+	IThreadPool* threadPool ) const
+{
+	results.DeleteAll();
+	results.SetSize( data.Height );
+	const int predictionSize = getPredictionSize();
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		CArray<double> rawPredictions;
+		CFastArray<double, 1> predictions;
+		for( int blockBegin = begin; blockBegin < end; blockBegin += DefaultBatchRowsGrainSize ) {
+			const int blockEnd = min( end, blockBegin + DefaultBatchRowsGrainSize );
+			rawPredictions.SetSize( ( blockEnd - blockBegin ) * predictionSize );
+			predictRaw( data, blockBegin, blockEnd, rawPredictions.GetPtr() );
+			for( int i = blockBegin; i < blockEnd; i++ ) {
+				predictions.SetSize( predictionSize );
+				for( int j = 0; j < predictionSize; j++ ) {
+					predictions[j] = rawPredictions[( i - blockBegin ) * predictionSize + j];
+				}
+				classify( predictions, results[i] );
+			}
+		}
+	} );
+	return true;
+}
+
 void CGradientBoostModel::Serialize( CArchive& archive )
 {
 #ifdef NEOML_USE_FINEOBJ
@@ -243,6 +269,61 @@ double CGradientBoostModel::Predict( const CFloatVectorDesc& data ) const
 	return predictions[0];
 }
 
+void CGradientBoostModel::PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+	IThreadPool* threadPool ) const
+{
+	NeoAssert(ensembles.Size() == 1 && valueSize == 1);
+	results.SetSize( data.Height );
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		for( int blockBegin = begin; blockBegin < end; blockBegin += DefaultBatchRowsGrainSize ) {
+			predictRaw( data, blockBegin, min( end, blockBegin + DefaultBatchRowsGrainSize ),
+				results.GetPtr() + blockBegin );
+		}
+	} );
+}
+
+// Gets the predictions for the [begin, end) rows, getPredictionSize() values for each row
+// Each tree is applied to all the rows before the next one, so that the tree stays in cache
+// The results are the same as PredictRaw gives
+void CGradientBoostModel::predictRaw( const CFloatMatrixDesc& data, int begin, int end, double* predictions ) const
+{
+	const int predictionSize = getPredictionSize();
+	const int rowsCount = end - begin;
+	CArray<CFloatVectorDesc> rows;
+	rows.SetSize( rowsCount );
+	for( int i = 0; i < rowsCount; i++ ) {
+		data.GetRow( begin + i, rows[i] );
+	}
+	for( int i = 0; i < rowsCount * predictionSize; i++ ) {
+		predictions[i] = 0;
+	}
+
+	CRegressionTree::CPrediction pred;
+	for( int ensembleIndex = 0; ensembleIndex < ensembles.Size(); ensembleIndex++ ) {
+		const CGradientBoostEnsemble& ensemble = ensembles[ensembleIndex];
+		for( int treeIndex = 0; treeIndex < ensemble.Size(); treeIndex++ ) {
+			const CRegressionTree* tree = static_cast<const CRegressionTree*>( ensemble[treeIndex].Ptr() );
+			if( valueSize == 1 ) {
+				for( int i = 0; i < rowsCount; i++ ) {
+					predictions[i * predictionSize + ensembleIndex] += tree->Predict( rows[i] );
+				}
+			} else {
+				for( int i = 0; i < rowsCount; i++ ) {
+					tree->Predict( rows[i], pred );
+					NeoPresume( predictionSize == pred.Size() );
+					for( int j = 0; j < predictionSize; j++ ) {
+						predictions[i * predictionSize + j] += pred[j];
+					}
+				}
+			}
+		}
+	}
+
+	for( int i = 0; i < rowsCount * predictionSize; i++ ) {
+		predictions[i] *= learningRate;
+	}
+}
+
 // IMultivariateRegressionModel interface method
 CFloatVector CGradientBoostModel::MultivariatePredict( const CFloatVectorDesc& data ) const
 {
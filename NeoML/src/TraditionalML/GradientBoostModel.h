@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -39,6 +39,8 @@ public:
 	// IModel interface methods
 	int GetClassCount() const override { return ( valueSize == 1 && ensembles.Size() == 1 ) ? 2 : valueSize * ensembles.Size(); }
 	bool Classify( const CFloatVectorDesc& data, CClassificationResult& result ) const override;
+	bool ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+		IThreadPool* threadPool = nullptr ) const override;
 	void Serialize( CArchive& archive ) override;
 
 	// IGradientBoostModel inteface methods
@@ -53,6 +55,8 @@ public:
 
 	// IRegressionModel interface methods
 	double Predict( const CFloatVectorDesc& data ) const override;
+	void PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+		IThreadPool* threadPool = nullptr ) const override;
 
 	// IMultivariateRegressionModel interface methods
 	CFloatVector MultivariatePredict( const CFloatVectorDesc& data ) const override;
@@ -63,6 +67,8 @@ private:
 	CGradientBoost::TLossFunction lossFunction{}; // the loss function to be optimized
 	int valueSize{}; // the value size of each model, if valueSize > 1 then ensemble consists of multiclass trees
 
+	int getPredictionSize() const { return ensembles.Size() > 1 ? ensembles.Size() : valueSize; }
+	void predictRaw( const CFloatMatrixDesc& data, int begin, int end, double* predictions ) const;
 	bool classify( CFastArray<double, 1>& predictions, CClassificationResult& result ) const;
 	double probability( double prediction ) const;
 };
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -15,10 +15,11 @@ limitations under the License.
 
 // QuickScorer implementation. Reference: http://ecmlpkdd2017.ijs.si/papers/paperID718.pdf
 //		  This algorithm speeds up the leaf search in trees trained by gradient boosting.
-//		Speeding up is possible for up to 64 leaves per tree. If a tree has more leaves, 
-//		a subtree with 64 leaves is chosen to be optimized. If a leaf in the optimized subtree is not a leaf in the whole tree 
+//		Speeding up is possible for up to 256 leaves per tree. If a tree has more leaves, 
+//		a subtree with 256 leaves is chosen to be optimized. If a leaf in the optimized subtree is not a leaf in the whole tree 
 //		the search will continue from there using the standard algorithm.
-//		  For each non-leaf node of the subtree the algorithm calculates a 64-bit bit mask, with each bit encoding one of the leaves.
+//		  For each non-leaf node of the subtree the algorithm calculates a bit mask, with each bit encoding one of the leaves.
+//		The mask consists of 1 to 4 64-bit words, the number of words is chosen by the largest optimized subtree of the ensemble.
 //		It puts zeros in the positions where we definitely cannot arrive if this node criterion is not fulfilled and ones in other positions.
 // 		To get the leaf for the vector take all nodes with unfulfilled criteria and calculate bitwise AND for their bit masks. 
 //		The index of the required leaf is the index of the highest nonzero bit in the result.
@@ -28,6 +29,8 @@ limitations under the License.
 //		So we don't need to pass zero feature values to the algorithm because the bit mask does not change anyway. 
 //		For inverted nodes the < operator is changed to >=, so we use two mask sets: for inverted and non-inverted nodes, 
 //		search in both sets and merge the results.
+//		  The batch prediction processes the dense vectors by blocks (see V-QuickScorer, https://doi.org/10.1145/2911451.2914758):
+//		each node is checked for all the vectors of the block at once, which amortizes the nodes traversal.
 
 #include <common.h>
 #pragma hdrstop
@@ -58,6 +61,17 @@ inline static int findLowestBitIndex( unsigned __int64 value )
 #endif
 }
 
+// Returns the lowest nonzero bit index in the mask of wordsCount words, which are placed with the given stride
+inline static int findLowestBitIndex( const unsigned __int64* mask, int wordsCount, int stride )
+{
+	for( int i = 0; i < wordsCount - 1; i++ ) {
+		if( mask[i * stride] != 0 ) {
+			return i * QSMaskWordBits + findLowestBitIndex( mask[i * stride] );
+		}
+	}
+	return ( wordsCount - 1 ) * QSMaskWordBits + findLowestBitIndex( mask[( wordsCount - 1 ) * stride] );
+}
+
 // Finds the nodes that will be used for leaves of the optimized subtree
 inline static void findQsLeaves( const IRegressionTreeNode* root, CHashTable<const IRegressionTreeNode*>& qsLeaves )
 {
@@ -274,9 +288,18 @@ void CGradientBoostQSEnsemble::Build( const CGradientBoostEnsemble &treeModel )
 	const int treeCount = treeModel.Size();
 	treeQsLeavesOffsets.SetSize( treeCount );
 
+	CHashTable<const IRegressionTreeNode*> qsLeavesTable; // the table of optimized subtree leaves
+	// The mask should fit the largest optimized subtree
+	int maxQsLeavesCount = 1;
+	for( int i = 0; i < treeCount; i++ ) {
+		findQsLeaves( CheckCast<const IRegressionTreeNode>( treeModel[i] ), qsLeavesTable );
+		maxQsLeavesCount = max( maxQsLeavesCount, qsLeavesTable.Size() );
+		qsLeavesTable.DeleteAll();
+	}
+	maskWordsCount = ( maxQsLeavesCount + QSMaskWordBits - 1 ) / QSMaskWordBits;
+
 	// Feature indices will be compressed for compact representation
 	CArray<int> features; // the "optimized node -> feature index" mapping
-	CHashTable<const IRegressionTreeNode*> qsLeavesTable; // the table of optimized subtree leaves
 	// For all optimized subtrees fill in lessNodes and moreNodes
 	for( int i = 0; i < treeCount; i++ ) {
 		treeQsLeavesOffsets[i] = qsLeaves.Size();
@@ -289,7 +312,7 @@ void CGradientBoostQSEnsemble::Build( const CGradientBoostEnsemble &treeModel )
 		CGBEnsembleQsSerializer serializer( tree, qsLeavesTable );
 		int startOrder = 0;
 		bool isQsLeaf = false;
-		unsigned __int64 mask = 0;
+		unsigned __int64 mask[MaxQSMaskWordsCount];
 		loadQSNode( serializer, i, startOrder, isQsLeaf, mask, features );
 
 		qsLeavesTable.DeleteAll(); // the table is only for one tree
@@ -302,54 +325,63 @@ void CGradientBoostQSEnsemble::Build( const CGradientBoostEnsemble &treeModel )
 
 double CGradientBoostQSEnsemble::Predict( const CFloatVectorDesc& data ) const
 {
-	// The resulting bit masks, one per tree; for a start all bits are set to 1
-	CFastArray<unsigned __int64, 512> resultBitvectors;
-	resultBitvectors.SetSize( GetTreesCount() );
-	memset( resultBitvectors.GetPtr(), ~0, resultBitvectors.Size() * sizeof( unsigned __int64 ) );
-
-	if( data.Indexes == nullptr ) {
-		for( int i = 0; i < data.Size; i++ ) {
-			processFeature( i, data.Values[i], resultBitvectors );
-		}
-	} else {
-		for( int i = 0; i < data.Size; i++ ) {
-			processFeature( data.Indexes[i], data.Values[i], resultBitvectors );
-		}
-	}
-
-	return calculateScore( data, resultBitvectors, GetTreesCount() - 1 );
+	return predict( data, GetTreesCount() - 1 );
 }
 
 double CGradientBoostQSEnsemble::Predict( const CFloatVectorDesc& data, int lastTreeIndex ) const
 {
-	CFastArray<unsigned __int64, 512> resultBitvectors;
-	resultBitvectors.SetSize( GetTreesCount() );
-	memset( resultBitvectors.GetPtr(), ~0, resultBitvectors.Size() * sizeof( unsigned __int64 ) );
+	return predict( data, lastTreeIndex );
+}
 
-	if( data.Indexes == nullptr ) {
-		for( int i = 0; i < data.Size; i++ ) {
-			processFeature( i, data.Values[i], resultBitvectors );
-		}
-	} else {
-		for( int i = 0; i < data.Size; i++ ) {
-			processFeature( data.Indexes[i], data.Values[i], resultBitvectors );
+void CGradientBoostQSEnsemble::Predict( const CFloatMatrixDesc& data, CArray<double>& results ) const
+{
+	results.SetSize( data.Height );
+	if( data.Columns != nullptr ) {
+		// The sparse vectors have different sets of features, process them one by one
+		for( int i = 0; i < data.Height; i++ ) {
+			results[i] = predict( data.GetRow( i ), GetTreesCount() - 1 );
 		}
+		return;
 	}
 
-	return calculateScore( data, resultBitvectors, lastTreeIndex );
+	// The bit masks for the block of vectors: the jth word of the mask of the kth vector for the ith tree
+	// is stored at ( i * maskWordsCount + j ) * QSBatchSize + k
+	CArray<unsigned __int64> bitvectors;
+	bitvectors.SetSize( GetTreesCount() * maskWordsCount * QSBatchSize );
+	for( int firstRow = 0; firstRow < data.Height; firstRow += QSBatchSize ) {
+		const int rowsCount = min( QSBatchSize, data.Height - firstRow );
+		switch( maskWordsCount ) {
+			case 1:
+				predictBatch<1>( data, firstRow, rowsCount, bitvectors.GetPtr(), results.GetPtr() + firstRow );
+				break;
+			case 2:
+				predictBatch<2>( data, firstRow, rowsCount, bitvectors.GetPtr(), results.GetPtr() + firstRow );
+				break;
+			case 3:
+				predictBatch<3>( data, firstRow, rowsCount, bitvectors.GetPtr(), results.GetPtr() + firstRow );
+				break;
+			case 4:
+				predictBatch<4>( data, firstRow, rowsCount, bitvectors.GetPtr(), results.GetPtr() + firstRow );
+				break;
+			default:
+				NeoAssert( false );
+		}
+	}
 }
 
+static const int GradientBoostQSEnsembleVersion = 1;
+
 CArchive& operator<<( CArchive& archive, const CGradientBoostQSEnsemble& block )
 {
-	archive.SerializeVersion( 0 );
+	archive.SerializeVersion( GradientBoostQSEnsembleVersion );
 	block.store( archive );
 	return archive;
 }
 
 CArchive& operator>>( CArchive& archive, CGradientBoostQSEnsemble& block )
 {
-	archive.SerializeVersion( 0 );
-	block.load( archive );
+	const int version = archive.SerializeVersion( GradientBoostQSEnsembleVersion );
+	block.load( archive, version );
 	return archive;
 }
 
@@ -392,6 +424,7 @@ void CGradientBoostQSEnsemble::store( CArchive& archive ) const
 	archive << qsLeaves.Size();
 	archive << treeQsLeavesOffsets.Size();
 	archive << simpleNodes.Size();
+	archive << maskWordsCount;
 
 	CArray<int> features;
 	buildNodesFeatures( features );
@@ -515,7 +548,7 @@ void CGradientBoostQSEnsemble::buildNodesFeatures( CArray<int>& features ) const
 }
 
 // Reads a tree ensemble from archive
-void CGradientBoostQSEnsemble::load( CArchive& archive )
+void CGradientBoostQSEnsemble::load( CArchive& archive, int version )
 {
 	int qsNodesSize = 0;
 	archive >> qsNodesSize;
@@ -537,6 +570,13 @@ void CGradientBoostQSEnsemble::load( CArchive& archive )
 	archive >> simpleNodesSize;
 	simpleNodes.SetBufferSize( simpleNodesSize );
 
+	maskWordsCount = 1;
+	if( version >= 1 ) {
+		archive >> maskWordsCount;
+		check( 0 < maskWordsCount && maskWordsCount <= MaxQSMaskWordsCount, ERR_BAD_ARCHIVE, archive.Name() );
+	}
+	qsMasks.SetBufferSize( qsNodesSize * maskWordsCount );
+
 	CArchiveQsSerializer serializer( archive, simpleNodesSize == 0 );
 
 	// Feature indices can be compressed for more compact representation
@@ -547,7 +587,7 @@ void CGradientBoostQSEnsemble::load( CArchive& archive )
 
 		int startOrder = 0;
 		bool isQsLeaf = false;
-		unsigned __int64 mask = 0;
+		unsigned __int64 mask[MaxQSMaskWordsCount];
 		loadQSNode( serializer, i, startOrder, isQsLeaf, mask, features );
 		features.Add( NotFound ); // so that treeQsLeavesOffsets[i] points to features as well (while there are one more leaves than features)
 	}
@@ -557,25 +597,26 @@ void CGradientBoostQSEnsemble::load( CArchive& archive )
 }
 
 // Reads from archive a node in the optimized subtree
+// The mask should have maskWordsCount words
 void CGradientBoostQSEnsemble::loadQSNode( IQsSerializer& serializer, int tree,
-	int& order, bool& isQsLeaf, unsigned __int64& mask, CArray<int>& features )
+	int& order, bool& isQsLeaf, unsigned __int64* mask, CArray<int>& features )
 {
 	int featureIndex = NotFound;
 	float threshold = 0;
 	isQsLeaf = false;
 	serializer.Read( featureIndex, threshold, isQsLeaf );
 
-	mask = 0;
 	if( !isQsLeaf ) {
 		// The current node is to be optimized
-		qsNodes.Add( CQSNode( 0, threshold, tree, order, 0 ) );
+		qsNodes.Add( CQSNode( threshold, tree, order, 0 ) );
 		const int index = qsNodes.Size() - 1;
+		qsMasks.Add( 0, maskWordsCount );
 		features.Add( featureIndex );
 		order++;
 
-		unsigned __int64 leftMask = 0;
+		unsigned __int64 leftMask[MaxQSMaskWordsCount];
 		bool leftIsQsLeaf = false;
-		unsigned __int64 rightMask = 0;
+		unsigned __int64 rightMask[MaxQSMaskWordsCount];
 		bool rightIsQsLeaf = false;
 		if( threshold < 0 ) {
 			loadQSNode( serializer, tree, order, rightIsQsLeaf, rightMask, features );
@@ -584,20 +625,27 @@ void CGradientBoostQSEnsemble::loadQSNode( IQsSerializer& serializer, int tree,
 			loadQSNode( serializer, tree, order, leftIsQsLeaf, leftMask, features );
 			loadQSNode( serializer, tree, order, rightIsQsLeaf, rightMask, features );
 		}
-		mask = leftMask & rightMask; 
-
 		// The zero values should be in the left subtree, otherwise invert the node
+		const unsigned __int64* nodeMask = threshold < 0 ? rightMask : leftMask;
+		for( int i = 0; i < maskWordsCount; i++ ) {
+			mask[i] = leftMask[i] & rightMask[i];
+			qsMasks[index * maskWordsCount + i] = nodeMask[i];
+		}
+
 		unsigned char propertiesMask = 0;
 		propertiesMask |= ( threshold < 0 ? PM_Inverted : 0 );
 		propertiesMask |= ( leftIsQsLeaf ? PM_LeftLeaf : 0 );
 		propertiesMask |= ( rightIsQsLeaf ? PM_RightLeaf : 0 );
-		qsNodes[index].Mask = threshold < 0 ? rightMask : leftMask;
 		qsNodes[index].PropertiesMask = propertiesMask;
 	} else {
 		// The leaf node
 		// The leaves are numbered left to right; when computing the score find the lowest nonzero bit index
 		const int leafIndex = qsLeaves.Size() - treeQsLeavesOffsets[tree];
-		mask = ~( static_cast<unsigned __int64>(1) << leafIndex );
+		NeoAssert( leafIndex < maskWordsCount * QSMaskWordBits );
+		for( int i = 0; i < maskWordsCount; i++ ) {
+			mask[i] = ~static_cast<unsigned __int64>( 0 );
+		}
+		mask[leafIndex / QSMaskWordBits] = ~( static_cast<unsigned __int64>( 1 ) << ( leafIndex % QSMaskWordBits ) );
 
 		loadQSLeaf( serializer, featureIndex, threshold );
 	}
@@ -640,25 +688,30 @@ void CGradientBoostQSEnsemble::loadSimpleSubtree( IQsSerializer& serializer, int
 // Used for generating the order optimal for classification
 class CQSNodeAscending {
 public:
-	CQSNodeAscending( const CArray<int>& _features, const CArray<int>& _treeOffsets );
+	CQSNodeAscending( const CArray<CQSNode>& _nodes, const CArray<int>& _features, const CArray<int>& _treeOffsets );
 
-	bool Predicate( const CQSNode& first, const CQSNode& second ) const;
-	bool IsEqual( const CQSNode& first, const CQSNode& second ) const;
-	void Swap( CQSNode& first, CQSNode& second ) const { swap<CQSNode>( first, second ); }
+	bool Predicate( const int& first, const int& second ) const;
+	bool IsEqual( const int& first, const int& second ) const;
+	void Swap( int& first, int& second ) const { swap<int>( first, second ); }
 
 private:
+	const CArray<CQSNode>& nodes;
 	const CArray<int>& features;
 	const CArray<int>& treeOffsets;
 };
 
-inline CQSNodeAscending::CQSNodeAscending( const CArray<int>& _features, const CArray<int>& _treeOffsets ) :
+inline CQSNodeAscending::CQSNodeAscending( const CArray<CQSNode>& _nodes, const CArray<int>& _features,
+		const CArray<int>& _treeOffsets ) :
+	nodes( _nodes ),
 	features( _features ),
 	treeOffsets( _treeOffsets )
 {
 }
 
-inline bool CQSNodeAscending::Predicate( const CQSNode& first, const CQSNode& second ) const
+inline bool CQSNodeAscending::Predicate( const int& firstIndex, const int& secondIndex ) const
 {
+	const CQSNode& first = nodes[firstIndex];
+	const CQSNode& second = nodes[secondIndex];
 	const bool firstIsInverted = HasFlag( first.PropertiesMask, PM_Inverted );
 	const bool secondIsInverted = HasFlag( second.PropertiesMask, PM_Inverted );
 	if( firstIsInverted != secondIsInverted ) {
@@ -677,8 +730,10 @@ inline bool CQSNodeAscending::Predicate( const CQSNode& first, const CQSNode& se
 	return ( second.Threshold < first.Threshold );
 }
 
-inline bool CQSNodeAscending::IsEqual( const CQSNode& first, const CQSNode& second ) const
+inline bool CQSNodeAscending::IsEqual( const int& firstIndex, const int& secondIndex ) const
 {
+	const CQSNode& first = nodes[firstIndex];
+	const CQSNode& second = nodes[secondIndex];
 	return ( HasFlag( first.PropertiesMask, PM_Inverted ) == HasFlag( second.PropertiesMask, PM_Inverted ) )
 		&& ( features[treeOffsets[first.Tree] + first.Order] == features[treeOffsets[second.Tree] + second.Order] )
 		&& ( first.Threshold == second.Threshold );
@@ -688,8 +743,27 @@ inline bool CQSNodeAscending::IsEqual( const CQSNode& first, const CQSNode& seco
 void CGradientBoostQSEnsemble::buildFeatureNodesOffsets( const CArray<int>& features )
 {
 	// Sort the non-leaf nodes by features and split thresholds
-	CQSNodeAscending comparator( features, treeQsLeavesOffsets );
-	qsNodes.QuickSort<CQSNodeAscending>( &comparator );
+	CArray<int> links;
+	links.SetBufferSize( qsNodes.Size() );
+	for( int i = 0; i < qsNodes.Size(); i++ ) {
+		links.Add( i );
+	}
+	CQSNodeAscending comparator( qsNodes, features, treeQsLeavesOffsets );
+	links.QuickSort<CQSNodeAscending>( &comparator );
+
+	// Reorder the nodes and their masks
+	CArray<CQSNode> sortedNodes;
+	sortedNodes.SetBufferSize( qsNodes.Size() );
+	CArray<unsigned __int64> sortedMasks;
+	sortedMasks.SetBufferSize( qsMasks.Size() );
+	for( int i = 0; i < links.Size(); i++ ) {
+		sortedNodes.Add( qsNodes[links[i]] );
+		for( int j = 0; j < maskWordsCount; j++ ) {
+			sortedMasks.Add( qsMasks[links[i] * maskWordsCount + j] );
+		}
+	}
+	sortedNodes.MoveTo( qsNodes );
+	sortedMasks.MoveTo( qsMasks );
 
 	featureQsNodesOffsets.Empty();
 	for( int i = 0; i < qsNodes.Size(); i++ ) {
@@ -709,12 +783,44 @@ void CGradientBoostQSEnsemble::buildFeatureNodesOffsets( const CArray<int>& feat
 	}
 }
 
+// Calculates the prediction for one vector
+double CGradientBoostQSEnsemble::predict( const CFloatVectorDesc& data, int lastTreeIndex ) const
+{
+	// The resulting bit masks, maskWordsCount words per tree; for a start all bits are set to 1
+	CFastArray<unsigned __int64, 512> resultBitvectors;
+	resultBitvectors.SetSize( GetTreesCount() * maskWordsCount );
+	memset( resultBitvectors.GetPtr(), ~0, resultBitvectors.Size() * sizeof( unsigned __int64 ) );
+
+	for( int i = 0; i < data.Size; i++ ) {
+		const int featureIndex = data.Indexes == nullptr ? i : data.Indexes[i];
+		switch( maskWordsCount ) {
+			case 1:
+				processFeature<1>( featureIndex, data.Values[i], resultBitvectors.GetPtr() );
+				break;
+			case 2:
+				processFeature<2>( featureIndex, data.Values[i], resultBitvectors.GetPtr() );
+				break;
+			case 3:
+				processFeature<3>( featureIndex, data.Values[i], resultBitvectors.GetPtr() );
+				break;
+			case 4:
+				processFeature<4>( featureIndex, data.Values[i], resultBitvectors.GetPtr() );
+				break;
+			default:
+				NeoAssert( false );
+		}
+	}
+
+	return calculateScore( data, resultBitvectors.GetPtr(), 1, lastTreeIndex );
+}
+
 // Mask computation
 // From the start, all bitvectors elements are filled with ones. 
 // Traverse all nodes that use the given feature; if the condition is not fulfilled, 
 // calculate bitwise AND of the current bitvector with the node mask. 
 // Once the condition is fulfilled, stop because all the rest will be fulfilled also.
-void CGradientBoostQSEnsemble::processFeature( int featureIndex, float value, CFastArray<unsigned __int64, 512>& bitvectors ) const
+template<int MaskWordsCount>
+void CGradientBoostQSEnsemble::processFeature( int featureIndex, float value, unsigned __int64* bitvectors ) const
 {
 	CQSNodeOffset offset;
 	if( !featureQsNodesOffsets.Lookup( featureIndex, offset ) ) {
@@ -723,16 +829,85 @@ void CGradientBoostQSEnsemble::processFeature( int featureIndex, float value, CF
 
 	if( offset.Less.Begin != NotFound ) {
 		for( int i = offset.Less.Begin; i <= offset.Less.End && qsNodes[i].Threshold < value; i++ ) {
-			const CQSNode& node = qsNodes[i];
-			bitvectors[node.Tree] &= node.Mask;
+			unsigned __int64* bitvector = bitvectors + qsNodes[i].Tree * MaskWordsCount;
+			const unsigned __int64* mask = qsMasks.GetPtr() + i * MaskWordsCount;
+			for( int j = 0; j < MaskWordsCount; j++ ) {
+				bitvector[j] &= mask[j];
+			}
 		}
 	}
 
 	if( offset.More.Begin != NotFound ) {
 		for( int i = offset.More.Begin; i <= offset.More.End && qsNodes[i].Threshold >= value; i++ ) {
-			const CQSNode& node = qsNodes[i];
-			bitvectors[node.Tree] &= node.Mask;
+			unsigned __int64* bitvector = bitvectors + qsNodes[i].Tree * MaskWordsCount;
+			const unsigned __int64* mask = qsMasks.GetPtr() + i * MaskWordsCount;
+			for( int j = 0; j < MaskWordsCount; j++ ) {
+				bitvector[j] &= mask[j];
+			}
+		}
+	}
+}
+
+// Calculates the predictions for the block of rowsCount <= QSBatchSize dense vectors
+// The same as processFeature for each vector, but each node is checked for all the vectors of the block,
+// and the traversal of the feature nodes stops only when the condition is fulfilled for all the vectors
+template<int MaskWordsCount>
+void CGradientBoostQSEnsemble::predictBatch( const CFloatMatrixDesc& data, int firstRow, int rowsCount,
+	unsigned __int64* bitvectors, double* results ) const
+{
+	NeoPresume( data.Columns == nullptr );
+	NeoPresume( rowsCount <= QSBatchSize );
+	memset( bitvectors, ~0, GetTreesCount() * MaskWordsCount * QSBatchSize * sizeof( unsigned __int64 ) );
+
+	float values[QSBatchSize];
+	for( int pos = featureQsNodesOffsets.GetFirstPosition(); pos != NotFound;
+		pos = featureQsNodesOffsets.GetNextPosition( pos ) )
+	{
+		const int featureIndex = featureQsNodesOffsets.GetKey( pos );
+		if( featureIndex >= data.Width ) {
+			continue; // the zero value does not change the masks
+		}
+		// The missing rows of the last block and the values beyond the row length are treated as zeros
+		float minValue = 0;
+		float maxValue = 0;
+		for( int k = 0; k < QSBatchSize; k++ ) {
+			values[k] = k < rowsCount && featureIndex < data.PointerE[firstRow + k] - data.PointerB[firstRow + k]
+				? data.Values[data.PointerB[firstRow + k] + featureIndex] : 0.f;
+			minValue = min( minValue, values[k] );
+			maxValue = max( maxValue, values[k] );
 		}
+
+		const CQSNodeOffset& offset = featureQsNodesOffsets.GetValue( pos );
+		if( offset.Less.Begin != NotFound ) {
+			for( int i = offset.Less.Begin; i <= offset.Less.End && qsNodes[i].Threshold < maxValue; i++ ) {
+				const float threshold = qsNodes[i].Threshold;
+				unsigned __int64* bitvector = bitvectors + qsNodes[i].Tree * MaskWordsCount * QSBatchSize;
+				const unsigned __int64* mask = qsMasks.GetPtr() + i * MaskWordsCount;
+				for( int j = 0; j < MaskWordsCount; j++ ) {
+					// Branchless so that the loop over the block could be vectorized
+					for( int k = 0; k < QSBatchSize; k++ ) {
+						bitvector[j * QSBatchSize + k] &= threshold < values[k] ? mask[j] : ~static_cast<unsigned __int64>( 0 );
+					}
+				}
+			}
+		}
+
+		if( offset.More.Begin != NotFound ) {
+			for( int i = offset.More.Begin; i <= offset.More.End && qsNodes[i].Threshold >= minValue; i++ ) {
+				const float threshold = qsNodes[i].Threshold;
+				unsigned __int64* bitvector = bitvectors + qsNodes[i].Tree * MaskWordsCount * QSBatchSize;
+				const unsigned __int64* mask = qsMasks.GetPtr() + i * MaskWordsCount;
+				for( int j = 0; j < MaskWordsCount; j++ ) {
+					for( int k = 0; k < QSBatchSize; k++ ) {
+						bitvector[j * QSBatchSize + k] &= threshold >= values[k] ? mask[j] : ~static_cast<unsigned __int64>( 0 );
+					}
+				}
+			}
+		}
+	}
+
+	for( int k = 0; k < rowsCount; k++ ) {
+		results[k] = calculateScore( data.GetRow( firstRow + k ), bitvectors + k, QSBatchSize, GetTreesCount() - 1 );
 	}
 }
 
@@ -747,13 +922,15 @@ static inline float getFeatureValue( const CFloatVectorDesc& data, int index )
 // The leaves are numbered left to right (all masks are inverted), so look for the lowest nonzero bit
 // In each bitvector the leaf we need has the index of the lowest nonzero
 // If it is a leaf in the original tree, take its value, if a subtree call its Predict method
-double CGradientBoostQSEnsemble::calculateScore( const CFloatVectorDesc& data, const CFastArray<unsigned __int64, 512>& bitvectors, int lastTreeIndex ) const
+// The words of the vector bit masks are placed with the given stride
+double CGradientBoostQSEnsemble::calculateScore( const CFloatVectorDesc& data, const unsigned __int64* bitvectors,
+	int stride, int lastTreeIndex ) const
 {
 	float score = 0.0;
 	int prev = -1;
 	const int end = min( lastTreeIndex, GetTreesCount() - 1 );
 	for( int i = 0; i <= end; i++ ) {
-		const int leafIndex = findLowestBitIndex( bitvectors[i] );
+		const int leafIndex = findLowestBitIndex( bitvectors + i * maskWordsCount * stride, maskWordsCount, stride );
 		const int currentTreeOffset = treeQsLeavesOffsets[i];
 		NeoAssert( prev != currentTreeOffset );
 		prev = currentTreeOffset;
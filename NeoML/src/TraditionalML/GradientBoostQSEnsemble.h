@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -19,29 +19,32 @@ limitations under the License.
 
 namespace NeoML {
 
-const int MaxQSLeavesCount = 64; // maximum number of leaves in a subtree that can be optimized
+const int MaxQSLeavesCount = 256; // maximum number of leaves in a subtree that can be optimized
+const int QSMaskWordBits = 64; // the number of bits in one word of a leaves mask
+const int MaxQSMaskWordsCount = MaxQSLeavesCount / QSMaskWordBits; // maximum number of words in a leaves mask
 const int MaxTreesCount = 32767; // maximum supported number of trees in an ensemble
+const int QSBatchSize = 16; // the number of vectors processed together by the batch prediction
 
 const unsigned char PM_Inverted = 1; // the node is inverted
 const unsigned char PM_LeftLeaf = 2; // the left child is a leaf in the optimized subtree
 const unsigned char PM_RightLeaf = 4; // the right child is a leaf in the optimized subtree
 
 // The descriptor of an non-leaf node of the subtree to be optimized
+// The false nodes mask of the node (has zeros in the positions where the vector cannot possibly belong 
+// if the node criterion is false) is stored separately, see CGradientBoostQSEnsemble::qsMasks
 struct CQSNode final {
-	unsigned __int64 Mask; // the false nodes mask: has zeros in the positions where the vector cannot possibly belong if the node criterion is false
 	float Threshold; // split threshold
 	short Tree; // the index of the tree in the ensemble
-	char Order; // the order of depth first traversal
+	unsigned char Order; // the order of depth first traversal
 	unsigned char PropertiesMask; // the node properties (inverted or not, is either of the children a leaf in the optimized subtree)
 
-	CQSNode( unsigned __int64 mask, float threshold, int tree, int order, unsigned char propertiesMask );
+	CQSNode( float threshold, int tree, int order, unsigned char propertiesMask );
 };
 
-inline CQSNode::CQSNode( unsigned __int64 mask, float threshold, int tree, int order, unsigned char propertiesMask ) :
-	Mask( mask ),
+inline CQSNode::CQSNode( float threshold, int tree, int order, unsigned char propertiesMask ) :
 	Threshold( threshold ),
 	Tree( static_cast<short>( tree ) ),
-	Order( static_cast<char>( order ) ),
+	Order( static_cast<unsigned char>( order ) ),
 	PropertiesMask( propertiesMask )
 {
 	NeoAssert( tree <= MaxTreesCount );
@@ -96,6 +99,9 @@ public:
 	// The prediction method that uses only the trees in the 0 to lastTreeIndex range
 	double Predict( const CFloatVectorDesc& data, int lastTreeIndex ) const;
 
+	// Predicts all the matrix rows; the dense matrices are processed by blocks of QSBatchSize rows
+	void Predict( const CFloatMatrixDesc& data, CArray<double>& results ) const;
+
 	// Gets the number of trees in the ensemble
 	int GetTreesCount() const { return treeQsLeavesOffsets.Size(); }
 
@@ -107,6 +113,10 @@ private:
 	// Optimized nodes descriptions, sorted by splitting feature
 	// The nodes that use ith feature are in the ranges featureQsNodesOffsets[i].Less and featureQsNodesOffsets[i].More
 	CArray<CQSNode> qsNodes{};
+	// The false nodes masks of the optimized nodes: maskWordsCount words for each node in qsNodes
+	// The ith leaf of a subtree corresponds to the (i % 64) bit of the (i / 64) word
+	CArray<unsigned __int64> qsMasks{};
+	int maskWordsCount = 1; // the number of words in a mask, enough for the largest optimized subtree
 	CMap<int, CQSNodeOffset> featureQsNodesOffsets{}; // offsets to optimized nodes that use the same feature
 	 // Optimized subtree leaves descriptions, sorted by subtree
 	CArray<CQSLeaf> qsLeaves{}; // the leaves of the i subtree start from treeQsLeavesOffsets[i] index
@@ -120,15 +130,21 @@ private:
 	void storeSimpleNode( IQsSerializer& serializer, int index ) const;
 	void buildNodesFeatures( CArray<int>& features ) const;
 
-	void load( CArchive& archive );
+	void load( CArchive& archive, int version );
 	void loadQSNode( IQsSerializer& serializer, int treeId,
-		int& orderId, bool& isQsLeaf, unsigned __int64& mask, CArray<int>& features );
+		int& orderId, bool& isQsLeaf, unsigned __int64* mask, CArray<int>& features );
 	void loadQSLeaf( IQsSerializer& serializer, int featureIndex, float threshold );
 	void loadSimpleSubtree( IQsSerializer& serializer, int featureIndex, float threshold );
 	void buildFeatureNodesOffsets( const CArray<int>& features );
 
-	void processFeature( int feature, float value, CFastArray<unsigned __int64, 512>& bitvectors ) const;
-	double calculateScore( const CFloatVectorDesc& data, const CFastArray<unsigned __int64, 512>& bitvectors, int lastTreeIndex ) const;
+	double predict( const CFloatVectorDesc& data, int lastTreeIndex ) const;
+	template<int MaskWordsCount>
+	void processFeature( int feature, float value, unsigned __int64* bitvectors ) const;
+	template<int MaskWordsCount>
+	void predictBatch( const CFloatMatrixDesc& data, int firstRow, int rowsCount,
+		unsigned __int64* bitvectors, double* results ) const;
+	double calculateScore( const CFloatVectorDesc& data, const unsigned __int64* bitvectors, int stride,
+		int lastTreeIndex ) const;
 };
 
 } // namespace NeoML
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <NeoML/TraditionalML/GradientBoostQuickScorer.h>
 #include <GradientBoostQSEnsemble.h>
+#include <ModelBatch.h>
 
 namespace NeoML {
 
@@ -60,10 +61,16 @@ public:
 	// IGradientBoostQSModel interface methods
 	bool ClassifyEx( const CSparseFloatVector& data, CArray<CClassificationResult>& results ) const override;
 	bool ClassifyEx( const CFloatVectorDesc& data, CArray<CClassificationResult>& results ) const override;
+	bool ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+		IThreadPool* threadPool = nullptr ) const override;
 
 	// IRegressionModel interface method
 	double Predict( const CFloatVectorDesc& data ) const override;
 
+	// IGradientBoostQSRegressionModel interface method
+	void PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+		IThreadPool* threadPool = nullptr ) const override;
+
 	// General methods
 	double GetLearningRate() const override { return learningRate; };
 	void Serialize( CArchive& archive ) override;
@@ -76,6 +83,8 @@ private:
 	bool classify( double prediction, CClassificationResult& result ) const;
 	bool classify( CArray<double>& predictions, CClassificationResult& result ) const;
 	double probability( double prediction ) const;
+	static void predictBatch( const CGradientBoostQSEnsemble& ensemble, const CFloatMatrixDesc& data,
+		CArray<double>& results, IThreadPool* threadPool );
 };
 
 REGISTER_NEOML_MODEL( CGradientBoostQSModel, GradientBoostQSModelName )
@@ -118,6 +127,54 @@ bool CGradientBoostQSModel::Classify( const CFloatVectorDesc& data, CClassificat
 	return classify( predictions, result );
 }
 
+void CGradientBoostQSModel::PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+	IThreadPool* threadPool ) const
+{
+	predictBatch( *ensembles.First(), data, results, threadPool );
+	for( int i = 0; i < results.Size(); i++ ) {
+		results[i] *= learningRate;
+	}
+}
+
+bool CGradientBoostQSModel::ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+	IThreadPool* threadPool ) const
+{
+	NeoAssert( !ensembles.IsEmpty() );
+
+	results.DeleteAll();
+	results.SetSize( data.Height );
+
+	if( GetClassCount() == 2 ) {
+		CArray<double> values;
+		PredictBatch( data, values, threadPool );
+		for( int i = 0; i < data.Height; i++ ) {
+			classify( values[i], results[i] );
+		}
+		return true;
+	}
+
+	// The predictions of all the ensembles for the ith row start from i * ensembles.Size()
+	CArray<double> allPredictions;
+	allPredictions.SetSize( data.Height * ensembles.Size() );
+	CArray<double> ensemblePredictions;
+	for( int ensembleIndex = 0; ensembleIndex < ensembles.Size(); ensembleIndex++ ) {
+		predictBatch( *ensembles[ensembleIndex], data, ensemblePredictions, threadPool );
+		for( int i = 0; i < data.Height; i++ ) {
+			allPredictions[i * ensembles.Size() + ensembleIndex] = ensemblePredictions[i];
+		}
+	}
+
+	CArray<double> predictions;
+	predictions.SetSize( ensembles.Size() );
+	for( int i = 0; i < data.Height; i++ ) {
+		for( int ensembleIndex = 0; ensembleIndex < ensembles.Size(); ensembleIndex++ ) {
+			predictions[ensembleIndex] = allPredictions[i * ensembles.Size() + ensembleIndex];
+		}
+		classify( predictions, results[i] );
+	}
+	return true;
+}
+
 bool CGradientBoostQSModel::ClassifyEx( const CSparseFloatVector& data, CArray<CClassificationResult>& results ) const
 {
 	return ClassifyEx( data.GetDesc(), results );
@@ -203,6 +260,21 @@ bool CGradientBoostQSModel::classify( CArray<double>& predictions, CClassificati
 	return true;
 }
 
+// Gets the ensemble predictions for all the matrix rows
+// The rows are split among the threads by the ranges of several QuickScorer blocks
+void CGradientBoostQSModel::predictBatch( const CGradientBoostQSEnsemble& ensemble, const CFloatMatrixDesc& data,
+	CArray<double>& results, IThreadPool* threadPool )
+{
+	results.SetSize( data.Height );
+	ProcessBatchRows( threadPool, data.Height, 4 * QSBatchSize, [&]( int, int begin, int end ) {
+		CArray<double> rangeResults;
+		ensemble.Predict( GetMatrixRows( data, begin, end ), rangeResults );
+		for( int i = begin; i < end; i++ ) {
+			results[i] = rangeResults[i - begin];
+		}
+	} );
+}
+
 // Calculates probability from prediction
 double CGradientBoostQSModel::probability( double prediction ) const
 {
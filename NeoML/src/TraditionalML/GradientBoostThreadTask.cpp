@@ -28,6 +28,13 @@ void IGradientBoostThreadTask::ParallelRun()
 		Run( /*threadIndex*/0, /*index*/0, ParallelizeSize() );
 		return;
 	}
+	if( !HasThreadResults() ) {
+		// The elements are processed independently, so the idle threads may take the work of the busy ones
+		ThreadPool.ParallelFor( ParallelizeSize(), /*grainSize*/0, []( int threadIndex, int begin, int end, void* ptr ) {
+			( ( IGradientBoostThreadTask* )ptr )->Run( threadIndex, begin, end - begin );
+		}, this );
+		return;
+	}
 	// Run in parallel
 	NEOML_NUM_THREADS( ThreadPool, this, []( int threadIndex, void* ptr ) {
 		( ( IGradientBoostThreadTask* )ptr )->RunSplittedByThreads( threadIndex );
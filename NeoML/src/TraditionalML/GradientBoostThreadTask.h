@@ -35,6 +35,10 @@ protected:
 	virtual void Run( int threadIndex, int startIndex, int count ) = 0;
 	// The size of parallelization, max number of elements to perform
 	virtual int ParallelizeSize() const = 0;
+	// Whether the task accumulates the results per thread (merged after the run)
+	// Such a task is split among the threads statically to get reproducible results,
+	// otherwise the elements are distributed among the threads dynamically
+	virtual bool HasThreadResults() const { return false; }
 
 	static constexpr int MultiThreadMinTasksCount = 2;
 	IThreadPool& ThreadPool; // Executors
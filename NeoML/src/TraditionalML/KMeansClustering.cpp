@@ -508,6 +508,169 @@ void CKMeansUpdateULBoundsThreadTask::RunOnElement( int threadIndex, int index )
 
 //-------------------------------------------------------------------------------------------------------------
 
+// Calculates half of the distance from every cluster center to the closest center of another cluster
+struct CKMeansClosestClusterThreadTask : public IKMeansThreadSubTask {
+	CKMeansClosestClusterThreadTask( IThreadPool& threadPool, const CObjectArray<CCommonCluster>& clusters,
+			TDistanceFunc distanceFunc, CArray<float>& closestClusterDist ) :
+		IKMeansThreadSubTask( threadPool, clusters.Size() ),
+		Clusters( clusters ),
+		DistanceFunc( distanceFunc ),
+		ClosestClusterDist( closestClusterDist )
+	{ NeoAssert( ClosestClusterDist.Size() == Clusters.Size() ); }
+
+protected:
+	bool TryRunOneThread() override { /*empty*/ return false; }
+	void RunOnElement( int threadIndex, int index ) override;
+	void Reduction() override { /*empty*/ }
+
+	const CObjectArray<CCommonCluster>& Clusters;
+	const TDistanceFunc DistanceFunc;
+	CArray<float>& ClosestClusterDist;
+};
+
+void CKMeansClosestClusterThreadTask::RunOnElement( int /*threadIndex*/, int index )
+{
+	float closestDist = FLT_MAX;
+	for( int c = 0; c < Clusters.Size(); ++c ) {
+		if( c != index ) {
+			const float dist = static_cast<float>( sqrt( Clusters[index]->CalcDistance( *Clusters[c], DistanceFunc ) ) );
+			closestDist = min( 0.5f * dist, closestDist );
+		}
+	}
+	ClosestClusterDist[index] = closestDist;
+}
+
+//-------------------------------------------------------------------------------------------------------------
+
+// Reassigns the elements by using Hamerly algorithm
+// Only one lower bound (of the distance to the second closest cluster) is stored for every element
+struct CKMeansHamerlyAssignThreadTask : public IKMeansThreadSubTask {
+	CKMeansHamerlyAssignThreadTask( IThreadPool& threadPool, const CFloatMatrixDesc& matrix,
+		const CKMeansClustering::CParam& params, const CObjectArray<CCommonCluster>& clusters );
+
+	// Element assignments (objectCount)
+	CArray<int> Assignments{};
+	// Distances bounds
+	CArray<float> UpperBounds{}; // upper bounds of the distance to the assigned cluster (objectCount)
+	CArray<float> LowerBounds{}; // lower bounds of the distance to the second closest cluster (objectCount)
+
+	// Half of the distance to the closest center of another cluster (clusterCount)
+	CArray<float> ClosestClusterDist{};
+	// Distances between old and updated centers of each cluster (clusterCount)
+	CArray<float> MoveDistance{};
+
+	const CObjectArray<CCommonCluster>& Clusters;
+	const TDistanceFunc DistanceFunc;
+
+protected:
+	bool TryRunOneThread() override { /*empty*/ return false; }
+	void RunOnElement( int threadIndex, int index ) override;
+	void Reduction() override { /*empty*/ }
+};
+
+// Initializes all required statistics for Hamerly algorithm
+CKMeansHamerlyAssignThreadTask::CKMeansHamerlyAssignThreadTask( IThreadPool& threadPool, const CFloatMatrixDesc& matrix,
+		const CKMeansClustering::CParam& params, const CObjectArray<CCommonCluster>& clusters ) :
+	IKMeansThreadSubTask( threadPool, &matrix ),
+	Clusters( clusters ),
+	DistanceFunc( params.DistanceFunc )
+{
+	Assignments.Add( 0, Matrix->Height );
+	UpperBounds.Add( FLT_MAX, Matrix->Height );
+	LowerBounds.Add( 0.f, Matrix->Height );
+	ClosestClusterDist.Add( FLT_MAX, params.InitialClustersCount );
+	MoveDistance.Add( 0.f, params.InitialClustersCount );
+}
+
+void CKMeansHamerlyAssignThreadTask::RunOnElement( int /*threadIndex*/, int index )
+{
+	const int assigned = Assignments[index];
+	const float bound = max( ClosestClusterDist[assigned], LowerBounds[index] );
+	if( UpperBounds[index] <= bound ) {
+		return;
+	}
+	// Tighten the upper bound and check again
+	const CFloatVectorDesc rowDesc = Matrix->GetRow( index );
+	UpperBounds[index] = static_cast<float>( sqrt( Clusters[assigned]->CalcDistance( rowDesc, DistanceFunc ) ) );
+	if( UpperBounds[index] <= bound ) {
+		return;
+	}
+
+	// Find the closest and the second closest clusters
+	int closest = assigned;
+	float closestDist = UpperBounds[index];
+	float secondClosestDist = FLT_MAX;
+	for( int c = 0; c < Clusters.Size(); ++c ) {
+		if( c == assigned ) {
+			continue;
+		}
+		const float dist = static_cast<float>( sqrt( Clusters[c]->CalcDistance( rowDesc, DistanceFunc ) ) );
+		if( dist < closestDist ) {
+			secondClosestDist = closestDist;
+			closestDist = dist;
+			closest = c;
+		} else if( dist < secondClosestDist ) {
+			secondClosestDist = dist;
+		}
+	}
+	Assignments[index] = closest;
+	UpperBounds[index] = closestDist;
+	LowerBounds[index] = secondClosestDist;
+}
+
+//-------------------------------------------------------------------------------------------------------------
+
+// Updates the bounds of Hamerly algorithm after the centers have moved and calculates the inertia
+struct CKMeansHamerlyUpdateBoundsThreadTask : public IKMeansThreadSubTask {
+	CKMeansHamerlyUpdateBoundsThreadTask( IThreadPool& threadPool, const CFloatMatrixDesc& matrix,
+		CKMeansHamerlyAssignThreadTask& assigns );
+
+	double Inertia = 0;
+protected:
+	void RunOnElement( int threadIndex, int index ) override;
+	bool TryRunOneThread() override { /*empty*/ return false; }
+	void Reduction() override { Inertia = ThreadInertia.GetSum(); }
+
+	CKMeansHamerlyAssignThreadTask& Assigns;
+	CKMeansInertia ThreadInertia;
+	// The cluster which has moved the most and its move distance
+	int MaxMoveCluster = NotFound;
+	float MaxMove = 0;
+	// The largest move distance among the other clusters
+	float SecondMaxMove = 0;
+};
+
+CKMeansHamerlyUpdateBoundsThreadTask::CKMeansHamerlyUpdateBoundsThreadTask( IThreadPool& threadPool,
+		const CFloatMatrixDesc& matrix, CKMeansHamerlyAssignThreadTask& assigns ) :
+	IKMeansThreadSubTask( threadPool, &matrix ),
+	Assigns( assigns ),
+	ThreadInertia( ThreadCount() )
+{
+	for( int c = 0; c < Assigns.MoveDistance.Size(); ++c ) {
+		const float move = Assigns.MoveDistance[c];
+		if( MaxMoveCluster == NotFound || move > MaxMove ) {
+			SecondMaxMove = MaxMove;
+			MaxMove = move;
+			MaxMoveCluster = c;
+		} else if( move > SecondMaxMove ) {
+			SecondMaxMove = move;
+		}
+	}
+}
+
+void CKMeansHamerlyUpdateBoundsThreadTask::RunOnElement( int threadIndex, int index )
+{
+	const int c = Assigns.Assignments[index];
+	Assigns.UpperBounds[index] += Assigns.MoveDistance[c];
+	// The second closest cluster may be any of the others
+	const float otherMove = ( c == MaxMoveCluster ) ? SecondMaxMove : MaxMove;
+	Assigns.LowerBounds[index] = max( Assigns.LowerBounds[index] - otherMove, 0.f );
+	const auto rowDesc = Matrix->GetRow( index );
+	ThreadInertia.Get( threadIndex ) += Assigns.Clusters[c]->CalcDistance( rowDesc, Assigns.DistanceFunc );
+}
+
+//-------------------------------------------------------------------------------------------------------------
+
 struct IKMeansMathEngineThreadTask : public IKMeansThreadTask {
 	static constexpr int FloatTaskAlignment = 16;
 	// Create a task 1D or 2D
@@ -811,6 +974,11 @@ bool CKMeansClustering::runClusterization( IClusteringData* input, int seed, CCl
 		*log << "\nK-means clustering started:\n";
 	}
 
+	// Mini-batch algorithm reads only the sampled rows (uses MathEngine)
+	if( params.Algo == KMA_MiniBatch ) {
+		return miniBatchClusterize( input, seed, result, inertia );
+	}
+
 	// Specific optimized case (uses MathEngine)
 	if( matrix.Columns == nullptr && params.DistanceFunc == DF_Euclid && params.Algo == KMA_Lloyd ) {
 		return denseLloydL2Clusterize( input, seed, result, inertia );
@@ -878,12 +1046,14 @@ bool CKMeansClustering::denseLloydL2Clusterize( IClusteringData* rawData, int se
 	CPtr<CDnnBlob> sizes = CDnnBlob::CreateVector( *mathEngine, CT_Float, clusterCount ); // no threads
 	CPtr<CDnnBlob> labels = CDnnBlob::CreateVector( *mathEngine, CT_Int, vectorCount ); // no threads
 
-	static_assert( KMA_Count == 2, "KMA_Count != 2" );
+	static_assert( KMA_Count == 4, "KMA_Count != 4" );
 	switch( params.Algo ) {
 		case KMA_Lloyd:
 			success = lloydBlobClusterization( *data, *weight, *centers, *sizes, *labels, inertia );
 			break;
 		case KMA_Elkan:
+		case KMA_Hamerly:
+		case KMA_MiniBatch:
 			// Only Lloyd algorithm is supported for dense data
 		default:
 			NeoAssert( false );
@@ -1031,11 +1201,20 @@ void CKMeansClustering::kMeansPlusPlusInitialization( const CFloatMatrixDesc& ma
 
 bool CKMeansClustering::clusterize( const CFloatMatrixDesc& matrix, const CArray<double>& weights, double& inertia )
 {
-	if( params.Algo == KMA_Lloyd ) {
-		return lloydClusterization( matrix, weights, inertia );
-	} else {
-		return elkanClusterization( matrix, weights, inertia );
+	static_assert( KMA_Count == 4, "KMA_Count != 4" );
+	switch( params.Algo ) {
+		case KMA_Lloyd:
+			return lloydClusterization( matrix, weights, inertia );
+		case KMA_Elkan:
+			return elkanClusterization( matrix, weights, inertia );
+		case KMA_Hamerly:
+			return hamerlyClusterization( matrix, weights, inertia );
+		case KMA_MiniBatch:
+			// Mini-batch algorithm is processed separately
+		default:
+			NeoAssert( false );
 	}
+	return false;
 }
 
 bool CKMeansClustering::lloydClusterization( const CFloatMatrixDesc& matrix, const CArray<double>& weights, double& inertia )
@@ -1099,6 +1278,40 @@ bool CKMeansClustering::elkanClusterization( const CFloatMatrixDesc& matrix, con
 	return false;
 }
 
+bool CKMeansClustering::hamerlyClusterization( const CFloatMatrixDesc& matrix, const CArray<double>& weights, double& inertia )
+{
+	// Metric must support triangle inequality
+	NeoAssert( params.DistanceFunc == DF_Euclid );
+
+	CKMeansHamerlyAssignThreadTask assignVectorsTask( *threadPool, matrix, params, clusters );
+	double lastResidual = DBL_MAX;
+	for( int i = 0; i < params.MaxIterations; ++i ) {
+		// Calculate closest cluster distances (the pairwise distances aren't stored)
+		CKMeansClosestClusterThreadTask( *threadPool, clusters, params.DistanceFunc,
+			assignVectorsTask.ClosestClusterDist ).ParallelRun();
+		// Reassign vectors
+		assignVectorsTask.ParallelRun();
+		// Recalculate centers
+		CKMeansUpdateClustersThreadTask updateClustersTask( *threadPool, matrix, clusters, weights, assignVectorsTask.Assignments );
+		updateClustersTask.ParallelRun();
+		// Update move distances
+		updateMoveDistance( updateClustersTask.OldCenters, assignVectorsTask.MoveDistance );
+		// Update bounds based on move distance
+		CKMeansHamerlyUpdateBoundsThreadTask updateBoundsTask( *threadPool, matrix, assignVectorsTask );
+		updateBoundsTask.ParallelRun();
+		inertia = updateBoundsTask.Inertia;
+		// Check stop criteria
+		if( abs( inertia - lastResidual ) <= params.Tolerance ) {
+			return true;
+		}
+		lastResidual = inertia;
+		if( log != 0 ) {
+			*log << L"Step " << i << L" Inertia: " << inertia << L"\n";
+		}
+	}
+	return false;
+}
+
 void CKMeansClustering::computeClustersDists( CVariableMatrix<float>& dists, CArray<float>& closestCluster ) const
 {
 	for( int i = 0; i < clusters.Size(); ++i ) {
@@ -1415,4 +1628,262 @@ void CKMeansClustering::calcClusterVariances( const CDnnBlob& data, const CDnnBl
 	}
 }
 
+//-------------------------------------------------------------------------------------------------------------
+
+// Writes the row of the dense or sparse matrix into the dense buffer
+static void copyMatrixRow( const CFloatMatrixDesc& matrix, int row, float* buffer )
+{
+	const CFloatVectorDesc desc = matrix.GetRow( row );
+	if( desc.Indexes == nullptr ) {
+		::memcpy( buffer, desc.Values, desc.Size * sizeof( float ) );
+		::memset( buffer + desc.Size, 0, ( matrix.Width - desc.Size ) * sizeof( float ) );
+	} else {
+		::memset( buffer, 0, matrix.Width * sizeof( float ) );
+		for( int i = 0; i < desc.Size; ++i ) {
+			buffer[desc.Indexes[i]] = desc.Values[i];
+		}
+	}
+}
+
+// Creates the dense blob from the given rows of the matrix, the buffer keeps the copy of the blob data
+static CPtr<CDnnBlob> createRowsBlob( IMathEngine& mathEngine, const CFloatMatrixDesc& matrix, const CArray<int>& rows,
+	CArray<float>& buffer )
+{
+	buffer.SetSize( rows.Size() * matrix.Width );
+	for( int i = 0; i < rows.Size(); ++i ) {
+		copyMatrixRow( matrix, rows[i], buffer.GetPtr() + i * matrix.Width );
+	}
+	CPtr<CDnnBlob> result = CDnnBlob::CreateDataBlob( mathEngine, CT_Float, 1, rows.Size(), matrix.Width ); // no threads
+	result->CopyFrom( buffer.GetPtr() );
+	return result;
+}
+
+// Clusterizes the data by using mini-batch algorithm
+// Only the sampled rows are copied into the blobs, so the memory doesn't depend on the data size
+bool CKMeansClustering::miniBatchClusterize( IClusteringData* rawData, int seed, CClusteringResult& result, double& inertia )
+{
+	NeoAssert( params.DistanceFunc == DF_Euclid );
+	NeoAssert( params.Algo == KMA_MiniBatch );
+	NeoAssert( params.MiniBatchSize > 0 );
+	NeoAssert( rawData->GetVectorCount() >= params.InitialClustersCount );
+
+	std::unique_ptr<IMathEngine> mathEngine( CreateCpuMathEngine( /*memoryLimit*/0u ) );
+	CPtr<CDnnBlob> centers = CDnnBlob::CreateDataBlob( *mathEngine, CT_Float, 1, params.InitialClustersCount,
+		rawData->GetFeaturesCount() ); // no threads
+
+	selectMiniBatchInitialClusters( rawData->GetMatrix(), seed, *centers );
+	const bool success = miniBatchClusterization( *rawData, seed, *centers );
+	inertia = miniBatchAssignAll( *rawData, *centers, result );
+
+	if( log != 0 ) {
+		if( success ) {
+			*log << "\nSuccessful!\n";
+		} else {
+			*log << "\nNeed more iterations!\n";
+		}
+	}
+	return success;
+}
+
+// Selects initial centers from the random sample of the data
+void CKMeansClustering::selectMiniBatchInitialClusters( const CFloatMatrixDesc& matrix, int seed, CDnnBlob& centers )
+{
+	const int vectorCount = matrix.Height;
+	const int sampleSize = min( vectorCount, 3 * max( params.MiniBatchSize, params.InitialClustersCount ) );
+
+	CArray<int> rows;
+	if( 2 * sampleSize > vectorCount ) {
+		rows.SetSize( vectorCount );
+		for( int i = 0; i < vectorCount; ++i ) {
+			rows[i] = i;
+		}
+	} else {
+		CRandom random( seed );
+		CHashTable<int> usedRows;
+		while( rows.Size() < sampleSize ) {
+			const int row = random.UniformInt( 0, vectorCount - 1 );
+			if( !usedRows.Has( row ) ) {
+				usedRows.Add( row );
+				rows.Add( row );
+			}
+		}
+		// Read the rows in the order of the data
+		rows.QuickSort<Ascending<int>>();
+	}
+
+	CArray<float> buffer;
+	CPtr<CDnnBlob> sample = createRowsBlob( centers.GetMathEngine(), matrix, rows, buffer );
+	selectInitialClusters( *sample, seed, centers );
+}
+
+// Updates the centers on the random batches, every center has its own learning rate
+// which is inversely proportional to the total weight of the elements assigned to it
+bool CKMeansClustering::miniBatchClusterization( const IClusteringData& rawData, int seed, CDnnBlob& centers )
+{
+	IMathEngine& mathEngine = centers.GetMathEngine();
+	const CFloatMatrixDesc matrix = rawData.GetMatrix();
+	const int vectorCount = matrix.Height;
+	const int featureCount = matrix.Width;
+	const int clusterCount = centers.GetObjectCount();
+	const int batchSize = min( params.MiniBatchSize, vectorCount );
+
+	CPtr<CDnnBlob> squaredBatch = CDnnBlob::CreateVector( mathEngine, CT_Float, batchSize ); // no threads
+	CPtr<CDnnBlob> closestDist = CDnnBlob::CreateVector( mathEngine, CT_Float, batchSize ); // no threads
+	CPtr<CDnnBlob> labels = CDnnBlob::CreateVector( mathEngine, CT_Int, batchSize ); // no threads
+	CFloatHandle closestDistHandle = closestDist->GetData();
+	CIntHandle labelsHandle = labels->GetData<int>();
+
+	CArray<float> centerValues;
+	centerValues.SetSize( centers.GetDataSize() );
+	centers.CopyTo( centerValues.GetPtr() );
+	CArray<float> prevCenterValues;
+	// The total weight of the elements assigned to each center
+	CArray<double> clusterWeights;
+	clusterWeights.Add( 0., clusterCount );
+
+	CArray<int> rows;
+	rows.SetSize( batchSize );
+	CArray<float> batchValues;
+	CArray<int> batchLabels;
+	batchLabels.SetSize( batchSize );
+
+	CRandom random( seed );
+	for( int iter = 0; iter < params.MaxIterations; ++iter ) {
+		for( int i = 0; i < batchSize; ++i ) {
+			rows[i] = random.UniformInt( 0, vectorCount - 1 );
+		}
+		CPtr<CDnnBlob> batch = createRowsBlob( mathEngine, matrix, rows, batchValues );
+
+		// Assign the batch to the closest centers
+		mathEngine.RowMultiplyMatrixByMatrix( batch->GetData(), batch->GetData(), batchSize, featureCount, // no threads
+			squaredBatch->GetData() );
+		calcClosestDistances( *threadPool, *batch, *squaredBatch, centers, closestDistHandle, labelsHandle );
+		labels->CopyTo( batchLabels.GetPtr() );
+
+		// Move the centers towards the assigned elements
+		centerValues.CopyTo( prevCenterValues );
+		for( int i = 0; i < batchSize; ++i ) {
+			const double weight = rawData.GetVectorWeight( rows[i] );
+			if( weight <= 0 ) {
+				continue;
+			}
+			const int c = batchLabels[i];
+			clusterWeights[c] += weight;
+			const float rate = static_cast<float>( weight / clusterWeights[c] );
+			float* center = centerValues.GetPtr() + c * featureCount;
+			const float* vector = batchValues.GetPtr() + i * featureCount;
+			for( int j = 0; j < featureCount; ++j ) {
+				center[j] += rate * ( vector[j] - center[j] );
+			}
+		}
+		centers.CopyFrom( centerValues.GetPtr() );
+
+		double squaredMove = 0;
+		for( int i = 0; i < centerValues.Size(); ++i ) {
+			const double diff = centerValues[i] - prevCenterValues[i];
+			squaredMove += diff * diff;
+		}
+		if( log != 0 ) {
+			*log << L"Step " << iter << L" Centers move: " << squaredMove << L"\n";
+		}
+		// Check stop criteria
+		if( squaredMove <= params.Tolerance ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Assigns every element to its closest center processing the data batch by batch
+// Fills the result and returns the inertia
+double CKMeansClustering::miniBatchAssignAll( const IClusteringData& rawData, const CDnnBlob& centers,
+	CClusteringResult& result )
+{
+	IMathEngine& mathEngine = centers.GetMathEngine();
+	const CFloatMatrixDesc matrix = rawData.GetMatrix();
+	const int vectorCount = matrix.Height;
+	const int featureCount = matrix.Width;
+	const int clusterCount = centers.GetObjectCount();
+	const int batchSize = min( params.MiniBatchSize, vectorCount );
+
+	result.ClusterCount = clusterCount;
+	result.Data.SetSize( vectorCount );
+
+	double inertia = 0;
+	CArray<double> clusterWeights;
+	clusterWeights.Add( 0., clusterCount );
+	CArray<int> clusterSizes;
+	clusterSizes.Add( 0, clusterCount );
+	// The sums of the squared deviations from the centers
+	CArray<double> sumOfSquares;
+	sumOfSquares.Add( 0., clusterCount * featureCount );
+
+	CArray<float> centerValues;
+	centerValues.SetSize( centers.GetDataSize() );
+	centers.CopyTo( centerValues.GetPtr() );
+
+	CArray<int> rows;
+	CArray<float> batchValues;
+	CArray<float> batchDists;
+	for( int batchStart = 0; batchStart < vectorCount; batchStart += batchSize ) {
+		const int rowCount = min( batchSize, vectorCount - batchStart );
+		rows.SetSize( rowCount );
+		for( int i = 0; i < rowCount; ++i ) {
+			rows[i] = batchStart + i;
+		}
+		CPtr<CDnnBlob> batch = createRowsBlob( mathEngine, matrix, rows, batchValues );
+		CPtr<CDnnBlob> squaredBatch = CDnnBlob::CreateVector( mathEngine, CT_Float, rowCount ); // no threads
+		CPtr<CDnnBlob> closestDist = CDnnBlob::CreateVector( mathEngine, CT_Float, rowCount ); // no threads
+		CPtr<CDnnBlob> labels = CDnnBlob::CreateVector( mathEngine, CT_Int, rowCount ); // no threads
+		mathEngine.RowMultiplyMatrixByMatrix( batch->GetData(), batch->GetData(), rowCount, featureCount, // no threads
+			squaredBatch->GetData() );
+		CFloatHandle closestDistHandle = closestDist->GetData();
+		CIntHandle labelsHandle = labels->GetData<int>();
+		calcClosestDistances( *threadPool, *batch, *squaredBatch, centers, closestDistHandle, labelsHandle );
+
+		labels->CopyTo( result.Data.GetPtr() + batchStart );
+		batchDists.SetSize( rowCount );
+		closestDist->CopyTo( batchDists.GetPtr() );
+
+		// Collect the statistics for the variances
+		for( int i = 0; i < rowCount; ++i ) {
+			const int c = result.Data[batchStart + i];
+			const double weight = rawData.GetVectorWeight( batchStart + i );
+			inertia += weight * batchDists[i];
+			clusterWeights[c] += weight;
+			clusterSizes[c]++;
+			const float* vector = batchValues.GetPtr() + i * featureCount;
+			const float* center = centerValues.GetPtr() + c * featureCount;
+			double* squares = sumOfSquares.GetPtr() + c * featureCount;
+			for( int j = 0; j < featureCount; ++j ) {
+				const double diff = vector[j] - center[j];
+				squares[j] += diff * diff;
+			}
+		}
+	}
+
+	result.Clusters.SetBufferSize( clusterCount );
+	for( int c = 0; c < clusterCount; ++c ) {
+		CFloatVector mean( featureCount );
+		CFloatVector variance( featureCount );
+		const float* center = centerValues.GetPtr() + c * featureCount;
+		const double* squares = sumOfSquares.GetPtr() + c * featureCount;
+		// The empty clusters have zero variance
+		const double sizeInv = clusterSizes[c] > 0 ? 1. / clusterSizes[c] : 0.;
+		float* meanPtr = mean.CopyOnWrite();
+		float* variancePtr = variance.CopyOnWrite();
+		for( int j = 0; j < featureCount; ++j ) {
+			meanPtr[j] = center[j];
+			variancePtr[j] = static_cast<float>( squares[j] * sizeInv );
+		}
+
+		CClusterCenter& currentCenter = result.Clusters.Append();
+		currentCenter.Mean = mean;
+		currentCenter.Disp = variance;
+		currentCenter.Norm = DotProduct( currentCenter.Mean, currentCenter.Mean );
+		currentCenter.Weight = clusterWeights[c];
+	}
+	return inertia;
+}
+
 } // namespace NeoML
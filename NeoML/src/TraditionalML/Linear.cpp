@@ -23,6 +23,8 @@ limitations under the License.
 #include <LinearBinaryModel.h>
 #include <NeoML/TraditionalML/PlattScalling.h>
 
+#include <memory>
+
 namespace NeoML {
 
 ILinearBinaryModel::~ILinearBinaryModel() = default;
@@ -76,29 +78,24 @@ static CFunctionWithHessian* createOptimizedFunction( const CLinear::CParams& pa
 
 CLinear::CLinear( const CParams& _params ) :
 	params( _params ),
-	log( 0 ),
-	function( 0 )
+	log( 0 )
 {
 }
 
 CLinear::~CLinear()
 {
-	if( function != 0 ) {
-		delete function;
-	}
 }
 
 CPtr<IRegressionModel> CLinear::TrainRegression( const IRegressionProblem& problem )
 {
-	if( function != 0 ) {
-		delete function; // delete the old loss function
-	}
 	const double errorWeight = params.NormalizeError ? normalizeErrorWeight( params, problem ) : params.ErrorWeight;
 	NeoAssert( params.Function == EF_L2_Regression );
-	function = FINE_DEBUG_NEW CL2Regression( problem, errorWeight, 1e-6, params.L1Coeff, params.ThreadCount );
+	// The loss function is local, so that the different problems may be trained concurrently
+	std::unique_ptr<CFunctionWithHessian> function( FINE_DEBUG_NEW CL2Regression( problem, errorWeight, 1e-6,
+		params.L1Coeff, params.ThreadCount ) );
 	const double tolerance = max( 1e-6, params.Tolerance );
 
-	CTrustRegionNewtonOptimizer optimizer( function, tolerance, params.MaxIterations );
+	CTrustRegionNewtonOptimizer optimizer( function.get(), tolerance, params.MaxIterations );
 	CFloatVector initialPlane( problem.GetFeatureCount() + 1 );
 	initialPlane.Nullify();
 	optimizer.SetInitialArgument( initialPlane );
@@ -125,10 +122,8 @@ CPtr<IModel> CLinear::Train( const IProblem& trainingClassificationData )
 		return nullptr;
 	}
 
-	if( function != 0 ) {
-		delete function; // delete the old loss function
-	}
-	function = createOptimizedFunction( params, trainingClassificationData );
+	// The loss function is local, so that the different problems may be trained concurrently
+	std::unique_ptr<CFunctionWithHessian> function( createOptimizedFunction( params, trainingClassificationData ) );
 	const int vectorsCount = trainingClassificationData.GetVectorCount();
 
 	double tolerance = 0;
@@ -146,7 +141,7 @@ CPtr<IModel> CLinear::Train( const IProblem& trainingClassificationData )
 		tolerance = 0.01 * max( min(positiveCount, vectorsCount  - positiveCount), 1 ) / vectorsCount;
 	}
 
-	CTrustRegionNewtonOptimizer optimizer( function, tolerance, params.MaxIterations );
+	CTrustRegionNewtonOptimizer optimizer( function.get(), tolerance, params.MaxIterations );
 	CFloatVector initialPlane( trainingClassificationData.GetFeatureCount() + 1 );
 	initialPlane.Nullify();
 	optimizer.SetInitialArgument( initialPlane );
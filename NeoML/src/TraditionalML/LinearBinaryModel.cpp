@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -17,6 +17,7 @@ limitations under the License.
 #pragma hdrstop
 
 #include <LinearBinaryModel.h>
+#include <ModelBatch.h>
 
 namespace NeoML {
 
@@ -36,6 +37,22 @@ bool CLinearBinaryModel::Classify( const CFloatVectorDesc& data, CClassification
 	return classify( distance, result );
 }
 
+bool CLinearBinaryModel::ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+	IThreadPool* threadPool ) const
+{
+	results.DeleteAll();
+	results.SetSize( data.Height );
+	CArray<double> distances;
+	distances.SetSize( data.Height );
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		calculateDistances( data, begin, end, distances.GetPtr() + begin );
+		for( int i = begin; i < end; i++ ) {
+			classify( distances[i], results[i] );
+		}
+	} );
+	return true;
+}
+
 // Calculates classification result from the distance to the separating plane
 bool CLinearBinaryModel::classify( double distance, CClassificationResult& result ) const
 {
@@ -75,4 +92,53 @@ double CLinearBinaryModel::Predict( const CFloatVectorDesc& data ) const
 	return LinearFunction( plane, data );
 }
 
+void CLinearBinaryModel::PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+	IThreadPool* threadPool ) const
+{
+	results.SetSize( data.Height );
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		calculateDistances( data, begin, end, results.GetPtr() + begin );
+	} );
+}
+
+// Calculates the distances to the separating plane for the [begin, end) rows
+// The dense rows are processed by four at once so that each plane element is loaded once for all of them
+// The results are the same as LinearFunction gives
+void CLinearBinaryModel::calculateDistances( const CFloatMatrixDesc& data, int begin, int end, double* distances ) const
+{
+	NeoAssert( plane.Size() > 0 );
+	const float freeTerm = plane[plane.Size() - 1];
+
+	int row = begin;
+	if( data.Columns == nullptr ) {
+		const float* planePtr = plane.GetPtr();
+		const int size = min( plane.Size(), data.Width );
+		for( ; row + 4 <= end; row += 4 ) {
+			const float* row0 = data.Values + data.PointerB[row];
+			const float* row1 = data.Values + data.PointerB[row + 1];
+			const float* row2 = data.Values + data.PointerB[row + 2];
+			const float* row3 = data.Values + data.PointerB[row + 3];
+			double sum0 = 0;
+			double sum1 = 0;
+			double sum2 = 0;
+			double sum3 = 0;
+			for( int i = 0; i < size; i++ ) {
+				const double planeValue = planePtr[i];
+				sum0 += row0[i] * planeValue;
+				sum1 += row1[i] * planeValue;
+				sum2 += row2[i] * planeValue;
+				sum3 += row3[i] * planeValue;
+			}
+			distances[row - begin] = freeTerm + sum0;
+			distances[row - begin + 1] = freeTerm + sum1;
+			distances[row - begin + 2] = freeTerm + sum2;
+			distances[row - begin + 3] = freeTerm + sum3;
+		}
+	}
+
+	for( ; row < end; row++ ) {
+		distances[row - begin] = LinearFunction( plane, data.GetRow( row ) );
+	}
+}
+
 } // namespace NeoML
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -31,14 +31,18 @@ public:
 	// IModel interface methods
 	int GetClassCount() const override { return 2; }
 	bool Classify( const CFloatVectorDesc& data, CClassificationResult& result ) const override;
+	bool ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+		IThreadPool* threadPool = nullptr ) const override;
 	void Serialize( CArchive& archive ) override;
 
 	// ILinearBinaryModel interface methods
 	CFloatVector GetPlane() const override { return plane; }
 	const CSigmoid& GetSigmoid() const override { return coefficients; }
 
-	// IRegressionModel interface method
+	// IRegressionModel interface methods
 	double Predict( const CFloatVectorDesc& data ) const override;
+	void PredictBatch( const CFloatMatrixDesc& data, CArray<double>& results,
+		IThreadPool* threadPool = nullptr ) const override;
 
 protected:
 	~CLinearBinaryModel() override = default; // delete prohibited
@@ -48,6 +52,7 @@ private:
 	CSigmoid coefficients; // sigmoid coefficients for estimating probability
 
 	bool classify( double distance, CClassificationResult& result ) const;
+	void calculateDistances( const CFloatMatrixDesc& data, int begin, int end, double* distances ) const;
 };
 
 } // namespace NeoML
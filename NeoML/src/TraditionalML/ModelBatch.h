@@ -0,0 +1,83 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#pragma once
+
+#include <NeoML/TraditionalML/SparseFloatMatrix.h>
+#include <NeoMathEngine/ThreadPool.h>
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+namespace NeoML {
+
+// The default number of rows processed by one task of the batch classification and prediction
+const int DefaultBatchRowsGrainSize = 64;
+
+// Calls function( threadIndex, begin, end ) for the ranges of the [0, rowsCount) rows
+// The ranges are processed in parallel if the thread pool with several threads is specified,
+// the threadIndex is always less than the thread pool size
+template<typename TFunction>
+inline void ProcessBatchRows( IThreadPool* threadPool, int rowsCount, int grainSize, const TFunction& function )
+{
+	if( threadPool == nullptr || threadPool->Size() == 1 || rowsCount <= grainSize ) {
+		function( 0, 0, rowsCount );
+		return;
+	}
+
+	threadPool->ParallelFor( rowsCount, grainSize, []( int threadIndex, int begin, int end, void* params ) {
+		( *static_cast<const TFunction*>( params ) )( threadIndex, begin, end );
+	}, const_cast<TFunction*>( &function ) );
+}
+
+// Calls function( index ) for each index of [0, count), in parallel if the thread pool with several threads is specified
+// The thread pool tasks must not throw, so the first exception is caught, the rest of the indices are skipped
+// and the exception is rethrown after all the tasks have finished
+template<typename TFunction>
+inline void ProcessRange( IThreadPool* threadPool, int count, int grainSize, const TFunction& function )
+{
+	std::mutex exceptionMutex;
+	std::exception_ptr exception;
+	std::atomic<bool> isFailed( false );
+	ProcessBatchRows( threadPool, count, grainSize, [&]( int, int begin, int end ) {
+		for( int i = begin; i < end && !isFailed; i++ ) {
+			try {
+				function( i );
+			} catch( ... ) {
+				std::lock_guard<std::mutex> lock( exceptionMutex );
+				if( exception == nullptr ) {
+					exception = std::current_exception();
+				}
+				isFailed = true;
+			}
+		}
+	} );
+	if( exception != nullptr ) {
+		std::rethrow_exception( exception );
+	}
+}
+
+// Gets the descriptor of the [begin, end) rows of the matrix
+inline CFloatMatrixDesc GetMatrixRows( const CFloatMatrixDesc& matrix, int begin, int end )
+{
+	NeoAssert( 0 <= begin && begin <= end && end <= matrix.Height );
+	CFloatMatrixDesc result = matrix;
+	result.Height = end - begin;
+	result.PointerB = matrix.PointerB + begin;
+	result.PointerE = matrix.PointerE + begin;
+	return result;
+}
+
+} // namespace NeoML
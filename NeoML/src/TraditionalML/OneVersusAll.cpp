@@ -18,6 +18,9 @@ limitations under the License.
 
 #include <NeoML/TraditionalML/OneVersusAll.h>
 #include <OneVersusAllModel.h>
+#include <ModelBatch.h>
+
+#include <memory>
 
 namespace NeoML {
 
@@ -54,7 +57,8 @@ inline COneVersusAllTrainingData::COneVersusAllTrainingData( const IProblem* _da
 
 COneVersusAll::COneVersusAll( ITrainingModel& _baseBinaryClassifier ) :
 	baseBinaryClassifier( _baseBinaryClassifier ),
-	logStream( 0 )
+	logStream( 0 ),
+	threadCount( 1 )
 {
 }
 
@@ -64,11 +68,17 @@ CPtr<IModel> COneVersusAll::Train( const IProblem& trainingClassificationData )
 		*logStream << "\nOne versus all training started:\n";
 	}
 
+	const int classCount = trainingClassificationData.GetClassCount();
 	CObjectArray<IModel> etalons;
-	for( int i = 0; i < trainingClassificationData.GetClassCount(); i++ ) {
+	etalons.SetSize( classCount );
+	auto trainClass = [&]( int i ) {
 		CPtr<IProblem> trainingData = FINE_DEBUG_NEW COneVersusAllTrainingData( &trainingClassificationData, i );
-		etalons.Add( baseBinaryClassifier.Train( *trainingData ) );
-	}
+		etalons[i] = baseBinaryClassifier.Train( *trainingData );
+	};
+
+	// The binary problems share the original data, each of them is trained on its own thread
+	std::unique_ptr<IThreadPool> threadPool( threadCount != 1 ? CreateThreadPool( threadCount ) : nullptr );
+	ProcessRange( threadPool.get(), classCount, /*grainSize*/1, trainClass );
 
 	if( logStream != 0 ) {
 		*logStream << "\nOne versus all training finished\n";
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2020 ABBYY Production LLC
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -17,6 +17,7 @@ limitations under the License.
 #pragma hdrstop
 
 #include <OneVersusAllModel.h>
+#include <ModelBatch.h>
 
 namespace NeoML {
 
@@ -85,6 +86,44 @@ bool COneVersusAllModel::Classify( const CFloatVectorDesc& data, CClassification
 	return true;
 }
 
+bool COneVersusAllModel::ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+	IThreadPool* threadPool ) const
+{
+	// The binary classifiers process the whole matrix, so that they could use their own batch methods
+	// The probability of the jth class for the ith row is stored at i * classifiers.Size() + j
+	CArray<double> probabilities;
+	probabilities.SetSize( data.Height * classifiers.Size() );
+	for( int j = 0; j < classifiers.Size(); j++ ) {
+		NeoAssert( classifiers[j]->ClassifyBatch( data, results, threadPool ) );
+		for( int i = 0; i < data.Height; i++ ) {
+			probabilities[i * classifiers.Size() + j] = results[i].Probabilities[0].GetValue();
+		}
+	}
+
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		for( int i = begin; i < end; i++ ) {
+			const double* probability = probabilities.GetPtr() + i * classifiers.Size();
+			double sigmoidSum = 0;
+			int preferredClass = 0;
+			for( int j = 0; j < classifiers.Size(); j++ ) {
+				sigmoidSum += probability[j];
+				if( probability[j] > probability[preferredClass] ) {
+					preferredClass = j;
+				}
+			}
+
+			CClassificationResult& result = results[i];
+			result.ExceptionProbability = CClassificationProbability( 0 );
+			result.PreferredClass = preferredClass;
+			result.Probabilities.SetSize( classifiers.Size() );
+			for( int j = 0; j < classifiers.Size(); j++ ) {
+				result.Probabilities[j] = CClassificationProbability( probability[j] / sigmoidSum );
+			}
+		}
+	} );
+	return true;
+}
+
 void COneVersusAllModel::Serialize( CArchive& archive )
 {
 #ifdef NEOML_USE_FINEOBJ
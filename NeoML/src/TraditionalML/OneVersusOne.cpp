@@ -18,13 +18,18 @@ limitations under the License.
 
 #include <NeoML/TraditionalML/OneVersusOne.h>
 #include <OneVersusOneModel.h>
+#include <ModelBatch.h>
+
+#include <memory>
 
 namespace NeoML {
 
 // The data for training binary classification: 0 for the first class, 1 for the second
 class COneVersusOneTrainingData : public IProblem {
 public:
-	COneVersusOneTrainingData( const IProblem& data, int firstClass, int secondClass );
+	// The vectors of each class are listed in ascending order
+	COneVersusOneTrainingData( const IProblem& data, int firstClass, int secondClass,
+		const CArray<int>& firstClassVectors, const CArray<int>& secondClassVectors );
 
 	// IProblem interface methods
 	int GetClassCount() const override { return 2; }
@@ -46,25 +51,31 @@ private:
 	CArray<int> vectorIndices; // indices of vectors in base problem
 };
 
-COneVersusOneTrainingData::COneVersusOneTrainingData( const IProblem& data, int _firstClass, int _secondClass ) :
+COneVersusOneTrainingData::COneVersusOneTrainingData( const IProblem& data, int _firstClass, int _secondClass,
+		const CArray<int>& firstClassVectors, const CArray<int>& secondClassVectors ) :
 	baseProblem( &data ),
 	firstClass( _firstClass ),
 	secondClass( _secondClass )
 {
 	NeoAssert( firstClass != secondClass );
 	const CFloatMatrixDesc baseDesc = data.GetMatrix();
-	desc.Height = 0;
 	desc.Width = baseDesc.Width;
 	desc.Columns = baseDesc.Columns; // This works for both sparse and dense cases
 	desc.Values = baseDesc.Values;
-	for( int vecIndex = 0; vecIndex < baseDesc.Height; ++vecIndex ) {
-		const int currClass = baseProblem->GetClass( vecIndex );
-		if( currClass == firstClass || currClass == secondClass ) {
-			desc.Height++;
-			rowStart.Add( baseDesc.PointerB[vecIndex] );
-			rowEnd.Add( baseDesc.PointerE[vecIndex] );
-			vectorIndices.Add( vecIndex );
-		}
+	// Merge the vectors of both classes keeping the original order
+	desc.Height = firstClassVectors.Size() + secondClassVectors.Size();
+	vectorIndices.SetBufferSize( desc.Height );
+	rowStart.SetBufferSize( desc.Height );
+	rowEnd.SetBufferSize( desc.Height );
+	int firstPos = 0;
+	int secondPos = 0;
+	while( firstPos < firstClassVectors.Size() || secondPos < secondClassVectors.Size() ) {
+		const int vecIndex = ( secondPos == secondClassVectors.Size()
+			|| ( firstPos < firstClassVectors.Size() && firstClassVectors[firstPos] < secondClassVectors[secondPos] ) )
+			? firstClassVectors[firstPos++] : secondClassVectors[secondPos++];
+		rowStart.Add( baseDesc.PointerB[vecIndex] );
+		rowEnd.Add( baseDesc.PointerE[vecIndex] );
+		vectorIndices.Add( vecIndex );
 	}
 	desc.PointerB = rowStart.GetPtr();
 	desc.PointerE = rowEnd.GetPtr();
@@ -81,7 +92,8 @@ int COneVersusOneTrainingData::GetClass( int index ) const
 
 COneVersusOne::COneVersusOne( ITrainingModel& _baseClassifier ) :
 	baseClassifier( _baseClassifier ),
-	log( nullptr )
+	log( nullptr ),
+	threadCount( 1 )
 {
 }
 
@@ -91,15 +103,36 @@ CPtr<IModel> COneVersusOne::Train( const IProblem& trainingData )
 		*log << "\nOne versus one traning started:\n";
 	}
 
-	CObjectArray<IModel> classifiers;
+	// The vectors of each class are found once for all the class pairs
 	const int classCount = trainingData.GetClassCount();
+	CArray<CArray<int>> classVectors;
+	classVectors.SetSize( classCount );
+	for( int vecIndex = 0; vecIndex < trainingData.GetVectorCount(); ++vecIndex ) {
+		classVectors[trainingData.GetClass( vecIndex )].Add( vecIndex );
+	}
+
+	CArray<int> firstClasses;
+	CArray<int> secondClasses;
 	for( int firstClass = 0; firstClass < classCount - 1; ++firstClass ) {
 		for( int secondClass = firstClass + 1; secondClass < classCount; ++secondClass ) {
-			CPtr<IProblem> subproblem = FINE_DEBUG_NEW COneVersusOneTrainingData( trainingData, firstClass, secondClass );
-			classifiers.Add( baseClassifier.Train( *subproblem ) );
+			firstClasses.Add( firstClass );
+			secondClasses.Add( secondClass );
 		}
 	}
 
+	CObjectArray<IModel> classifiers;
+	classifiers.SetSize( firstClasses.Size() );
+	auto trainPair = [&]( int pair ) {
+		const int firstClass = firstClasses[pair];
+		const int secondClass = secondClasses[pair];
+		CPtr<IProblem> subproblem = FINE_DEBUG_NEW COneVersusOneTrainingData( trainingData, firstClass, secondClass,
+			classVectors[firstClass], classVectors[secondClass] );
+		classifiers[pair] = baseClassifier.Train( *subproblem );
+	};
+
+	std::unique_ptr<IThreadPool> threadPool( threadCount != 1 ? CreateThreadPool( threadCount ) : nullptr );
+	ProcessRange( threadPool.get(), classifiers.Size(), /*grainSize*/1, trainPair );
+
 	if( log != nullptr ) {
 		*log << "\nOne versus one training finished\n";
 	}
@@ -17,6 +17,10 @@ limitations under the License.
 #pragma hdrstop
 
 #include <NeoML/TraditionalML/SubwordEncoder.h>
+#include <ModelBatch.h>
+
+#include <atomic>
+#include <mutex>
 
 namespace NeoML {
 
@@ -33,29 +37,140 @@ void ISubwordEncoder::CParams::Serialize( CArchive& archive )
 
 //////////////////////////////////////
 
+// The cache is split into shards by the word hash, each shard has its own lock
+// and erases the least recently requested words when it is full
+// The shard sizes add up to the cache size, so there are fewer shards if the cache is smaller than ShardCount
+class ISubwordEncoderWithCache::CCache {
+public:
+	CCache() : cachePeriod( 50000 ) {}
+
+	// Cache size
+	int GetCachePeriod() const { return cachePeriod; }
+	// Sets the cache size and clears the cache
+	void SetCachePeriod( int newPeriod );
+	// Requests data from cache.
+	bool Request( const CString& word, CArray<int>& tokenIds,
+		CArray<int>& tokenLengths );
+	// Adds data to cache.
+	void Add( const CString& word, const CArray<int>& tokenIds,
+		const CArray<int>& tokenLengths );
+	// Clears cache.
+	void Clear();
+
+private:
+	static constexpr int ShardCount = 16;
+
+	// Data stored in cache: the word, its token ids and their unicode lengths
+	struct CCachedData {
+		CString Word;
+		CFastArray<int, 4> TokenIds;
+		CFastArray<int, 4> TokenLengths;
+		// The neighbours in the list ordered by the last request time
+		int Prev = NotFound;
+		int Next = NotFound;
+
+		CCachedData() = default;
+		CCachedData( const CCachedData& other );
+		CCachedData( CCachedData&& other );
+	};
+
+	// The part of the cache with its own lock
+	struct CShard {
+		std::mutex Mutex;
+		// The cached words
+		CArray<CCachedData> Data;
+		// Map: word -> index in Data
+		CMap<CString, int> WordIndex;
+		// The most and the least recently requested words
+		int First = NotFound;
+		int Last = NotFound;
+
+		void Unlink( int index );
+		void PushFirst( int index );
+		void Clear();
+	};
+
+	CShard shards[ShardCount];
+	// Cache size
+	std::atomic<int> cachePeriod;
+
+	int activeShardCount() const { return min( ShardCount, cachePeriod.load() ); }
+	int getShardIndex( const CString& word ) const;
+	int shardSize( int shardIndex ) const;
+};
+
 ISubwordEncoderWithCache::CCache::CCachedData::CCachedData( const CCachedData& other ) :
-	Time( other.Time )
+	Word( other.Word ),
+	Prev( other.Prev ),
+	Next( other.Next )
 {
 	other.TokenIds.CopyTo( TokenIds );
 	other.TokenLengths.CopyTo( TokenLengths );
 }
 
 ISubwordEncoderWithCache::CCache::CCachedData::CCachedData( CCachedData&& other ) :
-	Time( other.Time )
+	Word( std::move( other.Word ) ),
+	Prev( other.Prev ),
+	Next( other.Next )
 {
 	other.TokenIds.MoveTo( TokenIds );
 	other.TokenLengths.MoveTo( TokenLengths );
 }
 
-///////////////////////////////////////////////////////////////////////////////
+void ISubwordEncoderWithCache::CCache::CShard::Unlink( int index )
+{
+	CCachedData& data = Data[index];
+	if( data.Prev == NotFound ) {
+		First = data.Next;
+	} else {
+		Data[data.Prev].Next = data.Next;
+	}
+	if( data.Next == NotFound ) {
+		Last = data.Prev;
+	} else {
+		Data[data.Next].Prev = data.Prev;
+	}
+	data.Prev = NotFound;
+	data.Next = NotFound;
+}
+
+void ISubwordEncoderWithCache::CCache::CShard::PushFirst( int index )
+{
+	Data[index].Next = First;
+	if( First == NotFound ) {
+		Last = index;
+	} else {
+		Data[First].Prev = index;
+	}
+	First = index;
+}
+
+void ISubwordEncoderWithCache::CCache::CShard::Clear()
+{
+	Data.DeleteAll();
+	WordIndex.DeleteAll();
+	First = NotFound;
+	Last = NotFound;
+}
+
+int ISubwordEncoderWithCache::CCache::getShardIndex( const CString& word ) const
+{
+	const unsigned int hash = static_cast<unsigned int>( CDefaultHash<CString>::HashKey( word ) );
+	// The low bits of the string hash are not mixed enough
+	return static_cast<int>( ( hash ^ ( hash >> 16 ) ) % activeShardCount() );
+}
+
+int ISubwordEncoderWithCache::CCache::shardSize( int shardIndex ) const
+{
+	const int shardCount = activeShardCount();
+	return cachePeriod / shardCount + ( shardIndex < cachePeriod % shardCount ? 1 : 0 );
+}
 
 void ISubwordEncoderWithCache::CCache::SetCachePeriod( int newPeriod )
 {
 	NeoAssert( newPeriod == NotFound || newPeriod > 0 );
 	cachePeriod = newPeriod;
-	if( cachePeriod == NotFound ) {
-		Clear();
-	}
+	Clear();
 }
 
 bool ISubwordEncoderWithCache::CCache::Request( const CString& word,
@@ -65,63 +180,84 @@ bool ISubwordEncoderWithCache::CCache::Request( const CString& word,
 		return false;
 	}
 
-	cacheTime++;
-	bool success = false;
-	if( wordCache.Has( word ) ) {
-		CCachedData& wordData = wordCache.Get( word );
-		tokenIds.SetBufferSize( wordData.TokenIds.Size() );
-		tokenLengths.SetBufferSize( wordData.TokenLengths.Size() );
-
-		for( int i = 0; i < wordData.TokenIds.Size(); i++ ) {
-			tokenIds.Add( wordData.TokenIds[i] );
-			tokenLengths.Add( wordData.TokenLengths[i] );
-		}
-		wordData.Time = cacheTime;
-		success = true;
+	CShard& shard = shards[getShardIndex( word )];
+	std::lock_guard<std::mutex> lock( shard.Mutex );
+	int index = NotFound;
+	if( !shard.WordIndex.Lookup( word, index ) ) {
+		return false;
 	}
 
-	// Removes items from cache.
-	// The item is erased if there has not been a request with the same word since the previous cleanup. 
-	if( cacheTime % cachePeriod == 0 ) {
-		CArray<CString> wordsToDelete;
-		for( TMapPosition pos = wordCache.GetFirstPosition(); pos != NotFound;
-			pos = wordCache.GetNextPosition( pos ) )
-		{
-			const CCachedData& wordData = wordCache.GetValue( pos );
-			if( cacheTime - wordData.Time >= cachePeriod ) {
-				wordsToDelete.Add( wordCache.GetKey( pos ) );
-			}
-		}
-
-		for( int i = 0; i < wordsToDelete.Size(); i++ ) {
-			wordCache.Delete( wordsToDelete[i] );
-		}
+	const CCachedData& wordData = shard.Data[index];
+	tokenIds.SetBufferSize( tokenIds.Size() + wordData.TokenIds.Size() );
+	tokenLengths.SetBufferSize( tokenLengths.Size() + wordData.TokenLengths.Size() );
+	for( int i = 0; i < wordData.TokenIds.Size(); i++ ) {
+		tokenIds.Add( wordData.TokenIds[i] );
+		tokenLengths.Add( wordData.TokenLengths[i] );
 	}
-
-	return success;
+	shard.Unlink( index );
+	shard.PushFirst( index );
+	return true;
 }
 
 void ISubwordEncoderWithCache::CCache::Add( const CString& word,
 	const CArray<int>& tokenIds, const CArray<int>& tokenLengths )
 {
-	NeoAssert( !wordCache.Has( word ) );
 	NeoAssert( tokenIds.Size() == tokenLengths.Size() );
+	if( cachePeriod == NotFound ) {
+		return;
+	}
 
-	CCachedData wordData;
-	wordData.Time = cacheTime;
+	const int shardIndex = getShardIndex( word );
+	CShard& shard = shards[shardIndex];
+	std::lock_guard<std::mutex> lock( shard.Mutex );
+	int index = NotFound;
+	if( shard.WordIndex.Lookup( word, index ) ) {
+		// The word has been encoded by another thread at the same time
+		shard.Unlink( index );
+	} else if( shard.Data.Size() < shardSize( shardIndex ) ) {
+		index = shard.Data.Size();
+		shard.Data.Append();
+		shard.WordIndex.Add( word, index );
+	} else {
+		// Reuse the least recently requested word data
+		index = shard.Last;
+		shard.Unlink( index );
+		shard.WordIndex.Delete( shard.Data[index].Word );
+		shard.WordIndex.Add( word, index );
+	}
+
+	CCachedData& wordData = shard.Data[index];
+	wordData.Word = word;
+	wordData.TokenIds.DeleteAll();
+	wordData.TokenLengths.DeleteAll();
 	for( int i = 0; i < tokenIds.Size(); i++ ) {
 		wordData.TokenIds.Add( tokenIds[i] );
 		wordData.TokenLengths.Add( tokenLengths[i] );
 	}
-	wordCache.Add( word, wordData );
+	shard.PushFirst( index );
+}
+
+void ISubwordEncoderWithCache::CCache::Clear()
+{
+	for( CShard& shard : shards ) {
+		std::lock_guard<std::mutex> lock( shard.Mutex );
+		shard.Clear();
+	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+ISubwordEncoderWithCache::ISubwordEncoderWithCache() :
+	cache( FINE_DEBUG_NEW CCache )
+{
+}
+
+ISubwordEncoderWithCache::~ISubwordEncoderWithCache() = default;
+
 void ISubwordEncoderWithCache::Encode( const CString& word, CArray<int>& tokenIds,
 	CArray<int>& tokenLengths ) const
 {
-	if( cache.Request( word, tokenIds, tokenLengths ) ) {
+	if( cache->Request( word, tokenIds, tokenLengths ) ) {
 		return;
 	}
 
@@ -132,6 +268,48 @@ void ISubwordEncoderWithCache::Encode( const CString& word, CArray<int>& tokenId
 	tokenIds.Add( wordTokenIds );
 	tokenLengths.Add( wordTokenLengths );
 
-	cache.Add( word, wordTokenIds, wordTokenLengths );
+	cache->Add( word, wordTokenIds, wordTokenLengths );
+}
+
+void ISubwordEncoderWithCache::EncodeBatch( const CArray<CString>& words, CArray<int>& tokenIds,
+	CArray<int>& tokenLengths, CArray<int>& offsets, IThreadPool* threadPool ) const
+{
+	CArray<CArray<int>> wordTokenIds;
+	CArray<CArray<int>> wordTokenLengths;
+	wordTokenIds.SetSize( words.Size() );
+	wordTokenLengths.SetSize( words.Size() );
+	ProcessRange( threadPool, words.Size(), /*grainSize*/16, [&]( int i ) {
+		Encode( words[i], wordTokenIds[i], wordTokenLengths[i] );
+	} );
+
+	offsets.SetSize( words.Size() + 1 );
+	offsets[0] = 0;
+	for( int i = 0; i < words.Size(); i++ ) {
+		offsets[i + 1] = offsets[i] + wordTokenIds[i].Size();
+	}
+	tokenIds.DeleteAll();
+	tokenLengths.DeleteAll();
+	tokenIds.SetBufferSize( offsets.Last() );
+	tokenLengths.SetBufferSize( offsets.Last() );
+	for( int i = 0; i < words.Size(); i++ ) {
+		tokenIds.Add( wordTokenIds[i] );
+		tokenLengths.Add( wordTokenLengths[i] );
+	}
+}
+
+int ISubwordEncoderWithCache::GetCachePeriod() const
+{
+	return cache->GetCachePeriod();
 }
+
+void ISubwordEncoderWithCache::SetCachePeriod( int cachePeriod ) const
+{
+	cache->SetCachePeriod( cachePeriod );
+}
+
+void ISubwordEncoderWithCache::ClearCache() const
+{
+	cache->Clear();
+}
+
 } // namespace NeoML
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -17,6 +17,7 @@ limitations under the License.
 #pragma hdrstop
 
 #include <SvmBinaryModel.h>
+#include <ModelBatch.h>
 
 namespace NeoML {
 
@@ -55,6 +56,52 @@ CSvmBinaryModel::CSvmBinaryModel( const CSvmKernel& _kernel,
 }
 
 bool CSvmBinaryModel::Classify( const CFloatVectorDesc& data, CClassificationResult& result ) const
+{
+	classify( decisionFunction( data ), result );
+	return true;
+}
+
+bool CSvmBinaryModel::ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+	IThreadPool* threadPool ) const
+{
+	results.DeleteAll();
+	results.SetSize( data.Height );
+
+	if( kernel.KernelType() != CSvmKernel::KT_Linear ) {
+		ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+			for( int i = begin; i < end; i++ ) {
+				classify( decisionFunction( data.GetRow( i ) ), results[i] );
+			}
+		} );
+		return true;
+	}
+
+	// The linear kernel decision function is the dot product with the sum of the weighted support vectors
+	CArray<double> plane;
+	calculateLinearPlane( plane );
+	ProcessBatchRows( threadPool, data.Height, DefaultBatchRowsGrainSize, [&]( int, int begin, int end ) {
+		CFloatVectorDesc desc;
+		for( int i = begin; i < end; i++ ) {
+			data.GetRow( i, desc );
+			double value = freeTerm;
+			if( desc.Indexes == nullptr ) {
+				const int size = min( desc.Size, plane.Size() );
+				for( int j = 0; j < size; j++ ) {
+					value += plane[j] * desc.Values[j];
+				}
+			} else {
+				for( int j = 0; j < desc.Size && desc.Indexes[j] < plane.Size(); j++ ) {
+					value += plane[desc.Indexes[j]] * desc.Values[j];
+				}
+			}
+			classify( value, results[i] );
+		}
+	} );
+	return true;
+}
+
+// Calculates the decision function value for the vector
+double CSvmBinaryModel::decisionFunction( const CFloatVectorDesc& data ) const
 {
 	CFloatVectorDesc desc;
 	double value = freeTerm;
@@ -62,7 +109,27 @@ bool CSvmBinaryModel::Classify( const CFloatVectorDesc& data, CClassificationRes
 		matrix.GetRow( i, desc );
 		value += alpha[i] * kernel.Calculate( data, desc );
 	}
+	return value;
+}
 
+// Calculates the sum of the support vectors multiplied by their coefficients
+void CSvmBinaryModel::calculateLinearPlane( CArray<double>& plane ) const
+{
+	const CFloatMatrixDesc desc = matrix.GetDesc();
+	plane.DeleteAll();
+	plane.Add( 0., desc.Width );
+	CFloatVectorDesc row;
+	for( int i = 0; i < alpha.Size(); i++ ) {
+		desc.GetRow( i, row );
+		for( int j = 0; j < row.Size; j++ ) {
+			plane[row.Indexes == nullptr ? j : row.Indexes[j]] += alpha[i] * row.Values[j];
+		}
+	}
+}
+
+// Calculates the classification result from the decision function value
+void CSvmBinaryModel::classify( double value, CClassificationResult& result )
+{
 	const double probability = 1 / ( 1 + exp( value ) );
 	result.ExceptionProbability = CClassificationProbability( 0 );
 	result.Probabilities.SetSize( 2 );
@@ -74,7 +141,6 @@ bool CSvmBinaryModel::Classify( const CFloatVectorDesc& data, CClassificationRes
 	} else {
 		result.PreferredClass = 1;
 	}
-	return true;
 }
 
 void CSvmBinaryModel::Serialize( CArchive& archive )
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -31,6 +31,8 @@ public:
 	// IModel interface methods
 	int GetClassCount() const override { return 2; }
 	bool Classify( const CFloatVectorDesc& data, CClassificationResult& result ) const override;
+	bool ClassifyBatch( const CFloatMatrixDesc& data, CArray<CClassificationResult>& results,
+		IThreadPool* threadPool = nullptr ) const override;
 	void Serialize( CArchive& archive ) override;
 
 	// ISvmBinaryModel interface methods
@@ -47,6 +49,10 @@ private:
 	double freeTerm{}; // the free term
 	CSparseFloatMatrix matrix{}; // the support vectors
 	CArray<double> alpha{}; // the coefficients
+
+	double decisionFunction( const CFloatVectorDesc& data ) const;
+	void calculateLinearPlane( CArray<double>& plane ) const;
+	static void classify( double value, CClassificationResult& result );
 };
 
 } // namespace NeoML
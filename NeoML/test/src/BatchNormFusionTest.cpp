@@ -103,3 +103,35 @@ TEST( BatchNormFusionTest, ImpossibleFusion )
 	data->SetBlob( bnFusionData( random ) );
 	checkBnFusion( dnn, sink, 0 );
 }
+
+TEST( BatchNormFusionTest, QuantizedWeights )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	CRandom random( 0x654 );
+	CDnn dnn( random, MathEngine() );
+	CSourceLayer* data = Source( dnn, "source" );
+	CBaseLayer* lastLayer = BatchNormalization( true )( "convBn", data );
+	CConvLayer* conv = Conv( 4, CConvAxisParams( 1 ), CConvAxisParams( 1 ) )( "conv", lastLayer );
+	lastLayer = BatchNormalization( true )( "fcBn", conv );
+	CFullyConnectedLayer* fc = FullyConnected( 8 )( "fc", lastLayer );
+	lastLayer = BatchNormalization( true )( "halfFcBn", fc );
+	CFullyConnectedLayer* halfFc = FullyConnected( 6 )( "halfFc", lastLayer );
+	CSinkLayer* sink = Sink( halfFc, "sink" );
+
+	data->SetBlob( bnFusionData( random ) );
+	dnn.RunOnce();
+	CDnnInt8Quantizer quantizer;
+	quantizer.StartCalibration( dnn );
+	dnn.RunOnce();
+	quantizer.FinishCalibration( dnn );
+	halfFc->ResetInt8Quantization();
+	halfFc->SetWeightsPrecision( DWP_Float16 );
+	ASSERT_TRUE( conv->GetInt8Quantization().IsQuantized() );
+	ASSERT_TRUE( fc->GetInt8Quantization().IsQuantized() );
+
+	// The weights stored in the int8 or 16-bit format are not changed
+	checkBnFusion( dnn, sink, 0 );
+}
@@ -17,6 +17,10 @@ limitations under the License.
 #pragma hdrstop
 
 #include <TestFixture.h>
+#include <NeoMathEngine/ThreadPool.h>
+
+#include <memory>
+#include <thread>
 
 using namespace NeoML;
 using namespace NeoMLTest;
@@ -276,6 +280,93 @@ TEST_F( CBpeTest, Ambiguous )
 	EXPECT_EQ( 1, tokenLengths[3] );
 }
 
+// The straightforward encoding: merges the pair of the adjacent tokens that gives the token with the least id
+static void encodeBpeNaive( const IBytePairEncoder::CBPEDictionary& dictionary, const CString& endOfWordToken,
+	const CString& word, CArray<int>& tokenIds )
+{
+	CArray<CString> wordTokens;
+	for( int i = 0; i < word.Length(); ++i ) {
+		wordTokens.Add( CString( static_cast<const char*>( word ) + i, 1 ) );
+	}
+	wordTokens.Add( endOfWordToken );
+
+	while( true ) {
+		int bestToken = dictionary.Size();
+		int bestPos = NotFound;
+		for( int i = 0; i < wordTokens.Size() - 1; ++i ) {
+			const int token = dictionary.Find( wordTokens[i] + wordTokens[i + 1] );
+			if( token != NotFound && token < bestToken ) {
+				bestToken = token;
+				bestPos = i;
+			}
+		}
+		if( bestPos == NotFound ) {
+			break;
+		}
+		wordTokens[bestPos] = dictionary[bestToken];
+		wordTokens.DeleteAt( bestPos + 1 );
+	}
+
+	for( const CString& token : wordTokens ) {
+		const int index = dictionary.Find( token );
+		tokenIds.Add( index == NotFound ? 0 : index + 1 );
+	}
+}
+
+TEST_F( CBpeTest, SameAsNaive )
+{
+	CRandom random( 0x5eed );
+	const CString alphabet = "abcde";
+	auto randomWord = [&]( const CString& letters, int maxLength ) {
+		CString word;
+		const int length = random.UniformInt( 1, maxLength );
+		for( int i = 0; i < length; ++i ) {
+			word += letters[random.UniformInt( 0, letters.Length() - 1 )];
+		}
+		return word;
+	};
+
+	CWordDictionary trainingDictionary;
+	for( int i = 0; i < 200; ++i ) {
+		trainingDictionary.AddWord( randomWord( alphabet, 8 ), random.UniformInt( 1, 10 ) );
+	}
+	CSubwordEncoderTrainer trainer( 60, TAlgorithm::BPE, TBorderHandling::None );
+	CPtr<ISubwordEncoder> trained = trainer.Train( trainingDictionary );
+	CMap<int, CString> idToToken;
+	trained->GetIdToTokenMapping( idToToken );
+
+	// The end-of-word token is also a merge of the letters
+	IBytePairEncoder::CBPEDictionary dictionary;
+	for( int i = 1; i < trained->Size(); ++i ) {
+		dictionary.Add( idToToken.Get( i ) );
+	}
+	for( const char* token : { "@", "a@", "ea", "eab" } ) {
+		if( !dictionary.Has( token ) ) {
+			dictionary.Add( token );
+		}
+	}
+	ISubwordEncoder::CParams params;
+	params.EndOfWordToken = "@";
+	CPtr<IBytePairEncoder> encoder = CheckCast<IBytePairEncoder>( CreateModel( BytePairEncoderModelName ) );
+	encoder->Initialize( dictionary, params );
+
+	for( int i = 0; i < 500; ++i ) {
+		// Long words with the unknown letters
+		const CString word = randomWord( alphabet + "xy", 40 );
+		CArray<int> expected;
+		encodeBpeNaive( dictionary, params.EndOfWordToken, word, expected );
+		CArray<int> tokenIds, tokenLengths;
+		encoder->Encode( word, tokenIds, tokenLengths );
+		ASSERT_EQ( expected.Size(), tokenIds.Size() ) << word;
+		int length = 0;
+		for( int j = 0; j < expected.Size(); ++j ) {
+			EXPECT_EQ( expected[j], tokenIds[j] ) << word;
+			length += tokenLengths[j];
+		}
+		EXPECT_EQ( word.Length(), length );
+	}
+}
+
 #ifdef NEOML_USE_FINEOBJ
 #define BPE_TEST_ASSERT( expr ) \
 	try { \
@@ -415,3 +506,85 @@ TEST_F( CBpeTest, UnknownId )
 		}
 	}
 }
+
+TEST_F( CBpeTest, EncodeBatch )
+{
+	CWordDictionary trainingDictionary = fillDictionary( "the quick brown fox jumps over the lazy dog", 10 );
+	CSubwordEncoderTrainer trainerBpe( 40, TAlgorithm::BPE, TBorderHandling::EndOfWord );
+	CSubwordEncoderTrainer trainerUnigram( 40, TAlgorithm::Unigram, TBorderHandling::EndOfWord );
+	CArray<CPtr<ISubwordEncoder>> encoders = { trainerBpe.Train( trainingDictionary ),
+		trainerUnigram.Train( trainingDictionary ) };
+
+	CArray<CString> sentence;
+	splitString( "the dog jumps over the quick fox and the brown dog sleeps under the lazy fox", sentence );
+	CArray<CString> words;
+	for( int i = 0; i < 50; ++i ) {
+		words.Add( sentence );
+	}
+
+	std::unique_ptr<IThreadPool> threadPool( CreateThreadPool( 4 ) );
+	for( const CPtr<ISubwordEncoder>& encoder : encoders ) {
+		ISubwordEncoderWithCache* encoderWithCache = CheckCast<ISubwordEncoderWithCache>( encoder.Ptr() );
+		// The cache is smaller than the number of different words
+		encoderWithCache->SetCachePeriod( 4 );
+		for( IThreadPool* pool : { static_cast<IThreadPool*>( nullptr ), threadPool.get() } ) {
+			CArray<int> tokenIds, tokenLengths, offsets;
+			encoderWithCache->EncodeBatch( words, tokenIds, tokenLengths, offsets, pool );
+			ASSERT_EQ( words.Size() + 1, offsets.Size() );
+			ASSERT_EQ( tokenIds.Size(), offsets.Last() );
+			ASSERT_EQ( tokenIds.Size(), tokenLengths.Size() );
+			for( int i = 0; i < words.Size(); ++i ) {
+				CArray<int> expectedIds, expectedLengths;
+				encoder->Encode( words[i], expectedIds, expectedLengths );
+				ASSERT_EQ( expectedIds.Size(), offsets[i + 1] - offsets[i] );
+				for( int j = 0; j < expectedIds.Size(); ++j ) {
+					EXPECT_EQ( expectedIds[j], tokenIds[offsets[i] + j] );
+					EXPECT_EQ( expectedLengths[j], tokenLengths[offsets[i] + j] );
+				}
+			}
+		}
+	}
+}
+
+TEST_F( CBpeTest, SharedEncoder )
+{
+	CWordDictionary trainingDictionary = fillDictionary( "the quick brown fox jumps over the lazy dog", 10 );
+	CSubwordEncoderTrainer trainer( 40, TAlgorithm::BPE, TBorderHandling::BeginOfWord );
+	CPtr<ISubwordEncoder> encoder = trainer.Train( trainingDictionary );
+	CheckCast<ISubwordEncoderWithCache>( encoder.Ptr() )->SetCachePeriod( 8 );
+
+	CArray<CString> words;
+	splitString( "the dog jumps over the quick fox and the brown dog sleeps under the lazy fox", words );
+	CArray<CArray<int>> expected;
+	expected.SetSize( words.Size() );
+	for( int i = 0; i < words.Size(); ++i ) {
+		CArray<int> tokenLengths;
+		encoder->Encode( words[i], expected[i], tokenLengths );
+	}
+
+	// The encoder and its cache are used by all the threads at the same time
+	const int threadCount = 4;
+	CArray<int> errorCounts;
+	errorCounts.Add( 0, threadCount );
+	std::vector<std::thread> threads;
+	for( int thread = 0; thread < threadCount; ++thread ) {
+		threads.emplace_back( [&, thread] {
+			for( int run = 0; run < 200; ++run ) {
+				const int index = ( run * 7 + thread ) % words.Size();
+				CArray<int> tokenIds, tokenLengths;
+				encoder->Encode( words[index], tokenIds, tokenLengths );
+				bool isEqual = tokenIds.Size() == expected[index].Size();
+				for( int i = 0; isEqual && i < tokenIds.Size(); ++i ) {
+					isEqual = tokenIds[i] == expected[index][i];
+				}
+				errorCounts[thread] += isEqual ? 0 : 1;
+			}
+		} );
+	}
+	for( std::thread& thread : threads ) {
+		thread.join();
+	}
+	for( int errorCount : errorCounts ) {
+		EXPECT_EQ( 0, errorCount );
+	}
+}
@@ -1,4 +1,4 @@
-/* Copyright © 2021-2023 ABBYY
+/* Copyright © 2021-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -18,6 +18,10 @@ limitations under the License.
 
 #include <TestFixture.h>
 #include <RandomProblem.h>
+#include <NeoML/TraditionalML/CrossValidationSubProblem.h>
+#include <NeoML/TraditionalML/StratifiedCrossValidationSubProblem.h>
+#include <NeoMathEngine/ThreadPool.h>
+#include <memory>
 
 using namespace NeoML;
 using namespace NeoMLTest;
@@ -25,6 +29,46 @@ using namespace NeoMLTest;
 //---------------------------------------------------------------------------------------------------------------------
 // Common functions
 
+// Checks that the batch classification gives the same results as the classification of each vector
+void TestClassifyBatch( const IModel& model, const CClassificationRandomProblem& testData )
+{
+	std::unique_ptr<IThreadPool> threadPool( CreateThreadPool( 4 ) );
+	for( IThreadPool* pool : { static_cast<IThreadPool*>( nullptr ), threadPool.get() } ) {
+		CArray<CClassificationResult> results;
+		ASSERT_TRUE( model.ClassifyBatch( testData.GetMatrix(), results, pool ) );
+		ASSERT_EQ( testData.GetVectorCount(), results.Size() );
+		for( int i = 0; i < testData.GetVectorCount(); i++ ) {
+			CClassificationResult expected;
+			ASSERT_TRUE( model.Classify( testData.GetVector( i ), expected ) );
+			ASSERT_EQ( expected.PreferredClass, results[i].PreferredClass );
+			ASSERT_EQ( expected.Probabilities.Size(), results[i].Probabilities.Size() );
+			for( int j = 0; j < expected.Probabilities.Size(); j++ ) {
+				const double expectedValue = expected.Probabilities[j].GetValue();
+				if( std::isnan( expectedValue ) ) {
+					// Some models (e.g. one versus one over decision trees) may give undefined probabilities
+					ASSERT_TRUE( std::isnan( results[i].Probabilities[j].GetValue() ) );
+				} else {
+					ASSERT_NEAR( expectedValue, results[i].Probabilities[j].GetValue(), 1e-6 );
+				}
+			}
+		}
+	}
+}
+
+// Checks that the batch prediction gives the same results as the prediction for each vector
+void TestPredictBatch( const IRegressionModel& model, const CFloatMatrixDesc& testData )
+{
+	std::unique_ptr<IThreadPool> threadPool( CreateThreadPool( 4 ) );
+	for( IThreadPool* pool : { static_cast<IThreadPool*>( nullptr ), threadPool.get() } ) {
+		CArray<double> results;
+		model.PredictBatch( testData, results, pool );
+		ASSERT_EQ( testData.Height, results.Size() );
+		for( int i = 0; i < testData.Height; i++ ) {
+			ASSERT_DOUBLE_EQ( model.Predict( testData.GetRow( i ) ), results[i] );
+		}
+	}
+}
+
 void TestClassificationResult( const IModel* modelDense, const IModel* modelSparse,
 	const CClassificationRandomProblem* testDataDense, const CClassificationRandomProblem* testDataSparse )
 {
@@ -43,6 +87,25 @@ void TestClassificationResult( const IModel* modelDense, const IModel* modelSpar
 		ASSERT_EQ( result1.PreferredClass, result3.PreferredClass );
 		ASSERT_EQ( result1.PreferredClass, result4.PreferredClass );
 	}
+
+	TestClassifyBatch( *modelDense, *testDataDense );
+	TestClassifyBatch( *modelSparse, *testDataSparse );
+}
+
+// Checks that the models give exactly the same results
+void TestSameClassification( const IModel& expectedModel, const IModel& model, const CClassificationRandomProblem& testData )
+{
+	for( int i = 0; i < testData.GetVectorCount(); i++ ) {
+		CClassificationResult expected;
+		CClassificationResult result;
+		ASSERT_TRUE( expectedModel.Classify( testData.GetVector( i ), expected ) );
+		ASSERT_TRUE( model.Classify( testData.GetVector( i ), result ) );
+		ASSERT_EQ( expected.PreferredClass, result.PreferredClass );
+		ASSERT_EQ( expected.Probabilities.Size(), result.Probabilities.Size() );
+		for( int j = 0; j < expected.Probabilities.Size(); j++ ) {
+			ASSERT_EQ( expected.Probabilities[j].GetValue(), result.Probabilities[j].GetValue() );
+		}
+	}
 }
 
 void CrossValidate( int PartsCount, ITrainingModel& trainingModel, const IProblem* dense, const IProblem* sparse )
@@ -195,6 +258,9 @@ protected:
 			ASSERT_DOUBLE_EQ( result1, result3 );
 			ASSERT_DOUBLE_EQ( result1, result4 );
 		}
+
+		TestPredictBatch( *ModelDense, DenseBinaryTestData->GetMatrix() );
+		TestPredictBatch( *ModelSparse, SparseBinaryTestData->GetMatrix() );
 	}
 };
 
@@ -420,6 +486,21 @@ TEST_F( RandomMultiClassification2000x20, OneVsAllLinear )
 	TestClassificationResult( ModelSparse, modelImplicitSparse, DenseMultiTestData, SparseMultiTestData );
 }
 
+TEST_F( RandomMultiClassification2000x20, OneVsAllLinearParallel )
+{
+	CLinear linear( EF_SquaredHinge );
+	COneVersusAll ovaLinear( linear );
+	TrainMulti( ovaLinear );
+
+	// The binary classifiers trained concurrently are the same
+	ovaLinear.SetThreadCount( 4 );
+	CPtr<IModel> modelParallelDense;
+	CPtr<IModel> modelParallelSparse;
+	Train( ovaLinear, *DenseRandomMultiProblem, *SparseRandomMultiProblem, modelParallelDense, modelParallelSparse );
+	TestSameClassification( *ModelDense, *modelParallelDense, *DenseMultiTestData );
+	TestSameClassification( *ModelSparse, *modelParallelSparse, *SparseMultiTestData );
+}
+
 TEST_F( RandomMultiClassification2000x20, OneVsAllRbf )
 {
 	CSvm svmRbf( CSvmKernel::KT_RBF );
@@ -474,6 +555,21 @@ TEST_F( RandomMultiClassification2000x20, OneVsOneLinear )
 	TestClassificationResult( ModelSparse, modelImplicitSparse, DenseMultiTestData, SparseMultiTestData );
 }
 
+TEST_F( RandomMultiClassification2000x20, OneVsOneLinearParallel )
+{
+	CLinear linear( EF_SquaredHinge );
+	COneVersusOne ovoLinear( linear );
+	TrainMulti( ovoLinear );
+
+	// The binary classifiers trained concurrently are the same
+	ovoLinear.SetThreadCount( 4 );
+	CPtr<IModel> modelParallelDense;
+	CPtr<IModel> modelParallelSparse;
+	Train( ovoLinear, *DenseRandomMultiProblem, *SparseRandomMultiProblem, modelParallelDense, modelParallelSparse );
+	TestSameClassification( *ModelDense, *modelParallelDense, *DenseMultiTestData );
+	TestSameClassification( *ModelSparse, *modelParallelSparse, *SparseMultiTestData );
+}
+
 TEST_F( RandomMultiClassification2000x20, OneVsOneRbf )
 {
 	CSvm::CParams params( CSvmKernel::KT_RBF );
@@ -518,6 +614,91 @@ TEST_F( RandomBinaryClassification4000x20, CrossValidationLinear )
 	CrossValidate( 10, linear, DenseRandomBinaryProblem, SparseRandomBinaryProblem );
 }
 
+TEST_F( RandomMultiClassification2000x20, CrossValidationParallel )
+{
+	const int partsCount = 5;
+	CLinear linear( EF_SquaredHinge );
+	for( bool stratified : { false, true } ) {
+		CCrossValidation crossValidation( linear, DenseRandomMultiProblem );
+		CCrossValidationResult expected;
+		crossValidation.Execute( partsCount, AccuracyScore, expected, stratified );
+
+		// The testing subsets are the same as the cross-validation subproblems
+		for( int i = 0; i < partsCount; i++ ) {
+			CPtr<ISubProblem> testSubProblem;
+			if( stratified ) {
+				testSubProblem = new CStratifiedCrossValidationSubProblem( DenseRandomMultiProblem, partsCount, i, true );
+			} else {
+				testSubProblem = new CCrossValidationSubProblem( DenseRandomMultiProblem, partsCount, i, true );
+			}
+			for( int j = 0; j < testSubProblem->GetVectorCount(); j++ ) {
+				ASSERT_EQ( i, expected.ModelIndex[testSubProblem->GetOriginalIndex( j )] );
+			}
+		}
+
+		crossValidation.SetThreadCount( 4 );
+		CCrossValidationResult result;
+		crossValidation.Execute( partsCount, AccuracyScore, result, stratified );
+		ASSERT_EQ( partsCount, result.Models.Size() );
+		ASSERT_EQ( partsCount, result.Success.Size() );
+		for( int i = 0; i < partsCount; i++ ) {
+			ASSERT_EQ( expected.Success[i], result.Success[i] );
+		}
+		ASSERT_EQ( expected.Results.Size(), result.Results.Size() );
+		for( int i = 0; i < expected.Results.Size(); i++ ) {
+			ASSERT_EQ( expected.ModelIndex[i], result.ModelIndex[i] );
+			ASSERT_EQ( expected.Results[i].PreferredClass, result.Results[i].PreferredClass );
+		}
+	}
+}
+
+TEST_F( RandomBinaryClassification4000x20, CrossValidationTrainingOrder )
+{
+	// The gradient boosting with subsampling depends on the order of the training vectors,
+	// so the models must be the same as the ones trained on the cross-validation subproblems
+	const int partsCount = 5;
+	CRandom random( 0x123 );
+	CGradientBoost::CParams params;
+	params.IterationsCount = 10;
+	params.MaxTreeDepth = 4;
+	params.Subsample = 0.5f;
+	params.Random = &random;
+	for( bool stratified : { false, true } ) {
+		random.Reset( 0x123 );
+		CGradientBoost boosting( params );
+		CCrossValidation crossValidation( boosting, DenseRandomBinaryProblem );
+		CCrossValidationResult result;
+		crossValidation.Execute( partsCount, AccuracyScore, result, stratified );
+
+		random.Reset( 0x123 );
+		for( int i = 0; i < partsCount; i++ ) {
+			CPtr<ISubProblem> trainSubProblem;
+			CPtr<ISubProblem> testSubProblem;
+			if( stratified ) {
+				trainSubProblem = new CStratifiedCrossValidationSubProblem( DenseRandomBinaryProblem, partsCount, i, false );
+				testSubProblem = new CStratifiedCrossValidationSubProblem( DenseRandomBinaryProblem, partsCount, i, true );
+			} else {
+				trainSubProblem = new CCrossValidationSubProblem( DenseRandomBinaryProblem, partsCount, i, false );
+				testSubProblem = new CCrossValidationSubProblem( DenseRandomBinaryProblem, partsCount, i, true );
+			}
+			CPtr<IModel> expectedModel = boosting.Train( *trainSubProblem );
+			const CFloatMatrixDesc testMatrix = testSubProblem->GetMatrix();
+			for( int j = 0; j < testSubProblem->GetVectorCount(); j++ ) {
+				CFloatVectorDesc vector;
+				testMatrix.GetRow( j, vector );
+				CClassificationResult expected;
+				ASSERT_TRUE( expectedModel->Classify( vector, expected ) );
+				const CClassificationResult& actual = result.Results[testSubProblem->GetOriginalIndex( j )];
+				ASSERT_EQ( expected.PreferredClass, actual.PreferredClass );
+				ASSERT_EQ( expected.Probabilities.Size(), actual.Probabilities.Size() );
+				for( int k = 0; k < expected.Probabilities.Size(); k++ ) {
+					ASSERT_NEAR( expected.Probabilities[k].GetValue(), actual.Probabilities[k].GetValue(), 1e-5 );
+				}
+			}
+		}
+	}
+}
+
 TEST_F( RandomBinaryClassification4000x20, CrossValidationSvmLinear )
 {
 	CSvm svmLinear( CSvmKernel::KT_Linear );
@@ -569,6 +750,9 @@ TEST_F( RandomBinaryRegression4000x20, Linear )
 		ASSERT_DOUBLE_EQ( result1, result3 );
 		ASSERT_DOUBLE_EQ( result1, result4 );
 	}
+
+	TestPredictBatch( *model, denseBinaryTestData->GetMatrix() );
+	TestPredictBatch( *model2, sparseBinaryTestData->GetMatrix() );
 }
 
 // GB binary tree builders
@@ -215,6 +215,35 @@ static void kmeansElkanClustering( IClusteringData* data, CClusteringResult& res
 	kMeans.Clusterize( data, result );
 }
 
+static void kmeansHamerlyClustering( IClusteringData* data, CClusteringResult& result )
+{
+	CKMeansClustering::CParam params;
+	params.DistanceFunc = DF_Euclid;
+	params.InitialClustersCount = 2;
+	params.MaxIterations = 50;
+	params.Algo = CKMeansClustering::KMA_Hamerly;
+	params.Initialization = CKMeansClustering::KMI_KMeansPlusPlus;
+	params.ThreadCount = -1;
+
+	CKMeansClustering kMeans( params );
+	kMeans.Clusterize( data, result );
+}
+
+static void kmeansMiniBatchClustering( IClusteringData* data, CClusteringResult& result )
+{
+	CKMeansClustering::CParam params;
+	params.DistanceFunc = DF_Euclid;
+	params.InitialClustersCount = 2;
+	params.MaxIterations = 50;
+	params.Algo = CKMeansClustering::KMA_MiniBatch;
+	params.Initialization = CKMeansClustering::KMI_KMeansPlusPlus;
+	params.MiniBatchSize = 64;
+	params.ThreadCount = -1;
+
+	CKMeansClustering kMeans( params );
+	kMeans.Clusterize( data, result );
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 // Result check functions
 
@@ -403,6 +432,20 @@ static void kmeansElkanDefaultInitClustering( IClusteringData* data, CClustering
 	kMeans.Clusterize( data, result );
 }
 
+static void kmeansHamerlyDefaultInitClustering( IClusteringData* data, CClusteringResult& result )
+{
+	CKMeansClustering::CParam params;
+	params.DistanceFunc = DF_Euclid;
+	params.InitialClustersCount = 2;
+	params.MaxIterations = 50;
+	params.Algo = CKMeansClustering::KMA_Hamerly;
+	params.Initialization = CKMeansClustering::KMI_Default;
+	params.ThreadCount = 4;
+
+	CKMeansClustering kMeans( params );
+	kMeans.Clusterize( data, result );
+}
+
 TEST_F( CClusteringTest, PrecalcKmeans )
 {
 	CClusteringResult expectedResult;
@@ -418,6 +461,77 @@ TEST_F( CClusteringTest, PrecalcKmeans )
 	precalcTestImpl( kmeansLloydClustering, expectedResult );
 	// Check that different algos with the same initialization return similar results
 	precalcTestImpl( kmeansElkanDefaultInitClustering, expectedResult );
+	precalcTestImpl( kmeansHamerlyDefaultInitClustering, expectedResult );
+}
+
+// Mini-batch algorithm finds almost the same clusters as Lloyd algorithm
+TEST_F( CClusteringTest, KmeansMiniBatch )
+{
+	CPtr<IClusteringData> sparseData = nullptr;
+	CPtr<IClusteringData> denseData = nullptr;
+	generateData( 4096, 16, 0x2025, sparseData, denseData );
+
+	CKMeansClustering::CParam params;
+	params.DistanceFunc = DF_Euclid;
+	params.InitialClustersCount = 8;
+	params.MaxIterations = 100;
+	params.Initialization = CKMeansClustering::KMI_KMeansPlusPlus;
+	params.ThreadCount = 4;
+	params.Seed = 0x123;
+
+	params.Algo = CKMeansClustering::KMA_Lloyd;
+	CClusteringResult lloydResult;
+	CKMeansClustering( params ).Clusterize( denseData, lloydResult );
+
+	params.Algo = CKMeansClustering::KMA_MiniBatch;
+	params.MiniBatchSize = 256;
+	params.MaxIterations = 200;
+	CClusteringResult miniBatchResult;
+	CKMeansClustering( params ).Clusterize( denseData, miniBatchResult );
+	ASSERT_EQ( params.InitialClustersCount, miniBatchResult.ClusterCount );
+	ASSERT_EQ( denseData->GetVectorCount(), miniBatchResult.Data.Size() );
+
+	// Sparse data gives the same result
+	CClusteringResult sparseResult;
+	CKMeansClustering( params ).Clusterize( sparseData, sparseResult );
+	EXPECT_TRUE( isEqual( miniBatchResult, sparseResult ) );
+
+	auto calcInertia = [&denseData]( const CClusteringResult& result ) {
+		const CFloatMatrixDesc matrix = denseData->GetMatrix();
+		double inertia = 0;
+		for( int i = 0; i < matrix.Height; ++i ) {
+			const CFloatVector& mean = result.Clusters[result.Data[i]].Mean;
+			CFloatVector diff( matrix.Width, matrix.GetRow( i ) );
+			diff -= mean;
+			inertia += DotProduct( diff, diff );
+		}
+		return inertia;
+	};
+	EXPECT_LT( calcInertia( miniBatchResult ), 1.05 * calcInertia( lloydResult ) );
+
+	// The variances are the mean squared deviations from the centers
+	const CFloatMatrixDesc matrix = denseData->GetMatrix();
+	CArray<double> sumOfSquares;
+	sumOfSquares.Add( 0., miniBatchResult.ClusterCount * matrix.Width );
+	CArray<int> clusterSizes;
+	clusterSizes.Add( 0, miniBatchResult.ClusterCount );
+	for( int i = 0; i < matrix.Height; ++i ) {
+		const int c = miniBatchResult.Data[i];
+		CFloatVector diff( matrix.Width, matrix.GetRow( i ) );
+		diff -= miniBatchResult.Clusters[c].Mean;
+		for( int j = 0; j < matrix.Width; ++j ) {
+			sumOfSquares[c * matrix.Width + j] += diff[j] * diff[j];
+		}
+		clusterSizes[c]++;
+	}
+	for( int c = 0; c < miniBatchResult.ClusterCount; ++c ) {
+		const CFloatVector& disp = miniBatchResult.Clusters[c].Disp;
+		for( int j = 0; j < matrix.Width; ++j ) {
+			EXPECT_GE( disp[j], 0.f );
+			const double expected = clusterSizes[c] > 0 ? sumOfSquares[c * matrix.Width + j] / clusterSizes[c] : 0.;
+			EXPECT_NEAR( expected, disp[j], 1e-4 * ( 1. + expected ) );
+		}
+	}
 }
 
 // Returns data with a specific dendrogram (only Distances may vary)
@@ -581,7 +695,9 @@ INSTANTIATE_TEST_CASE_P( CClusteringTestInstantiation, CClusteringTest,
 		hierarchicalClustering<CHierarchicalClustering::L_Ward>,
 		isoDataClustering,
 		kmeansElkanClustering,
-		kmeansLloydClustering
+		kmeansLloydClustering,
+		kmeansHamerlyClustering,
+		kmeansMiniBatchClustering
 	)
 );
 
@@ -18,6 +18,9 @@ limitations under the License.
 
 #include <memory>
 #include <cmath>
+#include <map>
+#include <stdexcept>
+#include <vector>
 
 #include <TestFixture.h>
 
@@ -967,3 +970,253 @@ INSTANTIATE_TEST_CASE_P( CCtcTestInstantiation, CCtcTest,
 		)
 	)
 );
+
+//---------------------------------------------------------------------------------------------------------------------
+
+namespace NeoMLTest {
+
+// The scorer which depends on the label and on the previous one
+class CCtcTestLabelScorer : public ICtcLabelScorer {
+public:
+	float GetLogScore( const int* prefix, int prefixLength, int label ) const override
+	{
+		const float bonus = prefixLength > 0 && prefix[prefixLength - 1] < label ? 0.3f : 0.f;
+		return -0.5f * label + bonus;
+	}
+};
+
+// The scorer which fails on the given label
+class CCtcFailingLabelScorer : public ICtcLabelScorer {
+public:
+	explicit CCtcFailingLabelScorer( int _failingLabel ) : failingLabel( _failingLabel ) {}
+
+	float GetLogScore( const int*, int, int label ) const override
+	{
+		if( label == failingLabel ) {
+			throw std::runtime_error( "label scorer failure" );
+		}
+		return 0.f;
+	}
+
+private:
+	const int failingLabel;
+};
+
+} // namespace NeoMLTest
+
+// Finds the best label sequence by enumerating all the paths
+static float ctcBeamSearchNaiveDecode( const float* logits, int sequenceLength, int labelsCount, int blankLabel,
+	const ICtcLabelScorer* scorer, CArray<int>& bestSequence )
+{
+	std::vector<double> logProbs( sequenceLength * labelsCount );
+	for( int pos = 0; pos < sequenceLength; ++pos ) {
+		double sum = 0;
+		for( int label = 0; label < labelsCount; ++label ) {
+			sum += std::exp( static_cast<double>( logits[pos * labelsCount + label] ) );
+		}
+		for( int label = 0; label < labelsCount; ++label ) {
+			logProbs[pos * labelsCount + label] = logits[pos * labelsCount + label] - std::log( sum );
+		}
+	}
+
+	// The probability of each label sequence
+	std::map<std::vector<int>, double> probs;
+	std::vector<int> path( sequenceLength, 0 );
+	while( true ) {
+		std::vector<int> sequence;
+		double logProb = 0;
+		for( int pos = 0; pos < sequenceLength; ++pos ) {
+			logProb += logProbs[pos * labelsCount + path[pos]];
+			if( path[pos] != blankLabel && ( pos == 0 || path[pos] != path[pos - 1] ) ) {
+				sequence.push_back( path[pos] );
+			}
+		}
+		probs[sequence] += std::exp( logProb );
+
+		int pos = 0;
+		while( pos < sequenceLength && ++path[pos] == labelsCount ) {
+			path[pos++] = 0;
+		}
+		if( pos == sequenceLength ) {
+			break;
+		}
+	}
+
+	double bestScore = -FLT_MAX;
+	for( const auto& prob : probs ) {
+		double score = std::log( prob.second );
+		for( size_t i = 0; scorer != nullptr && i < prob.first.size(); ++i ) {
+			score += scorer->GetLogScore( prob.first.data(), static_cast<int>( i ), prob.first[i] );
+		}
+		if( score > bestScore ) {
+			bestScore = score;
+			bestSequence.DeleteAll();
+			for( int label : prob.first ) {
+				bestSequence.Add( label );
+			}
+		}
+	}
+	return static_cast<float>( bestScore );
+}
+
+static CPtr<CCtcDecodingLayer> buildCtcBeamSearchDnn( CDnn& dnn, const CArray<float>& logits, int sequenceLength,
+	int batchWidth, int labelsCount, const CArray<int>* lengths )
+{
+	CPtr<CSourceLayer> result = Source( dnn, "result" );
+	CPtr<CDnnBlob> resultBlob = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, sequenceLength, batchWidth, labelsCount );
+	resultBlob->CopyFrom( logits.GetPtr() );
+	result->SetBlob( resultBlob );
+
+	CPtr<CCtcDecodingLayer> decoding = new CCtcDecodingLayer( MathEngine() );
+	decoding->SetName( "decoding" );
+	decoding->Connect( 0, *result );
+	if( lengths != nullptr ) {
+		CPtr<CSourceLayer> lengthsSource = Source( dnn, "lengths" );
+		CPtr<CDnnBlob> lengthsBlob = CDnnBlob::CreateDataBlob( MathEngine(), CT_Int, 1, batchWidth, 1 );
+		lengthsBlob->CopyFrom( lengths->GetPtr() );
+		lengthsSource->SetBlob( lengthsBlob );
+		decoding->Connect( 1, *lengthsSource );
+	}
+	dnn.AddLayer( *decoding );
+	return decoding;
+}
+
+// Gets the logits of the given sequence from the (BatchLength, BatchWidth, labels) array
+static void getCtcBeamSearchSequenceLogits( const CArray<float>& logits, int sequenceNumber, int sequenceLength,
+	int batchWidth, int labelsCount, CArray<float>& sequenceLogits )
+{
+	sequenceLogits.DeleteAll();
+	for( int pos = 0; pos < sequenceLength; ++pos ) {
+		for( int label = 0; label < labelsCount; ++label ) {
+			sequenceLogits.Add( logits[( pos * batchWidth + sequenceNumber ) * labelsCount + label] );
+		}
+	}
+}
+
+static void ctcBeamSearchExactTest( const ICtcLabelScorer* scorer )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	const int sequenceLength = 5;
+	const int batchWidth = 6;
+	const int labelsCount = 4;
+	CRandom random( 0x6543 );
+	CArray<float> logits;
+	for( int i = 0; i < sequenceLength * batchWidth * labelsCount; ++i ) {
+		logits.Add( static_cast<float>( random.Uniform( -2, 2 ) ) );
+	}
+
+	CDnn dnn( random, MathEngine() );
+	CPtr<CCtcDecodingLayer> decoding = buildCtcBeamSearchDnn( dnn, logits, sequenceLength, batchWidth,
+		labelsCount, nullptr );
+	decoding->SetBlankLabel( 1 );
+	// The beam is wide enough to keep all the prefixes
+	decoding->SetBeamWidth( 1000 );
+	decoding->SetBeamLabelProbabilityThreshold( 0 );
+	decoding->SetLabelScorer( scorer );
+	dnn.RunOnce();
+
+	for( int i = 0; i < batchWidth; ++i ) {
+		CArray<float> sequenceLogits;
+		getCtcBeamSearchSequenceLogits( logits, i, sequenceLength, batchWidth, labelsCount, sequenceLogits );
+		CArray<int> expected;
+		const float expectedScore = ctcBeamSearchNaiveDecode( sequenceLogits.GetPtr(), sequenceLength,
+			labelsCount, 1, scorer, expected );
+
+		CArray<int> actual;
+		const float actualScore = decoding->GetBeamSearchSequence( i, actual );
+		EXPECT_NEAR( expectedScore, actualScore, 1e-4f ) << i;
+		ASSERT_EQ( expected.Size(), actual.Size() ) << i;
+		for( int j = 0; j < expected.Size(); ++j ) {
+			EXPECT_EQ( expected[j], actual[j] ) << i;
+		}
+	}
+}
+
+TEST( CCtcDecodingLayerTest, BeamSearchExact )
+{
+	ctcBeamSearchExactTest( nullptr );
+}
+
+TEST( CCtcDecodingLayerTest, BeamSearchScorer )
+{
+	CCtcTestLabelScorer scorer;
+	ctcBeamSearchExactTest( &scorer );
+}
+
+TEST( CCtcDecodingLayerTest, BeamSearchBatch )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	const int sequenceLength = 30;
+	const int batchWidth = 17;
+	const int labelsCount = 12;
+	CRandom random( 0x3456 );
+	CArray<float> logits;
+	for( int i = 0; i < sequenceLength * batchWidth * labelsCount; ++i ) {
+		logits.Add( static_cast<float>( random.Uniform( -3, 3 ) ) );
+	}
+	CArray<int> lengths;
+	for( int i = 0; i < batchWidth; ++i ) {
+		lengths.Add( random.UniformInt( 0, sequenceLength ) );
+	}
+
+	CDnn dnn( random, MathEngine() );
+	CPtr<CCtcDecodingLayer> decoding = buildCtcBeamSearchDnn( dnn, logits, sequenceLength, batchWidth,
+		labelsCount, &lengths );
+	CCtcTestLabelScorer scorer;
+	decoding->SetLabelScorer( &scorer );
+	decoding->SetBeamWidth( 8 );
+	dnn.RunOnce();
+
+	CArray<CArray<int>> expected;
+	expected.SetSize( batchWidth );
+	for( int i = 0; i < batchWidth; ++i ) {
+		decoding->GetBeamSearchSequence( i, expected[i] );
+		EXPECT_TRUE( lengths[i] > 0 || expected[i].IsEmpty() );
+	}
+	for( int threadCount : { 1, 4 } ) {
+		CArray<CArray<int>> actual;
+		decoding->GetBeamSearchSequences( actual, threadCount );
+		ASSERT_EQ( batchWidth, actual.Size() );
+		for( int i = 0; i < batchWidth; ++i ) {
+			ASSERT_EQ( expected[i].Size(), actual[i].Size() ) << i;
+			for( int j = 0; j < expected[i].Size(); ++j ) {
+				EXPECT_EQ( expected[i][j], actual[i][j] ) << i;
+			}
+		}
+	}
+}
+
+TEST( CCtcDecodingLayerTest, BeamSearchScorerException )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	const int sequenceLength = 10;
+	const int batchWidth = 8;
+	const int labelsCount = 5;
+	CRandom random( 0x7654 );
+	CArray<float> logits;
+	for( int i = 0; i < sequenceLength * batchWidth * labelsCount; ++i ) {
+		logits.Add( static_cast<float>( random.Uniform( -3, 3 ) ) );
+	}
+
+	CDnn dnn( random, MathEngine() );
+	CPtr<CCtcDecodingLayer> decoding = buildCtcBeamSearchDnn( dnn, logits, sequenceLength, batchWidth,
+		labelsCount, nullptr );
+	CCtcFailingLabelScorer scorer( 3 );
+	decoding->SetLabelScorer( &scorer );
+	dnn.RunOnce();
+
+	// The exception from the scorer is passed to the caller from any thread
+	for( int threadCount : { 1, 4 } ) {
+		CArray<CArray<int>> sequences;
+		EXPECT_THROW( decoding->GetBeamSearchSequences( sequences, threadCount ), std::runtime_error ) << threadCount;
+	}
+}
@@ -0,0 +1,148 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+#include <thread>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static const int batchingTestInputSize = 4;
+
+// source -> fully connected -> sink; the fully connected layer processes each object separately
+static void buildBatchingTestDnn( CDnn& dnn )
+{
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 3 )( "fc", data.Ptr() );
+	Sink( fc.Ptr(), "sink" );
+}
+
+// Runs the network on a single request
+static CPtr<CDnnBlob> runBatchingTestDnn( CDnn& dnn, CDnnBlob* input )
+{
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob( input );
+	dnn.RunOnce();
+	return CheckCast<CSinkLayer>( dnn.GetLayer( "sink" ) )->GetBlob()->GetCopy();
+}
+
+static void checkBatchingTestResult( CDnnBlob& expected, CDnnBlob& actual )
+{
+	ASSERT_TRUE( expected.HasEqualDimensions( &actual ) );
+	CArray<float> expectedData;
+	GetBlobData( expected, expectedData );
+	CArray<float> actualData;
+	GetBlobData( actual, actualData );
+	ExpectDataNear( expectedData, actualData );
+}
+
+TEST( CDnnBatchingExecutorTest, MultipleThreads )
+{
+	const int threadCount = 4;
+	const int requestsPerThread = 8;
+
+	CRandom random( 0x123 );
+	CDnn dnn( random, MathEngine() );
+	buildBatchingTestDnn( dnn );
+
+	// Requests of different width and sequence length
+	CObjectArray<CDnnBlob> inputs;
+	CObjectArray<CDnnBlob> expected;
+	for( int i = 0; i < threadCount * requestsPerThread; ++i ) {
+		inputs.Add( CreateRandomDataBlob( random, 1 + i % 3, 1 + i % 2, batchingTestInputSize ) );
+		expected.Add( runBatchingTestDnn( dnn, inputs.Last() ) );
+	}
+
+	CObjectArray<CDnnBlob> results;
+	results.SetSize( inputs.Size() );
+	int runCount = 0;
+	{
+		CDnnBatchingExecutor executor( dnn, /*maxBatchSize*/8, /*maxQueueDelay*/20000 );
+		ASSERT_EQ( 1, executor.GetSourceNames().Size() );
+		ASSERT_EQ( 1, executor.GetSinkNames().Size() );
+
+		std::vector<std::thread> threads;
+		for( int thread = 0; thread < threadCount; ++thread ) {
+			threads.emplace_back( [&, thread] {
+				for( int i = thread * requestsPerThread; i < ( thread + 1 ) * requestsPerThread; ++i ) {
+					CObjectArray<CDnnBlob> request;
+					request.Add( inputs[i] );
+					results[i] = executor.Submit( request ).get()->GetOutput( 0 );
+				}
+			} );
+		}
+		for( std::thread& thread : threads ) {
+			thread.join();
+		}
+		runCount = executor.GetRunCount();
+	}
+
+	EXPECT_LT( runCount, inputs.Size() );
+	for( int i = 0; i < inputs.Size(); ++i ) {
+		checkBatchingTestResult( *expected[i], *results[i] );
+	}
+}
+
+TEST( CDnnBatchingExecutorTest, Buckets )
+{
+	CRandom random( 0x321 );
+	CDnn dnn( random, MathEngine() );
+	buildBatchingTestDnn( dnn );
+
+	CObjectArray<CDnnBlob> inputs;
+	CObjectArray<CDnnBlob> expected;
+	for( int i = 0; i < 6; ++i ) {
+		inputs.Add( CreateRandomDataBlob( random, i % 2 == 0 ? 2 : 5, 1, batchingTestInputSize ) );
+		expected.Add( runBatchingTestDnn( dnn, inputs.Last() ) );
+	}
+
+	CDnnBatchingExecutor executor( dnn, /*maxBatchSize*/3, /*maxQueueDelay*/1000000 );
+	std::vector<std::future<CPtr<CDnnBatchingResult>>> futures;
+	for( int i = 0; i < inputs.Size(); ++i ) {
+		CObjectArray<CDnnBlob> request;
+		request.Add( inputs[i] );
+		futures.push_back( executor.Submit( request ) );
+	}
+	for( int i = 0; i < inputs.Size(); ++i ) {
+		checkBatchingTestResult( *expected[i], *futures[i].get()->GetOutput( 0 ) );
+	}
+	// Each sequence length fills its own batch
+	EXPECT_EQ( 2, executor.GetRunCount() );
+}
+
+TEST( CDnnBatchingExecutorTest, Exception )
+{
+	CRandom random( 0x231 );
+	CDnn dnn( random, MathEngine() );
+	buildBatchingTestDnn( dnn );
+	CPtr<CDnnBlob> input = CreateRandomDataBlob( random, 1, 2, batchingTestInputSize );
+	CPtr<CDnnBlob> expected = runBatchingTestDnn( dnn, input );
+
+	CDnnBatchingExecutor executor( dnn, /*maxBatchSize*/4, /*maxQueueDelay*/0 );
+	// The input size doesn't match the fully connected layer weights
+	CObjectArray<CDnnBlob> request;
+	request.Add( CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, 1, batchingTestInputSize + 1 ) );
+	request[0]->Fill( 1.f );
+	std::future<CPtr<CDnnBatchingResult>> result = executor.Submit( request );
+	EXPECT_ANY_THROW( result.get() );
+
+	// The executor still works after the failed batch
+	request[0] = input;
+	checkBatchingTestResult( *expected, *executor.Submit( request ).get()->GetOutput( 0 ) );
+}
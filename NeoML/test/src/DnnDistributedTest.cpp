@@ -1,4 +1,4 @@
-/* Copyright © 2021-2023 ABBYY
+/* Copyright © 2021-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -226,3 +226,55 @@ TEST( CDnnDistributedTest, DnnDistributedAutoThreadCountTest )
 	ASSERT_LT( 0, distributed.GetModelCount() );
 	ASSERT_EQ( GetAvailableCpuCores(), distributed.GetModelCount() );
 }
+
+// Builds the net with many small parameter blobs (reduced together in buckets) and one large one
+static void buildBucketsDnn( CDnn& cnn, int inputSize, int outputSize )
+{
+	CSourceLayer* data = Source( cnn, "in" );
+	CBaseLayer* last = FullyConnected( 300 )( "large", data );
+	for( int i = 0; i < 20; ++i ) {
+		last = FullyConnected( 7 + i % 3 )( ( "small" + Str( i ) ).c_str(), last );
+	}
+	CFullyConnectedLayer* full = FullyConnected( outputSize )( "full", last );
+	CSourceLayer* label = Source( cnn, "label" );
+	EuclideanLoss()( "loss", full, label );
+	Sink( full, "sink" );
+
+	CPtr<CDnnAdaptiveGradientSolver> solver = new CDnnAdaptiveGradientSolver( cnn.GetMathEngine() );
+	cnn.SetSolver( solver.Ptr() );
+	NeoAssert( inputSize * 300 > ( 1 << 18 ) );
+}
+
+TEST( CDnnDistributedTest, DnnDistributedBucketsTest )
+{
+	std::unique_ptr<IMathEngine> mathEngine( CreateCpuMathEngine( /*memoryLimit*/0u ) );
+	CRandom rand( 42 );
+
+	const int inputSize = 1000;
+	const int outputSize = 5;
+	CDnn cnn( rand, *mathEngine );
+	buildBucketsDnn( cnn, inputSize, outputSize );
+
+	CDistributedTraining distributed( cnn, 3 );
+	CCustomDataset dataset( inputSize, outputSize );
+	for( int i = 0; i < 3; ++i ) {
+		distributed.RunAndLearnOnce( dataset );
+	}
+	distributed.RunOnce( dataset );
+
+	CArray<float> losses;
+	distributed.GetLastLoss( "loss", losses );
+	ASSERT_EQ( 3, losses.Size() );
+	ASSERT_EQ( losses[0], losses[1] );
+	ASSERT_EQ( losses[0], losses[2] );
+
+	// All the threads process the same data, so the result must be the same as without distributed training
+	for( int i = 0; i < 3; ++i ) {
+		dataset.SetInputBatch( cnn, 0 );
+		cnn.RunAndLearnOnce();
+	}
+	dataset.SetInputBatch( cnn, 0 );
+	cnn.RunOnce();
+	const float loss = CheckCast<CLossLayer>( cnn.GetLayer( "loss" ) )->GetLastLoss();
+	ASSERT_NEAR( loss, losses[0], 1e-5 * fabsf( loss ) );
+}
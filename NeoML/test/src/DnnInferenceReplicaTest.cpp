@@ -0,0 +1,235 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+#include <memory>
+#include <thread>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static const int replicaTestSequenceLength = 3;
+static const int replicaTestBatchWidth = 4;
+static const int replicaTestVectorCount = 10;
+
+// data -> lstm -> fc -> batch normalization -> concat -> sink
+// ids -> embeddings ----------------------------^
+static void buildReplicaTestDnn( CDnn& dnn )
+{
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	CPtr<CLstmLayer> lstm = new CLstmLayer( MathEngine() );
+	lstm->SetName( "lstm" );
+	lstm->SetHiddenSize( 5 );
+	lstm->Connect( *data );
+	dnn.AddLayer( *lstm );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 4 )( "fc", lstm.Ptr() );
+	CPtr<CBatchNormalizationLayer> batchNorm = BatchNormalization( true )( "batchNorm", fc.Ptr() );
+
+	CPtr<CSourceLayer> ids = Source( dnn, "ids" );
+	CPtr<CMultichannelLookupLayer> embeddings = Embeddings( replicaTestVectorCount, 3 )( "embeddings", ids.Ptr() );
+
+	CPtr<CConcatChannelsLayer> concat = ConcatChannels()( "concat", batchNorm.Ptr(), embeddings.Ptr() );
+	Sink( concat.Ptr(), "sink" );
+}
+
+static void setReplicaTestInputs( CDnn& dnn, CRandom& random )
+{
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob(
+		CreateRandomDataBlob( random, replicaTestSequenceLength, replicaTestBatchWidth, 6 ) );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "ids" ) )->SetBlob( CreateRandomIntDataBlob( random,
+		replicaTestSequenceLength, replicaTestBatchWidth, 1, replicaTestVectorCount - 1 ) );
+}
+
+TEST( CDnnInferenceReplicaTest, SharedParams )
+{
+	CRandom random( 0x5a5a );
+	CDnn dnn( random, MathEngine() );
+	buildReplicaTestDnn( dnn );
+	setReplicaTestInputs( dnn, random );
+	// The parameters are initialized on the first run
+	dnn.RunOnce();
+	CArray<float> expected;
+	GetSinkData( dnn, "sink", expected );
+
+	CRandom replicaRandom( 0x1234 );
+	std::unique_ptr<CDnn> replica( dnn.CreateInferenceReplica( replicaRandom ) );
+	EXPECT_TRUE( replica->IsInferenceReplica() );
+	EXPECT_FALSE( dnn.IsInferenceReplica() );
+	EXPECT_FALSE( replica->IsLearningEnabled() );
+
+	CPtr<CFullyConnectedLayer> fc = CheckCast<CFullyConnectedLayer>( dnn.GetLayer( "fc" ) );
+	CPtr<CFullyConnectedLayer> replicaFc = CheckCast<CFullyConnectedLayer>( replica->GetLayer( "fc" ) );
+	EXPECT_EQ( fc->Weights(), replicaFc->Weights() );
+	EXPECT_EQ( fc->FreeTerms(), replicaFc->FreeTerms() );
+	EXPECT_EQ( CheckCast<CMultichannelLookupLayer>( dnn.GetLayer( "embeddings" ) )->GetEmbeddings( 0 ),
+		CheckCast<CMultichannelLookupLayer>( replica->GetLayer( "embeddings" ) )->GetEmbeddings( 0 ) );
+	// The internal layers of the composite are shared too
+	CArray<CString> path = { "lstm", "InputHidden" };
+	EXPECT_EQ( CheckCast<CFullyConnectedLayer>( dnn.GetLayer( path ) )->Weights(),
+		CheckCast<CFullyConnectedLayer>( replica->GetLayer( path ) )->Weights() );
+
+	// The original network is still intact
+	dnn.RunOnce();
+	CArray<float> output;
+	GetSinkData( dnn, "sink", output );
+	ExpectDataNear( expected, output );
+
+	CopySourceBlobs( dnn, *replica );
+	replica->RunOnce();
+	GetSinkData( *replica, "sink", output );
+	ExpectDataNear( expected, output );
+
+	// The change of the shared parameters is visible in the replica
+	fc->Weights()->Fill( 0.5f );
+	dnn.RunOnce();
+	GetSinkData( dnn, "sink", expected );
+	replica->RunOnce();
+	GetSinkData( *replica, "sink", output );
+	ExpectDataNear( expected, output );
+}
+
+TEST( CDnnInferenceReplicaTest, Learning )
+{
+	CRandom random( 0x5a5b );
+	CDnn dnn( random, MathEngine() );
+	buildReplicaTestDnn( dnn );
+	setReplicaTestInputs( dnn, random );
+	dnn.RunOnce();
+
+	std::unique_ptr<CDnn> replica( dnn.CreateInferenceReplica( random ) );
+	setReplicaTestInputs( *replica, random );
+	EXPECT_ANY_THROW( replica->RunAndBackwardOnce() );
+	EXPECT_ANY_THROW( replica->RunAndLearnOnce() );
+	EXPECT_ANY_THROW( replica->EnableLearning() );
+	EXPECT_FALSE( replica->IsLearningEnabled() );
+	// The inference still works
+	replica->RunOnce();
+}
+
+TEST( CDnnInferenceReplicaTest, MultipleThreads )
+{
+	const int replicaCount = 3;
+	const int runCount = 10;
+
+	CRandom random( 0x5a5c );
+	CDnn dnn( random, MathEngine() );
+	buildReplicaTestDnn( dnn );
+	setReplicaTestInputs( dnn, random );
+	dnn.RunOnce();
+
+	CArray<CRandom> randoms;
+	randoms.SetSize( replicaCount );
+	std::vector<std::unique_ptr<CDnn>> replicas;
+	for( int i = 0; i < replicaCount; ++i ) {
+		replicas.emplace_back( dnn.CreateInferenceReplica( randoms[i] ) );
+	}
+
+	// The inputs and the expected outputs of each run of each network
+	const int dnnCount = replicaCount + 1;
+	CArray<CDnn*> dnns;
+	dnns.Add( &dnn );
+	for( int i = 0; i < replicaCount; ++i ) {
+		dnns.Add( replicas[i].get() );
+	}
+	CObjectArray<CDnnBlob> dataInputs;
+	CObjectArray<CDnnBlob> idsInputs;
+	CArray<CArray<float>> expected;
+	expected.SetSize( dnnCount * runCount );
+	for( int i = 0; i < dnnCount * runCount; ++i ) {
+		setReplicaTestInputs( dnn, random );
+		dataInputs.Add( CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->GetBlob() );
+		idsInputs.Add( CheckCast<CSourceLayer>( dnn.GetLayer( "ids" ) )->GetBlob() );
+		dnn.RunOnce();
+		GetSinkData( dnn, "sink", expected[i] );
+	}
+
+	CArray<CArray<float>> outputs;
+	outputs.SetSize( dnnCount * runCount );
+	std::vector<std::thread> threads;
+	for( int thread = 0; thread < dnnCount; ++thread ) {
+		threads.emplace_back( [&, thread] {
+			CDnn& threadDnn = *dnns[thread];
+			for( int run = 0; run < runCount; ++run ) {
+				const int index = thread * runCount + run;
+				CheckCast<CSourceLayer>( threadDnn.GetLayer( "data" ) )->SetBlob( dataInputs[index] );
+				CheckCast<CSourceLayer>( threadDnn.GetLayer( "ids" ) )->SetBlob( idsInputs[index] );
+				threadDnn.RunOnce();
+				GetSinkData( threadDnn, "sink", outputs[index] );
+			}
+		} );
+	}
+	for( std::thread& thread : threads ) {
+		thread.join();
+	}
+
+	for( int i = 0; i < dnnCount * runCount; ++i ) {
+		ExpectDataNear( expected[i], outputs[i] );
+	}
+}
+
+TEST( CDnnInferenceReplicaTest, CreateWhileRunning )
+{
+	const int replicaCount = 4;
+	const int runCount = 20;
+
+	CRandom random( 0x5a5d );
+	CDnn dnn( random, MathEngine() );
+	buildReplicaTestDnn( dnn );
+	setReplicaTestInputs( dnn, random );
+	dnn.RunOnce();
+	// The batch normalization final params become out of date after the backward pass
+	dnn.RunAndBackwardOnce();
+
+	// The original network is not changed while the replicas are created
+	CArray<CArray<float>> outputs;
+	outputs.SetSize( runCount );
+	std::thread runThread( [&] {
+		for( int run = 0; run < runCount; ++run ) {
+			dnn.RunOnce();
+			GetSinkData( dnn, "sink", outputs[run] );
+		}
+	} );
+	CArray<CRandom> randoms;
+	randoms.SetSize( replicaCount );
+	std::vector<std::unique_ptr<CDnn>> replicas;
+	replicas.resize( replicaCount );
+	std::vector<std::thread> createThreads;
+	for( int i = 0; i < replicaCount; ++i ) {
+		createThreads.emplace_back( [&, i] { replicas[i].reset( dnn.CreateInferenceReplica( randoms[i] ) ); } );
+	}
+	for( std::thread& thread : createThreads ) {
+		thread.join();
+	}
+	runThread.join();
+
+	dnn.RunOnce();
+	CArray<float> expected;
+	GetSinkData( dnn, "sink", expected );
+	for( int run = 0; run < runCount; ++run ) {
+		ExpectDataNear( expected, outputs[run] );
+	}
+	for( int i = 0; i < replicaCount; ++i ) {
+		CopySourceBlobs( dnn, *replicas[i] );
+		replicas[i]->RunOnce();
+		CArray<float> output;
+		GetSinkData( *replicas[i], "sink", output );
+		ExpectDataNear( expected, output );
+	}
+}
@@ -1574,6 +1574,9 @@ inline void checkSpecificParams<CCtcDecodingLayer>( CCtcDecodingLayer& layer )
 	ASSERT_NEAR( 0.5, layer.GetArcProbabilityThreshold(), 1e-3 );
 	ASSERT_NEAR( 0.75, layer.GetBlankProbabilityThreshold(), 1e-3 );
 	ASSERT_EQ( 2, layer.GetBlankLabel() );
+	// The beam search settings are not stored in the old archives
+	ASSERT_EQ( 16, layer.GetBeamWidth() );
+	ASSERT_NEAR( 0.001, layer.GetBeamLabelProbabilityThreshold(), 1e-6 );
 }
 
 #ifdef GENERATE_SERIALIZATION_FILES
@@ -1979,6 +1982,37 @@ GTEST_TEST( SerializeFromFile, MultiheadAttentionLayerSerialization )
 
 // ====================================================================================================================
 
+// CScaledDotProductAttentionLayer
+
+#ifdef GENERATE_SERIALIZATION_FILES
+
+static void setSpecificParams( CScaledDotProductAttentionLayer& layer )
+{
+	layer.SetHeadCount( 5 );
+	layer.SetScale( 0.25f );
+}
+
+GTEST_TEST( SerializeToFile, ScaledDotProductAttentionLayerSerialization )
+{
+	serializeToFile<CScaledDotProductAttentionLayer>( "NeoMLDnnScaledDotProductAttentionLayer" );
+}
+
+#endif // GENERATE_SERIALIZATION_FILES
+
+template<>
+inline void checkSpecificParams<CScaledDotProductAttentionLayer>( CScaledDotProductAttentionLayer& layer )
+{
+	EXPECT_EQ( 5, layer.GetHeadCount() );
+	EXPECT_NEAR( 0.25f, layer.GetScale(), 1e-5f );
+}
+
+GTEST_TEST( SerializeFromFile, ScaledDotProductAttentionLayerSerialization )
+{
+	checkSerializeLayer<CScaledDotProductAttentionLayer>( "NeoMLDnnScaledDotProductAttentionLayer" );
+}
+
+// ====================================================================================================================
+
 // CParameterLayer
 
 #ifdef GENERATE_SERIALIZATION_FILES
@@ -0,0 +1,196 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+#include <cstdio>
+#include <thread>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static const int mappedTestBatchWidth = 8;
+static const int mappedTestVectorCount = 10;
+
+// data -> fc -> batch normalization -> concat -> sink
+// ids -> embeddings ---------------------^        -> loss <- label
+static void buildMappedTestDnn( CDnn& dnn )
+{
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 4 )( "fc", data.Ptr() );
+	CPtr<CBatchNormalizationLayer> batchNorm = BatchNormalization( true )( "batchNorm", fc.Ptr() );
+
+	CPtr<CSourceLayer> ids = Source( dnn, "ids" );
+	CPtr<CMultichannelLookupLayer> embeddings = Embeddings( mappedTestVectorCount, 3 )( "embeddings", ids.Ptr() );
+
+	CPtr<CConcatChannelsLayer> concat = ConcatChannels()( "concat", batchNorm.Ptr(), embeddings.Ptr() );
+	Sink( concat.Ptr(), "sink" );
+	CPtr<CSourceLayer> label = Source( dnn, "label" );
+	EuclideanLoss()( "loss", concat.Ptr(), label.Ptr() );
+}
+
+static void setMappedTestInputs( CDnn& dnn, CRandom& random )
+{
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob(
+		CreateRandomDataBlob( random, 1, mappedTestBatchWidth, 6 ) );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "ids" ) )->SetBlob(
+		CreateRandomIntDataBlob( random, 1, mappedTestBatchWidth, 1, mappedTestVectorCount - 1 ) );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "label" ) )->SetBlob(
+		CreateRandomDataBlob( random, 1, mappedTestBatchWidth, 7 ) );
+}
+
+// Creates the trained network and stores it into the mapped file
+static void storeMappedTestDnn( CDnn& dnn, CRandom& random, const char* fileName )
+{
+	buildMappedTestDnn( dnn );
+	dnn.SetSolver( new CDnnSimpleGradientSolver( MathEngine() ) );
+	for( int i = 0; i < 3; ++i ) {
+		setMappedTestInputs( dnn, random );
+		dnn.RunAndLearnOnce();
+	}
+	dnn.StoreMapped( fileName );
+}
+
+TEST( CDnnMappedFileTest, StoreLoad )
+{
+	// The tests may be run in parallel
+	const char* fileName = "dnnMappedStoreLoad.bin";
+	CRandom random( 0x7a7a );
+	CDnn dnn( random, MathEngine() );
+	storeMappedTestDnn( dnn, random, fileName );
+	dnn.RunOnce();
+	CArray<float> expected;
+	GetSinkData( dnn, "sink", expected );
+
+	{
+		CRandom loadedRandom( 0x7a7b );
+		CDnn loaded( loadedRandom, MathEngine() );
+		loaded.LoadMapped( fileName );
+		EXPECT_EQ( dnn.IsLearningEnabled(), loaded.IsLearningEnabled() );
+		CopySourceBlobs( dnn, loaded );
+		loaded.RunOnce();
+		CArray<float> output;
+		GetSinkData( loaded, "sink", output );
+		ExpectDataNear( expected, output );
+
+		if( MathEngine().GetType() == MET_Cpu ) {
+			// The parameters use the page-aligned memory of the mapped file
+			CPtr<CDnnBlob> weights = CheckCast<CFullyConnectedLayer>( loaded.GetLayer( "fc" ) )->Weights();
+			CDnnBlobBuffer<float> buffer( *weights, TDnnBlobBufferAccess::Read );
+			EXPECT_EQ( 0u, reinterpret_cast<size_t>( buffer.Ptr() ) % 4096 );
+		}
+	}
+
+	EXPECT_EQ( 0, std::remove( fileName ) );
+}
+
+TEST( CDnnMappedFileTest, Learning )
+{
+	const char* fileName = "dnnMappedLearning.bin";
+	CRandom random( 0x7a7c );
+	CDnn dnn( random, MathEngine() );
+	storeMappedTestDnn( dnn, random, fileName );
+	CArray<float> expectedWeights;
+	GetBlobData( *CheckCast<CFullyConnectedLayer>( dnn.GetLayer( "fc" ) )->Weights(), expectedWeights );
+
+	{
+		CDnn loaded( random, MathEngine() );
+		loaded.LoadMapped( fileName );
+		loaded.SetSolver( new CDnnSimpleGradientSolver( MathEngine() ) );
+		for( int i = 0; i < 3; ++i ) {
+			setMappedTestInputs( loaded, random );
+			loaded.RunAndLearnOnce();
+		}
+		CArray<float> weights;
+		GetBlobData( *CheckCast<CFullyConnectedLayer>( loaded.GetLayer( "fc" ) )->Weights(), weights );
+		ASSERT_EQ( expectedWeights.Size(), weights.Size() );
+		bool isChanged = false;
+		for( int i = 0; i < weights.Size(); ++i ) {
+			isChanged |= ( weights[i] != expectedWeights[i] );
+		}
+		EXPECT_TRUE( isChanged );
+
+		// The changes are not written into the file
+		CDnn reloaded( random, MathEngine() );
+		reloaded.LoadMapped( fileName );
+		GetBlobData( *CheckCast<CFullyConnectedLayer>( reloaded.GetLayer( "fc" ) )->Weights(), weights );
+		ExpectDataNear( expectedWeights, weights );
+	}
+
+	EXPECT_EQ( 0, std::remove( fileName ) );
+}
+
+TEST( CDnnMappedFileTest, BadFile )
+{
+	const char* fileName = "dnnMappedBadFile.bin";
+	CRandom random( 0x7a7d );
+	CDnn dnn( random, MathEngine() );
+	EXPECT_ANY_THROW( dnn.LoadMapped( fileName ) );
+
+	// The regular archive is not a mapped file
+	buildMappedTestDnn( dnn );
+	{
+		CArchiveFile file( fileName, CArchive::SD_Storing );
+		CArchive archive( &file, CArchive::SD_Storing );
+		dnn.Serialize( archive );
+	}
+	CDnn loaded( random, MathEngine() );
+	EXPECT_ANY_THROW( loaded.LoadMapped( fileName ) );
+
+	EXPECT_EQ( 0, std::remove( fileName ) );
+}
+
+TEST( CDnnMappedFileTest, StoreWhileRunning )
+{
+	const char* fileName = "dnnMappedStoreWhileRunning.bin";
+	const int runCount = 20;
+	CRandom random( 0x7a7d );
+	CDnn dnn( random, MathEngine() );
+	storeMappedTestDnn( dnn, random, fileName );
+	dnn.RunOnce();
+	CArray<float> expected;
+	GetSinkData( dnn, "sink", expected );
+
+	// The shared parameters stay in the network while it is stored
+	CArray<CArray<float>> outputs;
+	outputs.SetSize( runCount );
+	std::thread runThread( [&] {
+		for( int run = 0; run < runCount; ++run ) {
+			dnn.RunOnce();
+			GetSinkData( dnn, "sink", outputs[run] );
+		}
+	} );
+	dnn.StoreMapped( fileName );
+	runThread.join();
+	for( int run = 0; run < runCount; ++run ) {
+		ExpectDataNear( expected, outputs[run] );
+	}
+
+	{
+		CDnn loaded( random, MathEngine() );
+		loaded.LoadMapped( fileName );
+		CopySourceBlobs( dnn, loaded );
+		loaded.RunOnce();
+		CArray<float> output;
+		GetSinkData( loaded, "sink", output );
+		ExpectDataNear( expected, output );
+	}
+
+	EXPECT_EQ( 0, std::remove( fileName ) );
+}
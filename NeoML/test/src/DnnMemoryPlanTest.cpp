@@ -0,0 +1,126 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+namespace NeoMLTest {
+
+static const int memoryPlanTestLayerCount = 5;
+static const int memoryPlanTestLayerSize = 32;
+
+// The chain of fully-connected layers with the in-place activations and one branch
+static void buildMemoryPlanTestDnn( CDnn& dnn )
+{
+	CBaseLayer* last = Source( dnn, "data" );
+	for( int i = 0; i < memoryPlanTestLayerCount; ++i ) {
+		last = FullyConnected( memoryPlanTestLayerSize )( "fc" + Str( i ), last );
+		last = Relu()( "relu" + Str( i ), last );
+	}
+	CBaseLayer* branch = FullyConnected( 4 )( "branch", dnn.GetLayer( "relu1" ).Ptr() );
+	Sink( FullyConnected( 8 )( "head", last ), "sink" );
+	Sink( branch, "branchSink" );
+}
+
+static void setMemoryPlanTestInput( CDnn& dnn, CRandom& random, int batchSize )
+{
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob( CreateRandomDataBlob( random, 1, batchSize, 16 ) );
+}
+
+static void getMemoryPlanTestOutput( CDnn& dnn, CArray<float>& output )
+{
+	output.DeleteAll();
+	for( const char* sinkName : { "sink", "branchSink" } ) {
+		CPtr<CDnnBlob> blob = CheckCast<CSinkLayer>( dnn.GetLayer( sinkName ) )->GetBlob();
+		const int prevSize = output.Size();
+		output.SetSize( prevSize + blob->GetDataSize() );
+		blob->CopyTo( output.GetPtr() + prevSize );
+	}
+}
+
+static void checkMemoryPlanTestOutput( CDnn& dnn, CDnn& expectedDnn )
+{
+	CArray<float> expected;
+	getMemoryPlanTestOutput( expectedDnn, expected );
+	CArray<float> actual;
+	getMemoryPlanTestOutput( dnn, actual );
+	ExpectDataNear( expected, actual );
+}
+
+} // namespace NeoMLTest
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TEST( CDnnMemoryPlanTest, RunOnce )
+{
+	CRandom random( 0x345 );
+	CDnn expectedDnn( random, MathEngine() );
+	buildMemoryPlanTestDnn( expectedDnn );
+	// The weights are initialized on the first run
+	setMemoryPlanTestInput( expectedDnn, random, 1 );
+	expectedDnn.RunOnce();
+
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::store );
+		expectedDnn.Serialize( archive );
+	}
+	file.SeekToBegin();
+	CDnn dnn( random, MathEngine() );
+	{
+		CArchive archive( &file, CArchive::load );
+		dnn.Serialize( archive );
+	}
+	EXPECT_EQ( 0u, dnn.GetPlannedPeakMemory() );
+	dnn.EnableStaticMemoryPlanning( true );
+	EXPECT_TRUE( dnn.IsStaticMemoryPlanningEnabled() );
+
+	for( int batchSize : { 3, 3, 7, 2 } ) {
+		setMemoryPlanTestInput( expectedDnn, random, batchSize );
+		CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob(
+			CheckCast<CSourceLayer>( expectedDnn.GetLayer( "data" ) )->GetBlob() );
+
+		// The outputs of the layers which are not used at the same time share the memory
+		const size_t outputsSize = sizeof( float ) * batchSize
+			* ( memoryPlanTestLayerCount * memoryPlanTestLayerSize + 4 + 8 );
+		const size_t peakMemory = dnn.GetPlannedPeakMemory();
+		EXPECT_LT( 0u, peakMemory );
+		EXPECT_GT( outputsSize, peakMemory );
+
+		expectedDnn.RunOnce();
+		dnn.RunOnce();
+		checkMemoryPlanTestOutput( dnn, expectedDnn );
+		EXPECT_EQ( peakMemory, dnn.GetPlannedPeakMemory() );
+	}
+
+	// The backward pass doesn't use the plan
+	dnn.RunAndBackwardOnce();
+	expectedDnn.RunAndBackwardOnce();
+	checkMemoryPlanTestOutput( dnn, expectedDnn );
+	dnn.RunOnce();
+	expectedDnn.RunOnce();
+	checkMemoryPlanTestOutput( dnn, expectedDnn );
+
+	dnn.EnableStaticMemoryPlanning( false );
+	EXPECT_EQ( 0u, dnn.GetPlannedPeakMemory() );
+	dnn.RunOnce();
+	checkMemoryPlanTestOutput( dnn, expectedDnn );
+}
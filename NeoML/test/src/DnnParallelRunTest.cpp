@@ -0,0 +1,186 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static const int parallelRunTestInputSize = 8;
+static const int parallelRunTestTowerCount = 4;
+
+// data -> fc -> tower_i (fc -> relu -> fc) -> concat -> sink
+//           |-> relu --------------------------^
+// data -> lstm --------------------------------^     -> loss <- label
+static void buildParallelRunTestDnn( CDnn& dnn )
+{
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 16 )( "fc", data.Ptr() );
+
+	CArray<CBaseLayer*> branches;
+	for( int i = 0; i < parallelRunTestTowerCount; ++i ) {
+		const CString suffix = Str( i );
+		CPtr<CFullyConnectedLayer> towerIn = FullyConnected( 8 )( "towerIn" + suffix, fc.Ptr() );
+		CPtr<CReLULayer> relu = Relu()( "towerRelu" + suffix, towerIn.Ptr() );
+		branches.Add( FullyConnected( 4 )( "towerOut" + suffix, relu.Ptr() ) );
+	}
+	// This layer may not work in-place, as its input is used by the towers at the same time
+	branches.Add( Relu()( "relu", fc.Ptr() ) );
+
+	CPtr<CLstmLayer> lstm = new CLstmLayer( MathEngine() );
+	lstm->SetName( "lstm" );
+	lstm->SetHiddenSize( 5 );
+	lstm->Connect( *data );
+	dnn.AddLayer( *lstm );
+	branches.Add( lstm );
+
+	CPtr<CConcatChannelsLayer> concat = new CConcatChannelsLayer( MathEngine() );
+	concat->SetName( "concat" );
+	for( int i = 0; i < branches.Size(); ++i ) {
+		concat->Connect( i, *branches[i] );
+	}
+	dnn.AddLayer( *concat );
+	Sink( concat.Ptr(), "sink" );
+
+	CPtr<CSourceLayer> label = Source( dnn, "label" );
+	EuclideanLoss()( "loss", concat.Ptr(), label.Ptr() );
+}
+
+static void setParallelRunTestInputs( CDnn& dnn, CRandom& random )
+{
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob(
+		CreateRandomDataBlob( random, 3, 2, parallelRunTestInputSize ) );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "label" ) )->SetBlob(
+		CreateRandomDataBlob( random, 3, 2, parallelRunTestTowerCount * 4 + 16 + 5 ) );
+}
+
+static void runParallelRunTestDnn( CDnn& dnn, int threadCount, CArray<float>& output )
+{
+	dnn.SetRunThreadCount( threadCount );
+	dnn.RunOnce();
+	GetSinkData( dnn, "sink", output );
+}
+
+TEST( CDnnParallelRunTest, SameResults )
+{
+	CRandom random( 0x3c3c );
+	CDnn dnn( random, MathEngine() );
+	buildParallelRunTestDnn( dnn );
+
+	for( int run = 0; run < 5; ++run ) {
+		setParallelRunTestInputs( dnn, random );
+		CArray<float> expected;
+		runParallelRunTestDnn( dnn, 1, expected );
+		for( int threadCount : { 2, 4 } ) {
+			CArray<float> output;
+			runParallelRunTestDnn( dnn, threadCount, output );
+			EXPECT_EQ( threadCount, dnn.GetRunThreadCount() );
+			ASSERT_EQ( expected.Size(), output.Size() );
+			for( int i = 0; i < expected.Size(); ++i ) {
+				// Each layer runs on one thread, so the results are exactly the same
+				EXPECT_EQ( expected[i], output[i] ) << i;
+			}
+		}
+	}
+
+	dnn.SetRunThreadCount( 0 );
+	EXPECT_LE( 1, dnn.GetRunThreadCount() );
+}
+
+namespace NeoMLTest {
+
+// Passes the input to the output; fails in RunOnce if requested
+class CParallelRunTestFailingLayer : public CBaseLayer {
+public:
+	explicit CParallelRunTestFailingLayer( IMathEngine& mathEngine ) :
+		CBaseLayer( mathEngine, "CParallelRunTestFailingLayer", false ), isFailing( false ) {}
+
+	void SetFailing( bool failing ) { isFailing = failing; }
+
+	void Serialize( CArchive& /* archive */ ) override { NeoAssert( false ); }
+
+protected:
+	void Reshape() override { inputDescs.CopyTo( outputDescs ); }
+	void RunOnce() override
+	{
+		NeoAssert( !isFailing );
+		outputBlobs[0]->CopyFrom( inputBlobs[0] );
+	}
+	void BackwardOnce() override { NeoAssert( false ); }
+
+private:
+	bool isFailing;
+};
+
+} // namespace NeoMLTest
+
+TEST( CDnnParallelRunTest, Exception )
+{
+	CRandom random( 0x3c3d );
+	CDnn dnn( random, MathEngine() );
+	buildParallelRunTestDnn( dnn );
+	setParallelRunTestInputs( dnn, random );
+	CPtr<CParallelRunTestFailingLayer> failing = new CParallelRunTestFailingLayer( MathEngine() );
+	failing->SetName( "failing" );
+	failing->Connect( "towerRelu0" );
+	dnn.AddLayer( *failing );
+	dnn.GetLayer( "towerOut0" )->Connect( *failing );
+
+	CArray<float> expected;
+	runParallelRunTestDnn( dnn, 1, expected );
+
+	failing->SetFailing( true );
+	dnn.SetRunThreadCount( 4 );
+	EXPECT_ANY_THROW( dnn.RunOnce() );
+
+	// The network still works after the failed run
+	failing->SetFailing( false );
+	CArray<float> output;
+	runParallelRunTestDnn( dnn, 4, output );
+	ASSERT_EQ( expected.Size(), output.Size() );
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_EQ( expected[i], output[i] ) << i;
+	}
+}
+
+TEST( CDnnParallelRunTest, Learning )
+{
+	CRandom random( 0x3c3e );
+	CDnn dnn( random, MathEngine() );
+	buildParallelRunTestDnn( dnn );
+	dnn.SetRunThreadCount( 4 );
+
+	// The learning runs the layers one by one
+	setParallelRunTestInputs( dnn, random );
+	dnn.RunAndLearnOnce();
+	const float firstLoss = CheckCast<CLossLayer>( dnn.GetLayer( "loss" ) )->GetLastLoss();
+	for( int i = 0; i < 20; ++i ) {
+		dnn.RunAndLearnOnce();
+	}
+	EXPECT_LT( CheckCast<CLossLayer>( dnn.GetLayer( "loss" ) )->GetLastLoss(), firstLoss );
+
+	CArray<float> expected;
+	runParallelRunTestDnn( dnn, 1, expected );
+	CArray<float> output;
+	runParallelRunTestDnn( dnn, 4, output );
+	ASSERT_EQ( expected.Size(), output.Size() );
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_EQ( expected[i], output[i] ) << i;
+	}
+}
@@ -0,0 +1,150 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+namespace NeoMLTest {
+
+static const int profilerTestBatchSize = 3;
+static const int profilerTestInputSize = 16;
+
+static void buildProfilerTestDnn( CDnn& dnn )
+{
+	CBaseLayer* data = Source( dnn, "data" );
+	CBaseLayer* fc = FullyConnected( 8 )( "fc", data );
+	CBaseLayer* relu = Relu()( "relu", fc );
+	CBaseLayer* head = FullyConnected( 4 )( "head", relu );
+	CBaseLayer* label = Source( dnn, "label" );
+	EuclideanLoss()( "loss", head, label );
+
+	CPtr<CDnnBlob> input = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, profilerTestBatchSize,
+		profilerTestInputSize );
+	input->Fill( 0.5f );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob( input );
+	CPtr<CDnnBlob> labels = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, profilerTestBatchSize, 4 );
+	labels->Fill( 1.f );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "label" ) )->SetBlob( labels );
+}
+
+// Counts the events of the layer and stage
+static int countProfileEvents( const CDnnProfiler& profiler, const char* layerPath, TDnnProfileStage stage )
+{
+	int result = 0;
+	for( const CDnnProfileEvent& event : profiler.GetEvents() ) {
+		if( event.LayerPath == layerPath && event.Stage == stage ) {
+			result++;
+		}
+	}
+	return result;
+}
+
+} // namespace NeoMLTest
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TEST( CDnnProfilerTest, Events )
+{
+	CRandom random( 0x123 );
+	CDnn dnn( random, MathEngine() );
+	buildProfilerTestDnn( dnn );
+
+	CDnnProfiler profiler;
+	dnn.SetProfiler( &profiler );
+	dnn.RunAndLearnOnce();
+	dnn.RunAndLearnOnce();
+	dnn.RunOnce();
+
+	for( const char* layer : { "data", "fc", "relu", "head", "label", "loss" } ) {
+		EXPECT_EQ( 3, countProfileEvents( profiler, layer, DPS_Forward ) ) << layer;
+	}
+	for( const char* layer : { "relu", "head" } ) {
+		EXPECT_EQ( 2, countProfileEvents( profiler, layer, DPS_Backward ) ) << layer;
+	}
+	for( const char* layer : { "fc", "head" } ) {
+		EXPECT_EQ( 2, countProfileEvents( profiler, layer, DPS_Learn ) ) << layer;
+	}
+	// The first layer doesn't need backward, only learning
+	EXPECT_EQ( 0, countProfileEvents( profiler, "fc", DPS_Backward ) );
+
+	IPerformanceCounters::CCounter::TCounterType lastStart = 0;
+	for( const CDnnProfileEvent& event : profiler.GetEvents() ) {
+		EXPECT_LE( lastStart, event.Start );
+		lastStart = event.Start;
+		if( event.LayerPath == "fc" ) {
+			EXPECT_EQ( 2. * profilerTestBatchSize * profilerTestInputSize * 8, event.Flops );
+		} else if( event.LayerPath == "relu" ) {
+			EXPECT_EQ( 0., event.Flops );
+		}
+	}
+
+	CTextStream trace;
+	profiler.SaveChromeTrace( trace );
+	const std::string traceText = trace.str();
+	EXPECT_EQ( 0u, traceText.find( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" ) );
+	EXPECT_NE( std::string::npos, traceText.find( "\"name\":\"fc\",\"cat\":\"Learn\",\"ph\":\"X\"" ) );
+
+	CTextStream summary;
+	profiler.SaveSummary( summary );
+	std::string line;
+	int lineCount = 0;
+	while( std::getline( summary, line ) ) {
+		lineCount++;
+	}
+	// The header and 6 forward, 3 backward (loss, head, relu) and 2 learn lines
+	EXPECT_EQ( 12, lineCount );
+
+	// The recording stops when the profiler is removed
+	const int eventCount = profiler.GetEvents().Size();
+	dnn.SetProfiler( nullptr );
+	dnn.RunOnce();
+	EXPECT_EQ( eventCount, profiler.GetEvents().Size() );
+
+	profiler.Clear();
+	EXPECT_EQ( 0, profiler.GetEvents().Size() );
+}
+
+TEST( CDnnProfilerTest, CompositeLayer )
+{
+	CRandom random( 0x123 );
+	CDnn dnn( random, MathEngine() );
+	CBaseLayer* data = Source( dnn, "data" );
+	CPtr<CCompositeLayer> composite = new CCompositeLayer( MathEngine(), "composite" );
+	CPtr<CFullyConnectedLayer> fc = new CFullyConnectedLayer( MathEngine(), "innerFc" );
+	fc->SetNumberOfElements( 4 );
+	composite->AddLayer( *fc );
+	composite->SetInputMapping( *fc );
+	composite->SetOutputMapping( *fc );
+	composite->Connect( *data );
+	dnn.AddLayer( *composite );
+	Sink( composite.Ptr(), "sink" );
+
+	CPtr<CDnnBlob> input = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, 2, 5 );
+	input->Fill( 1.f );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob( input );
+
+	CDnnProfiler profiler;
+	dnn.SetProfiler( &profiler );
+	dnn.RunOnce();
+
+	EXPECT_EQ( 1, countProfileEvents( profiler, "composite", DPS_Forward ) );
+	EXPECT_EQ( 1, countProfileEvents( profiler, "composite/innerFc", DPS_Forward ) );
+}
@@ -1,4 +1,4 @@
-/* Copyright © 2021-2023 ABBYY
+/* Copyright © 2021-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -874,3 +874,217 @@ TEST( CDnnSolverTest, CompositeLearningRate )
 	EXPECT_FALSE( checkLstmEquality( direct, secondDirect ) );
 	EXPECT_FALSE( checkLstmEquality( reverse, secondReverse ) );
 }
+
+// ====================================================================================================================
+
+static void buildDnnForInferenceAfterTrainingTest( CDnn& dnn )
+{
+	CSourceLayer* data = Source( dnn, "data" );
+	CConvLayer* conv = Conv( 8, CConvAxisParams( 1 ), CConvAxisParams( 1 ) )( "conv", data );
+	CFullyConnectedLayer* fc = FullyConnected( 4 )( "fc", conv );
+	Sink( fc, "sink" );
+	CSourceLayer* label = Source( dnn, "label" );
+	EuclideanLoss()( "loss", fc, label );
+}
+
+static void runAndGetSinkOutput( CDnn& dnn, CArray<float>& output )
+{
+	dnn.RunOnce();
+	CPtr<CDnnBlob> blob = CheckCast<CSinkLayer>( dnn.GetLayer( "sink" ) )->GetBlob();
+	output.SetSize( blob->GetDataSize() );
+	blob->CopyTo( output.GetPtr() );
+}
+
+TEST( CDnnSolverTest, InferenceAfterTraining )
+{
+	// The weights prepared for the inference (e.g. packed) must be updated after every training step
+	CRandom random( 0x1234 );
+	CDnn dnn( random, MathEngine() );
+	buildDnnForInferenceAfterTrainingTest( dnn );
+	CPtr<CDnnSimpleGradientSolver> solver = new CDnnSimpleGradientSolver( MathEngine() );
+	solver->SetLearningRate( 0.1f );
+	dnn.SetSolver( solver );
+
+	CPtr<CDnnBlob> data = CDnnBlob::Create2DImageBlob( MathEngine(), CT_Float, 1, 2, 5, 6, 16 );
+	CPtr<CDnnBlob> label = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, 2, 4 );
+	for( CDnnBlob* blob : { data.Ptr(), label.Ptr() } ) {
+		CArray<float> values;
+		values.SetSize( blob->GetDataSize() );
+		for( int i = 0; i < values.Size(); ++i ) {
+			values[i] = static_cast<float>( random.Uniform( -1, 1 ) );
+		}
+		blob->CopyFrom( values.GetPtr() );
+	}
+	CheckCast<CSourceLayer>( dnn.GetLayer( "data" ) )->SetBlob( data );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "label" ) )->SetBlob( label );
+
+	// The reference net doesn't run the inference until the weights are copied
+	CDnn referenceDnn( random, MathEngine() );
+	buildDnnForInferenceAfterTrainingTest( referenceDnn );
+	CheckCast<CSourceLayer>( referenceDnn.GetLayer( "data" ) )->SetBlob( data );
+	CheckCast<CSourceLayer>( referenceDnn.GetLayer( "label" ) )->SetBlob( label );
+
+	CArray<float> output;
+	CArray<float> expected;
+	for( int step = 0; step < 3; ++step ) {
+		runAndGetSinkOutput( dnn, output );
+		dnn.RunAndLearnOnce();
+		runAndGetSinkOutput( dnn, output );
+
+		CConvLayer* conv = CheckCast<CConvLayer>( dnn.GetLayer( "conv" ) );
+		CConvLayer* referenceConv = CheckCast<CConvLayer>( referenceDnn.GetLayer( "conv" ) );
+		referenceConv->SetFilterData( conv->GetFilterData() );
+		referenceConv->SetFreeTermData( conv->GetFreeTermData() );
+		CFullyConnectedLayer* fc = CheckCast<CFullyConnectedLayer>( dnn.GetLayer( "fc" ) );
+		CFullyConnectedLayer* referenceFc = CheckCast<CFullyConnectedLayer>( referenceDnn.GetLayer( "fc" ) );
+		referenceFc->SetWeightsData( fc->GetWeightsData() );
+		referenceFc->SetFreeTermData( fc->GetFreeTermData() );
+		runAndGetSinkOutput( referenceDnn, expected );
+
+		ASSERT_EQ( expected.Size(), output.Size() );
+		for( int i = 0; i < expected.Size(); ++i ) {
+			EXPECT_NEAR( expected[i], output[i], 1e-4f );
+		}
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------
+
+static void buildSparseEmbeddingsDnn( CDnn& dnn, bool useSparseGradients )
+{
+	CPtr<CSourceLayer> ids = Source( dnn, "ids" );
+	CPtr<CMultichannelLookupLayer> lookup = Embeddings( 20, 4 )( "embeddings", ids.Ptr() );
+	lookup->SetUseSparseGradients( useSparseGradients );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 3 )( "fc", lookup.Ptr() );
+	CPtr<CSourceLayer> target = Source( dnn, "target" );
+	EuclideanLoss()( "loss", fc.Ptr(), target.Ptr() );
+}
+
+static void setSparseEmbeddingsInputs( CDnn& dnn, CRandom& random )
+{
+	// Only the first half of the table is used, the ids may repeat
+	CArray<int> idsData;
+	CPtr<CDnnBlob> ids = CDnnBlob::CreateDataBlob( MathEngine(), CT_Int, 1, 8, 1 );
+	for( int i = 0; i < ids->GetDataSize(); ++i ) {
+		idsData.Add( random.UniformInt( 0, 9 ) );
+	}
+	ids->CopyFrom( idsData.GetPtr() );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "ids" ) )->SetBlob( ids );
+
+	CArray<float> targetData;
+	CPtr<CDnnBlob> target = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 1, 8, 3 );
+	for( int i = 0; i < target->GetDataSize(); ++i ) {
+		targetData.Add( static_cast<float>( random.Uniform( -1, 1 ) ) );
+	}
+	target->CopyFrom( targetData.GetPtr() );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "target" ) )->SetBlob( target );
+}
+
+static CDnnBlob& getSparseEmbeddingsTable( CDnn& dnn )
+{
+	return const_cast<CDnnBlob&>( *CheckCast<CMultichannelLookupLayer>( dnn.GetLayer( "embeddings" ) )->GetEmbeddings( 0 ) );
+}
+
+// Trains the same network with the dense and the sparse embeddings gradients
+static void trainSparseEmbeddingsDnns( CDnn& dense, CDnn& sparse, int stepCount, int accumulatedCount )
+{
+	CRandom random( 0x321 );
+	for( int step = 0; step < stepCount; ++step ) {
+		for( int i = 0; i < accumulatedCount; ++i ) {
+			setSparseEmbeddingsInputs( dense, random );
+			CheckCast<CSourceLayer>( sparse.GetLayer( "ids" ) )->SetBlob(
+				CheckCast<CSourceLayer>( dense.GetLayer( "ids" ) )->GetBlob() );
+			CheckCast<CSourceLayer>( sparse.GetLayer( "target" ) )->SetBlob(
+				CheckCast<CSourceLayer>( dense.GetLayer( "target" ) )->GetBlob() );
+			dense.RunAndBackwardOnce();
+			sparse.RunAndBackwardOnce();
+		}
+		dense.GetSolver()->Train();
+		sparse.GetSolver()->Train();
+	}
+}
+
+TEST( CDnnSolverTest, SparseEmbeddingsSgd )
+{
+	CRandom denseRandom( 0x1234 );
+	CDnn dense( denseRandom, MathEngine() );
+	buildSparseEmbeddingsDnn( dense, false );
+	CRandom sparseRandom( 0x1234 );
+	CDnn sparse( sparseRandom, MathEngine() );
+	buildSparseEmbeddingsDnn( sparse, true );
+
+	// Without the moment and the regularization the untouched rows are not changed by the dense update either
+	for( CDnn* dnn : { &dense, &sparse } ) {
+		CPtr<CDnnSimpleGradientSolver> sgd = new CDnnSimpleGradientSolver( MathEngine() );
+		sgd->SetMomentDecayRate( 0.f );
+		sgd->SetL1Regularization( 0.f );
+		sgd->SetL2Regularization( 0.f );
+		sgd->SetLearningRate( 0.1f );
+		dnn->SetSolver( sgd );
+	}
+
+	trainSparseEmbeddingsDnns( dense, sparse, 5, 2 );
+
+	EXPECT_TRUE( checkBlobEquality( getSparseEmbeddingsTable( dense ), getSparseEmbeddingsTable( sparse ) ) );
+	CFullyConnectedLayer* denseFc = CheckCast<CFullyConnectedLayer>( dense.GetLayer( "fc" ) );
+	CFullyConnectedLayer* sparseFc = CheckCast<CFullyConnectedLayer>( sparse.GetLayer( "fc" ) );
+	EXPECT_TRUE( checkBlobEquality( *denseFc->GetWeightsData(), *sparseFc->GetWeightsData() ) );
+}
+
+TEST( CDnnSolverTest, SparseEmbeddingsAdam )
+{
+	CRandom denseRandom( 0x1234 );
+	CDnn dense( denseRandom, MathEngine() );
+	buildSparseEmbeddingsDnn( dense, false );
+	CRandom sparseRandom( 0x1234 );
+	CDnn sparse( sparseRandom, MathEngine() );
+	buildSparseEmbeddingsDnn( sparse, true );
+
+	for( CDnn* dnn : { &dense, &sparse } ) {
+		CPtr<CDnnAdaptiveGradientSolver> adam = new CDnnAdaptiveGradientSolver( MathEngine() );
+		adam->SetL1Regularization( 0.f );
+		adam->SetL2Regularization( 1e-3f );
+		adam->SetLearningRate( 0.01f );
+		dnn->SetSolver( adam );
+	}
+	CRandom inputRandom( 0x123 );
+	setSparseEmbeddingsInputs( sparse, inputRandom );
+	sparse.RunOnce();
+	CPtr<CDnnBlob> initialTable = getSparseEmbeddingsTable( sparse ).GetCopy();
+
+	trainSparseEmbeddingsDnns( dense, sparse, 3, 1 );
+
+	// The rows that are not looked up are not changed, unlike the dense update with the regularization
+	CDnnBlobBuffer<float> initial( *initialTable, TDnnBlobBufferAccess::Read );
+	CDnnBlobBuffer<float> trained( getSparseEmbeddingsTable( sparse ), TDnnBlobBufferAccess::Read );
+	CDnnBlobBuffer<float> denseTrained( getSparseEmbeddingsTable( dense ), TDnnBlobBufferAccess::Read );
+	const int rowSize = initialTable->GetObjectSize();
+	for( int i = 10 * rowSize; i < initial.Size(); ++i ) {
+		EXPECT_EQ( initial[i], trained[i] );
+		EXPECT_NE( initial[i], denseTrained[i] );
+	}
+	bool isChanged = false;
+	for( int i = 0; i < 10 * rowSize; ++i ) {
+		isChanged |= initial[i] != trained[i];
+	}
+	EXPECT_TRUE( isChanged );
+
+	// The pending sparse gradients are serialized with the solver
+	setSparseEmbeddingsInputs( sparse, sparseRandom );
+	sparse.RunAndBackwardOnce();
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::SD_Storing );
+		sparse.SerializeCheckpoint( archive );
+	}
+	file.SeekToBegin();
+	CDnn loaded( sparseRandom, MathEngine() );
+	{
+		CArchive archive( &file, CArchive::SD_Loading );
+		loaded.SerializeCheckpoint( archive );
+	}
+	EXPECT_TRUE( CheckCast<CMultichannelLookupLayer>( loaded.GetLayer( "embeddings" ) )->IsUseSparseGradients() );
+	sparse.GetSolver()->Train();
+	loaded.GetSolver()->Train();
+	EXPECT_TRUE( checkBlobEquality( getSparseEmbeddingsTable( sparse ), getSparseEmbeddingsTable( loaded ) ) );
+}
@@ -1,4 +1,4 @@
-/* Copyright © 2021 ABBYY Production LLC
+/* Copyright © 2021-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -145,4 +145,112 @@ TEST( CGradientBoostingTest, IterativeRegressionTest )
 		params.TreeBuilder = type;
 		regressionTest( train.Ptr(), test.Ptr(), params );
 	}
-}
\ No newline at end of file
+}
+
+// Gets the maximum number of leaves in the ensemble trees
+static int getMaxLeavesCount( const CArray<CGradientBoostEnsemble>& ensembles )
+{
+	int result = 0;
+	for( const CGradientBoostEnsemble& ensemble : ensembles ) {
+		for( int i = 0; i < ensemble.Size(); i++ ) {
+			int leavesCount = 0;
+			CArray<const IRegressionTreeNode*> stack;
+			stack.Add( ensemble[i] );
+			while( !stack.IsEmpty() ) {
+				const IRegressionTreeNode* node = stack.Last();
+				stack.DeleteLast();
+				if( node->GetLeftChild() == nullptr ) {
+					leavesCount++;
+				} else {
+					stack.Add( node->GetLeftChild() );
+					stack.Add( node->GetRightChild() );
+				}
+			}
+			result = max( result, leavesCount );
+		}
+	}
+	return result;
+}
+
+TEST( CGradientBoostingTest, QuickScorerDeepTreesRegressionTest )
+{
+	CRandom rand( 42 );
+	auto train = CRegressionRandomProblem::Random( rand, 4000, 20, 10 );
+	auto test = CRegressionRandomProblem::Random( rand, 501, 20, 10 );
+	auto sparseTest = test->CreateSparse();
+
+	CGradientBoost::CParams params;
+	params.IterationsCount = 10;
+	params.MaxTreeDepth = 16;
+	params.L2RegFactor = 0;
+	CGradientBoost boosting( params );
+	CPtr<IGradientBoostRegressionModel> model = CheckCast<IGradientBoostRegressionModel>(
+		boosting.TrainRegression( *train ) );
+	// Both the trees with more than 64 leaves and the trees not fully optimized are checked
+	ASSERT_LT( 256, getMaxLeavesCount( model->GetEnsemble() ) );
+
+	CPtr<IGradientBoostQSRegressionModel> qsModel = CGradientBoostQuickScorer().BuildRegression( *model );
+
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::store );
+		qsModel->Serialize( archive );
+	}
+	file.SeekToBegin();
+	CPtr<IGradientBoostQSRegressionModel> loadedModel
+		= CreateModel<IGradientBoostQSRegressionModel>( GradientBoostQSModelName );
+	{
+		CArchive archive( &file, CArchive::load );
+		loadedModel->Serialize( archive );
+	}
+
+	CArray<double> batchResults;
+	qsModel->PredictBatch( test->GetMatrix(), batchResults );
+	CArray<double> sparseBatchResults;
+	loadedModel->PredictBatch( sparseTest->GetMatrix(), sparseBatchResults );
+	ASSERT_EQ( test->GetVectorCount(), batchResults.Size() );
+	ASSERT_EQ( test->GetVectorCount(), sparseBatchResults.Size() );
+
+	for( int i = 0; i < test->GetVectorCount(); i++ ) {
+		const double expected = model->Predict( test->GetVector( i ) );
+		const double result = qsModel->Predict( test->GetVector( i ) );
+		ASSERT_NEAR( expected, result, 1e-4 * max( 1., fabs( expected ) ) );
+		ASSERT_EQ( result, loadedModel->Predict( sparseTest->GetVector( i ) ) );
+		ASSERT_EQ( result, batchResults[i] );
+		ASSERT_EQ( result, sparseBatchResults[i] );
+	}
+}
+
+TEST( CGradientBoostingTest, QuickScorerDeepTreesClassificationTest )
+{
+	CRandom rand( 42 );
+	auto train = CClassificationRandomProblem::Random( rand, 2000, 20, 3 );
+	auto test = CClassificationRandomProblem::Random( rand, 501, 20, 3 );
+
+	CGradientBoost::CParams params;
+	params.IterationsCount = 10;
+	params.MaxTreeDepth = 8;
+	params.L2RegFactor = 0;
+	CGradientBoost boosting( params );
+	CPtr<IGradientBoostModel> model = CheckCast<IGradientBoostModel>( boosting.Train( *train ) );
+	ASSERT_LT( 64, getMaxLeavesCount( model->GetEnsemble() ) );
+
+	CPtr<IGradientBoostQSModel> qsModel = CGradientBoostQuickScorer().Build( *model );
+
+	CArray<CClassificationResult> batchResults;
+	ASSERT_TRUE( qsModel->ClassifyBatch( test->GetMatrix(), batchResults ) );
+	ASSERT_EQ( test->GetVectorCount(), batchResults.Size() );
+
+	for( int i = 0; i < test->GetVectorCount(); i++ ) {
+		CClassificationResult expected;
+		ASSERT_TRUE( model->Classify( test->GetVector( i ), expected ) );
+		CClassificationResult result;
+		ASSERT_TRUE( qsModel->Classify( test->GetVector( i ), result ) );
+		ASSERT_EQ( expected.PreferredClass, result.PreferredClass );
+		ASSERT_EQ( result.PreferredClass, batchResults[i].PreferredClass );
+		ASSERT_EQ( result.Probabilities.Size(), batchResults[i].Probabilities.Size() );
+		for( int j = 0; j < result.Probabilities.Size(); j++ ) {
+			ASSERT_EQ( result.Probabilities[j].GetValue(), batchResults[i].Probabilities[j].GetValue() );
+		}
+	}
+}
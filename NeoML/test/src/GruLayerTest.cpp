@@ -0,0 +1,101 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static CPtr<CDnnBlob> createGruTestBlob( CRandom& random, int batchLength, int batchWidth, int channels )
+{
+	CPtr<CDnnBlob> blob = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, batchLength, batchWidth, channels );
+	CArray<float> data;
+	for( int i = 0; i < blob->GetDataSize(); ++i ) {
+		data.Add( static_cast<float>( random.Uniform( -1, 1 ) ) );
+	}
+	blob->CopyFrom( data.GetPtr() );
+	return blob;
+}
+
+// Compares the fused inference with the step-by-step calculation used in training
+static void gruFusedInferenceTest( int sequenceLength, int batchWidth, bool reverse, bool withInitialState )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		GTEST_LOG_( INFO ) << "Skipped rest of test for MathEngine type=" << MathEngine().GetType() << " because no implementation.\n";
+		return;
+	}
+
+	const int inputSize = 5;
+	const int hiddenSize = 7;
+
+	CRandom random( 0x4567 );
+	CDnn dnn( random, MathEngine() );
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	data->SetBlob( createGruTestBlob( random, sequenceLength, batchWidth, inputSize ) );
+
+	CPtr<CGruLayer> gru = Gru( hiddenSize )( "gru", data.Ptr() );
+	gru->SetReverseSequence( reverse );
+	if( withInitialState ) {
+		CPtr<CSourceLayer> initialState = Source( dnn, "initialState" );
+		initialState->SetBlob( createGruTestBlob( random, 1, batchWidth, hiddenSize ) );
+		gru->Connect( 1, *initialState );
+	}
+	CPtr<CSinkLayer> sink = Sink( gru.Ptr(), "sink" );
+
+	CPtr<CSourceLayer> target = Source( dnn, "target" );
+	target->SetBlob( createGruTestBlob( random, sequenceLength, batchWidth, hiddenSize ) );
+	EuclideanLoss()( "loss", gru.Ptr(), target.Ptr() );
+
+	// The backward pass turns the fused calculation off
+	dnn.RunAndBackwardOnce();
+	CPtr<CDnnBlob> expected = sink->GetBlob()->GetCopy();
+
+	dnn.RunOnce();
+	CPtr<CDnnBlob> output = sink->GetBlob();
+	ASSERT_TRUE( expected->HasEqualDimensions( output ) );
+
+	CDnnBlobBuffer<float> expectedBuffer( *expected, TDnnBlobBufferAccess::Read );
+	CDnnBlobBuffer<float> outputBuffer( *output, TDnnBlobBufferAccess::Read );
+	for( int i = 0; i < expectedBuffer.Size(); ++i ) {
+		EXPECT_NEAR( expectedBuffer[i], outputBuffer[i], 1e-4f ) << i;
+	}
+}
+
+TEST( CGruLayerTest, FusedInference )
+{
+	gruFusedInferenceTest( 6, 3, false, false );
+}
+
+TEST( CGruLayerTest, FusedInferenceReverse )
+{
+	gruFusedInferenceTest( 6, 3, true, false );
+}
+
+TEST( CGruLayerTest, FusedInferenceInitialState )
+{
+	gruFusedInferenceTest( 6, 3, false, true );
+	gruFusedInferenceTest( 6, 3, true, true );
+}
+
+TEST( CGruLayerTest, FusedInferenceLongSequence )
+{
+	// The input part of the gates is calculated by several blocks
+	gruFusedInferenceTest( 50, 2, false, true );
+	gruFusedInferenceTest( 50, 2, true, false );
+}
@@ -0,0 +1,190 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+namespace NeoMLTest {
+
+static void getHalfFloatSinkOutput( CDnn& dnn, const char* sinkName, CArray<float>& output )
+{
+	CPtr<CDnnBlob> blob = CheckCast<CSinkLayer>( dnn.GetLayer( sinkName ) )->GetBlob();
+	output.SetSize( blob->GetDataSize() );
+	blob->CopyTo( output.GetPtr() );
+}
+
+static void checkHalfFloatOutput( const CArray<float>& expected, const CArray<float>& actual, float relativeError )
+{
+	ASSERT_EQ( expected.Size(), actual.Size() );
+	float maxAbs = 0;
+	for( float value : expected ) {
+		maxAbs = max( maxAbs, fabsf( value ) );
+	}
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_NEAR( expected[i], actual[i], relativeError * maxAbs );
+	}
+}
+
+// Runs the network and returns the outputs of both sinks
+static void runHalfFloatNetwork( CDnn& dnn, CArray<float>& output )
+{
+	dnn.RunOnce();
+	CArray<float> transformerOutput;
+	getHalfFloatSinkOutput( dnn, "sink", output );
+	getHalfFloatSinkOutput( dnn, "transformerSink", transformerOutput );
+	output.Add( transformerOutput );
+}
+
+static void buildHalfFloatNetwork( CDnn& dnn )
+{
+	CPtr<CSourceLayer> ids = Source( dnn, "ids" );
+	CPtr<CMultichannelLookupLayer> lookup = Embeddings( 1000, 32 )( "embeddings", ids.Ptr() );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 24 )( "fc", lookup.Ptr() );
+	Sink( fc.Ptr(), "sink" );
+
+	CPtr<CSourceLayer> sequence = Source( dnn, "sequence" );
+	CPtr<CTransformerEncoderLayer> transformer = new CTransformerEncoderLayer( MathEngine() );
+	transformer->SetName( "transformer" );
+	transformer->SetHeadCount( 2 );
+	transformer->SetHiddenSize( 16 );
+	transformer->SetFeedForwardSize( 32 );
+	transformer->Connect( *sequence );
+	dnn.AddLayer( *transformer );
+	Sink( transformer.Ptr(), "transformerSink" );
+}
+
+static void setHalfFloatInputs( CDnn& dnn, CRandom& random )
+{
+	CPtr<CDnnBlob> ids = CDnnBlob::CreateDataBlob( MathEngine(), CT_Int, 1, 7, 1 );
+	CArray<int> idsData;
+	for( int i = 0; i < ids->GetDataSize(); ++i ) {
+		idsData.Add( random.UniformInt( 0, 999 ) );
+	}
+	ids->CopyFrom( idsData.GetPtr() );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "ids" ) )->SetBlob( ids );
+
+	CPtr<CDnnBlob> sequence = CDnnBlob::CreateListBlob( MathEngine(), CT_Float, 1, 3, 4, 8 );
+	CArray<float> sequenceData;
+	for( int i = 0; i < sequence->GetDataSize(); ++i ) {
+		sequenceData.Add( static_cast<float>( random.Uniform( -1, 1 ) ) );
+	}
+	sequence->CopyFrom( sequenceData.GetPtr() );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "sequence" ) )->SetBlob( sequence );
+}
+
+static int getHalfFloatArchiveSize( CDnn& dnn )
+{
+	CMemoryFile file;
+	CArchive archive( &file, CArchive::SD_Storing );
+	dnn.Serialize( archive );
+	archive.Close();
+	return static_cast<int>( file.GetLength() );
+}
+
+} // namespace NeoMLTest
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TEST( HalfFloatWeightsTest, ConversionAndSerialization )
+{
+	CRandom random( 0x4321 );
+	CDnn dnn( random, MathEngine() );
+	buildHalfFloatNetwork( dnn );
+	setHalfFloatInputs( dnn, random );
+
+	CArray<float> expected;
+	runHalfFloatNetwork( dnn, expected );
+	const int floatArchiveSize = getHalfFloatArchiveSize( dnn );
+
+	// The lookup, the fully-connected layer and the fully-connected layers of the transformer
+	const int convertedCount = SetDnnWeightsPrecision( dnn, DWP_Float16 );
+	EXPECT_LE( 4, convertedCount );
+	CPtr<CFullyConnectedLayer> fc = CheckCast<CFullyConnectedLayer>( dnn.GetLayer( "fc" ) );
+	CPtr<CMultichannelLookupLayer> lookup = CheckCast<CMultichannelLookupLayer>( dnn.GetLayer( "embeddings" ) );
+	EXPECT_EQ( DWP_Float16, fc->GetWeightsPrecision() );
+	EXPECT_EQ( nullptr, fc->Weights() );
+	EXPECT_NE( nullptr, fc->GetWeightsData() );
+	EXPECT_EQ( DWP_Float16, lookup->GetEmbeddingsPrecision() );
+	EXPECT_EQ( nullptr, lookup->GetEmbeddings( 0 ) );
+
+	CArray<float> float16Output;
+	runHalfFloatNetwork( dnn, float16Output );
+	checkHalfFloatOutput( expected, float16Output, 1e-2f );
+
+	// The large weights take half of the archive size
+	const int float16ArchiveSize = getHalfFloatArchiveSize( dnn );
+	EXPECT_LT( float16ArchiveSize, floatArchiveSize * 3 / 4 );
+
+	// The 16-bit weights are stored and loaded as is
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::SD_Storing );
+		dnn.Serialize( archive );
+	}
+	file.SeekToBegin();
+	CDnn loaded( random, MathEngine() );
+	{
+		CArchive archive( &file, CArchive::SD_Loading );
+		loaded.Serialize( archive );
+	}
+	EXPECT_EQ( DWP_Float16, CheckCast<CFullyConnectedLayer>( loaded.GetLayer( "fc" ) )->GetWeightsPrecision() );
+	EXPECT_EQ( DWP_Float16,
+		CheckCast<CMultichannelLookupLayer>( loaded.GetLayer( "embeddings" ) )->GetEmbeddingsPrecision() );
+	CheckCast<CSourceLayer>( loaded.GetLayer( "ids" ) )->SetBlob(
+		CheckCast<CSourceLayer>( dnn.GetLayer( "ids" ) )->GetBlob() );
+	CheckCast<CSourceLayer>( loaded.GetLayer( "sequence" ) )->SetBlob(
+		CheckCast<CSourceLayer>( dnn.GetLayer( "sequence" ) )->GetBlob() );
+	CArray<float> loadedOutput;
+	runHalfFloatNetwork( loaded, loadedOutput );
+	ASSERT_EQ( float16Output.Size(), loadedOutput.Size() );
+	for( int i = 0; i < float16Output.Size(); ++i ) {
+		EXPECT_EQ( float16Output[i], loadedOutput[i] );
+	}
+
+	// bfloat16 has fewer significant bits
+	EXPECT_EQ( convertedCount, SetDnnWeightsPrecision( dnn, DWP_BFloat16 ) );
+	CArray<float> bfloat16Output;
+	runHalfFloatNetwork( dnn, bfloat16Output );
+	checkHalfFloatOutput( expected, bfloat16Output, 5e-2f );
+
+	// Back to float: the weights keep the rounding
+	EXPECT_EQ( convertedCount, SetDnnWeightsPrecision( dnn, DWP_Float32 ) );
+	EXPECT_NE( nullptr, fc->Weights() );
+	EXPECT_NE( nullptr, lookup->GetEmbeddings( 0 ) );
+	CArray<float> restoredOutput;
+	runHalfFloatNetwork( dnn, restoredOutput );
+	checkHalfFloatOutput( bfloat16Output, restoredOutput, 1e-5f );
+}
+
+TEST( HalfFloatWeightsTest, MinWeightsSize )
+{
+	CRandom random( 0x4321 );
+	CDnn dnn( random, MathEngine() );
+	buildHalfFloatNetwork( dnn );
+	setHalfFloatInputs( dnn, random );
+	dnn.RunOnce();
+
+	// Only the embeddings table has 32000 weights
+	EXPECT_EQ( 1, SetDnnWeightsPrecision( dnn, DWP_BFloat16, 10000 ) );
+	EXPECT_EQ( DWP_BFloat16,
+		CheckCast<CMultichannelLookupLayer>( dnn.GetLayer( "embeddings" ) )->GetEmbeddingsPrecision() );
+	EXPECT_EQ( DWP_Float32, CheckCast<CFullyConnectedLayer>( dnn.GetLayer( "fc" ) )->GetWeightsPrecision() );
+}
@@ -0,0 +1,171 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+namespace NeoMLTest {
+
+static void fillRandomBlob( CDnnBlob& blob, CRandom& random, double min, double max )
+{
+	CArray<float> data;
+	data.SetSize( blob.GetDataSize() );
+	for( int i = 0; i < data.Size(); ++i ) {
+		data[i] = static_cast<float>( random.Uniform( min, max ) );
+	}
+	blob.CopyFrom( data.GetPtr() );
+}
+
+static void getSinkOutput( CDnn& dnn, const char* sinkName, CArray<float>& output )
+{
+	CPtr<CDnnBlob> blob = CheckCast<CSinkLayer>( dnn.GetLayer( sinkName ) )->GetBlob();
+	output.SetSize( blob->GetDataSize() );
+	blob->CopyTo( output.GetPtr() );
+}
+
+// Checks that the quantized output is close to the float one
+static void checkQuantizedOutput( const CArray<float>& expected, const CArray<float>& actual )
+{
+	ASSERT_EQ( expected.Size(), actual.Size() );
+	float maxAbs = 0;
+	for( float value : expected ) {
+		maxAbs = max( maxAbs, fabsf( value ) );
+	}
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_NEAR( expected[i], actual[i], 0.05f * maxAbs );
+	}
+}
+
+} // namespace NeoMLTest
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TEST( Int8QuantizationTest, FullyConnectedAndConv1x1 )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	CRandom random( 0x1234 );
+	CDnn dnn( random, MathEngine() );
+
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	CPtr<CConvLayer> conv1x1 = Conv( 12, CConvAxisParams( 1 ), CConvAxisParams( 1 ) )( "conv1x1", data.Ptr() );
+	CPtr<CConvLayer> conv3x3 = Conv( 4, CConvAxisParams( 3, 1 ), CConvAxisParams( 3, 1 ) )( "conv3x3", conv1x1.Ptr() );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 10 )( "fc", conv3x3.Ptr() );
+	Sink( fc.Ptr(), "sink" );
+
+	CPtr<CDnnBlob> input = CDnnBlob::Create2DImageBlob( MathEngine(), CT_Float, 1, 3, 5, 6, 16 );
+	fillRandomBlob( *input, random, -2, 3 );
+	data->SetBlob( input );
+
+	CArray<float> expected;
+	dnn.RunOnce();
+	getSinkOutput( dnn, "sink", expected );
+
+	CDnnInt8Quantizer quantizer;
+	EXPECT_EQ( 2, quantizer.StartCalibration( dnn ) );
+	EXPECT_TRUE( conv1x1->GetInt8Quantization().IsCalibrating() );
+	EXPECT_FALSE( conv3x3->GetInt8Quantization().IsCalibrating() );
+	dnn.RunOnce();
+	EXPECT_EQ( 2, quantizer.FinishCalibration( dnn ) );
+	EXPECT_TRUE( conv1x1->GetInt8Quantization().IsQuantized() );
+	EXPECT_TRUE( fc->GetInt8Quantization().IsQuantized() );
+	EXPECT_EQ( 12, conv1x1->GetInt8Quantization().GetWeightScales().Size() );
+	EXPECT_EQ( 10, fc->GetInt8Quantization().GetWeightScales().Size() );
+	// Only the int8 weights are kept
+	EXPECT_TRUE( fc->Weights() == nullptr );
+	EXPECT_EQ( 10, fc->GetWeightsData()->GetObjectCount() );
+	EXPECT_EQ( 12, conv1x1->GetFilterData()->GetObjectCount() );
+
+	CArray<float> quantized;
+	dnn.RunOnce();
+	getSinkOutput( dnn, "sink", quantized );
+	checkQuantizedOutput( expected, quantized );
+
+	// The quantization parameters are stored with the network
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::SD_Storing );
+		dnn.Serialize( archive );
+	}
+	file.SeekToBegin();
+	CDnn loaded( random, MathEngine() );
+	{
+		CArchive archive( &file, CArchive::SD_Loading );
+		loaded.Serialize( archive );
+	}
+	EXPECT_TRUE( CheckCast<CConvLayer>( loaded.GetLayer( "conv1x1" ) )->GetInt8Quantization().IsQuantized() );
+	EXPECT_TRUE( CheckCast<CFullyConnectedLayer>( loaded.GetLayer( "fc" ) )->GetInt8Quantization().IsQuantized() );
+	CheckCast<CSourceLayer>( loaded.GetLayer( "data" ) )->SetBlob( input );
+	loaded.RunOnce();
+	CArray<float> loadedOutput;
+	getSinkOutput( loaded, "sink", loadedOutput );
+	ASSERT_EQ( quantized.Size(), loadedOutput.Size() );
+	for( int i = 0; i < quantized.Size(); ++i ) {
+		EXPECT_EQ( quantized[i], loadedOutput[i] );
+	}
+
+	// Back to float
+	EXPECT_EQ( 2, quantizer.Reset( dnn ) );
+	CArray<float> restored;
+	dnn.RunOnce();
+	getSinkOutput( dnn, "sink", restored );
+	// The float weights are restored from the int8 ones
+	EXPECT_TRUE( fc->Weights() != nullptr );
+	checkQuantizedOutput( expected, restored );
+}
+
+TEST( Int8QuantizationTest, RecurrentLayersAreSkipped )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	CRandom random( 0x4321 );
+	CDnn dnn( random, MathEngine() );
+
+	CPtr<CSourceLayer> data = Source( dnn, "data" );
+	CPtr<CLstmLayer> lstm = Lstm( 8, 0.f )( "lstm", data.Ptr() );
+	CPtr<CGruLayer> gru = Gru( 6 )( "gru", lstm.Ptr() );
+	CPtr<CFullyConnectedLayer> fc = FullyConnected( 5 )( "fc", gru.Ptr() );
+	Sink( fc.Ptr(), "sink" );
+
+	CPtr<CDnnBlob> input = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, 4, 3, 7 );
+	fillRandomBlob( *input, random, -1, 1 );
+	data->SetBlob( input );
+
+	CArray<float> expected;
+	dnn.RunOnce();
+	getSinkOutput( dnn, "sink", expected );
+
+	// Only the standalone fully-connected layer is quantized
+	CDnnInt8Quantizer quantizer;
+	EXPECT_EQ( 1, quantizer.StartCalibration( dnn ) );
+	dnn.RunOnce();
+	EXPECT_EQ( 1, quantizer.FinishCalibration( dnn ) );
+	EXPECT_TRUE( fc->GetInt8Quantization().IsQuantized() );
+
+	CArray<float> quantized;
+	dnn.RunOnce();
+	getSinkOutput( dnn, "sink", quantized );
+	checkQuantizedOutput( expected, quantized );
+}
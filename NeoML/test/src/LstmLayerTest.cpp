@@ -0,0 +1,170 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static CPtr<CDnnBlob> createLstmTestBlob( CRandom& random, int batchLength, int batchWidth, int channels )
+{
+	CPtr<CDnnBlob> blob = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, batchLength, batchWidth, channels );
+	CArray<float> data;
+	for( int i = 0; i < blob->GetDataSize(); ++i ) {
+		data.Add( static_cast<float>( random.Uniform( -1, 1 ) ) );
+	}
+	blob->CopyFrom( data.GetPtr() );
+	return blob;
+}
+
+static void expectLstmBlobsNear( const CDnnBlob& expected, const CDnnBlob& actual )
+{
+	ASSERT_TRUE( expected.HasEqualDimensions( &actual ) );
+	CDnnBlobBuffer<float> expectedBuffer( const_cast<CDnnBlob&>( expected ), TDnnBlobBufferAccess::Read );
+	CDnnBlobBuffer<float> actualBuffer( const_cast<CDnnBlob&>( actual ), TDnnBlobBufferAccess::Read );
+	for( int i = 0; i < expectedBuffer.Size(); ++i ) {
+		EXPECT_NEAR( expectedBuffer[i], actualBuffer[i], 1e-4f ) << i;
+	}
+}
+
+// The network for the fused training test
+// The fully connected layer before the LSTM checks the LSTM input diff
+// If isStepByStep is set the LSTM is wrapped into a recurrent layer, which turns the fused calculation off
+struct CLstmTrainingTestNet {
+	CDnn Dnn;
+	CPtr<CFullyConnectedLayer> Fc;
+	CPtr<CLstmLayer> Lstm;
+	CPtr<CSinkLayer> Sink;
+
+	CLstmTrainingTestNet( CRandom& random, const CArray<CPtr<CDnnBlob>>& inputs, int hiddenSize,
+		bool reverse, bool isStepByStep );
+};
+
+CLstmTrainingTestNet::CLstmTrainingTestNet( CRandom& random, const CArray<CPtr<CDnnBlob>>& inputs,
+		int hiddenSize, bool reverse, bool isStepByStep ) :
+	Dnn( random, MathEngine() )
+{
+	CPtr<CDnnSimpleGradientSolver> sgd = new CDnnSimpleGradientSolver( MathEngine() );
+	sgd->SetLearningRate( 0.1f );
+	Dnn.SetSolver( sgd );
+
+	CPtr<CSourceLayer> data = Source( Dnn, "data" );
+	data->SetBlob( inputs[0] );
+	Fc = FullyConnected( inputs[0]->GetChannelsCount() )( "fc", data.Ptr() );
+
+	Lstm = new CLstmLayer( MathEngine() );
+	Lstm->SetName( "lstm" );
+	Lstm->SetHiddenSize( hiddenSize );
+	Lstm->SetReverseSequence( reverse );
+
+	CPtr<CBaseLayer> output = Lstm.Ptr();
+	if( isStepByStep ) {
+		CPtr<CRecurrentLayer> recurrent = new CRecurrentLayer( MathEngine() );
+		recurrent->SetName( "recurrent" );
+		recurrent->SetReverseSequence( reverse );
+		recurrent->AddLayer( *Lstm );
+		for( int i = 0; i < inputs.Size(); ++i ) {
+			recurrent->SetInputMapping( i, *Lstm, i );
+		}
+		recurrent->SetOutputMapping( 0, *Lstm, 0 );
+		Dnn.AddLayer( *recurrent );
+		output = recurrent.Ptr();
+	} else {
+		Dnn.AddLayer( *Lstm );
+	}
+	output->Connect( 0, *Fc );
+	for( int i = 1; i < inputs.Size(); ++i ) {
+		CPtr<CSourceLayer> initialState = Source( Dnn, i == 1 ? "initialState" : "initialMain" );
+		initialState->SetBlob( inputs[i] );
+		output->Connect( i, *initialState );
+	}
+	Sink = NeoML::Sink( output.Ptr(), "sink" );
+
+	CPtr<CSourceLayer> target = Source( Dnn, "target" );
+	target->SetBlob( createLstmTestBlob( random, inputs[0]->GetBatchLength(), inputs[0]->GetBatchWidth(),
+		hiddenSize ) );
+	EuclideanLoss()( "loss", output.Ptr(), target.Ptr() );
+}
+
+// Compares the fused training with the step-by-step calculation of the internal network
+static void lstmFusedTrainingTest( int sequenceLength, int batchWidth, bool reverse, int initialStates )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		GTEST_LOG_( INFO ) << "Skipped rest of test for MathEngine type=" << MathEngine().GetType() << " because no implementation.\n";
+		return;
+	}
+
+	const int inputSize = 5;
+	const int hiddenSize = 6;
+
+	CRandom random( 0x1234 );
+	CArray<CPtr<CDnnBlob>> inputs;
+	inputs.Add( createLstmTestBlob( random, sequenceLength, batchWidth, inputSize ) );
+	for( int i = 0; i < initialStates; ++i ) {
+		inputs.Add( createLstmTestBlob( random, 1, batchWidth, hiddenSize ) );
+	}
+
+	CRandom fusedRandom( 0x4321 );
+	CLstmTrainingTestNet fused( fusedRandom, inputs, hiddenSize, reverse, /*isStepByStep*/false );
+	CRandom expectedRandom( 0x4321 );
+	CLstmTrainingTestNet expected( expectedRandom, inputs, hiddenSize, reverse, /*isStepByStep*/true );
+
+	// Initialize the weights and make them equal
+	fused.Dnn.RunOnce();
+	expected.Dnn.RunOnce();
+	expected.Fc->SetWeightsData( fused.Fc->GetWeightsData() );
+	expected.Fc->SetFreeTermData( fused.Fc->GetFreeTermData() );
+	expected.Lstm->SetInputWeightsData( fused.Lstm->GetInputWeightsData() );
+	expected.Lstm->SetInputFreeTermData( fused.Lstm->GetInputFreeTermData() );
+	expected.Lstm->SetRecurWeightsData( fused.Lstm->GetRecurWeightsData() );
+	expected.Lstm->SetRecurFreeTermData( fused.Lstm->GetRecurFreeTermData() );
+
+	for( int step = 0; step < 3; ++step ) {
+		fused.Dnn.RunAndLearnOnce();
+		expected.Dnn.RunAndLearnOnce();
+		expectLstmBlobsNear( *expected.Sink->GetBlob(), *fused.Sink->GetBlob() );
+	}
+
+	expectLstmBlobsNear( *expected.Lstm->GetInputWeightsData(), *fused.Lstm->GetInputWeightsData() );
+	expectLstmBlobsNear( *expected.Lstm->GetInputFreeTermData(), *fused.Lstm->GetInputFreeTermData() );
+	expectLstmBlobsNear( *expected.Lstm->GetRecurWeightsData(), *fused.Lstm->GetRecurWeightsData() );
+	expectLstmBlobsNear( *expected.Lstm->GetRecurFreeTermData(), *fused.Lstm->GetRecurFreeTermData() );
+	expectLstmBlobsNear( *expected.Fc->GetWeightsData(), *fused.Fc->GetWeightsData() );
+}
+
+TEST( CLstmLayerTest, FusedTraining )
+{
+	lstmFusedTrainingTest( 5, 3, false, 0 );
+}
+
+TEST( CLstmLayerTest, FusedTrainingReverse )
+{
+	lstmFusedTrainingTest( 5, 3, true, 0 );
+}
+
+TEST( CLstmLayerTest, FusedTrainingInitialState )
+{
+	lstmFusedTrainingTest( 5, 3, false, 2 );
+	lstmFusedTrainingTest( 5, 3, true, 1 );
+}
+
+TEST( CLstmLayerTest, FusedTrainingSingleStep )
+{
+	lstmFusedTrainingTest( 1, 4, false, 2 );
+}
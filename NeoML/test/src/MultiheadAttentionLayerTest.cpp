@@ -0,0 +1,409 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <TestFixture.h>
+#include <NeoML/NeoML.h>
+
+#include <memory>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+namespace NeoMLTest {
+
+static CPtr<CDnnBlob> createAttentionTestBlob( const CBlobDesc& desc, CRandom& random, bool isMask )
+{
+	CPtr<CDnnBlob> blob = CDnnBlob::CreateBlob( MathEngine(), CT_Float, desc );
+	CArray<float> data;
+	for( int i = 0; i < blob->GetDataSize(); ++i ) {
+		data.Add( isMask ? ( random.Uniform( 0, 1 ) < 0.2 ? 1.f : 0.f ) : static_cast<float>( random.Uniform( -1, 1 ) ) );
+	}
+	blob->CopyFrom( data.GetPtr() );
+	return blob;
+}
+
+// Builds the network with the attention output connected to "sink"
+// If withSoftmax is set the softmax output is connected to another sink, so the attention is calculated step by step
+static CPtr<CMultiheadAttentionLayer> buildAttentionTestNetwork( CDnn& dnn, CMultiheadAttentionLayer::TMaskType maskType,
+	bool withSoftmax )
+{
+	CPtr<CMultiheadAttentionLayer> attention = new CMultiheadAttentionLayer( MathEngine() );
+	attention->SetName( "attention" );
+	attention->SetHeadCount( 4 );
+	attention->SetHiddenSize( 32 );
+	attention->SetOutputSize( 16 );
+	attention->SetUseMask( true );
+	attention->SetMaskType( maskType );
+	const char* const inputNames[] = { "Q", "K", "V", "mask" };
+	for( int i = 0; i < 4; ++i ) {
+		attention->Connect( i, *Source( dnn, inputNames[i] ) );
+	}
+	dnn.AddLayer( *attention );
+	Sink( CDnnLayerLink( attention, 0 ), "sink" );
+	if( withSoftmax ) {
+		Sink( CDnnLayerLink( attention, 1 ), "softmaxSink" );
+	}
+	return attention;
+}
+
+static void checkFusedAttention( int batchWidth, int querySize, int keySize, CMultiheadAttentionLayer::TMaskType maskType )
+{
+	CRandom random( 0x1234 );
+	CDnn fusedDnn( random, MathEngine() );
+	CPtr<CMultiheadAttentionLayer> fusedAttention = buildAttentionTestNetwork( fusedDnn, maskType, false );
+	CDnn stepByStepDnn( random, MathEngine() );
+	CPtr<CMultiheadAttentionLayer> stepByStepAttention = buildAttentionTestNetwork( stepByStepDnn, maskType, true );
+
+	CPtr<CDnnBlob> inputs[4];
+	inputs[0] = createAttentionTestBlob( CBlobDesc( { 1, batchWidth, querySize, 1, 1, 1, 12 } ), random, false );
+	inputs[1] = createAttentionTestBlob( CBlobDesc( { 1, batchWidth, keySize, 1, 1, 1, 12 } ), random, false );
+	inputs[2] = createAttentionTestBlob( CBlobDesc( { 1, batchWidth, keySize, 1, 1, 1, 20 } ), random, false );
+	inputs[3] = createAttentionTestBlob( maskType == CMultiheadAttentionLayer::MT_OneObject
+		? CBlobDesc( { 1, 1, 1, 1, querySize, 1, keySize } )
+		: CBlobDesc( { 1, batchWidth, 4, 1, querySize, 1, keySize } ), random, true );
+	const char* const inputNames[] = { "Q", "K", "V", "mask" };
+	for( int i = 0; i < 4; ++i ) {
+		CheckCast<CSourceLayer>( fusedDnn.GetLayer( inputNames[i] ) )->SetBlob( inputs[i] );
+		CheckCast<CSourceLayer>( stepByStepDnn.GetLayer( inputNames[i] ) )->SetBlob( inputs[i] );
+	}
+
+	// The same weights in both networks
+	stepByStepDnn.RunOnce();
+	fusedDnn.RunOnce();
+	const char* const weightsLayers[] = { "Q", "K", "V", "Out.Dense" };
+	for( const char* name : weightsLayers ) {
+		CPtr<CFullyConnectedLayer> from = CheckCast<CFullyConnectedLayer>( stepByStepAttention->GetLayer( name ) );
+		CPtr<CFullyConnectedLayer> to = CheckCast<CFullyConnectedLayer>( fusedAttention->GetLayer( name ) );
+		to->SetWeightsData( from->GetWeightsData() );
+		to->SetFreeTermData( from->GetFreeTermData() );
+	}
+	fusedDnn.RunOnce();
+
+	const bool isFused = MathEngine().GetType() == MET_Cpu;
+	EXPECT_EQ( isFused, fusedAttention->HasLayer( "ScaledDotProductAttention" ) );
+	EXPECT_FALSE( stepByStepAttention->HasLayer( "ScaledDotProductAttention" ) );
+
+	CPtr<CDnnBlob> expected = CheckCast<CSinkLayer>( stepByStepDnn.GetLayer( "sink" ) )->GetBlob();
+	CPtr<CDnnBlob> actual = CheckCast<CSinkLayer>( fusedDnn.GetLayer( "sink" ) )->GetBlob();
+	ASSERT_TRUE( expected->HasEqualDimensions( actual ) );
+	CArray<float> expectedData;
+	expectedData.SetSize( expected->GetDataSize() );
+	expected->CopyTo( expectedData.GetPtr() );
+	CArray<float> actualData;
+	actualData.SetSize( actual->GetDataSize() );
+	actual->CopyTo( actualData.GetPtr() );
+	for( int i = 0; i < expectedData.Size(); ++i ) {
+		EXPECT_NEAR( expectedData[i], actualData[i], 1e-4f );
+	}
+}
+
+// The self-attention network with the cache: X is passed to Q, K and V
+static CPtr<CMultiheadAttentionLayer> buildCacheTestNetwork( CDnn& dnn )
+{
+	CPtr<CMultiheadAttentionLayer> attention = new CMultiheadAttentionLayer( MathEngine() );
+	attention->SetName( "attention" );
+	attention->SetHeadCount( 4 );
+	attention->SetHiddenSize( 32 );
+	attention->SetOutputSize( 16 );
+	attention->SetUseMask( true );
+	CPtr<CSourceLayer> x = Source( dnn, "X" );
+	for( int i = 0; i < 3; ++i ) {
+		attention->Connect( i, *x );
+	}
+	attention->Connect( 3, *Source( dnn, "mask" ) );
+	dnn.AddLayer( *attention );
+	Sink( attention.Ptr(), "sink" );
+	return attention;
+}
+
+// The mask which hides the next elements of the sequence; the queries are the last elements
+static CPtr<CDnnBlob> createCausalMask( int querySize, int keySize )
+{
+	CPtr<CDnnBlob> mask = CDnnBlob::CreateBlob( MathEngine(), CT_Float, CBlobDesc( { 1, 1, 1, 1, querySize, 1, keySize } ) );
+	CArray<float> data;
+	for( int i = 0; i < querySize; ++i ) {
+		for( int j = 0; j < keySize; ++j ) {
+			data.Add( j > keySize - querySize + i ? 1.f : 0.f );
+		}
+	}
+	mask->CopyFrom( data.GetPtr() );
+	return mask;
+}
+
+// Runs the network on the [from, to) elements of the sequences
+static void runCacheTestStep( CDnn& dnn, const CDnnBlob& sequence, int from, int to, int keySize, CArray<float>& output )
+{
+	const int batchWidth = sequence.GetBatchWidth();
+	const int channels = sequence.GetChannelsCount();
+	CArray<float> sequenceData;
+	sequenceData.SetSize( sequence.GetDataSize() );
+	sequence.CopyTo( sequenceData.GetPtr() );
+	CPtr<CDnnBlob> input = CDnnBlob::CreateBlob( MathEngine(), CT_Float,
+		CBlobDesc( { 1, batchWidth, to - from, 1, 1, 1, channels } ) );
+	CArray<float> inputData;
+	for( int b = 0; b < batchWidth; ++b ) {
+		for( int i = from; i < to; ++i ) {
+			for( int c = 0; c < channels; ++c ) {
+				inputData.Add( sequenceData[( b * sequence.GetListSize() + i ) * channels + c] );
+			}
+		}
+	}
+	input->CopyFrom( inputData.GetPtr() );
+
+	CheckCast<CSourceLayer>( dnn.GetLayer( "X" ) )->SetBlob( input );
+	CheckCast<CSourceLayer>( dnn.GetLayer( "mask" ) )->SetBlob( createCausalMask( to - from, keySize ) );
+	dnn.RunOnce();
+	CPtr<CDnnBlob> result = CheckCast<CSinkLayer>( dnn.GetLayer( "sink" ) )->GetBlob();
+	output.SetSize( result->GetDataSize() );
+	result->CopyTo( output.GetPtr() );
+}
+
+} // namespace NeoMLTest
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TEST( MultiheadAttentionLayerTest, FusedAttentionOneObjectMask )
+{
+	checkFusedAttention( 2, 7, 5, CMultiheadAttentionLayer::MT_OneObject );
+	checkFusedAttention( 1, 300, 300, CMultiheadAttentionLayer::MT_OneObject );
+}
+
+TEST( MultiheadAttentionLayerTest, FusedAttentionEltwiseMask )
+{
+	checkFusedAttention( 3, 5, 9, CMultiheadAttentionLayer::MT_Eltwise );
+	checkFusedAttention( 2, 100, 270, CMultiheadAttentionLayer::MT_Eltwise );
+}
+
+TEST( MultiheadAttentionLayerTest, SwitchToTraining )
+{
+	CRandom random( 0x4321 );
+	CDnn dnn( random, MathEngine() );
+	CPtr<CMultiheadAttentionLayer> attention = buildAttentionTestNetwork( dnn, CMultiheadAttentionLayer::MT_OneObject,
+		false );
+	const char* const inputNames[] = { "Q", "K", "V", "mask" };
+	const CBlobDesc inputDescs[] = { CBlobDesc( { 1, 2, 6, 1, 1, 1, 12 } ), CBlobDesc( { 1, 2, 4, 1, 1, 1, 12 } ),
+		CBlobDesc( { 1, 2, 4, 1, 1, 1, 20 } ), CBlobDesc( { 1, 1, 1, 1, 6, 1, 4 } ) };
+	for( int i = 0; i < 4; ++i ) {
+		CheckCast<CSourceLayer>( dnn.GetLayer( inputNames[i] ) )->SetBlob(
+			createAttentionTestBlob( inputDescs[i], random, i == 3 ) );
+	}
+	dnn.RunOnce();
+	CPtr<CDnnBlob> inferenceOutput = CheckCast<CSinkLayer>( dnn.GetLayer( "sink" ) )->GetBlob()->GetCopy();
+
+	// The backward pass needs the step by step calculation
+	dnn.RunAndBackwardOnce();
+	EXPECT_FALSE( attention->HasLayer( "ScaledDotProductAttention" ) );
+	CPtr<CDnnBlob> trainingOutput = CheckCast<CSinkLayer>( dnn.GetLayer( "sink" ) )->GetBlob();
+	CArray<float> expected;
+	expected.SetSize( inferenceOutput->GetDataSize() );
+	inferenceOutput->CopyTo( expected.GetPtr() );
+	CArray<float> actual;
+	actual.SetSize( trainingOutput->GetDataSize() );
+	trainingOutput->CopyTo( actual.GetPtr() );
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_NEAR( expected[i], actual[i], 1e-4f );
+	}
+
+	dnn.RunOnce();
+	EXPECT_EQ( MathEngine().GetType() == MET_Cpu, attention->HasLayer( "ScaledDotProductAttention" ) );
+}
+
+TEST( MultiheadAttentionLayerTest, StoreFusedAttention )
+{
+	CRandom random( 0x2468 );
+	CDnn dnn( random, MathEngine() );
+	CPtr<CMultiheadAttentionLayer> attention = buildAttentionTestNetwork( dnn, CMultiheadAttentionLayer::MT_Eltwise,
+		false );
+	const char* const inputNames[] = { "Q", "K", "V", "mask" };
+	const CBlobDesc inputDescs[] = { CBlobDesc( { 1, 2, 6, 1, 1, 1, 12 } ), CBlobDesc( { 1, 2, 4, 1, 1, 1, 12 } ),
+		CBlobDesc( { 1, 2, 4, 1, 1, 1, 20 } ), CBlobDesc( { 1, 2, 4, 1, 6, 1, 4 } ) };
+	CPtr<CDnnBlob> inputs[4];
+	for( int i = 0; i < 4; ++i ) {
+		inputs[i] = createAttentionTestBlob( inputDescs[i], random, i == 3 );
+		CheckCast<CSourceLayer>( dnn.GetLayer( inputNames[i] ) )->SetBlob( inputs[i] );
+	}
+	dnn.RunOnce();
+	CPtr<CDnnBlob> expected = CheckCast<CSinkLayer>( dnn.GetLayer( "sink" ) )->GetBlob()->GetCopy();
+	const bool isFused = MathEngine().GetType() == MET_Cpu;
+	EXPECT_EQ( isFused, attention->HasLayer( "ScaledDotProductAttention" ) );
+
+	CMemoryFile file;
+	{
+		CArchive archive( &file, CArchive::SD_Storing );
+		dnn.Serialize( archive );
+	}
+	// The stored network keeps working in the same mode
+	EXPECT_EQ( isFused, attention->HasLayer( "ScaledDotProductAttention" ) );
+	dnn.RunOnce();
+
+	// The step-by-step calculation is stored
+	file.SeekToBegin();
+	CDnn loaded( random, MathEngine() );
+	{
+		CArchive archive( &file, CArchive::SD_Loading );
+		loaded.Serialize( archive );
+	}
+	CPtr<CMultiheadAttentionLayer> loadedAttention = CheckCast<CMultiheadAttentionLayer>( loaded.GetLayer( "attention" ) );
+	EXPECT_FALSE( loadedAttention->HasLayer( "ScaledDotProductAttention" ) );
+	EXPECT_TRUE( loadedAttention->HasLayer( "MatrixDot" ) );
+
+	for( int i = 0; i < 4; ++i ) {
+		CheckCast<CSourceLayer>( loaded.GetLayer( inputNames[i] ) )->SetBlob( inputs[i] );
+	}
+	loaded.RunOnce();
+	EXPECT_EQ( isFused, loadedAttention->HasLayer( "ScaledDotProductAttention" ) );
+
+	// The replica is stored with the shared weights of the fused attention skipped
+	CRandom replicaRandom( 0x1357 );
+	std::unique_ptr<CDnn> replica( dnn.CreateInferenceReplica( replicaRandom ) );
+	EXPECT_EQ( isFused, attention->HasLayer( "ScaledDotProductAttention" ) );
+	for( int i = 0; i < 4; ++i ) {
+		CheckCast<CSourceLayer>( replica->GetLayer( inputNames[i] ) )->SetBlob( inputs[i] );
+	}
+	replica->RunOnce();
+
+	CArray<float> expectedData;
+	expectedData.SetSize( expected->GetDataSize() );
+	expected->CopyTo( expectedData.GetPtr() );
+	for( const CDnn* result : { &loaded, replica.get() } ) {
+		CPtr<const CDnnBlob> actual = CheckCast<const CSinkLayer>( result->GetLayer( "sink" ) )->GetBlob();
+		ASSERT_TRUE( expected->HasEqualDimensions( actual ) );
+		CArray<float> actualData;
+		actualData.SetSize( actual->GetDataSize() );
+		actual->CopyTo( actualData.GetPtr() );
+		for( int i = 0; i < expectedData.Size(); ++i ) {
+			EXPECT_NEAR( expectedData[i], actualData[i], 1e-5f );
+		}
+	}
+}
+
+TEST( MultiheadAttentionLayerTest, CacheDecoding )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	const int batchWidth = 2;
+	const int length = 9;
+	const int prefixLength = 4;
+	CRandom random( 0x5678 );
+	CDnn dnn( random, MathEngine() );
+	CPtr<CMultiheadAttentionLayer> attention = buildCacheTestNetwork( dnn );
+	CPtr<CDnnBlob> sequence = createAttentionTestBlob( CBlobDesc( { 1, batchWidth, length, 1, 1, 1, 12 } ), random, false );
+
+	// The whole sequences at once
+	CArray<float> expected;
+	runCacheTestStep( dnn, *sequence, 0, length, length, expected );
+	const int outputSize = expected.Size() / ( batchWidth * length );
+
+	// The prefix and then the elements one by one, the weights are kept
+	attention->SetMaxCacheLength( length );
+	int position = 0;
+	while( position < length ) {
+		const int stepLength = position == 0 ? prefixLength : 1;
+		CArray<float> actual;
+		runCacheTestStep( dnn, *sequence, position, position + stepLength, position + stepLength, actual );
+		EXPECT_EQ( position + stepLength, attention->GetCacheLength() );
+		for( int b = 0; b < batchWidth; ++b ) {
+			for( int i = 0; i < stepLength; ++i ) {
+				for( int j = 0; j < outputSize; ++j ) {
+					EXPECT_NEAR( expected[( b * length + position + i ) * outputSize + j],
+						actual[( b * stepLength + i ) * outputSize + j], 1e-4f );
+				}
+			}
+		}
+		position += stepLength;
+	}
+
+	attention->ResetCache();
+	EXPECT_EQ( 0, attention->GetCacheLength() );
+}
+
+TEST( MultiheadAttentionLayerTest, CacheState )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+
+	const int maxCacheLength = 8;
+	CRandom random( 0x8765 );
+	CDnn dnn( random, MathEngine() );
+	CPtr<CMultiheadAttentionLayer> attention = buildCacheTestNetwork( dnn );
+	attention->SetMaxCacheLength( maxCacheLength );
+	CPtr<CDnnBlob> sequence = createAttentionTestBlob( CBlobDesc( { 1, 3, 20, 1, 1, 1, 12 } ), random, false );
+
+	CArray<float> output;
+	runCacheTestStep( dnn, *sequence, 0, 5, 5, output );
+	CPtr<CDnnBlob> keys;
+	CPtr<CDnnBlob> values;
+	attention->GetCache( keys, values );
+	ASSERT_TRUE( keys != nullptr && values != nullptr );
+	EXPECT_EQ( 5, keys->GetListSize() );
+	EXPECT_EQ( attention->GetHiddenSize(), keys->GetChannelsCount() );
+
+	// Storing the network doesn't change the cache
+	{
+		CMemoryFile file;
+		CArchive archive( &file, CArchive::SD_Storing );
+		dnn.Serialize( archive );
+	}
+	EXPECT_EQ( 5, attention->GetCacheLength() );
+
+	CArray<float> expected;
+	runCacheTestStep( dnn, *sequence, 5, 6, 6, expected );
+
+	// Restoring the saved state gives the same result
+	attention->ResetCache();
+	attention->SetCache( *keys, *values );
+	EXPECT_EQ( 5, attention->GetCacheLength() );
+	CArray<float> actual;
+	runCacheTestStep( dnn, *sequence, 5, 6, 6, actual );
+	ASSERT_EQ( expected.Size(), actual.Size() );
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_NEAR( expected[i], actual[i], 1e-5f );
+	}
+
+	// Trimming keeps the last elements: the same state as after the run over these elements
+	attention->TrimCache( 3 );
+	EXPECT_EQ( 3, attention->GetCacheLength() );
+	CPtr<CDnnBlob> trimmedKeys;
+	CPtr<CDnnBlob> trimmedValues;
+	attention->GetCache( trimmedKeys, trimmedValues );
+	CArray<float> fullData;
+	fullData.SetSize( keys->GetDataSize() );
+	keys->CopyTo( fullData.GetPtr() );
+	CArray<float> trimmedData;
+	trimmedData.SetSize( trimmedKeys->GetDataSize() );
+	trimmedKeys->CopyTo( trimmedData.GetPtr() );
+	const int hiddenSize = attention->GetHiddenSize();
+	for( int b = 0; b < 3; ++b ) {
+		// The cache had 6 elements, the last 3 of them are kept; the 6th isn't in the saved keys
+		for( int i = 0; i < 2; ++i ) {
+			for( int c = 0; c < hiddenSize; ++c ) {
+				EXPECT_EQ( fullData[( b * 5 + 3 + i ) * hiddenSize + c], trimmedData[( b * 3 + i ) * hiddenSize + c] );
+			}
+		}
+	}
+
+	// The oldest elements are discarded when the cache is full
+	for( int position = 6; position < 20; ++position ) {
+		const int keySize = min( attention->GetCacheLength() + 1, maxCacheLength );
+		runCacheTestStep( dnn, *sequence, position, position + 1, keySize, output );
+		EXPECT_EQ( keySize, attention->GetCacheLength() );
+	}
+}
@@ -209,6 +209,60 @@ CPtr<T> AddLayer( const CString& layerName, const CArray<CBaseLayer*>& input )
 	return AddLayer( layer, layerName, input );
 }
 
+//------------------------------------------------------------------------------------------------------------
+// The helpers for the tests which compare the outputs of the whole networks
+
+// Creates a float blob filled with the random values from [-1, 1]
+inline CPtr<CDnnBlob> CreateRandomDataBlob( CRandom& random, int batchLength, int batchWidth, int channels )
+{
+	CPtr<CDnnBlob> blob = CDnnBlob::CreateDataBlob( MathEngine(), CT_Float, batchLength, batchWidth, channels );
+	CREATE_FILL_FLOAT_ARRAY( data, -1.f, 1.f, blob->GetDataSize(), random );
+	blob->CopyFrom( data.GetPtr() );
+	return blob;
+}
+
+// Creates an integer blob filled with the random values from [0, maxValue]
+inline CPtr<CDnnBlob> CreateRandomIntDataBlob( CRandom& random, int batchLength, int batchWidth, int channels,
+	int maxValue )
+{
+	CPtr<CDnnBlob> blob = CDnnBlob::CreateDataBlob( MathEngine(), CT_Int, batchLength, batchWidth, channels );
+	CREATE_FILL_INT_ARRAY( data, 0, maxValue, blob->GetDataSize(), random );
+	blob->CopyFrom( data.GetPtr() );
+	return blob;
+}
+
+inline void GetBlobData( const CDnnBlob& blob, CArray<float>& data )
+{
+	data.SetSize( blob.GetDataSize() );
+	blob.CopyTo( data.GetPtr() );
+}
+
+inline void GetSinkData( const CDnn& dnn, const char* sinkName, CArray<float>& data )
+{
+	GetBlobData( *CheckCast<const CSinkLayer>( dnn.GetLayer( sinkName ) )->GetBlob(), data );
+}
+
+// Sets the blobs of the source layers of one network to the source layers with the same names in another
+inline void CopySourceBlobs( const CDnn& from, CDnn& to )
+{
+	CArray<const char*> layerNames;
+	from.GetLayerList( layerNames );
+	for( const char* name : layerNames ) {
+		const CSourceLayer* source = dynamic_cast<const CSourceLayer*>( from.GetLayer( name ).Ptr() );
+		if( source != nullptr ) {
+			CheckCast<CSourceLayer>( to.GetLayer( name ) )->SetBlob( source->GetBlob() );
+		}
+	}
+}
+
+inline void ExpectDataNear( const CArray<float>& expected, const CArray<float>& actual, float precision = 1e-5f )
+{
+	ASSERT_EQ( expected.Size(), actual.Size() );
+	for( int i = 0; i < expected.Size(); ++i ) {
+		EXPECT_NEAR( expected[i], actual[i], precision ) << i;
+	}
+}
+
 //------------------------------------------------------------------------------------------------------------
 
 class CNeoMLTestFixture : public ::testing::Test {
@@ -385,6 +385,20 @@ public:
 
 //------------------------------------------------------------------------------------------------------------
 
+// The matrix prepared for the repeated multiplications
+struct NEOMATHENGINE_API CPackedMatrixDesc : public CCrtAllocatedObject { public: virtual ~CPackedMatrixDesc(); };
+
+// The 16-bit floating point formats
+enum THalfFloatFormat {
+	HFF_Float16 = 0, // IEEE 754 binary16: 5 bits of exponent, 10 bits of mantissa
+	HFF_BFloat16 // the upper half of IEEE 754 binary32: 8 bits of exponent, 7 bits of mantissa
+};
+
+// Converts the float values to the 16-bit format in the host memory (rounding to the nearest even)
+NEOMATHENGINE_API void ConvertToHalfFloat( THalfFloatFormat format, const float* source, uint16_t* result, int count );
+// Converts the 16-bit values in the host memory to float
+NEOMATHENGINE_API void ConvertFromHalfFloat( THalfFloatFormat format, const uint16_t* source, float* result, int count );
+
 // The class provides basic linear algebra operations
 class NEOMATHENGINE_API IBlasEngine : public IVectorMathEngine {
 public:
@@ -533,6 +547,24 @@ public:
 	virtual void MultiplyMatrixByTransposedMatrix( int batchSize, const CConstFloatHandle& firstHandle, int firstHeight,
 		int firstWidth, const CConstFloatHandle& secondHandle, int secondHeight, const CFloatHandle& resultHandle,
 		int resultBufferSize ) = 0;
+	// Prepares the constant secondHeight * secondWidth matrix (e.g. the layer weights)
+	// to be used as the transposed second operand of the repeated multiplications
+	// The packed copy doesn't track the changes of the original matrix
+	// Returns nullptr if the math engine doesn't support packing; use MultiplyMatrixByTransposedMatrix then
+	// The descriptor should be destroyed using the standard delete operator after use.
+	virtual CPackedMatrixDesc* InitPackedTransposedMatrix( const CConstFloatHandle& secondHandle,
+		int secondHeight, int secondWidth ) = 0;
+	// Prepares the constant secondHeight * secondWidth matrix stored in the 16-bit format in the host memory
+	// The data is not copied and must stay unchanged while the descriptor exists
+	// The matrix is converted to float block by block during the multiplication,
+	// so the descriptor itself doesn't hold the float copy
+	// Returns nullptr if the math engine doesn't support it; convert the matrix to float then
+	// The descriptor should be destroyed using the standard delete operator after use.
+	virtual CPackedMatrixDesc* InitHalfFloatPackedTransposedMatrix( THalfFloatFormat format, const uint16_t* second,
+		int secondHeight, int secondWidth ) = 0;
+	// Multiplies a matrix by the packed one, transposed; the result will be of firstHeight * secondHeight size
+	virtual void MultiplyMatrixByPackedTransposedMatrix( const CConstFloatHandle& firstHandle, int firstHeight,
+		int firstWidth, const CPackedMatrixDesc& secondDesc, const CFloatHandle& resultHandle, int resultBufferSize ) = 0;
 
 	// Operations on sparse matrices
 
@@ -659,7 +691,14 @@ struct NEOMATHENGINE_API CGlobalMaxOverTimePoolingDesc : public CCrtAllocatedObj
 struct NEOMATHENGINE_API CMaxOverTimePoolingDesc : public CCrtAllocatedObject { public: virtual ~CMaxOverTimePoolingDesc(); };
 struct NEOMATHENGINE_API CLrnDesc : public CCrtAllocatedObject { public: virtual ~CLrnDesc(); };
 struct NEOMATHENGINE_API CLstmDesc : public CCrtAllocatedObject { public: virtual ~CLstmDesc(); };
+struct NEOMATHENGINE_API CGruDesc : public CCrtAllocatedObject { public: virtual ~CGruDesc(); };
 struct NEOMATHENGINE_API CRowwiseOperationDesc : public CCrtAllocatedObject { public: virtual ~CRowwiseOperationDesc(); };
+struct NEOMATHENGINE_API CInt8FullyConnectedDesc : public CCrtAllocatedObject { public: virtual ~CInt8FullyConnectedDesc(); };
+
+// The maximum absolute value of the int8 quantized weights
+// The range is narrowed to 7 bits so that the pairwise uint8 x int8 products never saturate in 16-bit SIMD registers
+// (the same archive gives the same results on any CPU)
+static const int Int8WeightQuantizationMax = 63;
 
 //------------------------------------------------------------------------------------------------------------
 // RLE format
@@ -1009,6 +1048,45 @@ public:
 		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
 		const CConstFloatHandle& input, const CFloatHandle& outputStateBackLink,
 		const CFloatHandle& outputMainBackLink ) = 0;
+	// The LSTM forward pass for training
+	// Works as Lstm but also stores the activated gates (sequenceLength x sequenceCount x 4 * hiddenSize)
+	// in the [main, forget, input, output] order, which are used by LstmBackward and LstmLearn
+	// outputStateBackLink and outputMainBackLink must contain the whole sequence
+	virtual void LstmForwardTraining( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
+		const CConstFloatHandle& input, const CFloatHandle& gates, const CFloatHandle& outputStateBackLink,
+		const CFloatHandle& outputMainBackLink ) = 0;
+	// Calculates the gradients of the gates before the activations (gatesDiff) over the whole sequence
+	// and the input diff (may be null)
+	// outputStateDiff, inputStateBackLink, inputStateBackLinkDiff and inputMainBackLinkDiff may be null
+	virtual void LstmBackward( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& gates,
+		const CConstFloatHandle& outputStateBackLink, const CConstFloatHandle& outputStateDiff,
+		const CConstFloatHandle& outputMainDiff, const CFloatHandle& gatesDiff, const CFloatHandle& inputDiff,
+		const CFloatHandle& inputStateBackLinkDiff, const CFloatHandle& inputMainBackLinkDiff ) = 0;
+	// Adds the weights gradients calculated from gatesDiff to the diffs
+	// inputWeightsDiff is 4 * hiddenSize x objectSize, recurWeightsDiff is 4 * hiddenSize x hiddenSize
+	// inputMainBackLink and the free term diffs may be null
+	virtual void LstmLearn( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& input, const CConstFloatHandle& inputMainBackLink,
+		const CConstFloatHandle& outputMainBackLink, const CConstFloatHandle& gatesDiff,
+		const CFloatHandle& inputWeightsDiff, const CFloatHandle& inputFreeTermDiff,
+		const CFloatHandle& recurWeightsDiff, const CFloatHandle& recurFreeTermDiff ) = 0;
+
+	// Creates descriptor of GRU with given weights
+	// gateWeights is the (2 * hiddenSize) x (objectSize + hiddenSize) matrix of the update and reset gates
+	// mainWeights is the hiddenSize x (objectSize + hiddenSize) matrix of the candidate state
+	// The first objectSize columns of the both are applied to the input, the rest to the previous state
+	// The free terms may be null
+	virtual CGruDesc* InitGru( int hiddenSize, int objectSize,
+		const CConstFloatHandle& gateWeights, const CConstFloatHandle& gateFreeTerm,
+		const CConstFloatHandle& mainWeights, const CConstFloatHandle& mainFreeTerm ) = 0;
+	// Calculates the GRU output for the whole sequence (inference only)
+	// input is the sequenceLength x sequenceCount x objectSize matrix,
+	// output is the sequenceLength x sequenceCount x hiddenSize matrix
+	// inputMainBackLink is the initial state of sequenceCount x hiddenSize size, zeros are used if it is null
+	virtual void Gru( CGruDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputMainBackLink, const CConstFloatHandle& input, const CFloatHandle& output ) = 0;
 
 	// CTC
 
@@ -1108,6 +1186,34 @@ public:
 		const CBlobDesc& input ) = 0;
 	virtual void RowwiseExecute( const CBlobDesc& inputDesc, CRowwiseOperationDesc** operations, int operationCount,
 		const CFloatHandle& input, const CFloatHandle& output ) = 0;
+
+	// Int8 quantized fully-connected operation (inference only, CPU)
+	// The descriptor should be destroyed using the standard delete operator after use.
+	// weights is the outputSize x inputSize matrix of the quantized values in the host memory,
+	//     each row is quantized symmetrically to [-Int8WeightQuantizationMax; Int8WeightQuantizationMax]
+	//     with its own scale from weightScales; the values are copied into the descriptor
+	// freeTerm is optional, of outputSize elements
+	// inputScale and inputZeroPoint are the asymmetric uint8 quantization parameters of the input
+	virtual CInt8FullyConnectedDesc* InitInt8FullyConnected( int inputSize, int outputSize,
+		const signed char* weights, const CConstFloatHandle& weightScales, const CConstFloatHandle* freeTerm,
+		float inputScale, int inputZeroPoint ) = 0;
+	// Quantizes the inputHeight x inputSize input, multiplies it by the transposed quantized weights
+	// and writes the dequantized inputHeight x outputSize result (with the free term added)
+	virtual void Int8FullyConnected( const CInt8FullyConnectedDesc& desc, const CConstFloatHandle& input,
+		int inputHeight, const CFloatHandle& result ) = 0;
+
+	// Multihead scaled dot-product attention (inference only, CPU)
+	// For each object and head calculates softmax( scale * Q * K^T + maskMultiplier * mask ) * V
+	// The keys are processed by blocks with the online softmax, so the querySize x keySize matrix is never stored
+	// query is the batchSize x querySize x (headCount * headSize) matrix, the head h uses the columns
+	//     [h * headSize; (h + 1) * headSize)
+	// key and value are batchSize x keySize x (headCount * headSize) matrices with the same columns layout
+	// mask is optional, it contains maskObjectCount matrices of querySize x keySize, maskObjectCount is either 1
+	//     (one mask for all objects and heads) or batchSize * headCount (object-major)
+	// result is the batchSize x querySize x (headCount * headSize) matrix with the same columns layout
+	virtual void ScaledDotProductAttention( int batchSize, int headCount, int querySize, int keySize, int headSize,
+		const CConstFloatHandle& query, const CConstFloatHandle& key, const CConstFloatHandle& value, float scale,
+		const CConstFloatHandle* mask, int maskObjectCount, float maskMultiplier, const CFloatHandle& result ) = 0;
 };
 
 //------------------------------------------------------------------------------------------------------------
@@ -1238,6 +1344,11 @@ NEOMATHENGINE_API IMathEngine* CreateCpuMathEngine( int /*deprecated*/, size_t m
 // Should be called only if there are no running CpuMathEngine instances
 NEOMATHENGINE_API void CpuMathEngineCleanUp();
 
+// Creates a handle of the memory allocated outside of the CPU math engine (for example, a memory-mapped file)
+// The math engine never frees this memory, so it must stay valid while the handle is used
+// The memory should be aligned the same way as the memory allocated by HeapAlloc
+NEOMATHENGINE_API CMemoryHandle CreateCpuExternalMemoryHandle( IMathEngine& mathEngine, const void* data );
+
 // Gpu math engine flags
 
 // Use tensor cores in cublas (if possible)
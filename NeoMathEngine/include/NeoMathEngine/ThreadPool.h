@@ -25,6 +25,8 @@ class NEOMATHENGINE_API IThreadPool : public CCrtAllocatedObject {
 public:
 	// Interface for pool task.
 	typedef void( *TFunction )( int threadIndex, void* params );
+	// Interface for the body of the parallel loop, processes the [begin, end) range of the loop indices.
+	typedef void( *TRangeFunction )( int threadIndex, int begin, int end, void* params );
 
 	IThreadPool() = default;
 	virtual ~IThreadPool();
@@ -38,6 +40,14 @@ public:
 	virtual bool AddTask( int threadIndex, TFunction function, void* params ) = 0;
 	// Waits for all tasks to complete.
 	virtual void WaitAllTask() = 0;
+
+	// Runs the loop over [0, count) in parallel and waits for it to complete.
+	// The loop is split into the ranges of grainSize indices (chosen automatically if grainSize <= 0).
+	// The ranges are distributed among the threads dynamically, so the function may be called several times
+	// with the same threadIndex, but never simultaneously.
+	// The nested call from inside a task of the same pool runs the whole loop in the calling thread.
+	// The default implementation splits the loop statically using AddTask.
+	virtual void ParallelFor( int count, int grainSize, TRangeFunction function, void* params );
 };
 
 // Number of available CPU cores in current environment (e.g. inside container)
@@ -303,6 +303,13 @@ void CpuMathEngineCleanUp()
 #endif
 }
 
+CMemoryHandle CreateCpuExternalMemoryHandle( IMathEngine& mathEngine, const void* data )
+{
+	ASSERT_EXPR( mathEngine.GetType() == MET_Cpu );
+	ASSERT_EXPR( data != nullptr );
+	return CMemoryHandleInternal::CreateMemoryHandle( &mathEngine, data );
+}
+
 void DeinitializeNeoMathEngine()
 {
 #ifdef NEOML_USE_MKL
@@ -346,6 +346,12 @@ public:
 		const CFloatHandle& resultHandle, int resultRowSize, int resultBufferSize ) override;
 	void MultiplyMatrixByTransposedMatrix( int batchSize, const CConstFloatHandle& firstHandle, int firstHeight, int firstWidth,
 		const CConstFloatHandle& secondHandle, int secondHeight, const CFloatHandle& resultHandle, int resultBufferSize ) override;
+	CPackedMatrixDesc* InitPackedTransposedMatrix( const CConstFloatHandle& secondHandle,
+		int secondHeight, int secondWidth ) override;
+	CPackedMatrixDesc* InitHalfFloatPackedTransposedMatrix( THalfFloatFormat format, const uint16_t* second,
+		int secondHeight, int secondWidth ) override;
+	void MultiplyMatrixByPackedTransposedMatrix( const CConstFloatHandle& firstHandle, int firstHeight,
+		int firstWidth, const CPackedMatrixDesc& secondDesc, const CFloatHandle& resultHandle, int resultBufferSize ) override;
 	void MultiplySparseMatrixByTransposedMatrix( int firstHeight, int firstWidth, int secondHeight,
 		const CSparseMatrixDesc& firstDesc, const CConstFloatHandle& secondHandle, const CFloatHandle& resultHandle ) override;
 	void MultiplyTransposedMatrixBySparseMatrix( int firstHeight, int firstWidth, int secondWidth,
@@ -569,6 +575,25 @@ public:
 		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
 		const CConstFloatHandle& input, const CFloatHandle& outputStateBackLink,
 		const CFloatHandle& outputMainBackLink ) override;
+	void LstmForwardTraining( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
+		const CConstFloatHandle& input, const CFloatHandle& gates, const CFloatHandle& outputStateBackLink,
+		const CFloatHandle& outputMainBackLink ) override;
+	void LstmBackward( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& gates,
+		const CConstFloatHandle& outputStateBackLink, const CConstFloatHandle& outputStateDiff,
+		const CConstFloatHandle& outputMainDiff, const CFloatHandle& gatesDiff, const CFloatHandle& inputDiff,
+		const CFloatHandle& inputStateBackLinkDiff, const CFloatHandle& inputMainBackLinkDiff ) override;
+	void LstmLearn( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& input, const CConstFloatHandle& inputMainBackLink,
+		const CConstFloatHandle& outputMainBackLink, const CConstFloatHandle& gatesDiff,
+		const CFloatHandle& inputWeightsDiff, const CFloatHandle& inputFreeTermDiff,
+		const CFloatHandle& recurWeightsDiff, const CFloatHandle& recurFreeTermDiff ) override;
+	CGruDesc* InitGru( int hiddenSize, int objectSize,
+		const CConstFloatHandle& gateWeights, const CConstFloatHandle& gateFreeTerm,
+		const CConstFloatHandle& mainWeights, const CConstFloatHandle& mainFreeTerm ) override;
+	void Gru( CGruDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputMainBackLink, const CConstFloatHandle& input, const CFloatHandle& output ) override;
 	void LinearInterpolation( const CConstFloatHandle& dataHandle, const CFloatHandle& resultHandle,
 		TInterpolationCoords coords, TInterpolationRound round, int objectCount, int scaledAxis,
 		int objectSize, float scale ) override;
@@ -619,6 +644,14 @@ public:
 		const CBlobDesc& input ) override;
 	void RowwiseExecute( const CBlobDesc& inputDesc, CRowwiseOperationDesc** operations, int operationCount,
 		const CFloatHandle& input, const CFloatHandle& output ) override;
+	CInt8FullyConnectedDesc* InitInt8FullyConnected( int inputSize, int outputSize,
+		const signed char* weights, const CConstFloatHandle& weightScales, const CConstFloatHandle* freeTerm,
+		float inputScale, int inputZeroPoint ) override;
+	void Int8FullyConnected( const CInt8FullyConnectedDesc& desc, const CConstFloatHandle& input,
+		int inputHeight, const CFloatHandle& result ) override;
+	void ScaledDotProductAttention( int batchSize, int headCount, int querySize, int keySize, int headSize,
+		const CConstFloatHandle& query, const CConstFloatHandle& key, const CConstFloatHandle& value, float scale,
+		const CConstFloatHandle* mask, int maskObjectCount, float maskMultiplier, const CFloatHandle& result ) override;
 
 	IPerformanceCounters* CreatePerformanceCounters( bool isOnlyTime ) const override;
 	// For Distributed only
@@ -736,6 +769,9 @@ private:
 		const float* filterData, const CConstFloatHandle* freeTermData, float* resultData );
 	void blobConvolutionForwardAlgo1( const CCpuConvolutionDesc& desc, const float* sourceData,
 		const float* filterData, const CConstFloatHandle* freeTermData, float* resultData );
+	template<class TWinograd>
+	void blobConvolutionForwardWinograd( const CCpuConvolutionDesc& desc, const float* sourceData,
+		const float* filterData, const float* freeTermData, float* resultData );
 	void blobConvolutionBackwardAlgo1( const CCpuConvolutionDesc& desc,
 		const CConstFloatHandle& sourceData, const CConstFloatHandle& filterData, const CConstFloatHandle* freeTerm,
 		const CFloatHandle& resultData );
@@ -21,7 +21,15 @@ limitations under the License.
 #include <CpuExecutionScope.h>
 #include <MemoryHandleInternal.h>
 #include <MathEngineCommon.h>
+#include <CPUInfo.h>
 #include <math.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef NEOML_USE_MLAS
+#include "mlas/inc/mlas.h"
+#endif
 
 namespace NeoML {
 
@@ -937,6 +945,117 @@ void CCpuMathEngine::MultiplyMatrixByTransposedMatrix( int batchSize, const CCon
 	}
 }
 
+// The matrix packed for the repeated multiplications
+struct CCpuPackedMatrixDesc : public CPackedMatrixDesc {
+	CCpuPackedMatrixDesc( int height, int width ) :
+		Height( height ), Width( width ), Data( nullptr ), HalfFormat( HFF_Float16 ), HalfData( nullptr ) {}
+
+	const int Height;
+	const int Width;
+	std::vector<uint8_t> Buffer;
+	const void* Data; // the aligned pointer inside the buffer
+	// The 16-bit matrix which is converted on the fly (if HalfData is not null, Data is not used)
+	THalfFloatFormat HalfFormat;
+	const uint16_t* HalfData;
+};
+
+// The maximum size of the block of the 16-bit matrix converted to float at once
+static const int HalfFloatBlockSize = 64 * 1024;
+
+CPackedMatrixDesc* CCpuMathEngine::InitPackedTransposedMatrix( const CConstFloatHandle& secondHandle,
+	int secondHeight, int secondWidth )
+{
+	ASSERT_EXPR( secondHandle.GetMathEngine() == this );
+	ASSERT_EXPR( secondHeight > 0 && secondWidth > 0 );
+
+#ifdef NEOML_USE_MLAS
+	if( customSgemmFunction != nullptr ) {
+		return nullptr;
+	}
+#ifdef NEOML_USE_MKL
+	if( !CCPUInfo::IsNotIntel ) {
+		// MKL is used for the multiplication
+		return nullptr;
+	}
+#endif // NEOML_USE_MKL
+	const size_t packedSize = MlasGemmPackBSize( static_cast<size_t>( secondHeight ), static_cast<size_t>( secondWidth ) );
+	if( packedSize == 0 ) {
+		return nullptr;
+	}
+
+	CCpuPackedMatrixDesc* desc = new CCpuPackedMatrixDesc( secondHeight, secondWidth );
+	const size_t alignment = MlasGetPreferredBufferAlignment();
+	desc->Buffer.resize( packedSize + alignment );
+	void* packed = desc->Buffer.data();
+	size_t space = desc->Buffer.size();
+	packed = std::align( alignment, packedSize, packed, space );
+	ASSERT_EXPR( packed != nullptr );
+	MlasGemmPackB( MlasTrans, static_cast<size_t>( secondHeight ), static_cast<size_t>( secondWidth ),
+		GetRaw( secondHandle ), static_cast<size_t>( secondWidth ), packed );
+	desc->Data = packed;
+	return desc;
+#else  // !NEOML_USE_MLAS
+	return nullptr;
+#endif // !NEOML_USE_MLAS
+}
+
+CPackedMatrixDesc* CCpuMathEngine::InitHalfFloatPackedTransposedMatrix( THalfFloatFormat format,
+	const uint16_t* second, int secondHeight, int secondWidth )
+{
+	ASSERT_EXPR( second != nullptr );
+	ASSERT_EXPR( secondHeight > 0 && secondWidth > 0 );
+
+#ifdef NEOML_USE_MLAS
+	if( customSgemmFunction != nullptr ) {
+		return nullptr;
+	}
+	CCpuPackedMatrixDesc* desc = new CCpuPackedMatrixDesc( secondHeight, secondWidth );
+	desc->HalfFormat = format;
+	desc->HalfData = second;
+	return desc;
+#else  // !NEOML_USE_MLAS
+	( void ) format;
+	return nullptr;
+#endif // !NEOML_USE_MLAS
+}
+
+void CCpuMathEngine::MultiplyMatrixByPackedTransposedMatrix( const CConstFloatHandle& firstHandle, int firstHeight,
+	int firstWidth, const CPackedMatrixDesc& secondDesc, const CFloatHandle& resultHandle, int resultBufferSize )
+{
+	ASSERT_EXPR( firstHandle.GetMathEngine() == this );
+	ASSERT_EXPR( resultHandle.GetMathEngine() == this );
+	const CCpuPackedMatrixDesc& desc = static_cast<const CCpuPackedMatrixDesc&>( secondDesc );
+	ASSERT_EXPR( firstWidth == desc.Width );
+	ASSERT_EXPR( resultBufferSize >= firstHeight * desc.Height );
+	CCpuExecutionScope scope;
+
+#ifdef NEOML_USE_MLAS
+	if( desc.HalfData != nullptr ) {
+		// Convert the matrix by blocks of rows small enough to stay in cache while MLAS packs them
+		const int blockHeight = std::min( desc.Height, std::max( 16, HalfFloatBlockSize / desc.Width ) );
+		std::vector<float> block( static_cast<size_t>( blockHeight ) * desc.Width );
+		const float* first = GetRaw( firstHandle );
+		float* result = GetRaw( resultHandle );
+		for( int row = 0; row < desc.Height; row += blockHeight ) {
+			const int rowCount = std::min( blockHeight, desc.Height - row );
+			ConvertFromHalfFloat( desc.HalfFormat, desc.HalfData + static_cast<size_t>( row ) * desc.Width,
+				block.data(), rowCount * desc.Width );
+			MlasGemm( MlasNoTrans, MlasTrans, static_cast<size_t>( firstHeight ), static_cast<size_t>( rowCount ),
+				static_cast<size_t>( firstWidth ), 1.f, first, static_cast<size_t>( firstWidth ),
+				block.data(), static_cast<size_t>( desc.Width ), 0.f, result + row, static_cast<size_t>( desc.Height ),
+				nullptr );
+		}
+		return;
+	}
+	MlasGemm( MlasNoTrans, static_cast<size_t>( firstHeight ), static_cast<size_t>( desc.Height ),
+		static_cast<size_t>( firstWidth ), 1.f, GetRaw( firstHandle ), static_cast<size_t>( firstWidth ), desc.Data,
+		0.f, GetRaw( resultHandle ), static_cast<size_t>( desc.Height ), nullptr );
+#else  // !NEOML_USE_MLAS
+	( void ) firstHeight;
+	ASSERT_EXPR( false );
+#endif // !NEOML_USE_MLAS
+}
+
 void CCpuMathEngine::batchMultiplyTransposedMatrixByMatrix( int batchSize,
 	const float* first, int firstHeight, int firstWidth,
 	const float* second, int secondWidth,
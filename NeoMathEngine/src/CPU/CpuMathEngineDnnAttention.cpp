@@ -0,0 +1,123 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <CpuMathEngine.h>
+#include <CpuMathEnginePrivate.h>
+#include <CpuExecutionScope.h>
+#include <MemoryHandleInternal.h>
+#include <NeoMathEngine/NeoMathEngineException.h>
+
+namespace NeoML {
+
+// The number of query rows processed together
+static const int AttentionQueryBlockSize = 64;
+// The number of keys processed in one step of the online softmax
+static const int AttentionKeyBlockSize = 256;
+
+void CCpuMathEngine::ScaledDotProductAttention( int batchSize, int headCount, int querySize, int keySize,
+	int headSize, const CConstFloatHandle& queryHandle, const CConstFloatHandle& keyHandle,
+	const CConstFloatHandle& valueHandle, float scale, const CConstFloatHandle* maskHandle, int maskObjectCount,
+	float maskMultiplier, const CFloatHandle& resultHandle )
+{
+	ASSERT_EXPR( queryHandle.GetMathEngine() == this );
+	ASSERT_EXPR( keyHandle.GetMathEngine() == this );
+	ASSERT_EXPR( valueHandle.GetMathEngine() == this );
+	ASSERT_EXPR( resultHandle.GetMathEngine() == this );
+	ASSERT_EXPR( batchSize > 0 && headCount > 0 && querySize > 0 && keySize > 0 && headSize > 0 );
+	ASSERT_EXPR( maskHandle == nullptr || maskObjectCount == 1 || maskObjectCount == batchSize * headCount );
+	CCpuExecutionScope scope;
+
+	const int rowSize = headCount * headSize;
+	const int queryBlockSize = std::min( querySize, AttentionQueryBlockSize );
+	const int keyBlockSize = std::min( keySize, AttentionKeyBlockSize );
+
+	// The buffers depend only on the block sizes, not on the sequence lengths
+	CFloatHandleStackVar scoresVar( mathEngine(), queryBlockSize * keyBlockSize );
+	CFloatHandleStackVar accumulatorsVar( mathEngine(), queryBlockSize * headSize );
+	CFloatHandleStackVar rowMaxVar( mathEngine(), queryBlockSize );
+	CFloatHandleStackVar rowSumVar( mathEngine(), queryBlockSize );
+	float* scores = GetRaw( scoresVar.GetHandle() );
+	float* accumulators = GetRaw( accumulatorsVar.GetHandle() );
+	float* rowMax = GetRaw( rowMaxVar.GetHandle() );
+	float* rowSum = GetRaw( rowSumVar.GetHandle() );
+
+	for( int b = 0; b < batchSize; ++b ) {
+		for( int h = 0; h < headCount; ++h ) {
+			const float* query = GetRaw( queryHandle ) + b * querySize * rowSize + h * headSize;
+			const float* key = GetRaw( keyHandle ) + b * keySize * rowSize + h * headSize;
+			const float* value = GetRaw( valueHandle ) + b * keySize * rowSize + h * headSize;
+			float* result = GetRaw( resultHandle ) + b * querySize * rowSize + h * headSize;
+			const float* mask = nullptr;
+			if( maskHandle != nullptr ) {
+				mask = GetRaw( *maskHandle ) + ( maskObjectCount == 1 ? 0 : ( b * headCount + h ) * querySize * keySize );
+			}
+
+			for( int queryStart = 0; queryStart < querySize; queryStart += queryBlockSize ) {
+				const int queryCount = std::min( queryBlockSize, querySize - queryStart );
+				vectorFill( rowMax, -FLT_MAX, queryCount );
+				vectorFill0( rowSum, queryCount );
+				vectorFill0( accumulators, queryCount * headSize );
+
+				for( int keyStart = 0; keyStart < keySize; keyStart += keyBlockSize ) {
+					const int keyCount = std::min( keyBlockSize, keySize - keyStart );
+					multiplyMatrixByTransposedMatrix( query + queryStart * rowSize, queryCount, headSize, rowSize,
+						key + keyStart * rowSize, keyCount, rowSize, scores, keyCount );
+
+					// Scale, mask and shift the scores by the new maximum of the row
+					for( int i = 0; i < queryCount; ++i ) {
+						float* scoresRow = scores + i * keyCount;
+						vectorMultiply( scoresRow, scoresRow, keyCount, scale );
+						if( mask != nullptr ) {
+							const float* maskRow = mask + ( queryStart + i ) * keySize + keyStart;
+							for( int j = 0; j < keyCount; ++j ) {
+								scoresRow[j] += maskMultiplier * maskRow[j];
+							}
+						}
+						const float newMax = std::max( rowMax[i], *std::max_element( scoresRow, scoresRow + keyCount ) );
+						vectorAddValue( scoresRow, scoresRow, keyCount, -newMax );
+						// The values accumulated so far are rescaled to the new maximum
+						const float correction = std::exp( rowMax[i] - newMax );
+						rowSum[i] *= correction;
+						vectorMultiply( accumulators + i * headSize, accumulators + i * headSize, headSize, correction );
+						rowMax[i] = newMax;
+					}
+					VectorExp( scoresVar.GetHandle(), scoresVar.GetHandle(), queryCount * keyCount );
+					for( int i = 0; i < queryCount; ++i ) {
+						const float* scoresRow = scores + i * keyCount;
+						for( int j = 0; j < keyCount; ++j ) {
+							rowSum[i] += scoresRow[j];
+						}
+					}
+					multiplyMatrixByMatrixAndAdd( scores, queryCount, keyCount, keyCount,
+						value + keyStart * rowSize, headSize, rowSize, accumulators, headSize );
+				}
+
+				for( int i = 0; i < queryCount; ++i ) {
+					vectorMultiply( accumulators + i * headSize, result + ( queryStart + i ) * rowSize, headSize,
+						1.f / rowSum[i] );
+				}
+			}
+		}
+	}
+}
+
+} // namespace NeoML
@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
@@ -388,6 +388,290 @@ void CCpuMathEngine::blobConvolutionForwardAlgo1( const CCpuConvolutionDesc& des
 	}
 }
 
+//------------------------------------------------------------------------------------------------------------
+// Winograd convolution F(m x m, 3 x 3)
+// The image is split into the tiles of (m + 2) x (m + 2) size which overlap by 2 pixels
+// Each tile is transformed (B^T * d * B), the filter is transformed (G * g * G^T),
+// then for each of the (m + 2) x (m + 2) tile positions the transformed tiles are multiplied by the transformed filters
+// (one matrix multiplication over the channels) and the result is transformed back (A^T * M * A) into m x m output pixels
+
+// F(2x2, 3x3) transformation matrices
+struct CWinograd2x2 {
+	static constexpr int OutputTileSize = 2;
+	static constexpr int TileSize = 4;
+	static constexpr float InputTransform[TileSize * TileSize] = { // B^T
+		1.f, 0.f, -1.f, 0.f,
+		0.f, 1.f, 1.f, 0.f,
+		0.f, -1.f, 1.f, 0.f,
+		0.f, 1.f, 0.f, -1.f
+	};
+	static constexpr float FilterTransform[TileSize * 3] = { // G
+		1.f, 0.f, 0.f,
+		0.5f, 0.5f, 0.5f,
+		0.5f, -0.5f, 0.5f,
+		0.f, 0.f, 1.f
+	};
+	static constexpr float OutputTransform[OutputTileSize * TileSize] = { // A^T
+		1.f, 1.f, 1.f, 0.f,
+		0.f, 1.f, -1.f, -1.f
+	};
+};
+
+constexpr float CWinograd2x2::InputTransform[];
+constexpr float CWinograd2x2::FilterTransform[];
+constexpr float CWinograd2x2::OutputTransform[];
+
+// F(4x4, 3x3) transformation matrices
+struct CWinograd4x4 {
+	static constexpr int OutputTileSize = 4;
+	static constexpr int TileSize = 6;
+	static constexpr float InputTransform[TileSize * TileSize] = { // B^T
+		4.f, 0.f, -5.f, 0.f, 1.f, 0.f,
+		0.f, -4.f, -4.f, 1.f, 1.f, 0.f,
+		0.f, 4.f, -4.f, -1.f, 1.f, 0.f,
+		0.f, -2.f, -1.f, 2.f, 1.f, 0.f,
+		0.f, 2.f, -1.f, -2.f, 1.f, 0.f,
+		0.f, 4.f, 0.f, -5.f, 0.f, 1.f
+	};
+	static constexpr float FilterTransform[TileSize * 3] = { // G
+		1.f / 4, 0.f, 0.f,
+		-1.f / 6, -1.f / 6, -1.f / 6,
+		-1.f / 6, 1.f / 6, -1.f / 6,
+		1.f / 24, 1.f / 12, 1.f / 6,
+		1.f / 24, -1.f / 12, 1.f / 6,
+		0.f, 0.f, 1.f
+	};
+	static constexpr float OutputTransform[OutputTileSize * TileSize] = { // A^T
+		1.f, 1.f, 1.f, 1.f, 1.f, 0.f,
+		0.f, 1.f, -1.f, 2.f, -2.f, 0.f,
+		0.f, 1.f, 1.f, 4.f, 4.f, 0.f,
+		0.f, 1.f, -1.f, 8.f, -8.f, 1.f
+	};
+};
+
+constexpr float CWinograd4x4::InputTransform[];
+constexpr float CWinograd4x4::FilterTransform[];
+constexpr float CWinograd4x4::OutputTransform[];
+
+// result[c] = sum( coeffs[k] * vectors[k * vectorStep + c] ) for k in [0; Count)
+template<int Count>
+static inline void winogradCombine( const float* coeffs, const float* vectors, int vectorStep, int vectorSize,
+	float* result )
+{
+	for( int c = 0; c < vectorSize; ++c ) {
+		float sum = 0;
+		for( int k = 0; k < Count; ++k ) {
+			sum += coeffs[k] * vectors[k * vectorStep + c];
+		}
+		result[c] = sum;
+	}
+}
+
+// Transforms the filter: U = G * g * G^T for each pair of output and input channels
+// The result is stored in [tileSize * tileSize][filterCount][channels] layout
+template<class TWinograd>
+static void winogradTransformFilter( const float* filter, int filterCount, int channels, float* result )
+{
+	const int tileSize = TWinograd::TileSize;
+	std::vector<float> temp( tileSize * 3 * channels );
+	for( int k = 0; k < filterCount; ++k ) {
+		const float* kernel = filter + k * 9 * channels;
+		for( int i = 0; i < tileSize; ++i ) {
+			// temp = G * g
+			for( int q = 0; q < 3; ++q ) {
+				winogradCombine<3>( TWinograd::FilterTransform + i * 3, kernel + q * channels, 3 * channels, channels,
+					temp.data() + ( i * 3 + q ) * channels );
+			}
+			// U = temp * G^T
+			for( int j = 0; j < tileSize; ++j ) {
+				winogradCombine<3>( TWinograd::FilterTransform + j * 3, temp.data() + i * 3 * channels, channels, channels,
+					result + ( ( i * tileSize + j ) * filterCount + k ) * channels );
+			}
+		}
+	}
+}
+
+// Transforms the input tile: V = B^T * d * B
+// The result for the (i, j) position is written to result + (i * tileSize + j) * resultStep
+template<class TWinograd>
+static void winogradTransformInputTile( const float* tile, int channels, float* temp, float* result, int resultStep )
+{
+	const int tileSize = TWinograd::TileSize;
+	for( int i = 0; i < tileSize; ++i ) {
+		// temp = B^T * d
+		for( int j = 0; j < tileSize; ++j ) {
+			winogradCombine<tileSize>( TWinograd::InputTransform + i * tileSize, tile + j * channels,
+				tileSize * channels, channels, temp + j * channels );
+		}
+		// V = temp * B
+		for( int j = 0; j < tileSize; ++j ) {
+			winogradCombine<tileSize>( TWinograd::InputTransform + j * tileSize, temp, channels, channels,
+				result + ( i * tileSize + j ) * resultStep );
+		}
+	}
+}
+
+// Transforms the product back: Y = A^T * M * A
+// The product for the (i, j) position is stored at product + (i * tileSize + j) * productStep
+// The result is written in [outputTileSize][outputTileSize][filterCount] layout
+template<class TWinograd>
+static void winogradTransformOutputTile( const float* product, int productStep, int filterCount,
+	float* temp, float* result )
+{
+	const int tileSize = TWinograd::TileSize;
+	const int outputTileSize = TWinograd::OutputTileSize;
+	for( int a = 0; a < outputTileSize; ++a ) {
+		// temp = A^T * M
+		for( int j = 0; j < tileSize; ++j ) {
+			winogradCombine<tileSize>( TWinograd::OutputTransform + a * tileSize, product + j * productStep,
+				tileSize * productStep, filterCount, temp + j * filterCount );
+		}
+		// Y = temp * A
+		for( int b = 0; b < outputTileSize; ++b ) {
+			winogradCombine<tileSize>( TWinograd::OutputTransform + b * tileSize, temp, filterCount, filterCount,
+				result + ( a * outputTileSize + b ) * filterCount );
+		}
+	}
+}
+
+// The filter transformed for Winograd algorithm
+// It is calculated on every call, so the filter data may be changed between the calls
+struct CCpuWinogradFilter {
+	// The transformed filter: [tileSize * tileSize][filterCount][channels]
+	// Not stored if the packed filter is available
+	std::vector<float> Transformed;
+	// The transformed filter packed for the matrix multiplication: one matrix per tile position
+	std::vector<std::unique_ptr<CPackedMatrixDesc>> Packed;
+};
+
+// Transforms the filter for Winograd algorithm
+template<class TWinograd>
+static void prepareWinogradFilter( IMathEngine& mathEngine, const CCpuConvolutionDesc& desc, const float* filterData,
+	CCpuWinogradFilter& filter )
+{
+	const int tileArea = TWinograd::TileSize * TWinograd::TileSize;
+	const int filterCount = desc.Filter.ObjectCount();
+	const int channels = desc.Filter.ObjectSize() / 9;
+	filter.Transformed.resize( static_cast<size_t>( tileArea ) * filterCount * channels );
+	winogradTransformFilter<TWinograd>( filterData, filterCount, channels, filter.Transformed.data() );
+
+	// The transformed filter is multiplied by many blocks of tiles, so it is packed for the matrix multiplication
+	for( int i = 0; i < tileArea; ++i ) {
+		CPackedMatrixDesc* packed = mathEngine.InitPackedTransposedMatrix(
+			CConstFloatHandle( CMemoryHandleInternal::CreateMemoryHandle( &mathEngine,
+				filter.Transformed.data() + i * filterCount * channels ) ), filterCount, channels );
+		if( packed == nullptr ) {
+			// Packing is not supported
+			filter.Packed.clear();
+			return;
+		}
+		filter.Packed.emplace_back( packed );
+	}
+	// Only the packed filter is used
+	std::vector<float>().swap( filter.Transformed );
+}
+
+template<class TWinograd>
+void CCpuMathEngine::blobConvolutionForwardWinograd( const CCpuConvolutionDesc& desc, const float* sourceData,
+	const float* filterData, const float* freeTermData, float* resultData )
+{
+	const int tileSize = TWinograd::TileSize;
+	const int tileArea = tileSize * tileSize;
+	const int outputTileSize = TWinograd::OutputTileSize;
+
+	const CBlobDesc& source = desc.Source;
+	const CBlobDesc& result = desc.Result;
+	const int channels = source.Depth() * source.Channels();
+	const int filterCount = desc.Filter.ObjectCount();
+
+	// The filter transformation is much cheaper than the multiplication by all the tiles
+	CCpuWinogradFilter filter;
+	prepareWinogradFilter<TWinograd>( mathEngine(), desc, filterData, filter );
+
+	const int tileRows = ( result.Height() + outputTileSize - 1 ) / outputTileSize;
+	const int tileColumns = ( result.Width() + outputTileSize - 1 ) / outputTileSize;
+	const int tilesPerObject = tileRows * tileColumns;
+	const int tileCount = result.ObjectCount() * tilesPerObject;
+	// The tiles are processed in blocks so that the transformed data stays in cache
+	// The block shouldn't be too small, otherwise the matrix multiplication is ineffective
+	const int blockSize = std::min( tileCount,
+		std::max( 64, BlobConvolutionCacheSize / ( tileArea * ( channels + filterCount ) ) ) );
+
+	const int inputStep = blockSize * channels;
+	const int productStep = blockSize * filterCount;
+	const int tempSize = tileSize * std::max( channels, filterCount );
+	CFloatHandleStackVar buffer( mathEngine(), tileArea * ( inputStep + productStep + channels ) + tempSize
+		+ outputTileSize * outputTileSize * filterCount );
+	float* const transformedInput = GetRaw( buffer.GetHandle() );
+	float* const product = transformedInput + tileArea * inputStep;
+	float* const tile = product + tileArea * productStep;
+	float* const temp = tile + tileArea * channels;
+	float* const outputTile = temp + tempSize;
+
+	for( int blockStart = 0; blockStart < tileCount; blockStart += blockSize ) {
+		const int blockCount = std::min( blockSize, tileCount - blockStart );
+
+		for( int index = 0; index < blockCount; ++index ) {
+			const int object = ( blockStart + index ) / tilesPerObject;
+			const int tileRow = ( blockStart + index ) % tilesPerObject / tileColumns;
+			const int tileColumn = ( blockStart + index ) % tilesPerObject % tileColumns;
+			const float* sourceObject = sourceData + object * source.ObjectSize();
+			// Copy the tile, the padding and the pixels outside the image are filled with zeros
+			for( int i = 0; i < tileSize; ++i ) {
+				const int y = tileRow * outputTileSize - desc.PaddingHeight + i;
+				for( int j = 0; j < tileSize; ++j ) {
+					const int x = tileColumn * outputTileSize - desc.PaddingWidth + j;
+					float* tilePixel = tile + ( i * tileSize + j ) * channels;
+					if( 0 <= y && y < source.Height() && 0 <= x && x < source.Width() ) {
+						dataCopy( tilePixel, sourceObject + ( y * source.Width() + x ) * channels, channels );
+					} else {
+						vectorFill0( tilePixel, channels );
+					}
+				}
+			}
+			winogradTransformInputTile<TWinograd>( tile, channels, temp, transformedInput + index * channels, inputStep );
+		}
+
+		for( int i = 0; i < tileArea; ++i ) {
+			if( !filter.Packed.empty() ) {
+				MultiplyMatrixByPackedTransposedMatrix(
+					CConstFloatHandle( CMemoryHandleInternal::CreateMemoryHandle( this, transformedInput + i * inputStep ) ),
+					blockCount, channels, *filter.Packed[i],
+					CFloatHandle( CMemoryHandleInternal::CreateMemoryHandle( this, product + i * productStep ) ),
+					blockCount * filterCount );
+			} else {
+				multiplyMatrixByTransposedMatrix( transformedInput + i * inputStep, blockCount, channels, channels,
+					filter.Transformed.data() + i * filterCount * channels, filterCount, channels,
+					product + i * productStep, filterCount );
+			}
+		}
+
+		for( int index = 0; index < blockCount; ++index ) {
+			const int object = ( blockStart + index ) / tilesPerObject;
+			const int tileRow = ( blockStart + index ) % tilesPerObject / tileColumns;
+			const int tileColumn = ( blockStart + index ) % tilesPerObject % tileColumns;
+			winogradTransformOutputTile<TWinograd>( product + index * filterCount, productStep, filterCount,
+				temp, outputTile );
+
+			float* resultObject = resultData + object * result.ObjectSize();
+			const int rowCount = std::min( outputTileSize, result.Height() - tileRow * outputTileSize );
+			const int columnCount = std::min( outputTileSize, result.Width() - tileColumn * outputTileSize );
+			for( int a = 0; a < rowCount; ++a ) {
+				for( int b = 0; b < columnCount; ++b ) {
+					float* resultPixel = resultObject + ( ( tileRow * outputTileSize + a ) * result.Width()
+						+ tileColumn * outputTileSize + b ) * filterCount;
+					const float* outputPixel = outputTile + ( a * outputTileSize + b ) * filterCount;
+					if( freeTermData != nullptr ) {
+						vectorAdd( outputPixel, freeTermData, resultPixel, filterCount );
+					} else {
+						dataCopy( resultPixel, outputPixel, filterCount );
+					}
+				}
+			}
+		}
+	}
+}
+
 void CCpuMathEngine::BlobConvolution( const CConvolutionDesc& convDesc, const CConstFloatHandle& source,
 	const CConstFloatHandle& filter, const CConstFloatHandle* freeTerm, const CFloatHandle& result )
 {
@@ -425,6 +709,12 @@ void CCpuMathEngine::BlobConvolution( const CConvolutionDesc& convDesc, const CC
 				desc.StrideHeight, desc.StrideWidth, /*StrideDepth*/1, sourceRaw, filterRaw, freeTermRaw, resultRaw );
 			break;
 		}
+		case CA_Winograd2x2:
+			blobConvolutionForwardWinograd<CWinograd2x2>( desc, sourceRaw, filterRaw, freeTermRaw, resultRaw );
+			break;
+		case CA_Winograd4x4:
+			blobConvolutionForwardWinograd<CWinograd4x4>( desc, sourceRaw, filterRaw, freeTermRaw, resultRaw );
+			break;
 		default:
 			ASSERT_EXPR( false );
 	}
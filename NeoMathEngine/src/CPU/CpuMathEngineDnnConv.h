@@ -24,9 +24,22 @@ enum TConvAlgo {
 	CA_2,		// work with the data directly (only for stride = 1 and padding = 0)
 				// most efficient when the image is large and especially when it has many channels
 				
-	CA_1x1		// for convolution with a 1*1 filter, no padding and dilation (both 2D and 3D)
+	CA_1x1,		// for convolution with a 1*1 filter, no padding and dilation (both 2D and 3D)
+	CA_Winograd2x2,	// Winograd F(2x2, 3x3): for 3*3 filter, stride 1 and no dilation (forward only)
+	CA_Winograd4x4	// Winograd F(4x4, 3x3): fewer multiplications than F(2x2, 3x3), used for fewer channels
 };
 
+// The minimum number of the input and output channels when Winograd algorithm is used
+// With fewer channels the input and output transformations take more time than the matrix multiplications save
+constexpr int WinogradMinChannelCount = 48;
+// The minimum result size when Winograd algorithm is used
+// For small images the padding of the tiles is too large
+constexpr int WinogradMinResultSize = 8;
+// The maximum number of the input channels when Winograd F(4x4, 3x3) is used
+// Its transformations scale the values up, so the rounding error of the long sums over the channels becomes
+// noticeably larger than the error of the direct convolution; F(2x2, 3x3) is used instead
+constexpr int Winograd4x4MaxChannelCount = 64;
+
 constexpr int BlobConvolutionCacheSize = 256 * 1024;
 
 // Convolution descriptor
@@ -48,10 +61,26 @@ struct CCpuConvolutionDesc : public CCommonConvolutionDesc {
 private:
 	TConvAlgo getActualForwardAlgo() const;
 	TConvAlgo getActualBackwardAlgo() const;
+	TConvAlgo getDirectAlgo() const;
 };
 
 // Gets the algorithm to be used for this convolution
 inline TConvAlgo CCpuConvolutionDesc::getActualForwardAlgo() const
+{
+	if( Filter.Height() == 3 && Filter.Width() == 3
+		&& StrideHeight == 1 && StrideWidth == 1
+		&& DilationHeight == 1 && DilationWidth == 1
+		&& Source.Depth() * Source.Channels() >= WinogradMinChannelCount
+		&& Filter.ObjectCount() >= WinogradMinChannelCount
+		&& Result.Height() >= WinogradMinResultSize && Result.Width() >= WinogradMinResultSize )
+	{
+		return Source.Depth() * Source.Channels() < Winograd4x4MaxChannelCount ? CA_Winograd4x4 : CA_Winograd2x2;
+	}
+	return getDirectAlgo();
+}
+
+// Gets the algorithm which works with the filter directly (without transformation)
+inline TConvAlgo CCpuConvolutionDesc::getDirectAlgo() const
 {
 	if( PaddingHeight == 0 && PaddingWidth == 0
 		&& DilationHeight == 1 && DilationWidth == 1
@@ -80,7 +109,7 @@ inline TConvAlgo CCpuConvolutionDesc::getActualForwardAlgo() const
 
 inline TConvAlgo CCpuConvolutionDesc::getActualBackwardAlgo() const
 {
-	TConvAlgo ret = getActualForwardAlgo();
+	TConvAlgo ret = getDirectAlgo();
 	if( ret == CA_2 && ( PaddingHeight != 0 || PaddingWidth != 0 ) ) {
 		ret = CA_1;
 	}
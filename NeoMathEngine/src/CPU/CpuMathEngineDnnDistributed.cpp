@@ -1,4 +1,4 @@
-/* Copyright © 2017-2023 ABBYY
+/* Copyright © 2017-2024 ABBYY
 Licensed under the Apache License, Version 2.0 (the "License");
 you may not use this file except in compliance with the License.
 You may obtain a copy of the License at
@@ -57,18 +57,37 @@ void CMultiThreadDistributedCommunicator::AllReduce( const CFloatHandle& handle,
 
 	barrier();
 
+	// Each thread averages its own part of the data
+	// The part is processed in chunks: the sums are accumulated in the cache instead of iterating over the threads
+	// for each element, then the result is written back to all the threads
 	const int perThread = ( size + n_threads - 1 ) / n_threads;
-	for( int i = thread * perThread; i < std::min( ( thread + 1 ) * perThread, size ); i++ ){
-		float buf = 0;
-		for( int j = 0; j < n_threads; j++ ){
-			buf += handles[j][i];
+	const int start = std::min( thread * perThread, size );
+	const int end = std::min( start + perThread, size );
+	const int chunkSize = 1024;
+	float sum[chunkSize];
+	for( int chunkStart = start; chunkStart < end; chunkStart += chunkSize ) {
+		const int count = std::min( chunkSize, end - chunkStart );
+		const float* first = handles[0] + chunkStart;
+		for( int i = 0; i < count; i++ ) {
+			sum[i] = first[i];
 		}
-		buf /= n_threads;
-		for( int j = 0; j < n_threads; j++ ){
-			handles[j][i] = buf;
+		for( int j = 1; j < n_threads; j++ ) {
+			const float* data = handles[j] + chunkStart;
+			for( int i = 0; i < count; i++ ) {
+				sum[i] += data[i];
+			}
+		}
+		for( int i = 0; i < count; i++ ) {
+			sum[i] /= n_threads;
+		}
+		for( int j = 0; j < n_threads; j++ ) {
+			float* data = handles[j] + chunkStart;
+			for( int i = 0; i < count; i++ ) {
+				data[i] = sum[i];
+			}
 		}
 	}
-	
+
 	barrier();
 }
 
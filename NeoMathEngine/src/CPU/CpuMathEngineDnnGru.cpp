@@ -0,0 +1,194 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <algorithm>
+#include <memory>
+
+#include <CpuMathEngine.h>
+#include <CpuMathEnginePrivate.h>
+#include <CpuExecutionScope.h>
+#include <MemoryHandleInternal.h>
+#include <NeoMathEngine/NeoMathEngineException.h>
+
+namespace NeoML {
+
+// The weights are rearranged so that the input part of all the gates is calculated by one multiplication
+// for several steps of the sequence
+struct CCpuGruDesc : public CGruDesc {
+	CCpuGruDesc( IMathEngine& mathEngine, int hiddenSize, int objectSize,
+		const CConstFloatHandle& gateWeights, const CConstFloatHandle& gateFreeTerm,
+		const CConstFloatHandle& mainWeights, const CConstFloatHandle& mainFreeTerm );
+
+	// The number of the precalculated values for each object: update gate, reset gate, candidate state
+	static constexpr int GatesNum = 3;
+
+	const int HiddenSize;
+	const int ObjectSize;
+	// The input part of the weights, (GatesNum * HiddenSize) x ObjectSize
+	CFloatHandleVar InputWeights;
+	// The transposed recurrent part of the gate weights, HiddenSize x (2 * HiddenSize)
+	CFloatHandleVar GateRecurWeights;
+	// The transposed recurrent part of the main weights, HiddenSize x HiddenSize
+	CFloatHandleVar MainRecurWeights;
+	// The free terms of all the gates, GatesNum * HiddenSize; null if there are no free terms
+	std::unique_ptr<CFloatHandleVar> FreeTerm;
+};
+
+// Copies the input columns of the weights and transposes the recurrent columns
+static void splitGruWeights( const float* weights, int height, int objectSize, int hiddenSize,
+	float* inputWeights, float* recurWeights )
+{
+	const int width = objectSize + hiddenSize;
+	for( int row = 0; row < height; ++row ) {
+		const float* weightsRow = weights + row * width;
+		dataCopy( inputWeights + row * objectSize, weightsRow, objectSize );
+		for( int col = 0; col < hiddenSize; ++col ) {
+			recurWeights[col * height + row] = weightsRow[objectSize + col];
+		}
+	}
+}
+
+CCpuGruDesc::CCpuGruDesc( IMathEngine& mathEngine, int hiddenSize, int objectSize,
+		const CConstFloatHandle& gateWeights, const CConstFloatHandle& gateFreeTerm,
+		const CConstFloatHandle& mainWeights, const CConstFloatHandle& mainFreeTerm ) :
+	HiddenSize( hiddenSize ),
+	ObjectSize( objectSize ),
+	InputWeights( mathEngine, GatesNum * hiddenSize * objectSize ),
+	GateRecurWeights( mathEngine, 2 * hiddenSize * hiddenSize ),
+	MainRecurWeights( mathEngine, hiddenSize * hiddenSize )
+{
+	float* inputWeights = GetRaw( InputWeights.GetHandle() );
+	splitGruWeights( GetRaw( gateWeights ), 2 * hiddenSize, objectSize, hiddenSize,
+		inputWeights, GetRaw( GateRecurWeights.GetHandle() ) );
+	splitGruWeights( GetRaw( mainWeights ), hiddenSize, objectSize, hiddenSize,
+		inputWeights + 2 * hiddenSize * objectSize, GetRaw( MainRecurWeights.GetHandle() ) );
+
+	if( !gateFreeTerm.IsNull() || !mainFreeTerm.IsNull() ) {
+		FreeTerm.reset( new CFloatHandleVar( mathEngine, GatesNum * hiddenSize ) );
+		float* freeTerm = GetRaw( FreeTerm->GetHandle() );
+		if( gateFreeTerm.IsNull() ) {
+			vectorFill0( freeTerm, 2 * hiddenSize );
+		} else {
+			dataCopy( freeTerm, GetRaw( gateFreeTerm ), 2 * hiddenSize );
+		}
+		if( mainFreeTerm.IsNull() ) {
+			vectorFill0( freeTerm + 2 * hiddenSize, hiddenSize );
+		} else {
+			dataCopy( freeTerm + 2 * hiddenSize, GetRaw( mainFreeTerm ), hiddenSize );
+		}
+	}
+}
+
+CGruDesc* CCpuMathEngine::InitGru( int hiddenSize, int objectSize,
+	const CConstFloatHandle& gateWeights, const CConstFloatHandle& gateFreeTerm,
+	const CConstFloatHandle& mainWeights, const CConstFloatHandle& mainFreeTerm )
+{
+	ASSERT_EXPR( hiddenSize > 0 && objectSize > 0 );
+	ASSERT_EXPR( gateWeights.GetMathEngine() == this );
+	ASSERT_EXPR( mainWeights.GetMathEngine() == this );
+	return new CCpuGruDesc( *this, hiddenSize, objectSize, gateWeights, gateFreeTerm, mainWeights, mainFreeTerm );
+}
+
+void CCpuMathEngine::Gru( CGruDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+	const CConstFloatHandle& inputMainBackLink, const CConstFloatHandle& inputHandle, const CFloatHandle& outputHandle )
+{
+	ASSERT_EXPR( inputHandle.GetMathEngine() == this );
+	ASSERT_EXPR( outputHandle.GetMathEngine() == this );
+	CCpuExecutionScope scope;
+
+	const CCpuGruDesc& gruDesc = dynamic_cast<const CCpuGruDesc&>( desc );
+	const int hiddenSize = gruDesc.HiddenSize;
+	const int objectSize = gruDesc.ObjectSize;
+	const int gatesSize = CCpuGruDesc::GatesNum * hiddenSize;
+	const float* inputWeights = GetRaw( gruDesc.InputWeights.GetHandle() );
+	const float* gateRecurWeights = GetRaw( gruDesc.GateRecurWeights.GetHandle() );
+	const float* mainRecurWeights = GetRaw( gruDesc.MainRecurWeights.GetHandle() );
+	const float* freeTerm = gruDesc.FreeTerm == nullptr ? nullptr : GetRaw( gruDesc.FreeTerm->GetHandle() );
+
+	const float* input = GetRaw( inputHandle );
+	float* output = GetRaw( outputHandle );
+
+	// The input part of the gates is calculated for several steps at once
+	const int bufferLength = std::min( sequenceLength, ( 64 + sequenceCount - 1 ) / sequenceCount );
+	CFloatHandleStackVar buffer( *this, bufferLength * sequenceCount * gatesSize
+		+ 2 * sequenceCount * hiddenSize );
+	float* gates = GetRaw( buffer.GetHandle() );
+	// The previous state multiplied by the reset gate
+	float* resetState = gates + bufferLength * sequenceCount * gatesSize;
+	// The initial state
+	float* initialState = resetState + sequenceCount * hiddenSize;
+	if( inputMainBackLink.IsNull() ) {
+		vectorFill0( initialState, sequenceCount * hiddenSize );
+	} else {
+		dataCopy( initialState, GetRaw( inputMainBackLink ), sequenceCount * hiddenSize );
+	}
+
+	int bufferStart = 0;
+	int stepsInBuffer = 0;
+	const float* prevState = initialState;
+	for( int i = 0; i < sequenceLength; ++i ) {
+		const int pos = reverse ? sequenceLength - 1 - i : i;
+
+		if( stepsInBuffer == 0 ) {
+			// Calculate the input part of the next steps
+			stepsInBuffer = std::min( bufferLength, sequenceLength - i );
+			bufferStart = reverse ? pos - stepsInBuffer + 1 : pos;
+			multiplyMatrixByTransposedMatrix( input + bufferStart * sequenceCount * objectSize,
+				stepsInBuffer * sequenceCount, objectSize, objectSize, inputWeights, gatesSize, objectSize,
+				gates, gatesSize );
+			if( freeTerm != nullptr ) {
+				addVectorToMatrixRows( gates, gates, stepsInBuffer * sequenceCount, gatesSize, gatesSize,
+					gatesSize, freeTerm );
+			}
+		}
+		--stepsInBuffer;
+
+		float* stepGates = gates + ( pos - bufferStart ) * sequenceCount * gatesSize;
+		float* state = output + pos * sequenceCount * hiddenSize;
+
+		// Update and reset gates
+		multiplyMatrixByMatrixAndAdd( prevState, sequenceCount, hiddenSize, hiddenSize,
+			gateRecurWeights, 2 * hiddenSize, 2 * hiddenSize, stepGates, gatesSize );
+		for( int j = 0; j < sequenceCount; ++j ) {
+			float* objectGates = stepGates + j * gatesSize;
+			vectorSigmoid( objectGates, objectGates, 2 * hiddenSize );
+			vectorEltwiseMultiply( objectGates + hiddenSize, prevState + j * hiddenSize,
+				resetState + j * hiddenSize, hiddenSize );
+		}
+
+		// Candidate state
+		multiplyMatrixByMatrixAndAdd( resetState, sequenceCount, hiddenSize, hiddenSize,
+			mainRecurWeights, hiddenSize, hiddenSize, stepGates + 2 * hiddenSize, gatesSize );
+
+		// state = update * prevState + ( 1 - update ) * candidate
+		for( int j = 0; j < sequenceCount; ++j ) {
+			float* update = stepGates + j * gatesSize;
+			float* candidate = update + 2 * hiddenSize;
+			float* objectState = state + j * hiddenSize;
+			vectorTanh( candidate, candidate, hiddenSize );
+			vectorEltwiseMultiply( update, prevState + j * hiddenSize, objectState, hiddenSize );
+			vectorMultiply( update, update, hiddenSize, -1.f );
+			vectorAddValue( update, update, hiddenSize, 1.f );
+			vectorEltwiseMultiplyAdd( update, candidate, objectState, hiddenSize );
+		}
+
+		prevState = state;
+	}
+}
+
+} // namespace NeoML
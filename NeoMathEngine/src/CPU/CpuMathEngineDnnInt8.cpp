@@ -0,0 +1,212 @@
+/* Copyright © 2017-2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <CpuMathEngine.h>
+#include <CpuMathEnginePrivate.h>
+#include <CpuExecutionScope.h>
+#include <MemoryHandleInternal.h>
+#include <NeoMathEngine/NeoMathEngineException.h>
+
+#ifdef NEOML_USE_MLAS
+#include "mlas/inc/mlas.h"
+#endif
+
+namespace NeoML {
+
+// The descriptor of int8 quantized fully-connected operation
+struct CCpuInt8FullyConnectedDesc : public CInt8FullyConnectedDesc {
+	CCpuInt8FullyConnectedDesc( int inputSize, int outputSize, float inputScale, int inputZeroPoint );
+
+	const int InputSize;
+	const int OutputSize;
+	const float InputScale;
+	const uint8_t InputZeroPoint;
+	const uint8_t WeightsZeroPoint; // always 0, stored for MLAS which needs its address
+	// The quantized weights in inputSize x outputSize layout (not used if packed ones are available)
+	std::vector<int8_t> Weights;
+	// The weights packed by MLAS (if the current platform supports packing)
+	std::vector<uint8_t> PackedWeightsBuffer;
+	const void* PackedWeights;
+	// The scales used for result dequantization (inputScale * weightScale)
+	std::vector<float> OutputScales;
+	// The free term (empty if not set)
+	std::vector<float> FreeTerm;
+};
+
+CCpuInt8FullyConnectedDesc::CCpuInt8FullyConnectedDesc( int inputSize, int outputSize,
+		float inputScale, int inputZeroPoint ) :
+	InputSize( inputSize ),
+	OutputSize( outputSize ),
+	InputScale( inputScale ),
+	InputZeroPoint( static_cast<uint8_t>( inputZeroPoint ) ),
+	WeightsZeroPoint( 0 ),
+	PackedWeights( nullptr )
+{
+}
+
+// Quantizes the values to uint8 (asymmetric quantization)
+static void quantizeToUint8( const float* input, uint8_t* result, int size, float scale, uint8_t zeroPoint )
+{
+#ifdef NEOML_USE_MLAS
+	MlasQuantizeLinear( input, result, static_cast<size_t>( size ), scale, zeroPoint );
+#else
+	const float invScale = 1.f / scale;
+	for( int i = 0; i < size; ++i ) {
+		const float value = std::nearbyint( input[i] * invScale ) + zeroPoint;
+		result[i] = static_cast<uint8_t>( std::min( 255.f, std::max( 0.f, value ) ) );
+	}
+#endif
+}
+
+//-------------------------------------------------------------------------------------------------------------------------
+
+CInt8FullyConnectedDesc* CCpuMathEngine::InitInt8FullyConnected( int inputSize, int outputSize,
+	const signed char* weights, const CConstFloatHandle& weightScalesHandle,
+	const CConstFloatHandle* freeTermHandle, float inputScale, int inputZeroPoint )
+{
+	ASSERT_EXPR( weights != nullptr );
+	ASSERT_EXPR( weightScalesHandle.GetMathEngine() == this );
+	ASSERT_EXPR( freeTermHandle == nullptr || freeTermHandle->GetMathEngine() == this );
+	ASSERT_EXPR( inputSize > 0 && outputSize > 0 );
+	ASSERT_EXPR( inputScale > 0 );
+	ASSERT_EXPR( 0 <= inputZeroPoint && inputZeroPoint <= 255 );
+
+	CCpuInt8FullyConnectedDesc* desc = new CCpuInt8FullyConnectedDesc( inputSize, outputSize,
+		inputScale, inputZeroPoint );
+
+	const float* weightScales = GetRaw( weightScalesHandle );
+
+	// Transpose the quantized weights to the inputSize x outputSize layout
+	desc->Weights.resize( static_cast<size_t>( inputSize ) * outputSize );
+	desc->OutputScales.resize( outputSize );
+	for( int out = 0; out < outputSize; ++out ) {
+		const float scale = weightScales[out];
+		ASSERT_EXPR( scale > 0 );
+		desc->OutputScales[out] = inputScale * scale;
+		const signed char* weightsRow = weights + static_cast<size_t>( out ) * inputSize;
+		for( int in = 0; in < inputSize; ++in ) {
+			ASSERT_EXPR( -Int8WeightQuantizationMax <= weightsRow[in] && weightsRow[in] <= Int8WeightQuantizationMax );
+			desc->Weights[static_cast<size_t>( in ) * outputSize + out] = static_cast<int8_t>( weightsRow[in] );
+		}
+	}
+
+	if( freeTermHandle != nullptr ) {
+		desc->FreeTerm.resize( outputSize );
+		dataCopy( desc->FreeTerm.data(), GetRaw( *freeTermHandle ), outputSize );
+	}
+
+#ifdef NEOML_USE_MLAS
+	const size_t packedSize = MlasGemmPackBSize( static_cast<size_t>( outputSize ), static_cast<size_t>( inputSize ),
+		/*AIsSigned*/false, /*BIsSigned*/true );
+	if( packedSize != 0 ) {
+		const size_t alignment = MlasGetPreferredBufferAlignment();
+		desc->PackedWeightsBuffer.resize( packedSize + alignment );
+		void* packed = desc->PackedWeightsBuffer.data();
+		size_t space = desc->PackedWeightsBuffer.size();
+		packed = std::align( alignment, packedSize, packed, space );
+		ASSERT_EXPR( packed != nullptr );
+		MlasGemmPackB( static_cast<size_t>( outputSize ), static_cast<size_t>( inputSize ),
+			reinterpret_cast<const uint8_t*>( desc->Weights.data() ), static_cast<size_t>( outputSize ),
+			/*AIsSigned*/false, /*BIsSigned*/true, packed );
+		desc->PackedWeights = packed;
+		// The unpacked copy is not needed anymore
+		std::vector<int8_t>().swap( desc->Weights );
+	}
+#endif
+	return desc;
+}
+
+void CCpuMathEngine::Int8FullyConnected( const CInt8FullyConnectedDesc& fcDesc, const CConstFloatHandle& inputHandle,
+	int inputHeight, const CFloatHandle& resultHandle )
+{
+	ASSERT_EXPR( inputHandle.GetMathEngine() == this );
+	ASSERT_EXPR( resultHandle.GetMathEngine() == this );
+	ASSERT_EXPR( inputHeight > 0 );
+	CCpuExecutionScope scope;
+
+	const CCpuInt8FullyConnectedDesc& desc = static_cast<const CCpuInt8FullyConnectedDesc&>( fcDesc );
+	const int inputDataSize = inputHeight * desc.InputSize;
+
+	// The quantized input is kept in the stack memory
+	CFloatHandleStackVar quantizedInputVar( mathEngine(),
+		static_cast<size_t>( ( inputDataSize + sizeof( float ) - 1 ) / sizeof( float ) ) );
+	uint8_t* quantizedInput = reinterpret_cast<uint8_t*>( GetRaw( quantizedInputVar.GetHandle() ) );
+	quantizeToUint8( GetRaw( inputHandle ), quantizedInput, inputDataSize, desc.InputScale, desc.InputZeroPoint );
+
+	float* result = GetRaw( resultHandle );
+	// The int32 accumulators are written into the result buffer and dequantized in-place
+	int32_t* accumulators = reinterpret_cast<int32_t*>( result );
+
+#ifdef NEOML_USE_MLAS
+	MLAS_QGEMM_SCALE_BIAS_OUTPUT_PROCESSOR outputProcessor( result, static_cast<size_t>( desc.OutputSize ),
+		desc.OutputScales.data(), desc.FreeTerm.empty() ? nullptr : desc.FreeTerm.data(),
+		MLAS_QGEMM_OUTPUT_MODE::ZeroMode, MLAS_QUANTIZATION_GRANULARITY::PerColumn );
+
+	MLAS_GEMM_QUANT_SHAPE_PARAMS shape;
+	shape.M = static_cast<size_t>( inputHeight );
+	shape.N = static_cast<size_t>( desc.OutputSize );
+	shape.K = static_cast<size_t>( desc.InputSize );
+	shape.AIsSigned = false;
+	shape.BIsSigned = true;
+
+	MLAS_GEMM_QUANT_DATA_PARAMS data;
+	data.A = quantizedInput;
+	data.lda = static_cast<size_t>( desc.InputSize );
+	data.ZeroPointA = desc.InputZeroPoint;
+	data.ZeroPointB = &desc.WeightsZeroPoint;
+	if( desc.PackedWeights != nullptr ) {
+		data.B = desc.PackedWeights;
+		data.BIsPacked = true;
+	} else {
+		data.B = desc.Weights.data();
+		data.ldb = static_cast<size_t>( desc.OutputSize );
+	}
+	data.C = accumulators;
+	data.ldc = static_cast<size_t>( desc.OutputSize );
+	data.OutputProcessor = &outputProcessor;
+
+	MlasGemm( shape, data, nullptr );
+#else // !NEOML_USE_MLAS
+	const int zeroPoint = desc.InputZeroPoint;
+	for( int row = 0; row < inputHeight; ++row ) {
+		const uint8_t* inputRow = quantizedInput + static_cast<size_t>( row ) * desc.InputSize;
+		int32_t* accumulatorsRow = accumulators + static_cast<size_t>( row ) * desc.OutputSize;
+		std::fill_n( accumulatorsRow, desc.OutputSize, 0 );
+		for( int in = 0; in < desc.InputSize; ++in ) {
+			const int32_t inputValue = static_cast<int32_t>( inputRow[in] ) - zeroPoint;
+			const int8_t* weightsRow = desc.Weights.data() + static_cast<size_t>( in ) * desc.OutputSize;
+			for( int out = 0; out < desc.OutputSize; ++out ) {
+				accumulatorsRow[out] += inputValue * weightsRow[out];
+			}
+		}
+		float* resultRow = result + static_cast<size_t>( row ) * desc.OutputSize;
+		for( int out = 0; out < desc.OutputSize; ++out ) {
+			resultRow[out] = static_cast<float>( accumulatorsRow[out] ) * desc.OutputScales[out]
+				+ ( desc.FreeTerm.empty() ? 0.f : desc.FreeTerm[out] );
+		}
+	}
+#endif // !NEOML_USE_MLAS
+}
+
+} // namespace NeoML
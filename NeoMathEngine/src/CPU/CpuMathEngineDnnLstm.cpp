@@ -209,4 +209,212 @@ void CCpuMathEngine::Lstm( CLstmDesc& desc, bool reverse, int sequenceLength, in
 	}
 }
 
+//-------------------------------------------------------------------------------------------------------------------------
+
+void CCpuMathEngine::LstmForwardTraining( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+	const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
+	const CConstFloatHandle& inputHandle, const CFloatHandle& gatesHandle, const CFloatHandle& outputStateBackLink,
+	const CFloatHandle& outputMainBackLink )
+{
+	ASSERT_EXPR( inputHandle.GetMathEngine() == this );
+	ASSERT_EXPR( gatesHandle.GetMathEngine() == this );
+	ASSERT_EXPR( outputStateBackLink.GetMathEngine() == this );
+	ASSERT_EXPR( outputMainBackLink.GetMathEngine() == this );
+
+	const CMathEngineLstmDesc& lstmDesc = dynamic_cast<const CMathEngineLstmDesc&>( desc );
+	const int hiddenSize = lstmDesc.HiddenSize;
+	const int objectSize = lstmDesc.ObjectSize;
+	const int gatesSize = CMathEngineLstmDesc::GatesNum * hiddenSize;
+	const int stepSize = sequenceCount * hiddenSize;
+
+	float* gates = GetRaw( gatesHandle );
+	float* states = GetRaw( outputStateBackLink );
+	float* mains = GetRaw( outputMainBackLink );
+
+	// The input part of the gates is calculated for the whole sequence by one multiplication
+	multiplyMatrixByTransposedMatrix( GetRaw( inputHandle ), sequenceLength * sequenceCount, objectSize, objectSize,
+		lstmDesc.InputWeights, gatesSize, objectSize, gates, gatesSize );
+	if( lstmDesc.FreeTerm != nullptr ) {
+		addVectorToMatrixRows( gates, gates, sequenceLength * sequenceCount, gatesSize, gatesSize, gatesSize,
+			lstmDesc.FreeTerm );
+	}
+
+	CFloatHandleStackVar zeros( *this, stepSize );
+	vectorFill0( GetRaw( zeros.GetHandle() ), stepSize );
+	const float* prevState = inputStateBackLink.IsNull() ? GetRaw( zeros.GetHandle() ) : GetRaw( inputStateBackLink );
+	const float* prevMain = inputMainBackLink.IsNull() ? GetRaw( zeros.GetHandle() ) : GetRaw( inputMainBackLink );
+
+	for( int i = 0; i < sequenceLength; ++i ) {
+		const int pos = reverse ? sequenceLength - 1 - i : i;
+		float* stepGates = gates + pos * sequenceCount * gatesSize;
+		float* state = states + pos * stepSize;
+		float* main = mains + pos * stepSize;
+
+		multiplyMatrixByMatrixAndAdd( prevMain, sequenceCount, hiddenSize, hiddenSize,
+			lstmDesc.RecurWeights, gatesSize, gatesSize, stepGates, gatesSize );
+
+		for( int j = 0; j < sequenceCount; ++j ) {
+			float* mainGate = stepGates + j * gatesSize;
+			float* forgetGate = mainGate + hiddenSize;
+			float* inputGate = forgetGate + hiddenSize;
+			float* outputGate = inputGate + hiddenSize;
+			float* objectState = state + j * hiddenSize;
+			float* objectMain = main + j * hiddenSize;
+
+			// The activated gates are kept for the backward pass
+			vectorTanh( mainGate, mainGate, hiddenSize );
+			vectorSigmoid( forgetGate, forgetGate, 3 * hiddenSize );
+
+			// state = forget * prevState + input * main
+			vectorEltwiseMultiply( forgetGate, prevState + j * hiddenSize, objectState, hiddenSize );
+			vectorEltwiseMultiplyAdd( inputGate, mainGate, objectState, hiddenSize );
+			// main = output * tanh( state )
+			vectorTanh( objectState, objectMain, hiddenSize );
+			vectorEltwiseMultiply( objectMain, outputGate, objectMain, hiddenSize );
+		}
+
+		prevState = state;
+		prevMain = main;
+	}
+}
+
+void CCpuMathEngine::LstmBackward( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+	const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& gatesHandle,
+	const CConstFloatHandle& outputStateBackLink, const CConstFloatHandle& outputStateDiff,
+	const CConstFloatHandle& outputMainDiff, const CFloatHandle& gatesDiffHandle, const CFloatHandle& inputDiff,
+	const CFloatHandle& inputStateBackLinkDiff, const CFloatHandle& inputMainBackLinkDiff )
+{
+	ASSERT_EXPR( gatesHandle.GetMathEngine() == this );
+	ASSERT_EXPR( outputStateBackLink.GetMathEngine() == this );
+	ASSERT_EXPR( outputMainDiff.GetMathEngine() == this );
+	ASSERT_EXPR( gatesDiffHandle.GetMathEngine() == this );
+
+	const CMathEngineLstmDesc& lstmDesc = dynamic_cast<const CMathEngineLstmDesc&>( desc );
+	const int hiddenSize = lstmDesc.HiddenSize;
+	const int objectSize = lstmDesc.ObjectSize;
+	const int gatesSize = CMathEngineLstmDesc::GatesNum * hiddenSize;
+	const int stepSize = sequenceCount * hiddenSize;
+
+	const float* gates = GetRaw( gatesHandle );
+	const float* states = GetRaw( outputStateBackLink );
+	const float* stateDiffs = outputStateDiff.IsNull() ? nullptr : GetRaw( outputStateDiff );
+	const float* mainDiffs = GetRaw( outputMainDiff );
+	float* gatesDiff = GetRaw( gatesDiffHandle );
+
+	// The gradients passed to the previous step and tanh( state ) of one object
+	CFloatHandleStackVar buffer( *this, 2 * stepSize + hiddenSize );
+	float* mainBackDiff = GetRaw( buffer.GetHandle() );
+	float* stateBackDiff = mainBackDiff + stepSize;
+	float* stateTanh = stateBackDiff + stepSize;
+	vectorFill0( mainBackDiff, 2 * stepSize );
+
+	for( int i = sequenceLength - 1; i >= 0; --i ) {
+		const int pos = reverse ? sequenceLength - 1 - i : i;
+		const float* prevState = nullptr;
+		if( i > 0 ) {
+			prevState = states + ( reverse ? pos + 1 : pos - 1 ) * stepSize;
+		} else if( !inputStateBackLink.IsNull() ) {
+			prevState = GetRaw( inputStateBackLink );
+		}
+
+		vectorAdd( mainBackDiff, mainDiffs + pos * stepSize, mainBackDiff, stepSize );
+		if( stateDiffs != nullptr ) {
+			vectorAdd( stateBackDiff, stateDiffs + pos * stepSize, stateBackDiff, stepSize );
+		}
+
+		float* stepGatesDiff = gatesDiff + pos * sequenceCount * gatesSize;
+		for( int j = 0; j < sequenceCount; ++j ) {
+			const float* mainGate = gates + ( pos * sequenceCount + j ) * gatesSize;
+			const float* forgetGate = mainGate + hiddenSize;
+			const float* inputGate = forgetGate + hiddenSize;
+			const float* outputGate = inputGate + hiddenSize;
+			float* mainGateDiff = stepGatesDiff + j * gatesSize;
+			float* forgetGateDiff = mainGateDiff + hiddenSize;
+			float* inputGateDiff = forgetGateDiff + hiddenSize;
+			float* outputGateDiff = inputGateDiff + hiddenSize;
+			const float* mainDiff = mainBackDiff + j * hiddenSize;
+			float* stateDiff = stateBackDiff + j * hiddenSize;
+			const float* objectPrevState = prevState == nullptr ? nullptr : prevState + j * hiddenSize;
+
+			vectorTanh( states + pos * stepSize + j * hiddenSize, stateTanh, hiddenSize );
+			for( int k = 0; k < hiddenSize; ++k ) {
+				const float output = outputGate[k];
+				const float input = inputGate[k];
+				const float forget = forgetGate[k];
+				const float main = mainGate[k];
+				outputGateDiff[k] = mainDiff[k] * stateTanh[k] * output * ( 1.f - output );
+				const float diff = stateDiff[k] + mainDiff[k] * output * ( 1.f - stateTanh[k] * stateTanh[k] );
+				mainGateDiff[k] = diff * input * ( 1.f - main * main );
+				inputGateDiff[k] = diff * main * input * ( 1.f - input );
+				forgetGateDiff[k] = objectPrevState == nullptr ? 0.f
+					: diff * objectPrevState[k] * forget * ( 1.f - forget );
+				stateDiff[k] = diff * forget;
+			}
+		}
+
+		// The gradient of the previous main backlink
+		multiplyMatrixByTransposedMatrix( stepGatesDiff, sequenceCount, gatesSize, gatesSize,
+			lstmDesc.RecurWeights, hiddenSize, gatesSize, mainBackDiff, hiddenSize );
+	}
+
+	if( !inputStateBackLinkDiff.IsNull() ) {
+		dataCopy( GetRaw( inputStateBackLinkDiff ), stateBackDiff, stepSize );
+	}
+	if( !inputMainBackLinkDiff.IsNull() ) {
+		dataCopy( GetRaw( inputMainBackLinkDiff ), mainBackDiff, stepSize );
+	}
+	if( !inputDiff.IsNull() ) {
+		// The input diff is calculated for the whole sequence by one multiplication
+		multiplyMatrixByMatrix( gatesDiff, sequenceLength * sequenceCount, gatesSize, gatesSize,
+			lstmDesc.InputWeights, objectSize, objectSize, GetRaw( inputDiff ), objectSize );
+	}
+}
+
+void CCpuMathEngine::LstmLearn( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+	const CConstFloatHandle& inputHandle, const CConstFloatHandle& inputMainBackLink,
+	const CConstFloatHandle& outputMainBackLink, const CConstFloatHandle& gatesDiffHandle,
+	const CFloatHandle& inputWeightsDiff, const CFloatHandle& inputFreeTermDiff,
+	const CFloatHandle& recurWeightsDiff, const CFloatHandle& recurFreeTermDiff )
+{
+	ASSERT_EXPR( inputHandle.GetMathEngine() == this );
+	ASSERT_EXPR( outputMainBackLink.GetMathEngine() == this );
+	ASSERT_EXPR( gatesDiffHandle.GetMathEngine() == this );
+	ASSERT_EXPR( inputWeightsDiff.GetMathEngine() == this );
+	ASSERT_EXPR( recurWeightsDiff.GetMathEngine() == this );
+
+	const CMathEngineLstmDesc& lstmDesc = dynamic_cast<const CMathEngineLstmDesc&>( desc );
+	const int hiddenSize = lstmDesc.HiddenSize;
+	const int objectSize = lstmDesc.ObjectSize;
+	const int gatesSize = CMathEngineLstmDesc::GatesNum * hiddenSize;
+	const int stepSize = sequenceCount * hiddenSize;
+
+	const float* gatesDiff = GetRaw( gatesDiffHandle );
+	const float* mains = GetRaw( outputMainBackLink );
+
+	multiplyTransposedMatrixByMatrixAndAdd( gatesDiff, sequenceLength * sequenceCount, gatesSize, gatesSize,
+		GetRaw( inputHandle ), objectSize, objectSize, GetRaw( inputWeightsDiff ), objectSize );
+
+	// Each step except the first one uses the main backlink of the neighbouring position
+	if( sequenceLength > 1 ) {
+		const int stepCount = sequenceLength - 1;
+		const float* stepGatesDiff = reverse ? gatesDiff : gatesDiff + sequenceCount * gatesSize;
+		const float* prevMains = reverse ? mains + stepSize : mains;
+		multiplyTransposedMatrixByMatrixAndAdd( stepGatesDiff, stepCount * sequenceCount, gatesSize, gatesSize,
+			prevMains, hiddenSize, hiddenSize, GetRaw( recurWeightsDiff ), hiddenSize );
+	}
+	if( !inputMainBackLink.IsNull() ) {
+		const int firstPos = reverse ? sequenceLength - 1 : 0;
+		multiplyTransposedMatrixByMatrixAndAdd( gatesDiff + firstPos * sequenceCount * gatesSize, sequenceCount,
+			gatesSize, gatesSize, GetRaw( inputMainBackLink ), hiddenSize, hiddenSize,
+			GetRaw( recurWeightsDiff ), hiddenSize );
+	}
+
+	if( !inputFreeTermDiff.IsNull() ) {
+		sumMatrixRowsAdd( GetRaw( inputFreeTermDiff ), gatesDiff, sequenceLength * sequenceCount, gatesSize );
+	}
+	if( !recurFreeTermDiff.IsNull() ) {
+		sumMatrixRowsAdd( GetRaw( recurFreeTermDiff ), gatesDiff, sequenceLength * sequenceCount, gatesSize );
+	}
+}
+
 } // namespace NeoML
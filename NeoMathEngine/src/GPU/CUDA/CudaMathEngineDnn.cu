@@ -830,6 +830,25 @@ void CCudaMathEngine::ScatterND( const CConstIntHandle& indicesHandle, const CCo
 		GetRaw( dataHandle ), cudaDataDesc, updateCount, indexDims, objectSize );
 }
 
+CInt8FullyConnectedDesc* CCudaMathEngine::InitInt8FullyConnected( int, int, const signed char*,
+	const CConstFloatHandle&, const CConstFloatHandle*, float, int )
+{
+	ASSERT_EXPR( false );
+	return nullptr;
+}
+
+void CCudaMathEngine::Int8FullyConnected( const CInt8FullyConnectedDesc&, const CConstFloatHandle&, int,
+	const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+void CCudaMathEngine::ScaledDotProductAttention( int, int, int, int, int, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle&, float, const CConstFloatHandle*, int, float, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
 } // namespace NeoML
 
 #endif // NEOML_USE_CUDA
@@ -35,6 +35,39 @@ void CCudaMathEngine::Lstm( CLstmDesc&, bool, int, int, const CConstFloatHandle&
 	ASSERT_EXPR( false );
 }
 
+void CCudaMathEngine::LstmForwardTraining( CLstmDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CFloatHandle&, const CFloatHandle&, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+void CCudaMathEngine::LstmBackward( CLstmDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle&, const CConstFloatHandle&, const CFloatHandle&,
+	const CFloatHandle&, const CFloatHandle&, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+void CCudaMathEngine::LstmLearn( CLstmDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle&, const CFloatHandle&, const CFloatHandle&,
+	const CFloatHandle&, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+CGruDesc* CCudaMathEngine::InitGru( int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle& )
+{
+	ASSERT_EXPR( false );
+	return nullptr;
+}
+
+void CCudaMathEngine::Gru( CGruDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
 } // namespace NeoML
 
 #endif // NEOML_USE_CUDA
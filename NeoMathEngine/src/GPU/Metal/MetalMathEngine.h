@@ -352,6 +352,10 @@ public:
 		const CFloatHandle& resultHandle, int resultRowSize, int resultBufferSize) override;
 	void MultiplyMatrixByTransposedMatrix(int batchSize, const CConstFloatHandle& firstHandle, int firstHeight, int firstWidth,
 		const CConstFloatHandle& secondHandle, int secondHeight, const CFloatHandle& resultHandle, int resultBufferSize) override;
+	CPackedMatrixDesc* InitPackedTransposedMatrix( const CConstFloatHandle&, int, int ) override { return nullptr; }
+	CPackedMatrixDesc* InitHalfFloatPackedTransposedMatrix( THalfFloatFormat, const uint16_t*, int, int ) override { return nullptr; }
+	void MultiplyMatrixByPackedTransposedMatrix( const CConstFloatHandle&, int, int, const CPackedMatrixDesc&,
+		const CFloatHandle&, int ) override { ASSERT_EXPR( false ); }
 	void MultiplySparseMatrixByTransposedMatrix( int firstHeight, int firstWidth, int secondHeight,
 		const CSparseMatrixDesc& firstDesc, const CConstFloatHandle& secondHandle, const CFloatHandle& resultHandle ) override;
 	void MultiplyTransposedMatrixBySparseMatrix( int firstHeight, int firstWidth, int secondWidth,
@@ -582,6 +586,25 @@ public:
 		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
 		const CConstFloatHandle& input, const CFloatHandle& outputStateBackLink,
 		const CFloatHandle& outputMainBackLink) override;
+	void LstmForwardTraining( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& inputMainBackLink,
+		const CConstFloatHandle& input, const CFloatHandle& gates, const CFloatHandle& outputStateBackLink,
+		const CFloatHandle& outputMainBackLink ) override;
+	void LstmBackward( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputStateBackLink, const CConstFloatHandle& gates,
+		const CConstFloatHandle& outputStateBackLink, const CConstFloatHandle& outputStateDiff,
+		const CConstFloatHandle& outputMainDiff, const CFloatHandle& gatesDiff, const CFloatHandle& inputDiff,
+		const CFloatHandle& inputStateBackLinkDiff, const CFloatHandle& inputMainBackLinkDiff ) override;
+	void LstmLearn( CLstmDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& input, const CConstFloatHandle& inputMainBackLink,
+		const CConstFloatHandle& outputMainBackLink, const CConstFloatHandle& gatesDiff,
+		const CFloatHandle& inputWeightsDiff, const CFloatHandle& inputFreeTermDiff,
+		const CFloatHandle& recurWeightsDiff, const CFloatHandle& recurFreeTermDiff ) override;
+	CGruDesc* InitGru( int hiddenSize, int objectSize,
+		const CConstFloatHandle& gateWeights, const CConstFloatHandle& gateFreeTerm,
+		const CConstFloatHandle& mainWeights, const CConstFloatHandle& mainFreeTerm ) override;
+	void Gru( CGruDesc& desc, bool reverse, int sequenceLength, int sequenceCount,
+		const CConstFloatHandle& inputMainBackLink, const CConstFloatHandle& input, const CFloatHandle& output ) override;
 	void LinearInterpolation( const CConstFloatHandle& dataHandle, const CFloatHandle& resultHandle,
 		TInterpolationCoords coords, TInterpolationRound round, int objectCount, int scaledAxis,
 		int objectSize, float scale ) override;
@@ -628,6 +651,13 @@ public:
 		{ ASSERT_EXPR( false ); return CBlobDesc(); }
 	void RowwiseExecute( const CBlobDesc&, CRowwiseOperationDesc**, int, const CFloatHandle&,
 		const CFloatHandle& ) override { ASSERT_EXPR( false ); }
+	CInt8FullyConnectedDesc* InitInt8FullyConnected( int, int, const signed char*, const CConstFloatHandle&,
+		const CConstFloatHandle*, float, int ) override { ASSERT_EXPR( false ); return nullptr; }
+	void Int8FullyConnected( const CInt8FullyConnectedDesc&, const CConstFloatHandle&, int,
+		const CFloatHandle& ) override { ASSERT_EXPR( false ); }
+	void ScaledDotProductAttention( int, int, int, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+		const CConstFloatHandle&, float, const CConstFloatHandle*, int, float, const CFloatHandle& ) override
+		{ ASSERT_EXPR( false ); }
 
 	IPerformanceCounters* CreatePerformanceCounters( bool ) const override { return new CPerformanceCountersDefault(); }
 	void AllReduce( const CFloatHandle& /*handle*/, int /*size*/ ) override {};
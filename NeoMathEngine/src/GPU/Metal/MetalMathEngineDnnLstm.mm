@@ -35,6 +35,39 @@ void CMetalMathEngine::Lstm( CLstmDesc&, bool, int, int, const CConstFloatHandle
 	ASSERT_EXPR( false );
 }
 
+void CMetalMathEngine::LstmForwardTraining( CLstmDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CFloatHandle&, const CFloatHandle&, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+void CMetalMathEngine::LstmBackward( CLstmDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle&, const CConstFloatHandle&, const CFloatHandle&,
+	const CFloatHandle&, const CFloatHandle&, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+void CMetalMathEngine::LstmLearn( CLstmDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle&, const CFloatHandle&, const CFloatHandle&,
+	const CFloatHandle&, const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
+CGruDesc* CMetalMathEngine::InitGru( int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CConstFloatHandle&, const CConstFloatHandle& )
+{
+	ASSERT_EXPR( false );
+	return nullptr;
+}
+
+void CMetalMathEngine::Gru( CGruDesc&, bool, int, int, const CConstFloatHandle&, const CConstFloatHandle&,
+	const CFloatHandle& )
+{
+	ASSERT_EXPR( false );
+}
+
 } // namespace NeoML
 
 #endif // NEOML_USE_METAL
@@ -0,0 +1,131 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <common.h>
+#pragma hdrstop
+
+#include <NeoMathEngine/NeoMathEngine.h>
+#include <MathEngineCommon.h>
+#include <cstring>
+
+namespace NeoML {
+
+static inline uint32_t floatToBits( float value )
+{
+	uint32_t bits;
+	::memcpy( &bits, &value, sizeof( bits ) );
+	return bits;
+}
+
+static inline float bitsToFloat( uint32_t bits )
+{
+	float value;
+	::memcpy( &value, &bits, sizeof( value ) );
+	return value;
+}
+
+static inline uint16_t floatToFloat16( float value )
+{
+	uint32_t bits = floatToBits( value );
+	const uint16_t sign = static_cast<uint16_t>( ( bits >> 16 ) & 0x8000 );
+	bits &= 0x7FFFFFFF;
+
+	if( bits >= 0x7F800000 ) {
+		// Infinity or NaN (NaN stays quiet)
+		return sign | 0x7C00 | ( bits > 0x7F800000 ? 0x200 : 0 );
+	}
+	if( bits >= 0x477FF000 ) {
+		// Rounds to infinity (the maximum float16 value is 65504)
+		return sign | 0x7C00;
+	}
+	if( bits < 0x38800000 ) {
+		// The subnormal float16: the float addition rounds the value to the multiple of 2^-24
+		return sign | static_cast<uint16_t>( floatToBits( bitsToFloat( bits ) + 0.5f ) - 0x3F000000 );
+	}
+	// Rebias the exponent and round the mantissa to the nearest even
+	bits += 0xC8000FFF + ( ( bits >> 13 ) & 1 );
+	return sign | static_cast<uint16_t>( bits >> 13 );
+}
+
+static inline float float16ToFloat( uint16_t value )
+{
+	static const uint32_t shiftedExponent = 0x7C00 << 13;
+	uint32_t bits = static_cast<uint32_t>( value & 0x7FFF ) << 13;
+	const uint32_t exponent = bits & shiftedExponent;
+	bits += ( 127 - 15 ) << 23;
+	if( exponent == shiftedExponent ) {
+		// Infinity or NaN
+		bits += ( 128 - 16 ) << 23;
+	} else if( exponent == 0 ) {
+		// Zero or subnormal
+		bits = floatToBits( bitsToFloat( bits + ( 1 << 23 ) ) - bitsToFloat( 113 << 23 ) );
+	}
+	return bitsToFloat( bits | ( static_cast<uint32_t>( value & 0x8000 ) << 16 ) );
+}
+
+static inline uint16_t floatToBFloat16( float value )
+{
+	const uint32_t bits = floatToBits( value );
+	if( ( bits & 0x7FFFFFFF ) > 0x7F800000 ) {
+		// NaN must not be rounded to infinity
+		return static_cast<uint16_t>( ( bits >> 16 ) | 0x40 );
+	}
+	return static_cast<uint16_t>( ( bits + 0x7FFF + ( ( bits >> 16 ) & 1 ) ) >> 16 );
+}
+
+static inline float bfloat16ToFloat( uint16_t value )
+{
+	return bitsToFloat( static_cast<uint32_t>( value ) << 16 );
+}
+
+void ConvertToHalfFloat( THalfFloatFormat format, const float* source, uint16_t* result, int count )
+{
+	ASSERT_EXPR( count >= 0 );
+	switch( format ) {
+		case HFF_Float16:
+			for( int i = 0; i < count; ++i ) {
+				result[i] = floatToFloat16( source[i] );
+			}
+			break;
+		case HFF_BFloat16:
+			for( int i = 0; i < count; ++i ) {
+				result[i] = floatToBFloat16( source[i] );
+			}
+			break;
+		default:
+			ASSERT_EXPR( false );
+	}
+}
+
+void ConvertFromHalfFloat( THalfFloatFormat format, const uint16_t* source, float* result, int count )
+{
+	ASSERT_EXPR( count >= 0 );
+	switch( format ) {
+		case HFF_Float16:
+			for( int i = 0; i < count; ++i ) {
+				result[i] = float16ToFloat( source[i] );
+			}
+			break;
+		case HFF_BFloat16:
+			for( int i = 0; i < count; ++i ) {
+				result[i] = bfloat16ToFloat( source[i] );
+			}
+			break;
+		default:
+			ASSERT_EXPR( false );
+	}
+}
+
+} // namespace NeoML
@@ -69,7 +69,10 @@ CGlobalMaxOverTimePoolingDesc::~CGlobalMaxOverTimePoolingDesc() = default;
 CMaxOverTimePoolingDesc::~CMaxOverTimePoolingDesc() = default;
 CLrnDesc::~CLrnDesc() = default;
 CLstmDesc::~CLstmDesc() = default;
+CGruDesc::~CGruDesc() = default;
 CRowwiseOperationDesc::~CRowwiseOperationDesc() = default;
+CInt8FullyConnectedDesc::~CInt8FullyConnectedDesc() = default;
+CPackedMatrixDesc::~CPackedMatrixDesc() = default;
 
 //------------------------------------------------------------------------------------------------------------
 
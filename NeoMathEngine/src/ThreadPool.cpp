@@ -19,7 +19,11 @@ limitations under the License.
 #include <NeoMathEngine/ThreadPool.h>
 #include <NeoMathEngine/NeoMathEngineException.h>
 
+#include <algorithm>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <queue>
@@ -107,6 +111,59 @@ int GetAvailableCpuCores()
 
 //------------------------------------------------------------------------------------------------------------
 
+// The average number of ranges per thread if the grain size is chosen automatically
+static constexpr int autoGrainsPerThread = 8;
+
+static int getAutoGrainSize( int count, int threadCount, int grainsPerThread )
+{
+	return std::max( count / ( threadCount * grainsPerThread ), 1 );
+}
+
+// The loop for the default static implementation of ParallelFor
+struct CStaticParallelFor final {
+	IThreadPool::TRangeFunction Function{};
+	void* Params{};
+	int Count{};
+	int GrainSize{};
+	int ThreadCount{};
+};
+
+static void staticParallelForEntry( int threadIndex, void* params )
+{
+	const CStaticParallelFor& loop = *static_cast<const CStaticParallelFor*>( params );
+	int index = 0;
+	int count = 0;
+	if( GetTaskIndexAndCount( loop.ThreadCount, threadIndex, loop.Count, index, count ) ) {
+		const int end = index + count;
+		for( int begin = index; begin < end; begin += loop.GrainSize ) {
+			loop.Function( threadIndex, begin, std::min( end - begin, loop.GrainSize ) + begin, loop.Params );
+		}
+	}
+}
+
+void IThreadPool::ParallelFor( int count, int grainSize, TRangeFunction function, void* params )
+{
+	ASSERT_EXPR( count >= 0 );
+	const int threadCount = Size();
+	if( count == 0 ) {
+		return;
+	}
+	if( threadCount == 1 ) {
+		function( 0, 0, count, params );
+		return;
+	}
+
+	CStaticParallelFor loop;
+	loop.Function = function;
+	loop.Params = params;
+	loop.Count = count;
+	loop.GrainSize = grainSize > 0 ? grainSize : getAutoGrainSize( count, threadCount, /*grainsPerThread*/1 );
+	loop.ThreadCount = threadCount;
+	ExecuteTasks( *this, &loop, staticParallelForEntry );
+}
+
+//------------------------------------------------------------------------------------------------------------
+
 class CThreadPoolEmpty : public IThreadPool {
 public:
 	CThreadPoolEmpty() = default;
@@ -114,10 +171,23 @@ public:
 	int Size() const override { return 1; }
 	bool AddTask( int, TFunction, void* ) override { ASSERT_EXPR( false ); return false; }
 	void WaitAllTask() override { ASSERT_EXPR( false ); }
+	void ParallelFor( int count, int, TRangeFunction function, void* params ) override;
 };
 
+void CThreadPoolEmpty::ParallelFor( int count, int, TRangeFunction function, void* params )
+{
+	ASSERT_EXPR( count >= 0 );
+	if( count > 0 ) {
+		function( 0, 0, count, params );
+	}
+}
+
 //------------------------------------------------------------------------------------------------------------
 
+// The number of attempts to get the work before the thread falls asleep
+// Spinning avoids the expensive wakeup if the next task comes soon (as usual for the sequence of parallel loops)
+static constexpr int threadPoolSpinCount = 1000;
+
 class CThreadPool : public IThreadPool {
 public:
 	explicit CThreadPool( int threadCount );
@@ -127,6 +197,7 @@ public:
 	int Size() const override { return static_cast<int>( threads.size() ); }
 	bool AddTask( int threadIndex, TFunction function, void* params ) override;
 	void WaitAllTask() override;
+	void ParallelFor( int count, int grainSize, TRangeFunction function, void* params ) override;
 
 private:
 	struct CTask final {
@@ -140,39 +211,91 @@ private:
 		std::condition_variable ConditionVariable{};
 		std::mutex Mutex{};
 		std::queue<CTask> Queue{};
+		std::atomic<int> QueueSize{}; // Queue size available without locking (used for spinning).
 		bool Stopped{};
 	};
 
-	static void threadEntry( CParams* );
+	// The part of the parallel loop [begin, end) owned by a thread
+	// Begin and end are packed into one 64-bit value to be changed atomically
+	struct CLoopRange final {
+		std::atomic<uint64_t> Value{};
+		char Padding[64 - sizeof( std::atomic<uint64_t> )]{}; // avoids false sharing between the threads
+	};
+
+	// The parallel loop distributed among the threads
+	struct CParallelFor final {
+		TRangeFunction Function{};
+		void* Params{};
+		int GrainSize{};
+		int ThreadCount{};
+		std::unique_ptr<CLoopRange[]> Ranges{};
+	};
+
+	void threadEntry( CParams* );
+	void onTaskCompleted();
 	// Stops all threads and waits for them to complete.
 	void stopAndWait();
 
+	static void parallelForEntry( int threadIndex, void* params );
+	static bool popRangeFront( std::atomic<uint64_t>& range, int grainSize, int& begin, int& end );
+	static bool stealRangeBack( std::atomic<uint64_t>& range, int grainSize, int& begin, int& end );
+
 	std::vector<std::thread*> threads{}; // CPointerArray isn't available in neoml.
 	std::vector<CParams*> params{};
+	std::atomic<int> runningTaskCount{}; // Number of the added tasks which aren't completed yet.
+	std::condition_variable waitConditionVariable{};
+	std::mutex waitMutex{};
 };
 
+// The pool which owns the current thread and the index of the thread in that pool
+static thread_local const IThreadPool* currentThreadPool = nullptr;
+static thread_local int currentThreadIndex = 0;
+
+static inline uint64_t packLoopRange( int begin, int end )
+{
+	return ( static_cast<uint64_t>( static_cast<uint32_t>( begin ) ) << 32 ) | static_cast<uint32_t>( end );
+}
+
+static inline int loopRangeBegin( uint64_t range ) { return static_cast<int>( range >> 32 ); }
+static inline int loopRangeEnd( uint64_t range ) { return static_cast<int>( range & 0xFFFFFFFF ); }
+
 void CThreadPool::threadEntry( CParams* parameters )
 {
 	CParams& params = *parameters;
-	std::unique_lock<std::mutex> lock( params.Mutex );
+	currentThreadPool = this;
+	currentThreadIndex = params.Index;
 
-	while( !params.Stopped ) {
-		if( !params.Queue.empty() ) {
-			CTask task = params.Queue.front();
-			lock.unlock();
+	while( true ) {
+		for( int i = 0; i < threadPoolSpinCount && params.QueueSize.load( std::memory_order_acquire ) == 0; ++i ) {
+			std::this_thread::yield();
+		}
 
-			try {
-				task.Function( params.Index, task.Params );
-			} catch( ... ) {
-				ASSERT_EXPR( false ); // Better than nothing
+		CTask task;
+		{
+			std::unique_lock<std::mutex> lock( params.Mutex );
+			params.ConditionVariable.wait( lock, [&params] { return params.Stopped || !params.Queue.empty(); } );
+			if( params.Queue.empty() ) {
+				return; // stopped
 			}
-
-			lock.lock();
+			task = params.Queue.front();
 			params.Queue.pop();
-			params.ConditionVariable.notify_all();
+			params.QueueSize.fetch_sub( 1, std::memory_order_relaxed );
+		}
+
+		try {
+			task.Function( params.Index, task.Params );
+		} catch( ... ) {
+			ASSERT_EXPR( false ); // Better than nothing
 		}
+		onTaskCompleted();
+	}
+}
 
-		params.ConditionVariable.wait( lock );
+void CThreadPool::onTaskCompleted()
+{
+	if( runningTaskCount.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+		std::lock_guard<std::mutex> lock( waitMutex );
+		waitConditionVariable.notify_all();
 	}
 }
 
@@ -186,7 +309,7 @@ CThreadPool::CThreadPool( int threadCount )
 		param->Stopped = false;
 		params.push_back( param );
 
-		std::thread* thread = new std::thread( threadEntry, param );
+		std::thread* thread = new std::thread( &CThreadPool::threadEntry, this, param );
 		threads.push_back( thread );
 	}
 }
@@ -206,19 +329,134 @@ bool CThreadPool::AddTask( int threadIndex, TFunction function, void* functionPa
 {
 	assert( 0 <= threadIndex && threadIndex < Size() );
 
+	runningTaskCount.fetch_add( 1, std::memory_order_relaxed );
 	std::unique_lock<std::mutex> lock( params[threadIndex]->Mutex );
 	params[threadIndex]->Queue.push( { function, functionParams } );
-	params[threadIndex]->ConditionVariable.notify_all();
+	params[threadIndex]->QueueSize.fetch_add( 1, std::memory_order_release );
+	params[threadIndex]->ConditionVariable.notify_one();
 
 	return !params[threadIndex]->Stopped;
 }
 
 void CThreadPool::WaitAllTask()
 {
-	for( size_t i = 0; i < params.size(); i++ ) {
-		std::unique_lock<std::mutex> lock( params[i]->Mutex );
-		while( !params[i]->Queue.empty() ) {
-			params[i]->ConditionVariable.wait( lock );
+	for( int i = 0; i < threadPoolSpinCount; ++i ) {
+		if( runningTaskCount.load( std::memory_order_acquire ) == 0 ) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+
+	std::unique_lock<std::mutex> lock( waitMutex );
+	waitConditionVariable.wait( lock,
+		[this] { return runningTaskCount.load( std::memory_order_acquire ) == 0; } );
+}
+
+void CThreadPool::ParallelFor( int count, int grainSize, TRangeFunction function, void* functionParams )
+{
+	ASSERT_EXPR( count >= 0 );
+	if( count == 0 ) {
+		return;
+	}
+	if( currentThreadPool == this ) {
+		// Nested parallel loop: the other threads are already busy with the outer one
+		function( currentThreadIndex, 0, count, functionParams );
+		return;
+	}
+
+	const int threadCount = Size();
+	CParallelFor loop;
+	loop.Function = function;
+	loop.Params = functionParams;
+	loop.GrainSize = grainSize > 0 ? grainSize : getAutoGrainSize( count, threadCount, autoGrainsPerThread );
+	loop.ThreadCount = threadCount;
+	if( count <= loop.GrainSize ) {
+		function( 0, 0, count, functionParams );
+		return;
+	}
+
+	// Each thread starts from its own part of the loop
+	loop.Ranges.reset( new CLoopRange[threadCount] );
+	for( int i = 0; i < threadCount; ++i ) {
+		int index = 0;
+		int rangeCount = 0;
+		if( GetTaskIndexAndCount( threadCount, i, count, loop.GrainSize, index, rangeCount ) ) {
+			loop.Ranges[i].Value.store( packLoopRange( index, index + rangeCount ), std::memory_order_relaxed );
+		}
+	}
+
+	for( int i = 0; i < threadCount; ++i ) {
+		AddTask( i, parallelForEntry, &loop );
+	}
+	WaitAllTask();
+}
+
+void CThreadPool::parallelForEntry( int threadIndex, void* params )
+{
+	CParallelFor& loop = *static_cast<CParallelFor*>( params );
+	int begin = 0;
+	int end = 0;
+	while( true ) {
+		while( popRangeFront( loop.Ranges[threadIndex].Value, loop.GrainSize, begin, end ) ) {
+			loop.Function( threadIndex, begin, end, loop.Params );
+		}
+
+		// The own part is over, steal the work from the other threads
+		bool isStolen = false;
+		for( int i = 1; i < loop.ThreadCount && !isStolen; ++i ) {
+			isStolen = stealRangeBack( loop.Ranges[( threadIndex + i ) % loop.ThreadCount].Value,
+				loop.GrainSize, begin, end );
+		}
+		if( !isStolen ) {
+			return;
+		}
+		// The stolen range becomes the own part (and may be stolen again by another thread)
+		loop.Ranges[threadIndex].Value.store( packLoopRange( begin, end ), std::memory_order_release );
+	}
+}
+
+// Takes the range of grainSize indices from the beginning of the thread's part of the loop
+bool CThreadPool::popRangeFront( std::atomic<uint64_t>& range, int grainSize, int& begin, int& end )
+{
+	uint64_t value = range.load( std::memory_order_acquire );
+	while( true ) {
+		const int rangeBegin = loopRangeBegin( value );
+		const int rangeEnd = loopRangeEnd( value );
+		if( rangeBegin >= rangeEnd ) {
+			return false;
+		}
+		const int newBegin = ( rangeEnd - rangeBegin <= grainSize ) ? rangeEnd : rangeBegin + grainSize;
+		if( range.compare_exchange_weak( value, packLoopRange( newBegin, rangeEnd ),
+			std::memory_order_acq_rel, std::memory_order_acquire ) )
+		{
+			begin = rangeBegin;
+			end = newBegin;
+			return true;
+		}
+	}
+}
+
+// Takes the second half of another thread's part of the loop
+bool CThreadPool::stealRangeBack( std::atomic<uint64_t>& range, int grainSize, int& begin, int& end )
+{
+	uint64_t value = range.load( std::memory_order_acquire );
+	while( true ) {
+		const int rangeBegin = loopRangeBegin( value );
+		const int rangeEnd = loopRangeEnd( value );
+		if( rangeBegin >= rangeEnd ) {
+			return false;
+		}
+		const int size = rangeEnd - rangeBegin;
+		const int newEnd = ( size <= grainSize ) ? rangeBegin : rangeBegin + ( size / 2 + grainSize - 1 ) / grainSize * grainSize;
+		if( newEnd >= rangeEnd ) {
+			return false;
+		}
+		if( range.compare_exchange_weak( value, packLoopRange( rangeBegin, newEnd ),
+			std::memory_order_acq_rel, std::memory_order_acquire ) )
+		{
+			begin = newEnd;
+			end = rangeEnd;
+			return true;
 		}
 	}
 }
@@ -182,7 +182,12 @@ CTestParams TestParams[] = {
 	CTestParams( "ConvParams = { 8, 8, 1, 1, 8, 8, 256, 256, 16, 1, 3, 3, 1 }; TestCount = 1;" ),
 	CTestParams( "ConvParams = { 8, 8, 1, 1, 8, 8, 256, 256, 24, 1, 3, 3, 1 }; TestCount = 1;" ),
 	CTestParams( "ConvParams = { 8, 8, 1, 1, 8, 8, 256, 256, 64, 1, 3, 3, 1 }; TestCount = 1;" ),
-	CTestParams( "ConvParams = { 8, 8, 1, 1, 8, 8, 256, 256, 96, 1, 3, 3, 1 }; TestCount = 1;" )
+	CTestParams( "ConvParams = { 8, 8, 1, 1, 8, 8, 256, 256, 96, 1, 3, 3, 1 }; TestCount = 1;" ),
+	// Winograd algorithm on CPU: F(4x4, 3x3) for 48 channels, F(2x2, 3x3) for more, several objects
+	CTestParams( "ConvParams = { 1, 1, 1, 1, 1, 1, 56, 56, 48, 4, 3, 3, 1 }; TestCount = 1;" ),
+	CTestParams( "ConvParams = { 1, 1, 1, 1, 1, 1, 56, 56, 64, 4, 3, 3, 1 }; TestCount = 1;" ),
+	CTestParams( "ConvParams = { 1, 1, 1, 1, 1, 1, 28, 28, 128, 4, 3, 3, 1 }; TestCount = 1;" ),
+	CTestParams( "ConvParams = { 0, 0, 1, 1, 1, 1, 14, 14, 256, 4, 3, 3, 0 }; TestCount = 1;" )
 };
 // PaddingHeight | PaddingWidth | StrideHeight | StrideWidth | DilationHeight | DilationWidth | ObjectWidth | ObjectHeight | NumChannels | ObjectCount | FiltWidth | FiltHeight | IsFreeTerm
 INSTANTIATE_TEST_CASE_P( CMathEngineBlobConvolutionPerformanceTestInstantiation, CMathEngineBlobConvolutionPerformanceTest,
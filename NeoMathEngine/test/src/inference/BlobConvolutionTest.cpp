@@ -631,6 +631,26 @@ INSTANTIATE_TEST_CASE_P( CMathEngineBlobConvolutionTestInstantiation, CMathEngin
 			"IsZeroFreeTerm = 0;"
 			"Values = (-10..10);"
 			"TestCount = 1;"
+		),
+		CTestParams(
+			"InputLength = (1..2);"
+			"InputBatch = (1..2);"
+			"InputHeight = (6..20);"
+			"InputWidth = (6..20);"
+			"InputDepth = (1..2);"
+			"InputChannels = (48..80);"
+			"FilterCount = (48..60);"
+			"FilterHeight = 3;"
+			"FilterWidth = 3;"
+			"PaddingHeight = (0..2);"
+			"PaddingWidth = (0..2);"
+			"DilationHeight = 1;"
+			"DilationWidth = 1;"
+			"StrideHeight = 1;"
+			"StrideWidth = 1;"
+			"IsZeroFreeTerm = (0..1);"
+			"Values = (-1..1);"
+			"TestCount = 10;"
 		)
 	)
 );
@@ -639,3 +659,74 @@ TEST_P( CMathEngineBlobConvolutionTest, Random )
 {
 	RUN_TEST_IMPL( blobConvolutionTestImpl );
 }
+
+//------------------------------------------------------------------------------------------------------------
+
+// Checks that the convolution descriptor uses the new filter data
+// when the filter blob is changed between the calls (the descriptor mustn't cache the transformed filter)
+static void blobConvolutionFilterChangeTestImpl( const CTestParams& params, int seed )
+{
+	CRandom random( seed );
+
+	const int batchSize = 2;
+	const int height = params.GetValue<int>( "InputHeight" );
+	const int width = params.GetValue<int>( "InputWidth" );
+	const int channels = params.GetValue<int>( "InputChannels" );
+	const int filterCount = params.GetValue<int>( "FilterCount" );
+	const int padding = 1;
+
+	CREATE_FILL_FLOAT_ARRAY( inputData, -1.f, 1.f, batchSize * height * width * channels, random )
+	CFloatBlob inputBlob( MathEngine(), 1, batchSize, 1, height, width, 1, channels );
+	inputBlob.CopyFrom( inputData.data() );
+	CFloatBlob filterBlob( MathEngine(), filterCount, 3, 3, 1, channels );
+	CFloatBlob outputBlob( MathEngine(), 1, batchSize, 1, height, width, 1, filterCount );
+
+	std::unique_ptr<CConvolutionDesc> convDesc( MathEngine().InitBlobConvolution( inputBlob.GetDesc(),
+		padding, padding, 1, 1, 1, 1, filterBlob.GetDesc(), outputBlob.GetDesc() ) );
+
+	std::vector<float> freeTermData( filterCount, 0.f );
+	std::vector<float> expectedData( outputBlob.GetDataSize() );
+	std::vector<float> actualData( outputBlob.GetDataSize() );
+	for( int step = 0; step < 3; ++step ) {
+		CREATE_FILL_FLOAT_ARRAY( filterData, -1.f, 1.f, filterCount * 9 * channels, random )
+		filterBlob.CopyFrom( filterData.data() );
+
+		MathEngine().BlobConvolution( *convDesc, inputBlob.GetData(), filterBlob.GetData(), nullptr,
+			outputBlob.GetData() );
+		outputBlob.CopyTo( actualData.data() );
+
+		batchConvolutionForward( inputData.data(), filterData.data(), freeTermData.data(), expectedData.data(),
+			1, batchSize, height, width, 1, channels, padding, padding, filterCount, 3, 3, 1, 1, 1, 1 );
+		for( size_t i = 0; i < expectedData.size(); ++i ) {
+			ASSERT_TRUE( FloatEq( expectedData[i], actualData[i], 1e-3f ) ) << "step " << step;
+		}
+	}
+}
+
+class CMathEngineBlobConvolutionFilterChangeTest : public CTestFixtureWithParams {
+};
+
+INSTANTIATE_TEST_CASE_P( CMathEngineBlobConvolutionFilterChangeTestInstantiation,
+	CMathEngineBlobConvolutionFilterChangeTest,
+	::testing::Values(
+		CTestParams(
+			"InputHeight = 8;"
+			"InputWidth = 9;"
+			"InputChannels = 50;"
+			"FilterCount = 49;"
+			"TestCount = 1;"
+		),
+		CTestParams(
+			"InputHeight = 13;"
+			"InputWidth = 10;"
+			"InputChannels = 70;"
+			"FilterCount = 52;"
+			"TestCount = 1;"
+		)
+	)
+);
+
+TEST_P( CMathEngineBlobConvolutionFilterChangeTest, Random )
+{
+	RUN_TEST_IMPL( blobConvolutionFilterChangeTestImpl );
+}
@@ -0,0 +1,130 @@
+/* Copyright © 2017-2024 ABBYY Production LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <TestFixture.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static void int8FullyConnectedImpl( const CTestParams& params, int seed )
+{
+	CRandom random( seed );
+
+	const CInterval batchSizeInterval = params.GetInterval( "BatchSize" );
+	const CInterval inputSizeInterval = params.GetInterval( "InputSize" );
+	const CInterval outputSizeInterval = params.GetInterval( "OutputSize" );
+	const CInterval valuesInterval = params.GetInterval( "Values" );
+
+	const int batchSize = random.UniformInt( batchSizeInterval.Begin, batchSizeInterval.End );
+	const int inputSize = random.UniformInt( inputSizeInterval.Begin, inputSizeInterval.End );
+	const int outputSize = random.UniformInt( outputSizeInterval.Begin, outputSizeInterval.End );
+	const bool hasFreeTerm = random.Next() % 2 == 1;
+
+	CREATE_FILL_FLOAT_ARRAY( input, valuesInterval.Begin, valuesInterval.End, batchSize * inputSize, random )
+	CREATE_FILL_FLOAT_ARRAY( weights, valuesInterval.Begin, valuesInterval.End, outputSize * inputSize, random )
+	CREATE_FILL_FLOAT_ARRAY( freeTerm, valuesInterval.Begin, valuesInterval.End, outputSize, random )
+
+	// Calibration: asymmetric per-tensor input quantization, symmetric per-channel weights quantization
+	float inputMin = 0;
+	float inputMax = 0;
+	for( float value : input ) {
+		inputMin = std::min( inputMin, value );
+		inputMax = std::max( inputMax, value );
+	}
+	const float inputScale = std::max( inputMax - inputMin, 1e-6f ) / 255.f;
+	const int inputZeroPoint = static_cast<int>( std::round( -inputMin / inputScale ) );
+
+	std::vector<float> weightScales( outputSize );
+	std::vector<signed char> quantizedWeights( outputSize * inputSize );
+	for( int out = 0; out < outputSize; ++out ) {
+		float maxAbs = 0;
+		for( int in = 0; in < inputSize; ++in ) {
+			maxAbs = std::max( maxAbs, std::fabs( weights[out * inputSize + in] ) );
+		}
+		weightScales[out] = std::max( maxAbs, 1e-6f ) / Int8WeightQuantizationMax;
+		for( int in = 0; in < inputSize; ++in ) {
+			const float value = std::nearbyint( weights[out * inputSize + in] / weightScales[out] );
+			quantizedWeights[out * inputSize + in] = static_cast<signed char>( std::min(
+				static_cast<float>( Int8WeightQuantizationMax ), std::max( -static_cast<float>( Int8WeightQuantizationMax ), value ) ) );
+		}
+	}
+
+	// The float reference and the quantization error bound
+	std::vector<float> expected( batchSize * outputSize );
+	std::vector<float> tolerance( batchSize * outputSize );
+	for( int b = 0; b < batchSize; ++b ) {
+		for( int out = 0; out < outputSize; ++out ) {
+			double sum = hasFreeTerm ? freeTerm[out] : 0.;
+			double error = 0;
+			for( int in = 0; in < inputSize; ++in ) {
+				const float x = input[b * inputSize + in];
+				const float w = weights[out * inputSize + in];
+				sum += static_cast<double>( x ) * w;
+				error += ( std::fabs( w ) + weightScales[out] / 2 ) * inputScale / 2 + std::fabs( x ) * weightScales[out] / 2;
+			}
+			expected[b * outputSize + out] = static_cast<float>( sum );
+			tolerance[b * outputSize + out] = static_cast<float>( error ) + 1e-3f;
+		}
+	}
+
+	CFloatBlob weightScalesBlob( MathEngine(), outputSize, 1, 1, 1 );
+	weightScalesBlob.CopyFrom( weightScales.data() );
+	CFloatBlob freeTermBlob( MathEngine(), outputSize, 1, 1, 1 );
+	freeTermBlob.CopyFrom( freeTerm.data() );
+	const CConstFloatHandle freeTermHandle = freeTermBlob.GetData();
+
+	std::unique_ptr<CInt8FullyConnectedDesc> desc( MathEngine().InitInt8FullyConnected( inputSize, outputSize,
+		quantizedWeights.data(), weightScalesBlob.GetData(), hasFreeTerm ? &freeTermHandle : nullptr,
+		inputScale, inputZeroPoint ) );
+
+	std::vector<float> result( batchSize * outputSize );
+	MathEngine().Int8FullyConnected( *desc, CARRAY_FLOAT_WRAPPER( input ), batchSize, CARRAY_FLOAT_WRAPPER( result ) );
+
+	for( int i = 0; i < batchSize * outputSize; ++i ) {
+		ASSERT_NEAR( expected[i], result[i], tolerance[i] );
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------
+
+class CMathEngineInt8FullyConnectedTest : public CTestFixtureWithParams {
+};
+
+INSTANTIATE_TEST_CASE_P( CMathEngineInt8FullyConnectedTestInstantiation, CMathEngineInt8FullyConnectedTest,
+	::testing::Values(
+		CTestParams(
+			"BatchSize = (1..10);"
+			"InputSize = (1..100);"
+			"OutputSize = (1..100);"
+			"Values = (-2..2);"
+			"TestCount = 100;"
+		),
+		CTestParams(
+			"BatchSize = (50..100);"
+			"InputSize = (200..300);"
+			"OutputSize = (1..30);"
+			"Values = (-10..10);"
+			"TestCount = 10;"
+		)
+	)
+);
+
+TEST_P( CMathEngineInt8FullyConnectedTest, Random )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+	RUN_TEST_IMPL( int8FullyConnectedImpl )
+}
@@ -96,6 +96,94 @@ static void batchMultiplyMatrixByTransposedMatrixTestImpl( const CTestParams& pa
 	}
 }
 
+static void multiplyMatrixByPackedTransposedMatrixTestImpl( const CTestParams& params, int seed )
+{
+	CRandom random( seed );
+
+	const CInterval heightInterval = params.GetInterval( "Height" );
+	const CInterval widthInterval = params.GetInterval( "Width" );
+	const CInterval valuesInterval = params.GetInterval( "Values" );
+
+	const int secondHeight = random.UniformInt( heightInterval.Begin, heightInterval.End );
+	const int firstHeight = random.UniformInt( heightInterval.Begin, heightInterval.End );
+	const int firstWidth = random.UniformInt( widthInterval.Begin, widthInterval.End );
+
+	CREATE_FILL_FLOAT_ARRAY( a, valuesInterval.Begin, valuesInterval.End, firstHeight * firstWidth, random )
+	CREATE_FILL_FLOAT_ARRAY( b, valuesInterval.Begin, valuesInterval.End, firstWidth * secondHeight, random )
+
+	std::unique_ptr<CPackedMatrixDesc> packed( MathEngine().InitPackedTransposedMatrix( CARRAY_FLOAT_WRAPPER( b ),
+		secondHeight, firstWidth ) );
+	if( packed == nullptr ) {
+		// Packing is not supported by the math engine
+		return;
+	}
+
+	std::vector<float> exp;
+	exp.insert( exp.begin(), firstHeight * secondHeight, 0.f );
+	multiplyMatrixByTransposedMatrixAndAddNaive( 1, a, b, firstHeight, firstWidth, secondHeight, exp );
+
+	std::vector<float> result;
+	result.resize( firstHeight * secondHeight );
+	// The packed matrix may be used several times
+	for( int run = 0; run < 2; ++run ) {
+		MathEngine().MultiplyMatrixByPackedTransposedMatrix( CARRAY_FLOAT_WRAPPER( a ), firstHeight, firstWidth,
+			*packed, CARRAY_FLOAT_WRAPPER( result ), firstHeight * secondHeight );
+
+		for( int i = 0; i < firstHeight * secondHeight; ++i ) {
+			ASSERT_NEAR( exp[i], result[i], 1e-3 );
+		}
+	}
+}
+
+static void multiplyMatrixByHalfFloatPackedTransposedMatrixTestImpl( const CTestParams& params, int seed )
+{
+	CRandom random( seed );
+
+	const CInterval heightInterval = params.GetInterval( "Height" );
+	const CInterval widthInterval = params.GetInterval( "Width" );
+	const CInterval valuesInterval = params.GetInterval( "Values" );
+
+	const int secondHeight = random.UniformInt( heightInterval.Begin, heightInterval.End );
+	const int firstHeight = random.UniformInt( heightInterval.Begin, heightInterval.End );
+	const int firstWidth = random.UniformInt( widthInterval.Begin, widthInterval.End );
+
+	CREATE_FILL_FLOAT_ARRAY( a, valuesInterval.Begin, valuesInterval.End, firstHeight * firstWidth, random )
+	CREATE_FILL_FLOAT_ARRAY( b, valuesInterval.Begin, valuesInterval.End, firstWidth * secondHeight, random )
+
+	for( THalfFloatFormat format : { HFF_Float16, HFF_BFloat16 } ) {
+		// The relative error of rounding to the 11 or 8 significant bits
+		const float maxRoundingError = format == HFF_Float16 ? 1.f / 2048 : 1.f / 256;
+		// The absolute error of the float16 subnormal values (half of 2^-24)
+		const float maxSubnormalError = format == HFF_Float16 ? ldexpf( 1.f, -25 ) : 0.f;
+		std::vector<uint16_t> halfB( b.size() );
+		ConvertToHalfFloat( format, b.data(), halfB.data(), static_cast<int>( b.size() ) );
+		std::vector<float> roundedB( b.size() );
+		ConvertFromHalfFloat( format, halfB.data(), roundedB.data(), static_cast<int>( b.size() ) );
+		for( size_t i = 0; i < b.size(); ++i ) {
+			ASSERT_NEAR( b[i], roundedB[i], std::max( fabsf( b[i] ) * maxRoundingError, maxSubnormalError ) );
+		}
+
+		std::unique_ptr<CPackedMatrixDesc> packed( MathEngine().InitHalfFloatPackedTransposedMatrix( format,
+			halfB.data(), secondHeight, firstWidth ) );
+		if( packed == nullptr ) {
+			// Not supported by the math engine
+			return;
+		}
+
+		std::vector<float> exp;
+		exp.insert( exp.begin(), firstHeight * secondHeight, 0.f );
+		multiplyMatrixByTransposedMatrixAndAddNaive( 1, a, roundedB, firstHeight, firstWidth, secondHeight, exp );
+
+		std::vector<float> result;
+		result.resize( firstHeight * secondHeight );
+		MathEngine().MultiplyMatrixByPackedTransposedMatrix( CARRAY_FLOAT_WRAPPER( a ), firstHeight, firstWidth,
+			*packed, CARRAY_FLOAT_WRAPPER( result ), firstHeight * secondHeight );
+
+		for( int i = 0; i < firstHeight * secondHeight; ++i ) {
+			ASSERT_NEAR( exp[i], result[i], 1e-3 );
+		}
+	}
+}
 
 //---------------------------------------------------------------------------------------------------------------------
 
@@ -150,3 +238,54 @@ TEST_P( CBatchMultiplyMatrixByTransposedMatrixTest, Random )
 {
 	RUN_TEST_IMPL( batchMultiplyMatrixByTransposedMatrixTestImpl );
 }
+
+class CMultiplyMatrixByPackedTransposedMatrixTest : public CTestFixtureWithParams {
+};
+
+INSTANTIATE_TEST_CASE_P( CMultiplyMatrixByPackedTransposedMatrixTestInstantiation, CMultiplyMatrixByPackedTransposedMatrixTest,
+	::testing::Values(
+		CTestParams(
+			"Height = (1..50);"
+			"Width = (1..50);"
+			"Values = (-1..1);"
+			"TestCount = 100;"
+		),
+		CTestParams(
+			"Height = (100..500);"
+			"Width = (100..500);"
+			"Values = (-1..1);"
+			"TestCount = 5;"
+		)
+	)
+);
+
+TEST_P( CMultiplyMatrixByPackedTransposedMatrixTest, Random )
+{
+	RUN_TEST_IMPL( multiplyMatrixByPackedTransposedMatrixTestImpl );
+}
+
+class CMultiplyMatrixByHalfFloatPackedTransposedMatrixTest : public CTestFixtureWithParams {
+};
+
+INSTANTIATE_TEST_CASE_P( CMultiplyMatrixByHalfFloatPackedTransposedMatrixTestInstantiation,
+	CMultiplyMatrixByHalfFloatPackedTransposedMatrixTest,
+	::testing::Values(
+		CTestParams(
+			"Height = (1..50);"
+			"Width = (1..50);"
+			"Values = (-1..1);"
+			"TestCount = 100;"
+		),
+		CTestParams(
+			"Height = (100..500);"
+			"Width = (100..500);"
+			"Values = (-1..1);"
+			"TestCount = 5;"
+		)
+	)
+);
+
+TEST_P( CMultiplyMatrixByHalfFloatPackedTransposedMatrixTest, Random )
+{
+	RUN_TEST_IMPL( multiplyMatrixByHalfFloatPackedTransposedMatrixTestImpl );
+}
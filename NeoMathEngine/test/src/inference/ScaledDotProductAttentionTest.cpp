@@ -0,0 +1,136 @@
+/* Copyright © 2024 ABBYY Production LLC
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <TestFixture.h>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+static void scaledDotProductAttentionImpl( const CTestParams& params, int seed )
+{
+	CRandom random( seed );
+
+	const CInterval batchSizeInterval = params.GetInterval( "BatchSize" );
+	const CInterval headCountInterval = params.GetInterval( "HeadCount" );
+	const CInterval headSizeInterval = params.GetInterval( "HeadSize" );
+	const CInterval sequenceLengthInterval = params.GetInterval( "SequenceLength" );
+	const CInterval valuesInterval = params.GetInterval( "Values" );
+
+	const int batchSize = random.UniformInt( batchSizeInterval.Begin, batchSizeInterval.End );
+	const int headCount = random.UniformInt( headCountInterval.Begin, headCountInterval.End );
+	const int headSize = random.UniformInt( headSizeInterval.Begin, headSizeInterval.End );
+	const int querySize = random.UniformInt( sequenceLengthInterval.Begin, sequenceLengthInterval.End );
+	const int keySize = random.UniformInt( sequenceLengthInterval.Begin, sequenceLengthInterval.End );
+	const int rowSize = headCount * headSize;
+	const float scale = static_cast<float>( 1. / std::sqrt( headSize ) );
+	// 0 - no mask, 1 - one mask for all, 2 - mask per object and head
+	const int maskMode = random.UniformInt( 0, 2 );
+	const int maskObjectCount = maskMode == 2 ? batchSize * headCount : 1;
+	const float maskMultiplier = -1e9f;
+
+	CREATE_FILL_FLOAT_ARRAY( query, valuesInterval.Begin, valuesInterval.End, batchSize * querySize * rowSize, random )
+	CREATE_FILL_FLOAT_ARRAY( key, valuesInterval.Begin, valuesInterval.End, batchSize * keySize * rowSize, random )
+	CREATE_FILL_FLOAT_ARRAY( value, valuesInterval.Begin, valuesInterval.End, batchSize * keySize * rowSize, random )
+	std::vector<float> mask( maskObjectCount * querySize * keySize );
+	for( float& maskValue : mask ) {
+		maskValue = random.Uniform( 0, 1 ) < 0.3 ? 1.f : 0.f;
+	}
+
+	// The straightforward calculation with the whole matrix of scores
+	std::vector<float> expected( batchSize * querySize * rowSize );
+	std::vector<double> scores( keySize );
+	for( int b = 0; b < batchSize; ++b ) {
+		for( int h = 0; h < headCount; ++h ) {
+			const float* maskData = mask.data() + ( maskObjectCount == 1 ? 0 : ( b * headCount + h ) * querySize * keySize );
+			for( int q = 0; q < querySize; ++q ) {
+				double maxScore = -DBL_MAX;
+				for( int k = 0; k < keySize; ++k ) {
+					double score = 0;
+					for( int i = 0; i < headSize; ++i ) {
+						score += static_cast<double>( query[( b * querySize + q ) * rowSize + h * headSize + i] )
+							* key[( b * keySize + k ) * rowSize + h * headSize + i];
+					}
+					score *= scale;
+					if( maskMode != 0 ) {
+						// Added in float: the fully masked rows get the uniform distribution as in the step-by-step layer
+						score = static_cast<float>( score ) + maskMultiplier * maskData[q * keySize + k];
+					}
+					scores[k] = score;
+					maxScore = std::max( maxScore, score );
+				}
+				double sum = 0;
+				for( int k = 0; k < keySize; ++k ) {
+					scores[k] = std::exp( scores[k] - maxScore );
+					sum += scores[k];
+				}
+				for( int i = 0; i < headSize; ++i ) {
+					double result = 0;
+					for( int k = 0; k < keySize; ++k ) {
+						result += scores[k] * value[( b * keySize + k ) * rowSize + h * headSize + i];
+					}
+					expected[( b * querySize + q ) * rowSize + h * headSize + i] = static_cast<float>( result / sum );
+				}
+			}
+		}
+	}
+
+	CFloatBlob maskBlob( MathEngine(), maskObjectCount, querySize, 1, keySize );
+	maskBlob.CopyFrom( mask.data() );
+	const CConstFloatHandle maskHandle = maskBlob.GetData();
+
+	std::vector<float> result( expected.size() );
+	MathEngine().ScaledDotProductAttention( batchSize, headCount, querySize, keySize, headSize,
+		CARRAY_FLOAT_WRAPPER( query ), CARRAY_FLOAT_WRAPPER( key ), CARRAY_FLOAT_WRAPPER( value ), scale,
+		maskMode == 0 ? nullptr : &maskHandle, maskObjectCount, maskMultiplier, CARRAY_FLOAT_WRAPPER( result ) );
+
+	for( size_t i = 0; i < expected.size(); ++i ) {
+		ASSERT_NEAR( expected[i], result[i], 1e-4f );
+	}
+}
+
+//------------------------------------------------------------------------------------------------------------
+
+class CMathEngineScaledDotProductAttentionTest : public CTestFixtureWithParams {
+};
+
+INSTANTIATE_TEST_CASE_P( CMathEngineScaledDotProductAttentionTestInstantiation,
+	CMathEngineScaledDotProductAttentionTest,
+	::testing::Values(
+		CTestParams(
+			"BatchSize = (1..3);"
+			"HeadCount = (1..4);"
+			"HeadSize = (1..16);"
+			"SequenceLength = (1..20);"
+			"Values = (-2..2);"
+			"TestCount = 100;"
+		),
+		CTestParams(
+			"BatchSize = (1..2);"
+			"HeadCount = (1..2);"
+			"HeadSize = (8..32);"
+			"SequenceLength = (60..600);"
+			"Values = (-1..1);"
+			"TestCount = 5;"
+		)
+	)
+);
+
+TEST_P( CMathEngineScaledDotProductAttentionTest, Random )
+{
+	if( MathEngine().GetType() != MET_Cpu ) {
+		return;
+	}
+	RUN_TEST_IMPL( scaledDotProductAttentionImpl )
+}
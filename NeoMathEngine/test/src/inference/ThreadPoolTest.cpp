@@ -0,0 +1,124 @@
+/* Copyright © 2024 ABBYY
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+	http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+--------------------------------------------------------------------------------------------------------------*/
+
+#include <TestFixture.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace NeoML;
+using namespace NeoMLTest;
+
+namespace NeoMLTest {
+
+struct CParallelForTestParams final {
+	explicit CParallelForTestParams( int count, int threadCount ) :
+		Visits( count ), IsThreadBusy( threadCount ) {}
+
+	std::vector<std::atomic<int>> Visits; // how many times each index has been processed
+	std::vector<std::atomic<bool>> IsThreadBusy; // checks that the same thread index isn't used simultaneously
+	std::atomic<bool> IsCorrect{ true };
+};
+
+static void parallelForTestFunction( int threadIndex, int begin, int end, void* ptr )
+{
+	CParallelForTestParams& params = *static_cast<CParallelForTestParams*>( ptr );
+	if( threadIndex < 0 || threadIndex >= static_cast<int>( params.IsThreadBusy.size() )
+		|| params.IsThreadBusy[threadIndex].exchange( true ) || begin >= end )
+	{
+		params.IsCorrect = false;
+		return;
+	}
+	for( int i = begin; i < end; ++i ) {
+		params.Visits[i]++;
+		if( i % 7 == 0 ) {
+			// Unbalanced work
+			std::this_thread::yield();
+		}
+	}
+	params.IsThreadBusy[threadIndex] = false;
+}
+
+static void parallelForTestImpl( IThreadPool& threadPool, int count, int grainSize )
+{
+	CParallelForTestParams params( count, threadPool.Size() );
+	threadPool.ParallelFor( count, grainSize, parallelForTestFunction, &params );
+	EXPECT_TRUE( params.IsCorrect.load() );
+	for( int i = 0; i < count; ++i ) {
+		ASSERT_EQ( 1, params.Visits[i].load() ) << "index " << i;
+	}
+}
+
+struct CNestedParallelForTestParams final {
+	IThreadPool* ThreadPool{};
+	std::atomic<int> Sum{};
+};
+
+static void nestedParallelForTestFunction( int threadIndex, int begin, int end, void* ptr )
+{
+	CNestedParallelForTestParams& params = *static_cast<CNestedParallelForTestParams*>( ptr );
+	for( int i = begin; i < end; ++i ) {
+		int innerThreadIndex = -1;
+		std::atomic<int> innerSum{};
+		std::pair<int*, std::atomic<int>*> innerParams( &innerThreadIndex, &innerSum );
+		params.ThreadPool->ParallelFor( 10, 1, []( int thread, int innerBegin, int innerEnd, void* innerPtr ) {
+			auto& inner = *static_cast<std::pair<int*, std::atomic<int>*>*>( innerPtr );
+			*inner.first = thread;
+			*inner.second += innerEnd - innerBegin;
+		}, &innerParams );
+		// The nested loop is executed in the calling thread
+		EXPECT_EQ( threadIndex, innerThreadIndex );
+		params.Sum += innerSum;
+	}
+}
+
+} // namespace NeoMLTest
+
+//------------------------------------------------------------------------------------------------------------
+
+TEST( CThreadPoolTest, ParallelFor )
+{
+	for( int threadCount : { 1, 2, 4, 7 } ) {
+		std::unique_ptr<IThreadPool> threadPool( CreateThreadPool( threadCount ) );
+		for( int count : { 0, 1, 3, 100, 1000, 12345 } ) {
+			for( int grainSize : { 0, 1, 16, 100000 } ) {
+				parallelForTestImpl( *threadPool, count, grainSize );
+			}
+		}
+	}
+}
+
+TEST( CThreadPoolTest, NestedParallelFor )
+{
+	std::unique_ptr<IThreadPool> threadPool( CreateThreadPool( 4 ) );
+	CNestedParallelForTestParams params;
+	params.ThreadPool = threadPool.get();
+	threadPool->ParallelFor( 100, 1, nestedParallelForTestFunction, &params );
+	EXPECT_EQ( 1000, params.Sum.load() );
+}
+
+TEST( CThreadPoolTest, ParallelForAfterTasks )
+{
+	std::unique_ptr<IThreadPool> threadPool( CreateThreadPool( 3 ) );
+	std::atomic<int> taskCount{};
+	for( int run = 0; run < 10; ++run ) {
+		// The tasks added directly and the parallel loops are executed in turn
+		ExecuteTasks( *threadPool, &taskCount, []( int, void* ptr ) { ( *static_cast<std::atomic<int>*>( ptr ) )++; } );
+		parallelForTestImpl( *threadPool, 1000, 10 );
+	}
+	EXPECT_EQ( 30, taskCount.load() );
+}